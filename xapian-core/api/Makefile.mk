@@ -2,6 +2,7 @@ noinst_HEADERS +=\
 	api/documentvaluelist.h\
 	api/editdistance.h\
 	api/maptermlist.h\
+	api/resultcache.h\
 	api/vectortermlist.h
 
 EXTRA_DIST +=\
@@ -9,6 +10,7 @@ EXTRA_DIST +=\
 	api/Makefile
 
 lib_src +=\
+	api/bulkbuilder.cc\
 	api/compactor.cc\
 	api/decvalwtsource.cc\
 	api/documentvaluelist.cc\
@@ -31,6 +33,7 @@ lib_src +=\
 	api/postlist.cc\
 	api/registry.cc\
 	api/replication.cc\
+	api/resultcache.cc\
 	api/sortable-serialise.cc\
 	api/termiterator.cc\
 	api/termlist.cc\
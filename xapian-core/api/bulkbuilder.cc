@@ -0,0 +1,339 @@
+/** @file bulkbuilder.cc
+ * @brief Build a new database from many documents using several threads.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include <xapian/bulkbuilder.h>
+
+#include <xapian/compactor.h>
+#include <xapian/database.h>
+#include <xapian/dbfactory.h>
+#include <xapian/document.h>
+#include <xapian/error.h>
+#include <xapian/termgenerator.h>
+
+#include "safeerrno.h"
+#include "safeunistd.h"
+
+#include "autoptr.h"
+#include "debuglog.h"
+#include "omassert.h"
+#include "str.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/** How much memory to use to buffer the changes for each run.
+ *
+ *  Each run is committed once when its batch is complete, so buffering more
+ *  means fewer intermediate flushes while a batch is indexed.
+ */
+const size_t RUN_FLUSH_MEMORY = 128 * 1024 * 1024;
+
+namespace Xapian {
+
+/// Index a batch of records into a run database.
+class BulkBuildTask : public ThreadTask {
+    /// The indexer, whose setup() and index() methods we call.
+    const BulkIndexer & indexer;
+
+    /// The directory to create the run in.
+    string rundir;
+
+    /// The document id to give the first record.
+    Xapian::docid first_did;
+
+    /// The records in this batch.
+    vector<string> records;
+
+  protected:
+    void run();
+
+  public:
+    BulkBuildTask(const BulkIndexer & indexer_, const string & rundir_,
+		  Xapian::docid first_did_)
+	: indexer(indexer_), rundir(rundir_), first_did(first_did_) { }
+
+    const string & get_rundir() const { return rundir; }
+
+    void add_record(const string & record) { records.push_back(record); }
+
+    Xapian::doccount size() const { return records.size(); }
+};
+
+void
+BulkBuildTask::run()
+{
+    Xapian::WritableDatabase db =
+	Xapian::Brass::open(rundir, Xapian::DB_CREATE_OR_OVERWRITE);
+    db.set_flush_memory_limit(RUN_FLUSH_MEMORY);
+
+    Xapian::TermGenerator termgen;
+    indexer.setup(termgen);
+
+    Xapian::docid did = first_did;
+    vector<string>::const_iterator i;
+    for (i = records.begin(); i != records.end(); ++i) {
+	Xapian::Document doc;
+	termgen.set_document(doc);
+	indexer.index(*i, doc, termgen);
+	db.replace_document(did++, doc);
+    }
+    db.commit();
+    db.close();
+
+    // Free the records now rather than when the task is deleted.
+    vector<string>().swap(records);
+}
+
+class BulkBuilder::Internal : public Xapian::Internal::intrusive_base {
+    friend class BulkBuilder;
+
+    string destdir;
+
+    /// The indexer to use for each batch.
+    const BulkIndexer & indexer;
+
+    Xapian::doccount batch_size;
+
+    /// The worker threads.
+    ThreadPool pool;
+
+    /// The batch currently being collected, or NULL if none.
+    AutoPtr<BulkBuildTask> current;
+
+    /// Batches which have been started, oldest first.
+    deque<BulkBuildTask *> running;
+
+    /// The runs which have been written, in ascending docid order.
+    vector<string> runs;
+
+    /// The document id to give the next record added.
+    Xapian::docid next_did;
+
+    /// True once finish() has been called.
+    bool finished;
+
+    /// Start indexing the current batch.
+    void start_batch();
+
+    /// Wait for the oldest running batch to finish.
+    void wait_for_batch();
+
+    /// Wait for all running batches, ignoring any exceptions.
+    void abandon_batches();
+
+    /// Remove the runs written so far.
+    void remove_runs();
+
+  public:
+    Internal(const string & destdir_, const BulkIndexer & indexer_,
+	     unsigned threads)
+	: destdir(destdir_), indexer(indexer_), batch_size(100000),
+	  pool(threads), next_did(1), finished(false) { }
+
+    ~Internal() {
+	abandon_batches();
+	try {
+	    remove_runs();
+	} catch (...) {
+	}
+    }
+};
+
+void
+BulkBuilder::Internal::start_batch()
+{
+    // Limit the number of batches in memory at once.
+    while (running.size() > pool.size())
+	wait_for_batch();
+    running.push_back(current.release());
+    pool.start(running.back());
+}
+
+void
+BulkBuilder::Internal::wait_for_batch()
+{
+    Assert(!running.empty());
+    AutoPtr<BulkBuildTask> task(running.front());
+    running.pop_front();
+    try {
+	pool.wait(task.get());
+    } catch (...) {
+	runs.push_back(task->get_rundir());
+	abandon_batches();
+	finished = true;
+	throw;
+    }
+    runs.push_back(task->get_rundir());
+}
+
+void
+BulkBuilder::Internal::abandon_batches()
+{
+    while (!running.empty()) {
+	AutoPtr<BulkBuildTask> task(running.front());
+	running.pop_front();
+	runs.push_back(task->get_rundir());
+	try {
+	    pool.wait(task.get());
+	} catch (...) {
+	}
+    }
+    current.reset();
+}
+
+void
+BulkBuilder::Internal::remove_runs()
+{
+    vector<string>::const_iterator i;
+    for (i = runs.begin(); i != runs.end(); ++i) {
+	removedir(*i);
+    }
+    runs.clear();
+    // Remove the directory which held the runs (if we created it).
+    (void)rmdir((destdir + "/bulkruns").c_str());
+}
+
+BulkIndexer::~BulkIndexer() { }
+
+void
+BulkIndexer::setup(Xapian::TermGenerator &) const
+{
+}
+
+void
+BulkIndexer::index(const string & record,
+		   Xapian::Document & doc,
+		   Xapian::TermGenerator & termgen) const
+{
+    doc.set_data(record);
+    termgen.index_text(record);
+}
+
+/// The indexer used if the caller doesn't supply one.
+static const BulkIndexer default_indexer;
+
+BulkBuilder::BulkBuilder(const string & destdir, unsigned threads)
+    : internal(new BulkBuilder::Internal(destdir, default_indexer, threads))
+{
+    LOGCALL_CTOR(API, "BulkBuilder", destdir | threads);
+}
+
+BulkBuilder::BulkBuilder(const string & destdir,
+			 const BulkIndexer & indexer,
+			 unsigned threads)
+    : internal(new BulkBuilder::Internal(destdir, indexer, threads))
+{
+    LOGCALL_CTOR(API, "BulkBuilder", destdir | Literal("indexer") | threads);
+}
+
+BulkBuilder::~BulkBuilder()
+{
+    LOGCALL_DTOR(API, "BulkBuilder");
+    // Wait for the worker threads to stop using the indexer now, as the
+    // caller may destroy it as soon as we return.
+    internal->abandon_batches();
+}
+
+void
+BulkBuilder::set_batch_size(Xapian::doccount batch_size)
+{
+    LOGCALL_VOID(API, "BulkBuilder::set_batch_size", batch_size);
+    if (batch_size == 0)
+	throw Xapian::InvalidArgumentError("Batch size must be at least 1");
+    internal->batch_size = batch_size;
+}
+
+void
+BulkBuilder::add_record(const string & record)
+{
+    LOGCALL_VOID(API, "BulkBuilder::add_record", record);
+    Internal & i = *internal;
+    if (i.finished)
+	throw Xapian::InvalidOperationError("BulkBuilder already finished");
+    if (!i.current.get()) {
+	if (i.runs.empty() && i.running.empty()) {
+	    // Create the directory the runs are written to.
+	    string rundir = i.destdir + "/bulkruns";
+	    if (mkdir(i.destdir, 0755) < 0 && errno != EEXIST) {
+		throw Xapian::DatabaseError("Cannot create directory '" +
+					    i.destdir + "'", errno);
+	    }
+	    if (mkdir(rundir, 0755) < 0 && errno != EEXIST) {
+		throw Xapian::DatabaseError("Cannot create directory '" +
+					    rundir + "'", errno);
+	    }
+	}
+	string rundir = i.destdir;
+	rundir += "/bulkruns/";
+	rundir += str(i.runs.size() + i.running.size());
+	i.current.reset(new BulkBuildTask(i.indexer, rundir, i.next_did));
+    }
+    i.current->add_record(record);
+    ++i.next_did;
+    if (i.current->size() >= i.batch_size)
+	i.start_batch();
+}
+
+void
+BulkBuilder::finish()
+{
+    LOGCALL_VOID(API, "BulkBuilder::finish", NO_ARGS);
+    Internal & i = *internal;
+    if (i.finished)
+	throw Xapian::InvalidOperationError("BulkBuilder already finished");
+    i.finished = true;
+    if (i.current.get())
+	i.start_batch();
+    while (!i.running.empty())
+	i.wait_for_batch();
+
+    if (i.runs.empty()) {
+	// No records were added, so just create an empty database.
+	(void)Xapian::Brass::open(i.destdir, Xapian::DB_CREATE_OR_OVERWRITE);
+	return;
+    }
+
+    {
+	Xapian::Compactor compactor;
+	// Each run has its own range of document ids, and there are no gaps
+	// between them, so they can just be merged.
+	compactor.set_renumber(false);
+	compactor.set_multipass(i.runs.size() > 3);
+	compactor.set_threads(i.pool.size());
+	compactor.set_destdir(i.destdir);
+	vector<string>::const_iterator j;
+	for (j = i.runs.begin(); j != i.runs.end(); ++j) {
+	    compactor.add_source(*j);
+	}
+	compactor.compact();
+    }
+
+    i.remove_runs();
+}
+
+}
@@ -86,6 +86,8 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     string destdir;
     bool renumber;
     bool multipass;
+    unsigned threads;
+    size_t io_rate_limit;
     int compact_to_stub;
     size_t block_size;
     compaction_level compaction;
@@ -104,7 +106,8 @@ class Compactor::Internal : public Xapian::Internal::intrusive_base {
     vector<pair<Xapian::docid, Xapian::docid> > used_ranges;
   public:
     Internal()
-	: renumber(true), multipass(false),
+	: renumber(true), multipass(false), threads(1),
+	  io_rate_limit(0),
 	  block_size(8192), compaction(FULL), tot_off(0),
 	  last_docid(0), backend(UNKNOWN)
     {
@@ -139,6 +142,18 @@ Compactor::set_multipass(bool multipass)
     internal->multipass = multipass;
 }
 
+void
+Compactor::set_threads(unsigned threads)
+{
+    internal->threads = threads;
+}
+
+void
+Compactor::set_io_rate_limit(size_t bytes_per_second)
+{
+    internal->io_rate_limit = bytes_per_second;
+}
+
 void
 Compactor::set_compaction_level(compaction_level compaction)
 {
@@ -458,7 +473,8 @@ Compactor::Internal::compact(Xapian::Compactor & compactor)
     } else if (backend == BRASS) {
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	compact_brass(compactor, destdir.c_str(), sources, offset, block_size,
-		      compaction, multipass, last_docid);
+		      compaction, multipass, last_docid, threads,
+		      io_rate_limit);
 #else
 	throw Xapian::FeatureUnavailableError("Brass backend disabled at build time");
 #endif
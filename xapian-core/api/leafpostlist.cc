@@ -67,6 +67,12 @@ LeafPostList::get_maxweight() const
     return weight ? weight->get_maxpart() : 0;
 }
 
+Xapian::weight
+LeafPostList::get_maxweight_for_wdf(Xapian::termcount wdf_max) const
+{
+    return weight ? weight->get_maxpart_for_wdf_(wdf_max) : 0;
+}
+
 Xapian::weight
 LeafPostList::get_weight() const
 {
@@ -102,8 +102,11 @@ Database::reopen()
     bool maybe_changed = false;
     vector<intrusive_ptr<Database::Internal> >::iterator i;
     for (i = internal.begin(); i != internal.end(); ++i) {
-	if ((*i)->reopen())
+	if ((*i)->reopen()) {
 	    maybe_changed = true;
+	    // Cached filter results are only valid for the old revision.
+	    (*i)->filter_cache.clear();
+	}
     }
     return maybe_changed;
 }
@@ -118,6 +121,28 @@ Database::close()
     }
 }
 
+void
+Database::set_filter_cache_size(size_t bytes)
+{
+    LOGCALL_VOID(API, "Database::set_filter_cache_size", bytes);
+    vector<intrusive_ptr<Database::Internal> >::iterator i;
+    for (i = internal.begin(); i != internal.end(); ++i) {
+	(*i)->filter_cache.set_max_size(bytes);
+    }
+}
+
+unsigned long
+Database::get_filter_cache_hits() const
+{
+    LOGCALL(API, unsigned long, "Database::get_filter_cache_hits", NO_ARGS);
+    unsigned long hits = 0;
+    vector<intrusive_ptr<Database::Internal> >::const_iterator i;
+    for (i = internal.begin(); i != internal.end(); ++i) {
+	hits += (*i)->filter_cache.get_hits();
+    }
+    RETURN(hits);
+}
+
 void
 Database::add_database(const Database & database)
 {
@@ -785,6 +810,38 @@ WritableDatabase::commit()
     internal[0]->commit();
 }
 
+void
+WritableDatabase::commit_async()
+{
+    LOGCALL_VOID(API, "WritableDatabase::commit_async", NO_ARGS);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->commit_async();
+}
+
+void
+WritableDatabase::wait_for_commit()
+{
+    LOGCALL_VOID(API, "WritableDatabase::wait_for_commit", NO_ARGS);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->wait_for_commit();
+}
+
+void
+WritableDatabase::set_commit_window(double seconds)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_commit_window", seconds);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->set_commit_window(seconds);
+}
+
+void
+WritableDatabase::set_flush_memory_limit(size_t bytes)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_flush_memory_limit", bytes);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->set_flush_memory_limit(bytes);
+}
+
 void
 WritableDatabase::begin_transaction(bool flushed)
 {
@@ -806,6 +863,7 @@ WritableDatabase::cancel_transaction()
 {
     LOGCALL_VOID(API, "WritableDatabase::cancel_transaction", NO_ARGS);
     if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->filter_cache.clear();
     internal[0]->cancel_transaction();
 }
 
@@ -815,6 +873,7 @@ WritableDatabase::add_document(const Document & document)
 {
     LOGCALL(API, Xapian::docid, "WritableDatabase::add_document", document);
     if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->filter_cache.clear();
     RETURN(internal[0]->add_document(document));
 }
 
@@ -825,6 +884,7 @@ WritableDatabase::delete_document(Xapian::docid did)
     if (internal.size() != 1) only_one_subdatabase_allowed();
     if (did == 0)
 	docid_zero_invalid();
+    internal[0]->filter_cache.clear();
     internal[0]->delete_document(did);
 }
 
@@ -835,6 +895,7 @@ WritableDatabase::delete_document(const std::string & unique_term)
     if (internal.size() != 1) only_one_subdatabase_allowed();
     if (unique_term.empty())
 	throw InvalidArgumentError("Empty termnames are invalid");
+    internal[0]->filter_cache.clear();
     internal[0]->delete_document(unique_term);
 }
 
@@ -845,6 +906,7 @@ WritableDatabase::replace_document(Xapian::docid did, const Document & document)
     if (internal.size() != 1) only_one_subdatabase_allowed();
     if (did == 0)
 	docid_zero_invalid();
+    internal[0]->filter_cache.clear();
     internal[0]->replace_document(did, document);
 }
 
@@ -856,9 +918,58 @@ WritableDatabase::replace_document(const std::string & unique_term,
     if (internal.size() != 1) only_one_subdatabase_allowed();
     if (unique_term.empty())
 	throw InvalidArgumentError("Empty termnames are invalid");
+    internal[0]->filter_cache.clear();
     RETURN(internal[0]->replace_document(unique_term, document));
 }
 
+vector<Xapian::docid>
+WritableDatabase::add_documents(const vector<Document> & documents)
+{
+    LOGCALL_VOID(API, "WritableDatabase::add_documents", documents.size());
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    vector<Xapian::docid> dids;
+    internal[0]->filter_cache.clear();
+    if (!documents.empty()) internal[0]->add_documents(documents, dids);
+    return dids;
+}
+
+void
+WritableDatabase::replace_documents(const vector<Xapian::docid> & dids,
+				    const vector<Document> & documents)
+{
+    LOGCALL_VOID(API, "WritableDatabase::replace_documents", dids.size() | documents.size());
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    if (dids.size() != documents.size())
+	throw InvalidArgumentError("Need one document for each document id");
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	if (*i == 0)
+	    docid_zero_invalid();
+    }
+    internal[0]->filter_cache.clear();
+    if (!dids.empty()) internal[0]->replace_documents(dids, documents);
+}
+
+vector<Xapian::docid>
+WritableDatabase::replace_documents(const vector<string> & unique_terms,
+				    const vector<Document> & documents)
+{
+    LOGCALL_VOID(API, "WritableDatabase::replace_documents", unique_terms.size() | documents.size());
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    if (unique_terms.size() != documents.size())
+	throw InvalidArgumentError("Need one document for each unique term");
+    vector<string>::const_iterator i;
+    for (i = unique_terms.begin(); i != unique_terms.end(); ++i) {
+	if (i->empty())
+	    throw InvalidArgumentError("Empty termnames are invalid");
+    }
+    vector<Xapian::docid> dids;
+    internal[0]->filter_cache.clear();
+    if (!unique_terms.empty())
+	internal[0]->replace_documents(unique_terms, documents, dids);
+    return dids;
+}
+
 void
 WritableDatabase::add_spelling(const std::string & word,
 			       Xapian::termcount freqinc) const
@@ -913,6 +1024,14 @@ WritableDatabase::set_metadata(const string & key, const string & value)
     internal[0]->set_metadata(key, value);
 }
 
+void
+WritableDatabase::set_value_index(Xapian::valueno slot, bool enabled)
+{
+    LOGCALL_VOID(API, "WritableDatabase::set_value_index", slot | enabled);
+    if (internal.size() != 1) only_one_subdatabase_allowed();
+    internal[0]->set_value_index(slot, enabled);
+}
+
 string
 WritableDatabase::get_description() const
 {
@@ -41,7 +41,11 @@
 #include "multimatch.h"
 #include "omassert.h"
 #include "omenquireinternal.h"
+#include "resultcache.h"
+#include "serialise.h"
+#include "serialise-double.h"
 #include "str.h"
+#include "threadpool.h"
 #include "weightinternal.h"
 
 #include <algorithm>
@@ -625,7 +629,7 @@ Enquire::Internal::Internal(const Database &db_, ErrorHandler * errorhandler_)
   : db(db_), query(), collapse_key(Xapian::BAD_VALUENO), collapse_max(0),
     order(Enquire::ASCENDING), percent_cutoff(0), weight_cutoff(0),
     sort_key(Xapian::BAD_VALUENO), sort_by(REL), sort_value_forward(true),
-    sorter(0), errorhandler(errorhandler_), weight(0)
+    sorter(0), errorhandler(errorhandler_), weight(0), search_threads(1)
 {
     if (db.internal.empty()) {
 	throw InvalidArgumentError("Can't make an Enquire object from an uninitialised Database object.");
@@ -651,6 +655,55 @@ Enquire::Internal::get_query()
     return query;
 }
 
+string
+Enquire::Internal::get_result_cache_key(const RSet *omrset,
+					const MatchDecider *mdecider) const
+{
+    LOGCALL(MATCH, string, "Enquire::Internal::get_result_cache_key", omrset | mdecider);
+    // We can't tell if results which depend on these would be the same.
+    if ((omrset && !omrset->empty()) || mdecider || !spies.empty() ||
+	sorter || errorhandler) {
+	RETURN(string());
+    }
+
+    string key = encode_length(db.internal.size());
+    vector<Xapian::Internal::intrusive_ptr<Database::Internal> >::const_iterator i;
+    for (i = db.internal.begin(); i != db.internal.end(); ++i) {
+	string revision = (*i)->get_revision_key();
+	if (revision.empty()) RETURN(string());
+	key += encode_length(revision.size());
+	key += revision;
+    }
+
+    string weight_name = weight->name();
+    if (weight_name.empty()) RETURN(string());
+    try {
+	string q = query.serialise();
+	key += encode_length(q.size());
+	key += q;
+	string params = weight->serialise();
+	key += encode_length(weight_name.size());
+	key += weight_name;
+	key += encode_length(params.size());
+	key += params;
+    } catch (const Xapian::Error &) {
+	// The query includes a PostingSource which can't be serialised, or
+	// the weighting scheme's parameters can't be.
+	RETURN(string());
+    }
+
+    key += encode_length(qlen);
+    key += encode_length(collapse_key);
+    key += encode_length(collapse_max);
+    key += encode_length(int(order));
+    key += encode_length(percent_cutoff);
+    key += serialise_double(weight_cutoff);
+    key += encode_length(sort_key);
+    key += encode_length(int(sort_by));
+    key += char(sort_value_forward);
+    RETURN(key);
+}
+
 MSet
 Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    Xapian::doccount check_at_least, const RSet *rset,
@@ -675,6 +728,38 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	check_at_least = max(check_at_least, maxitems);
     }
 
+    // Only searches which want some results are cached, since just
+    // wanting the statistics is already cheap.
+    string cache_key;
+    if (maxitems != 0 && ResultCache::enabled()) {
+	cache_key = get_result_cache_key(rset, mdecider);
+    }
+    if (!cache_key.empty()) {
+	// Documents beyond first + maxitems are only checked once
+	// first + maxitems candidates have been found, so this doesn't change
+	// the results.
+	check_at_least = max(check_at_least, first + maxitems);
+	MSet::Internal * cached =
+	    ResultCache::lookup(cache_key, first, maxitems, check_at_least);
+	if (cached) {
+	    MSet retval(cached);
+	    retval.internal->firstitem = first_orig;
+	    retval.internal->enquire = this;
+	    RETURN(retval);
+	}
+	// Run the match for all the items up to the ones wanted, so the
+	// cached results can answer requests for earlier pages too.
+	maxitems += first;
+	first = 0;
+    }
+
+    if (search_threads > 1 && !pool.get()) {
+	// There's no point having more threads than sub-databases.
+	unsigned n_threads = search_threads;
+	if (n_threads > db.internal.size()) n_threads = db.internal.size();
+	pool.reset(new ThreadPool(n_threads));
+    }
+
     Xapian::Weight::Internal stats;
     ::MultiMatch match(db, query.internal.get(), qlen, rset,
 		       collapse_max, collapse_key,
@@ -682,11 +767,20 @@ Enquire::Internal::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		       order, sort_key, sort_by, sort_value_forward,
 		       errorhandler, stats, weight, spies,
 		       (sorter != NULL),
-		       (mdecider != NULL));
+		       (mdecider != NULL),
+		       pool.get());
     // Run query and put results into supplied Xapian::MSet object.
     MSet retval;
     match.get_mset(first, maxitems, check_at_least, retval,
 		   stats, mdecider, sorter);
+    if (!cache_key.empty()) {
+	ResultCache::add(cache_key, maxitems, check_at_least, *retval.internal);
+	// Drop the items before those wanted.
+	vector<Xapian::Internal::MSetItem> & items = retval.internal->items;
+	Xapian::doccount n = min(first_orig, Xapian::doccount(items.size()));
+	items.erase(items.begin(), items.begin() + n);
+	retval.internal->firstitem = first_orig;
+    }
     if (first_orig != first && retval.internal.get()) {
 	retval.internal->firstitem = first_orig;
     }
@@ -947,8 +1041,21 @@ Enquire::set_cutoff(int percent_cutoff, Xapian::weight weight_cutoff)
     internal->weight_cutoff = weight_cutoff;
 }
 
+void
+Enquire::set_search_threads(unsigned threads)
+{
+    LOGCALL_VOID(API, "Xapian::Enquire::set_search_threads", threads);
+    if (threads != internal->search_threads) {
+	// Stop any existing worker threads - a pool of the new size will be
+	// created when it's next needed.
+	internal->pool.reset();
+	internal->search_threads = threads;
+    }
+}
+
 void
 Enquire::set_sort_by_relevance()
+
 {
     internal->sort_by = Internal::REL;
 }
@@ -52,6 +52,12 @@ PostingIterator::Internal::get_collapse_key() const
     return NULL;
 }
 
+const string *
+PostingIterator::Internal::get_sort_key() const
+{
+    return NULL;
+}
+
 PositionList *
 PostList::read_position_list()
 {
@@ -0,0 +1,262 @@
+/** @file resultcache.cc
+ * @brief Process-wide cache of search results.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "resultcache.h"
+
+#include "xapian/resultcache.h"
+
+#include "debuglog.h"
+#include "mutex.h"
+#include "omassert.h"
+#include "omenquireinternal.h"
+
+#include <algorithm>
+#include <cstdlib> // For getenv() and atol().
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+typedef map<string, Xapian::MSet::Internal::TermFreqAndWeight> TermFreqMap;
+
+struct CachedResult {
+    string key;
+
+    /// The number of items the match was run for.
+    Xapian::doccount maxitems;
+
+    /// The check_at_least value the match was run with.
+    Xapian::doccount check_at_least;
+
+    vector<Xapian::Internal::MSetItem> items;
+
+    TermFreqMap termfreqandwts;
+
+    Xapian::doccount matches_lower_bound;
+    Xapian::doccount matches_estimated;
+    Xapian::doccount matches_upper_bound;
+    Xapian::doccount uncollapsed_lower_bound;
+    Xapian::doccount uncollapsed_estimated;
+    Xapian::doccount uncollapsed_upper_bound;
+    Xapian::weight max_possible;
+    Xapian::weight max_attained;
+    double percent_factor;
+
+    /// Approximate number of bytes of memory used.
+    size_t size;
+
+    CachedResult(const string & key_, Xapian::doccount maxitems_,
+		 Xapian::doccount check_at_least_)
+	: key(key_), maxitems(maxitems_), check_at_least(check_at_least_),
+	  size(0) { }
+
+    /// Copy the results from @a mset.
+    void set(const Xapian::MSet::Internal & mset) {
+	items = mset.items;
+	termfreqandwts = mset.termfreqandwts;
+	matches_lower_bound = mset.matches_lower_bound;
+	matches_estimated = mset.matches_estimated;
+	matches_upper_bound = mset.matches_upper_bound;
+	uncollapsed_lower_bound = mset.uncollapsed_lower_bound;
+	uncollapsed_estimated = mset.uncollapsed_estimated;
+	uncollapsed_upper_bound = mset.uncollapsed_upper_bound;
+	max_possible = mset.max_possible;
+	max_attained = mset.max_attained;
+	percent_factor = mset.percent_factor;
+
+	size = sizeof(CachedResult) + key.size();
+	vector<Xapian::Internal::MSetItem>::const_iterator i;
+	for (i = items.begin(); i != items.end(); ++i) {
+	    size += sizeof(*i) + i->collapse_key.size() + i->sort_key.size();
+	}
+	TermFreqMap::const_iterator t;
+	for (t = termfreqandwts.begin(); t != termfreqandwts.end(); ++t) {
+	    // Allow for the overhead of a node of the map.
+	    size += sizeof(*t) + t->first.size() + 4 * sizeof(void*);
+	}
+    }
+
+    /// Build an MSet::Internal holding items [first, first + n).
+    Xapian::MSet::Internal * slice(Xapian::doccount first,
+				   Xapian::doccount n) const {
+	vector<Xapian::Internal::MSetItem> result;
+	if (first < items.size()) {
+	    Xapian::doccount end = min(Xapian::doccount(items.size()),
+				       first + n);
+	    result.assign(items.begin() + first, items.begin() + end);
+	}
+	return new Xapian::MSet::Internal(first,
+					  matches_upper_bound,
+					  matches_lower_bound,
+					  matches_estimated,
+					  uncollapsed_upper_bound,
+					  uncollapsed_lower_bound,
+					  uncollapsed_estimated,
+					  max_possible, max_attained,
+					  result, termfreqandwts,
+					  percent_factor);
+    }
+};
+
+typedef list<CachedResult> lru_list;
+
+/// Protects all the variables below.
+Mutex mutex;
+
+/// Most recently used result at the front.
+lru_list lru;
+
+map<string, lru_list::iterator> index;
+
+/// Approximate number of bytes used by cached results.
+size_t used = 0;
+
+unsigned long hits = 0, misses = 0;
+
+/// The total size limit (in bytes) of the cache.
+size_t cache_size = 0;
+
+/// Discard least recently used results until no more than limit is used.
+void
+trim(size_t limit)
+{
+    while (used > limit) {
+	CachedResult & victim = lru.back();
+	used -= victim.size;
+	index.erase(victim.key);
+	lru.pop_back();
+    }
+}
+
+/// Read the initial size from the environment.
+class InitFromEnvironment {
+  public:
+    InitFromEnvironment() {
+	const char * p = getenv("XAPIAN_RESULT_CACHE_SIZE");
+	if (p) cache_size = size_t(atol(p));
+    }
+};
+
+InitFromEnvironment init_from_environment;
+
+}
+
+namespace ResultCache {
+
+bool
+enabled()
+{
+    MutexLock lock(mutex);
+    return cache_size != 0;
+}
+
+Xapian::MSet::Internal *
+lookup(const string & key, Xapian::doccount first, Xapian::doccount maxitems,
+       Xapian::doccount check_at_least)
+{
+    LOGCALL_STATIC(MATCH, Xapian::MSet::Internal *, "ResultCache::lookup", key | first | maxitems | check_at_least);
+    AssertRel(check_at_least,>=,first + maxitems);
+    MutexLock lock(mutex);
+    map<string, lru_list::iterator>::iterator i = index.find(key);
+    if (i == index.end() ||
+	i->second->maxitems < first + maxitems ||
+	i->second->check_at_least < check_at_least) {
+	++misses;
+	RETURN(NULL);
+    }
+    ++hits;
+    // Move to the front of the LRU list.
+    lru.splice(lru.begin(), lru, i->second);
+    RETURN(i->second->slice(first, maxitems));
+}
+
+void
+add(const string & key, Xapian::doccount maxitems,
+    Xapian::doccount check_at_least, const Xapian::MSet::Internal & mset)
+{
+    LOGCALL_STATIC_VOID(MATCH, "ResultCache::add", key | maxitems | check_at_least | Literal("mset"));
+    Assert(mset.firstitem == 0);
+    // Build the entry before taking the lock, as copying the items may take
+    // a while.
+    lru_list entry;
+    entry.push_back(CachedResult(key, maxitems, check_at_least));
+    entry.front().set(mset);
+
+    MutexLock lock(mutex);
+    if (entry.front().size > cache_size) return;
+    map<string, lru_list::iterator>::iterator i = index.find(key);
+    if (i != index.end()) {
+	// Replace the results for fewer items (or less checking) which the
+	// caller couldn't use.
+	used -= i->second->size;
+	lru.erase(i->second);
+	index.erase(i);
+    }
+    trim(cache_size - entry.front().size);
+    lru.splice(lru.begin(), entry);
+    index.insert(make_pair(key, lru.begin()));
+    used += lru.front().size;
+}
+
+}
+
+namespace Xapian {
+
+void
+set_result_cache_size(size_t size)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::set_result_cache_size", size);
+    MutexLock lock(mutex);
+    cache_size = size;
+    trim(size);
+}
+
+size_t
+get_result_cache_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::get_result_cache_size", NO_ARGS);
+    MutexLock lock(mutex);
+    RETURN(cache_size);
+}
+
+unsigned long
+get_result_cache_hits()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::get_result_cache_hits", NO_ARGS);
+    MutexLock lock(mutex);
+    RETURN(hits);
+}
+
+unsigned long
+get_result_cache_misses()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::get_result_cache_misses", NO_ARGS);
+    MutexLock lock(mutex);
+    RETURN(misses);
+}
+
+}
@@ -0,0 +1,85 @@
+/** @file resultcache.h
+ * @brief Process-wide cache of search results.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_API_RESULTCACHE_H
+#define XAPIAN_INCLUDED_API_RESULTCACHE_H
+
+#include "xapian/enquire.h"
+#include "xapian/types.h"
+
+#include <string>
+
+/** Cache of the results of searches, shared by every Enquire object in the
+ *  process.
+ *
+ *  Each key holds the top results of a search (see
+ *  Enquire::Internal::get_result_cache_key()), with the number of items
+ *  and the check_at_least value the match was run with.  A request for a
+ *  subrange of those items which needs no more documents checked is
+ *  answered from the cache - this covers repeating a search, and asking for
+ *  a page of results before the end of one already cached.  Keys include the
+ *  revision of each database searched, so entries never need explicit
+ *  invalidation - once a revision is superseded nobody asks for its results
+ *  any more and they fall out of the LRU.
+ *
+ *  The cache is disabled until a size is set, either with
+ *  Xapian::set_result_cache_size() or via the XAPIAN_RESULT_CACHE_SIZE
+ *  environment variable.
+ */
+namespace ResultCache {
+
+/// Return true if the cache is enabled (i.e. has a non-zero size).
+bool enabled();
+
+/** Look up results in the cache.
+ *
+ *  @param key		The key for the search.
+ *  @param first	The index of the first item wanted.
+ *  @param maxitems	The number of items wanted.
+ *  @param check_at_least	The check_at_least value for the search,
+ *				which must be at least first + maxitems.
+ *
+ *  @return	A new MSet::Internal holding the items wanted, or NULL if the
+ *		cache can't supply them.
+ */
+Xapian::MSet::Internal * lookup(const std::string & key,
+				Xapian::doccount first,
+				Xapian::doccount maxitems,
+				Xapian::doccount check_at_least);
+
+/** Add results to the cache.
+ *
+ *  Any results already cached for @a key are replaced.
+ *
+ *  @param key		The key for the search.
+ *  @param maxitems	The number of items the match was run for.
+ *  @param check_at_least	The check_at_least value the match was run
+ *				with.
+ *  @param mset		The results, starting with the first item.
+ */
+void add(const std::string & key,
+	 Xapian::doccount maxitems,
+	 Xapian::doccount check_at_least,
+	 const Xapian::MSet::Internal & mset);
+
+}
+
+#endif // XAPIAN_INCLUDED_API_RESULTCACHE_H
@@ -1,4 +1,5 @@
 noinst_HEADERS +=\
+	backends/blockcache.h\
 	backends/flint_lock.h\
 	backends/byte_length_strings.h\
 	backends/prefix_compressed_strings.h\
@@ -10,6 +11,7 @@ EXTRA_DIST +=\
 
 lib_src +=\
 	backends/alltermslist.cc\
+	backends/blockcache.cc\
 	backends/database.cc\
 	backends/databasereplicator.cc\
 	backends/dbfactory.cc\
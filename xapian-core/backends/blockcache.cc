@@ -0,0 +1,297 @@
+/** @file blockcache.cc
+ * @brief Process-wide cache of B-tree blocks shared between tables.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "blockcache.h"
+
+#include "xapian/blockcache.h"
+
+#include "debuglog.h"
+#include "mutex.h"
+
+#include <cstdlib> // For getenv() and atol().
+#include <cstring>
+#include <list>
+#include <map>
+#include <string>
+
+using namespace std;
+
+/** Number of independently locked shards the cache is split into.
+ *
+ *  Each shard has its own mutex, so threads reading different blocks rarely
+ *  contend for the same lock.
+ */
+#define BLOCK_CACHE_SHARDS 16
+
+namespace {
+
+struct BlockKey {
+    unsigned table_id;
+    unsigned revision;
+    unsigned n;
+
+    BlockKey(unsigned table_id_, unsigned revision_, unsigned n_)
+	: table_id(table_id_), revision(revision_), n(n_) { }
+
+    bool operator<(const BlockKey & o) const {
+	if (n != o.n) return n < o.n;
+	if (table_id != o.table_id) return table_id < o.table_id;
+	return revision < o.revision;
+    }
+
+    /// Which shard this block belongs in.
+    unsigned shard() const {
+	// Mix in the table id so block 0 of every table (usually a root block)
+	// doesn't end up in the same shard.  The revision isn't used, so that
+	// a block can be moved on to a later revision within its shard.
+	return (n ^ (table_id * 0x9e3779b9u)) % BLOCK_CACHE_SHARDS;
+    }
+};
+
+struct CachedBlock {
+    BlockKey key;
+    unsigned block_size;
+    unsigned char * data;
+
+    CachedBlock(const BlockKey & key_, unsigned block_size_)
+	: key(key_), block_size(block_size_), data(NULL) { }
+};
+
+/// One independently locked part of the cache.
+class Shard {
+    typedef list<CachedBlock> lru_list;
+
+    /// Most recently used block at the front.
+    lru_list lru;
+
+    map<BlockKey, lru_list::iterator> index;
+
+    /// Number of bytes of block data held.
+    size_t used;
+
+  public:
+    /// Protects all the members (including this shard's blocks).
+    Mutex mutex;
+
+    /// The size limit (in bytes) for this shard - 0 if the cache is disabled.
+    size_t limit;
+
+    unsigned long hits, misses;
+
+    Shard() : used(0), limit(0), hits(0), misses(0) { }
+
+    ~Shard() { trim(0); }
+
+    /// Discard least recently used blocks until no more than max_used is used.
+    void trim(size_t max_used) {
+	while (used > max_used) {
+	    CachedBlock & victim = lru.back();
+	    used -= victim.block_size;
+	    index.erase(victim.key);
+	    delete [] victim.data;
+	    lru.pop_back();
+	}
+    }
+
+    bool lookup(const BlockKey & key, unsigned char * p, unsigned block_size,
+		unsigned old_revision) {
+	if (limit == 0) return false;
+	map<BlockKey, lru_list::iterator>::iterator i = index.find(key);
+	if (i == index.end() && old_revision != key.revision) {
+	    BlockKey old_key(key.table_id, old_revision, key.n);
+	    i = index.find(old_key);
+	    if (i != index.end()) {
+		// Move the block on to the new revision.
+		lru_list::iterator entry = i->second;
+		index.erase(i);
+		entry->key = key;
+		i = index.insert(make_pair(key, entry)).first;
+	    }
+	}
+	if (i == index.end() || i->second->block_size != block_size) {
+	    ++misses;
+	    return false;
+	}
+	++hits;
+	// Move to the front of the LRU list.
+	lru.splice(lru.begin(), lru, i->second);
+	memcpy(p, i->second->data, block_size);
+	return true;
+    }
+
+    void insert(const BlockKey & key, const unsigned char * p,
+		unsigned block_size) {
+	if (block_size > limit) return;
+	if (index.find(key) != index.end()) {
+	    // Another reader added this block while we were reading it.
+	    return;
+	}
+	trim(limit - block_size);
+	lru.push_front(CachedBlock(key, block_size));
+	CachedBlock & entry = lru.front();
+	try {
+	    entry.data = new unsigned char[block_size];
+	} catch (...) {
+	    lru.pop_front();
+	    throw;
+	}
+	memcpy(entry.data, p, block_size);
+	index.insert(make_pair(key, lru.begin()));
+	used += block_size;
+    }
+};
+
+Shard shards[BLOCK_CACHE_SHARDS];
+
+/// Protects table_ids.
+Mutex table_ids_mutex;
+
+map<string, unsigned> table_ids;
+
+/// Protects cache_size.
+Mutex size_mutex;
+
+/** The total size limit (in bytes) of the cache.
+ *
+ *  Each shard has its own copy of its share of this, so reading and caching
+ *  blocks only needs the shard's lock.
+ */
+size_t cache_size = 0;
+
+/// Set the size limit of the cache.
+void
+set_cache_size(size_t size)
+{
+    MutexLock lock(size_mutex);
+    cache_size = size;
+    for (size_t i = 0; i != BLOCK_CACHE_SHARDS; ++i) {
+	MutexLock shard_lock(shards[i].mutex);
+	shards[i].limit = size / BLOCK_CACHE_SHARDS;
+	shards[i].trim(shards[i].limit);
+    }
+}
+
+/// Read the initial size from the environment.
+class InitFromEnvironment {
+  public:
+    InitFromEnvironment() {
+	const char * p = getenv("XAPIAN_BLOCK_CACHE_SIZE");
+	if (p) set_cache_size(size_t(atol(p)));
+    }
+};
+
+InitFromEnvironment init_from_environment;
+
+}
+
+namespace BlockCache {
+
+unsigned
+get_table_id(const string & db_id, const char * tablename)
+{
+    string key(db_id);
+    key += '\0';
+    key += tablename;
+    MutexLock lock(table_ids_mutex);
+    map<string, unsigned>::const_iterator i = table_ids.find(key);
+    if (i != table_ids.end()) return i->second;
+    // Ids start at 1 so 0 can mean "not using the cache".
+    unsigned id = unsigned(table_ids.size()) + 1;
+    table_ids.insert(make_pair(key, id));
+    return id;
+}
+
+bool
+lookup(unsigned table_id, unsigned revision, unsigned n,
+       unsigned char * p, unsigned block_size)
+{
+    BlockKey key(table_id, revision, n);
+    Shard & shard = shards[key.shard()];
+    MutexLock lock(shard.mutex);
+    return shard.lookup(key, p, block_size, revision);
+}
+
+bool
+lookup(unsigned table_id, unsigned revision, unsigned old_revision,
+       unsigned n, unsigned char * p, unsigned block_size)
+{
+    BlockKey key(table_id, revision, n);
+    Shard & shard = shards[key.shard()];
+    MutexLock lock(shard.mutex);
+    return shard.lookup(key, p, block_size, old_revision);
+}
+
+void
+insert(unsigned table_id, unsigned revision, unsigned n,
+       const unsigned char * p, unsigned block_size)
+{
+    BlockKey key(table_id, revision, n);
+    Shard & shard = shards[key.shard()];
+    MutexLock lock(shard.mutex);
+    shard.insert(key, p, block_size);
+}
+
+}
+
+namespace Xapian {
+
+void
+set_block_cache_size(size_t size)
+{
+    LOGCALL_STATIC_VOID(API, "Xapian::set_block_cache_size", size);
+    set_cache_size(size);
+}
+
+size_t
+get_block_cache_size()
+{
+    LOGCALL_STATIC(API, size_t, "Xapian::get_block_cache_size", NO_ARGS);
+    MutexLock lock(size_mutex);
+    RETURN(cache_size);
+}
+
+unsigned long
+get_block_cache_hits()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::get_block_cache_hits", NO_ARGS);
+    unsigned long hits = 0;
+    for (size_t i = 0; i != BLOCK_CACHE_SHARDS; ++i) {
+	MutexLock lock(shards[i].mutex);
+	hits += shards[i].hits;
+    }
+    RETURN(hits);
+}
+
+unsigned long
+get_block_cache_misses()
+{
+    LOGCALL_STATIC(API, unsigned long, "Xapian::get_block_cache_misses", NO_ARGS);
+    unsigned long misses = 0;
+    for (size_t i = 0; i != BLOCK_CACHE_SHARDS; ++i) {
+	MutexLock lock(shards[i].mutex);
+	misses += shards[i].misses;
+    }
+    RETURN(misses);
+}
+
+}
@@ -0,0 +1,95 @@
+/** @file blockcache.h
+ * @brief Process-wide cache of B-tree blocks shared between tables.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BACKENDS_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_BACKENDS_BLOCKCACHE_H
+
+#include <cstddef>
+#include <string>
+
+/** Cache of B-tree blocks, shared by every table opened in the process.
+ *
+ *  Blocks are keyed by the table they come from, the revision the table was
+ *  opened at, and the block number.  A block which is part of revision R of
+ *  a table can't change while R is still a valid revision (the writer only
+ *  reuses blocks which were freed at least two revisions ago) so cached
+ *  entries never need explicit invalidation - once a revision is superseded
+ *  nobody asks for its blocks any more and they fall out of the LRU.  A
+ *  table which a reopen moves on to a later revision without any change to
+ *  its B-tree keeps using the revision it was opened at, since its blocks
+ *  are all still the same.  A table which does change can carry the blocks
+ *  cached for its old revision forward as they're next used, when the
+ *  writer can't have reused any of them in between (see lookup()).
+ *
+ *  Only tables opened read-only use the cache.  The cache is disabled until
+ *  a size is set, either with Xapian::set_block_cache_size() or via the
+ *  XAPIAN_BLOCK_CACHE_SIZE environment variable.
+ */
+namespace BlockCache {
+
+/** Return the id to use for a table.
+ *
+ *  @param db_id	String uniquely identifying the database (e.g. its
+ *			UUID).
+ *  @param tablename	The name of the table within the database.
+ *
+ *  @return	A non-zero id which is the same for every call with the same
+ *		arguments during the lifetime of the process.
+ */
+unsigned get_table_id(const std::string & db_id, const char * tablename);
+
+/** Look up a block in the cache.
+ *
+ *  @param table_id	Id from get_table_id().
+ *  @param revision	The revision the table is open at.
+ *  @param n		The block number.
+ *  @param p		Buffer of @a block_size bytes to copy the block to.
+ *  @param block_size	The table's block size.
+ *
+ *  @return true if the block was found (and copied to @a p).  If the cache
+ *	    is disabled, false is returned without counting a miss.
+ */
+bool lookup(unsigned table_id, unsigned revision, unsigned n,
+	    unsigned char * p, unsigned block_size);
+
+/** Look up a block, also accepting it if cached for an older revision.
+ *
+ *  If block @a n isn't cached for @a revision but is for @a old_revision,
+ *  the cached copy is moved on to @a revision and used.  The caller must
+ *  know that no block which @a old_revision uses can have been rewritten
+ *  by @a revision.
+ *
+ *  Other parameters and the return value are as for the other form.
+ */
+bool lookup(unsigned table_id, unsigned revision, unsigned old_revision,
+	    unsigned n, unsigned char * p, unsigned block_size);
+
+/** Add a block to the cache.
+ *
+ *  Parameters are as for lookup(), except that @a p points to the block
+ *  contents to store.  Does nothing if the cache is disabled.
+ */
+void insert(unsigned table_id, unsigned revision, unsigned n,
+	    const unsigned char * p, unsigned block_size);
+
+}
+
+#endif // XAPIAN_INCLUDED_BACKENDS_BLOCKCACHE_H
@@ -6,8 +6,10 @@ if BUILD_BACKEND_BRASS
 noinst_HEADERS +=\
 	backends/brass/brass_alldocspostlist.h\
 	backends/brass/brass_alltermslist.h\
+	backends/brass/brass_bitmap.h\
 	backends/brass/brass_btreebase.h\
 	backends/brass/brass_check.h\
+	backends/brass/brass_committer.h\
 	backends/brass/brass_compact.h\
 	backends/brass/brass_cursor.h\
 	backends/brass/brass_database.h\
@@ -17,6 +19,8 @@ noinst_HEADERS +=\
 	backends/brass/brass_inverter.h\
 	backends/brass/brass_lazytable.h\
 	backends/brass/brass_metadata.h\
+	backends/brass/brass_packedchunk.h\
+	backends/brass/brass_pins.h\
 	backends/brass/brass_positionlist.h\
 	backends/brass/brass_postlist.h\
 	backends/brass/brass_record.h\
@@ -35,7 +39,9 @@ noinst_HEADERS +=\
 lib_src +=\
 	backends/brass/brass_alldocspostlist.cc\
 	backends/brass/brass_alltermslist.cc\
+	backends/brass/brass_bitmap.cc\
 	backends/brass/brass_btreebase.cc\
+	backends/brass/brass_committer.cc\
 	backends/brass/brass_compact.cc\
 	backends/brass/brass_cursor.cc\
 	backends/brass/brass_database.cc\
@@ -44,6 +50,8 @@ lib_src +=\
 	backends/brass/brass_document.cc\
 	backends/brass/brass_inverter.cc\
 	backends/brass/brass_metadata.cc\
+	backends/brass/brass_packedchunk.cc\
+	backends/brass/brass_pins.cc\
 	backends/brass/brass_positionlist.cc\
 	backends/brass/brass_postlist.cc\
 	backends/brass/brass_record.cc\
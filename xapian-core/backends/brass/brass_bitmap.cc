@@ -0,0 +1,230 @@
+/** @file brass_bitmap.cc
+ * @brief Docid bitmaps stored for dense terms in a brass database.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_bitmap.h"
+
+#include "brass_cursor.h"
+#include "brass_database.h"
+#include "brass_table.h"
+#include "debuglog.h"
+#include "omassert.h"
+#include "stringutils.h"
+
+#include "xapian/error.h"
+
+#include <cstring>
+
+using namespace std;
+using namespace Brass;
+
+/// Return the number of bits set in @a word.
+static inline unsigned
+count_bits(uint8 word)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    unsigned n = 0;
+    while (word) {
+	word &= word - 1;
+	++n;
+    }
+    return n;
+#endif
+}
+
+void
+Brass::decode_bitmap_block(const string & tag, uint8 * words)
+{
+    const unsigned char * p =
+	reinterpret_cast<const unsigned char *>(tag.data());
+    if (tag.size() == BITMAP_TAG_SIZE) {
+	for (unsigned w = 0; w != DocidBitmap::BLOCK_WORDS; ++w) {
+	    uint8 word = 0;
+	    for (int i = 7; i >= 0; --i) {
+		word = (word << 8) | p[i];
+	    }
+	    words[w] = word;
+	    p += 8;
+	}
+	return;
+    }
+
+    if (tag.empty() || tag.size() % 2 != 0 || tag.size() > BITMAP_TAG_SIZE)
+	throw Xapian::DatabaseCorruptError("Bad bitmap block");
+    memset(words, 0, DocidBitmap::BLOCK_WORDS * sizeof(uint8));
+    const unsigned char * end = p + tag.size();
+    while (p != end) {
+	unsigned v = (unsigned(p[0]) << 8) | p[1];
+	words[v >> 6] |= uint8(1) << (v & 63);
+	p += 2;
+    }
+}
+
+void
+Brass::encode_bitmap_block(const uint8 * words, string & tag)
+{
+    tag.resize(0);
+    unsigned count = 0;
+    for (unsigned w = 0; w != DocidBitmap::BLOCK_WORDS; ++w) {
+	count += count_bits(words[w]);
+    }
+    if (count == 0) return;
+
+    if (count * 2 >= BITMAP_TAG_SIZE) {
+	tag.reserve(BITMAP_TAG_SIZE);
+	for (unsigned w = 0; w != DocidBitmap::BLOCK_WORDS; ++w) {
+	    uint8 word = words[w];
+	    for (int i = 0; i != 8; ++i) {
+		tag += char(word & 0xff);
+		word >>= 8;
+	    }
+	}
+	return;
+    }
+
+    tag.reserve(count * 2);
+    for (unsigned w = 0; w != DocidBitmap::BLOCK_WORDS; ++w) {
+	uint8 word = words[w];
+	while (word) {
+	    // The bits below the lowest set bit give its index.
+	    uint8 low = word & -word;
+	    unsigned v = w * 64 + count_bits(low - 1);
+	    tag += char(v >> 8);
+	    tag += char(v & 0xff);
+	    word ^= low;
+	}
+    }
+}
+
+BitmapWriter::BitmapWriter(BrassTable * table_, const string & term_)
+    : table(table_), term(term_), block(DocidBitmap::NO_BLOCK),
+      words(DocidBitmap::BLOCK_WORDS)
+{
+    table->add(make_bitmap_key(term), string());
+}
+
+void
+BitmapWriter::add(Xapian::docid did)
+{
+    Xapian::docid b = did >> DocidBitmap::BLOCK_SHIFT;
+    if (b != block) {
+	flush();
+	block = b;
+    }
+    unsigned bit = did & (DocidBitmap::BLOCK_SIZE - 1);
+    words[bit >> 6] |= uint8(1) << (bit & 63);
+}
+
+void
+BitmapWriter::flush()
+{
+    if (block == DocidBitmap::NO_BLOCK) return;
+    string tag;
+    encode_bitmap_block(&words[0], tag);
+    if (!tag.empty())
+	table->add(make_bitmap_key(term, block), tag);
+    memset(&words[0], 0, DocidBitmap::BLOCK_WORDS * sizeof(uint8));
+    block = DocidBitmap::NO_BLOCK;
+}
+
+BrassDocidBitmap::BrassDocidBitmap(const BrassDatabase * db_,
+				   const string & term_,
+				   Xapian::doccount termfreq_,
+				   BrassCursor * cursor_)
+    : db(db_), term(term_), termfreq(termfreq_),
+      prefix(make_bitmap_key(term_)), cursor(cursor_),
+      queried(NO_BLOCK), found(NO_BLOCK)
+{
+}
+
+BrassDocidBitmap::~BrassDocidBitmap()
+{
+}
+
+Xapian::docid
+BrassDocidBitmap::find_block(Xapian::docid block)
+{
+    LOGCALL(DB, Xapian::docid, "BrassDocidBitmap::find_block", block);
+    // There's nothing between the block we last looked for and the one we
+    // found then.
+    if (queried <= block && block <= found) RETURN(found);
+    Assert(queried == NO_BLOCK || block > queried);
+
+    queried = block;
+    found = NO_BLOCK;
+    string key = prefix;
+    pack_uint_preserving_sort(key, block);
+    (void)cursor->find_entry_ge(key);
+    if (cursor->after_end() || !startswith(cursor->current_key, prefix))
+	RETURN(found);
+
+    const char * p = cursor->current_key.data() + prefix.size();
+    const char * end = cursor->current_key.data() + cursor->current_key.size();
+    Xapian::docid b;
+    if (!unpack_uint_preserving_sort(&p, end, &b) || p != end)
+	throw Xapian::DatabaseCorruptError("Bad bitmap block key");
+    found = b;
+    RETURN(found);
+}
+
+void
+BrassDocidBitmap::read_block(Xapian::docid block, uint8 * words)
+{
+    LOGCALL_VOID(DB, "BrassDocidBitmap::read_block", block | (void*)words);
+    AssertRel(block, <=, found);
+    if (block != found) {
+	// There are no docids in the blocks before found.
+	memset(words, 0, BLOCK_WORDS * sizeof(uint8));
+	return;
+    }
+    cursor->read_tag();
+    decode_bitmap_block(cursor->current_tag, words);
+}
+
+Xapian::doccount
+BrassDocidBitmap::get_termfreq_min() const
+{
+    return termfreq;
+}
+
+Xapian::doccount
+BrassDocidBitmap::get_termfreq_est() const
+{
+    return termfreq;
+}
+
+Xapian::doccount
+BrassDocidBitmap::get_termfreq_max() const
+{
+    return termfreq;
+}
+
+string
+BrassDocidBitmap::get_description() const
+{
+    string desc = "BrassDocidBitmap(";
+    desc += term;
+    desc += ')';
+    return desc;
+}
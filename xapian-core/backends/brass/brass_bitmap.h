@@ -0,0 +1,207 @@
+/** @file brass_bitmap.h
+ * @brief Docid bitmaps stored for dense terms in a brass database.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_BITMAP_H
+#define XAPIAN_INCLUDED_BRASS_BITMAP_H
+
+#include "autoptr.h"
+#include "docidbitmap.h"
+#include "pack.h"
+
+#include "xapian/intrusive_ptr.h"
+#include "xapian/types.h"
+
+#include <string>
+#include <vector>
+
+class BrassCursor;
+class BrassDatabase;
+class BrassTable;
+
+/** A term with a bitmap has an entry in the postlist table with key
+ *  make_bitmap_key(term) and an empty tag, followed by an entry with key
+ *  make_bitmap_key(term, block) for each non-empty block of
+ *  DocidBitmap::BLOCK_SIZE docids.
+ *
+ *  Like a roaring bitmap, the tag for a block is either the low 16 bits of
+ *  each docid in ascending order, each stored in two bytes (most significant
+ *  first) if there are fewer than 4096 docids in the block, or otherwise a
+ *  bitmap of BLOCK_SIZE / 8 bytes (bit j of byte i is set for docid
+ *  i * 8 + j in the block).  The length of the tag tells us which.
+ *
+ *  The bitmap is kept as well as the posting list, and is kept up to date
+ *  as the posting list is modified.
+ */
+namespace Brass {
+
+/// Terms need at least this many postings to get a bitmap.
+const Xapian::doccount BITMAP_MIN_TERMFREQ = 1024;
+
+/// The size of a tag holding a bitmap for a block.
+const unsigned BITMAP_TAG_SIZE = DocidBitmap::BLOCK_SIZE / 8;
+
+/** Generate the key marking that a term has a bitmap.
+ *
+ *  This is also the prefix of the keys for the term's blocks.
+ */
+inline std::string
+make_bitmap_key(const std::string & term)
+{
+    std::string key("\0\xde", 2);
+    pack_string_preserving_sort(key, term);
+    return key;
+}
+
+/** Generate the key for a block of a term's bitmap. */
+inline std::string
+make_bitmap_key(const std::string & term, Xapian::docid block)
+{
+    std::string key = make_bitmap_key(term);
+    pack_uint_preserving_sort(key, block);
+    return key;
+}
+
+/** Decide whether a term should have a bitmap.
+ *
+ *  @param termfreq	The number of documents the term indexes.
+ *  @param last_docid	The highest docid used in the database.
+ *  @param have		Whether the term has a bitmap already.  A term
+ *			keeps its bitmap until it gets quite a lot sparser
+ *			than the density needed for a new bitmap, so a term
+ *			near the threshold doesn't keep gaining and losing one.
+ *
+ *  A bitmap takes at most two bytes per docid, so is never much bigger than
+ *  the posting list, but only helps much for terms which index a good
+ *  proportion of the documents.
+ */
+inline bool
+want_bitmap(Xapian::doccount termfreq, Xapian::docid last_docid, bool have)
+{
+    if (have)
+	return termfreq >= BITMAP_MIN_TERMFREQ / 2 &&
+	       termfreq >= last_docid / 64;
+    return termfreq >= BITMAP_MIN_TERMFREQ && termfreq >= last_docid / 16;
+}
+
+/** Decode the tag for a block of a bitmap.
+ *
+ *  @param tag	The tag.
+ *  @param words	Array of DocidBitmap::BLOCK_WORDS words to set.
+ */
+void decode_bitmap_block(const std::string & tag, uint8 * words);
+
+/** Encode a block of a bitmap as a tag.
+ *
+ *  @param words	Array of DocidBitmap::BLOCK_WORDS words.
+ *  @param tag	String to set to the tag (which is set to empty if the
+ *			block is empty, in which case it shouldn't be stored).
+ */
+void encode_bitmap_block(const uint8 * words, std::string & tag);
+
+/// Write a new bitmap for a term, a docid at a time.
+class BitmapWriter {
+    /// Don't allow assignment.
+    void operator=(const BitmapWriter &);
+
+    /// Don't allow copying.
+    BitmapWriter(const BitmapWriter &);
+
+    /// The table to write to.
+    BrassTable * table;
+
+    /// The term.
+    std::string term;
+
+    /// The block being built, or DocidBitmap::NO_BLOCK if none is.
+    Xapian::docid block;
+
+    /// The bitmap of the block being built.
+    std::vector<uint8> words;
+
+  public:
+    /** Start writing a term's bitmap.
+     *
+     *  @param table_	The postlist table.  Any existing bitmap for the
+     *			term must already have been deleted.
+     *  @param term_	The term.
+     */
+    BitmapWriter(BrassTable * table_, const std::string & term_);
+
+    /// Add a docid, which must be greater than any already added.
+    void add(Xapian::docid did);
+
+    /// Write the last block.
+    void flush();
+};
+
+}
+
+/// A term's bitmap in a brass database.
+class BrassDocidBitmap : public DocidBitmap {
+    /// The database (which we keep a reference to, so it isn't closed).
+    Xapian::Internal::intrusive_ptr<const BrassDatabase> db;
+
+    /// The term.
+    std::string term;
+
+    /// The number of documents the term indexes.
+    Xapian::doccount termfreq;
+
+    /// The prefix of the keys for the blocks.
+    std::string prefix;
+
+    /// Cursor for reading the blocks.
+    AutoPtr<BrassCursor> cursor;
+
+    /// The block last passed to find_block().
+    Xapian::docid queried;
+
+    /// The block find_block() last returned.
+    Xapian::docid found;
+
+  public:
+    /** Construct a BrassDocidBitmap.
+     *
+     *  @param db_	The database.
+     *  @param term_	The term, which must have a bitmap.
+     *  @param termfreq_	The number of documents the term indexes.
+     *  @param cursor_	Cursor on the postlist table (which this object
+     *			takes ownership of).
+     */
+    BrassDocidBitmap(const BrassDatabase * db_, const std::string & term_,
+		     Xapian::doccount termfreq_, BrassCursor * cursor_);
+
+    ~BrassDocidBitmap();
+
+    Xapian::docid find_block(Xapian::docid block);
+
+    void read_block(Xapian::docid block, uint8 * words);
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_BITMAP_H
@@ -83,7 +83,8 @@ BrassTable_base::BrassTable_base()
 	  sequential(false),
 	  bit_map_low(0),
 	  bit_map0(0),
-	  bit_map(0)
+	  bit_map(0),
+	  pinned_below(0)
 {
 }
 
@@ -99,7 +100,9 @@ BrassTable_base::BrassTable_base(const BrassTable_base &other)
 	  sequential(other.sequential),
 	  bit_map_low(other.bit_map_low),
 	  bit_map0(0),
-	  bit_map(0)
+	  bit_map(0),
+	  pinned_bit_map(other.pinned_bit_map),
+	  pinned_below(other.pinned_below)
 {
     try {
 	bit_map0 = new byte[bit_map_size];
@@ -128,6 +131,8 @@ BrassTable_base::swap(BrassTable_base &other)
     std::swap(bit_map_low, other.bit_map_low);
     std::swap(bit_map0, other.bit_map0);
     std::swap(bit_map, other.bit_map);
+    pinned_bit_map.swap(other.pinned_bit_map);
+    std::swap(pinned_below, other.pinned_below);
 }
 
 BrassTable_base::~BrassTable_base()
@@ -308,7 +313,8 @@ BrassTable_base::write_to_file(const string &filename,
 			       char base_letter,
 			       const string &tablename,
 			       int changes_fd,
-			       const string * changes_tail)
+			       const string * changes_tail,
+			       bool sync)
 {
     calculate_last_block();
 
@@ -357,7 +363,7 @@ BrassTable_base::write_to_file(const string &filename,
     }
 
     io_write(h, buf.data(), buf.size());
-    io_sync(h);
+    if (sync) io_sync(h);
 }
 
 /*
@@ -427,10 +433,26 @@ BrassTable_base::extend_bit_map()
     bit_map_size = n;
 }
 
+/* pinned_byte(i) returns byte i of the bit map of blocks which are pinned by
+   readers: those below pinned_below, and those set in pinned_bit_map.
+*/
+
+int
+BrassTable_base::pinned_byte(uint4 i) const
+{
+    uint4 below = pinned_below / CHAR_BIT;
+    if (i < below) return UCHAR_MAX;
+    int x = 0;
+    if (i == below) x = (0x1 << pinned_below % CHAR_BIT) - 1;
+    if (i < pinned_bit_map.size()) x |= byte(pinned_bit_map[i]);
+    return x;
+}
+
 /* next_free_block(B) returns the number of the next available free block in
    the bitmap, marking it as 'in use' before returning. More precisely, we get
    a block that is both free now (in bit_map) and was free at the beginning of
-   the transaction on the B-tree (in bit_map0).
+   the transaction on the B-tree (in bit_map0), and which isn't used by a
+   revision pinned by a reader.
 
    Starting at bit_map_low we go up byte at a time until we find a byte with a
    free (zero) bit, and then go up that byte bit at a time. If the bit map has
@@ -446,7 +468,7 @@ BrassTable_base::next_free_block()
 	if (i >= bit_map_size) {
 	    extend_bit_map();
 	}
-        x = bit_map0[i] | bit_map[i];
+        x = bit_map0[i] | bit_map[i] | pinned_byte(i);
         if (x != UCHAR_MAX) break;
     }
     uint4 n = i * CHAR_BIT;
@@ -530,6 +552,20 @@ BrassTable_base::clear_bit_map()
     memset(bit_map, 0, bit_map_size);
 }
 
+void
+BrassTable_base::get_bit_map_at_start(string & out) const
+{
+    out.assign(reinterpret_cast<const char *>(bit_map0), bit_map_size);
+}
+
+void
+BrassTable_base::set_pinned_blocks(const string & pinned, uint4 below)
+{
+    pinned_bit_map = pinned;
+    pinned_below = below;
+    bit_map_low = 0;
+}
+
 // We've commited, so "bitmap at start" needs to be reset to the current bitmap.
 void
 BrassTable_base::commit()
@@ -85,12 +85,17 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 	    sequential = sequential_;
 	}
 
-	/** Write the btree base file to disk. */
+	/** Write the btree base file to disk.
+	 *
+	 *  If @a sync is false, the caller is responsible for syncing the
+	 *  file.
+	 */
 	void write_to_file(const std::string &filename,
 			   char base_letter,
 			   const std::string &tablename,
 			   int changes_fd,
-			   const std::string * changes_tail);
+			   const std::string * changes_tail,
+			   bool sync = true);
 
 	/* Methods dealing with the bitmap */
 	/** true iff block n was free at the start of the transaction on
@@ -115,6 +120,23 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 	/* Only used with fake root blocks */
 	void clear_bit_map();
 
+	/** Get the bitmap of blocks in use at the start of the transaction.
+	 *
+	 *  This is the bitmap of the revision the table is open at.
+	 */
+	void get_bit_map_at_start(std::string & out) const;
+
+	/** Set the blocks which next_free_block() mustn't return.
+	 *
+	 *  These are blocks used by older revisions which readers have
+	 *  pinned (see BrassRevisionPins).
+	 *
+	 *  @param pinned	A bitmap of the pinned blocks, in the same
+	 *			format as the bitmap in the base file.
+	 *  @param below	All blocks below this are also pinned.
+	 */
+	void set_pinned_blocks(const std::string & pinned, uint4 below);
+
 	void commit();
 
 	/* Used by BrassTable::check() */
@@ -128,6 +150,9 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 
 	void extend_bit_map();
 
+	/// Byte @a i of the bitmap of pinned blocks.
+	int pinned_byte(uint4 i) const;
+
 	/* Decoded values from the base file follow */
 	uint4 revision;
 	uint4 block_size;
@@ -150,6 +175,13 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable_base {
 
 	/** the current state of the bit map of blocks */
 	byte *bit_map;
+
+	/** blocks used by revisions which readers have pinned: 1 means
+	   pinned */
+	std::string pinned_bit_map;
+
+	/** all blocks below this are pinned */
+	uint4 pinned_below;
 };
 
 #endif /* OM_HGUARD_BRASS_BTREEBASE_H */
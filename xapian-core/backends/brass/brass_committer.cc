@@ -0,0 +1,202 @@
+/** @file brass_committer.cc
+ * @brief Sync the tables of a brass database to disk, possibly in the
+ *        background.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "brass_committer.h"
+
+#include "brass_pins.h"
+#include "brass_table.h"
+#include "debuglog.h"
+#include "omassert.h"
+#include "threadpool.h"
+
+using namespace std;
+
+/// Sync one table's DB file and new base file.
+class BrassSyncTask : public ThreadTask {
+    const BrassTable & table;
+
+  protected:
+    void run() { table.sync_commit(); }
+
+  public:
+    explicit BrassSyncTask(const BrassTable & table_) : table(table_) { }
+};
+
+/// Sync all the tables, then rename their new base files into place.
+class BrassCommitTask : public ThreadTask {
+    ThreadPool & pool;
+
+    const vector<BrassTable *> & tables;
+
+    /// Action to run once the commit has completed, or NULL.
+    BrassCommitAction * action;
+
+  protected:
+    void run() { commit(); }
+
+  public:
+    BrassCommitTask(ThreadPool & pool_, const vector<BrassTable *> & tables_,
+		    BrassCommitAction * action_)
+	: pool(pool_), tables(tables_), action(action_) { }
+
+    void commit();
+};
+
+void
+BrassCommitTask::commit()
+{
+    vector<BrassSyncTask *> tasks;
+    tasks.reserve(tables.size());
+    vector<BrassTable *>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	tasks.push_back(new BrassSyncTask(**i));
+	pool.start(tasks.back());
+    }
+
+    size_t failed = tasks.size();
+    for (size_t k = 0; k != tasks.size(); ++k) {
+	try {
+	    pool.wait(tasks[k]);
+	} catch (...) {
+	    if (failed == tasks.size()) failed = k;
+	}
+    }
+    try {
+	// Rethrow the exception (if any).
+	if (failed != tasks.size()) pool.wait(tasks[failed]);
+    } catch (...) {
+	for (size_t k = 0; k != tasks.size(); ++k) {
+	    delete tasks[k];
+	}
+	throw;
+    }
+    for (size_t k = 0; k != tasks.size(); ++k) {
+	delete tasks[k];
+    }
+
+    // Everything is on disk, so now make the new revision visible.  Readers
+    // check the revision of the record table is consistent with the others,
+    // so it's added last.
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	(*i)->finish_commit();
+    }
+
+    if (action) action->committed();
+}
+
+BrassCommitter::BrassCommitter() : pins(NULL), pins_current(false)
+{
+}
+
+BrassCommitter::~BrassCommitter()
+{
+    try {
+	wait();
+    } catch (...) {
+    }
+}
+
+void
+BrassCommitter::add_table(BrassTable * table)
+{
+    tables.push_back(table);
+    table->set_committer(this);
+}
+
+void
+BrassCommitter::close_tables()
+{
+    vector<BrassTable *>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	(*i)->close(true);
+    }
+}
+
+void
+BrassCommitter::commit(bool background, BrassCommitAction * action)
+{
+    LOGCALL_VOID(DB, "BrassCommitter::commit", background | action);
+    Assert(!pending.get());
+    AutoPtr<BrassCommitAction> action_ptr(action);
+    try {
+	// One thread per table for the syncs, plus one to wait for them if
+	// we're committing in the background.
+	if (!pool.get()) pool.reset(new ThreadPool(tables.size() + 1));
+	AutoPtr<BrassCommitTask> task(new BrassCommitTask(*pool, tables,
+							  action));
+	pins_current = false;
+	if (background) {
+	    pool->start(task.get());
+	    pending = task;
+	    pending_action = action_ptr;
+	} else {
+	    task->commit();
+	}
+    } catch (...) {
+	if (action_ptr.get()) action_ptr->failed();
+	close_tables();
+	throw;
+    }
+}
+
+void
+BrassCommitter::wait()
+{
+    if (!pending.get()) return;
+    LOGCALL_VOID(DB, "BrassCommitter::wait", NO_ARGS);
+    AutoPtr<BrassCommitTask> task(pending);
+    AutoPtr<BrassCommitAction> action(pending_action);
+    try {
+	pool->wait(task.get());
+    } catch (...) {
+	if (action.get()) action->failed();
+	close_tables();
+	throw;
+    }
+}
+
+void
+BrassCommitter::update_pins()
+{
+    if (pins_current || !pins || tables.empty()) return;
+    LOGCALL_VOID(DB, "BrassCommitter::update_pins", NO_ARGS);
+
+    // Revisions from the one the tables are open at are never reused, so
+    // we only need to know about older ones.
+    brass_revision_number_t revision = tables.back()->get_open_revision_number();
+    vector<brass_revision_number_t> revisions;
+    pins->get_pinned(revision, revisions);
+    if (pending.get() && revision > 0 &&
+	(revisions.empty() || revisions.back() != revision - 1)) {
+	// The commit to the revision the tables are open at may not be
+	// visible to readers yet, so one could open and pin the previous
+	// revision after we've looked.  Rather than wait for the commit,
+	// assume it's pinned.
+	revisions.push_back(revision - 1);
+    }
+    vector<BrassTable *>::const_iterator i;
+    for (i = tables.begin(); i != tables.end(); ++i) {
+	(*i)->set_pinned_revisions(revisions);
+    }
+    pins_current = true;
+}
@@ -0,0 +1,151 @@
+/** @file brass_committer.h
+ * @brief Sync the tables of a brass database to disk, possibly in the
+ *        background.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_COMMITTER_H
+#define XAPIAN_INCLUDED_BRASS_COMMITTER_H
+
+#include "autoptr.h"
+
+#include <cstddef> // For NULL.
+#include <vector>
+
+class BrassCommitTask;
+class BrassRevisionPins;
+class BrassTable;
+class ThreadPool;
+
+/// Something to do once a commit has been completed, or has failed.
+class BrassCommitAction {
+  public:
+    virtual ~BrassCommitAction() { }
+
+    /** Called once the new revision has been made visible.
+     *
+     *  This is called in the thread which completes the commit, which may
+     *  be a background thread.  If it throws, the commit is treated as
+     *  having failed.
+     */
+    virtual void committed() = 0;
+
+    /** Called if the commit fails (including if committed() throws).
+     *
+     *  This is called by commit(), or by wait() for a commit completed in
+     *  the background, and must not throw.
+     */
+    virtual void failed() = 0;
+};
+
+/** Complete commits prepared by BrassTable::prepare_commit().
+ *
+ *  The DB file and new base file of every table are synced concurrently,
+ *  so a commit waits for the slowest sync rather than the sum of them all.
+ *  Once all the syncs have succeeded, the new base files are renamed into
+ *  place, in the order the tables were added.
+ *
+ *  This can happen in a background thread, in which case the tables may be
+ *  read meanwhile, but must not be modified until wait() has been called.
+ *  Tables call wait() themselves before writing a block (see
+ *  BrassTable::set_committer()).
+ *
+ *  This also tells the tables which blocks readers' pinned revisions use,
+ *  before the first change after each commit (see update_pins()).
+ */
+class BrassCommitter {
+    /// Don't allow assignment.
+    void operator=(const BrassCommitter &);
+
+    /// Don't allow copying.
+    BrassCommitter(const BrassCommitter &);
+
+    /// The tables to commit, in the order to rename their base files.
+    std::vector<BrassTable *> tables;
+
+    /// Threads to run the syncs on (created when first needed).
+    AutoPtr<ThreadPool> pool;
+
+    /// The commit being completed in the background, or NULL.
+    AutoPtr<BrassCommitTask> pending;
+
+    /// The action for the commit being completed in the background, or NULL.
+    AutoPtr<BrassCommitAction> pending_action;
+
+    /// The revisions readers have pinned, or NULL to ignore them.
+    BrassRevisionPins * pins;
+
+    /// True if the tables have been told the pins since the last commit.
+    bool pins_current;
+
+    /// Close all the tables after a commit fails.
+    void close_tables();
+
+  public:
+    BrassCommitter();
+
+    /// Waits for any commit in progress (ignoring any error).
+    ~BrassCommitter();
+
+    /** Add a table.
+     *
+     *  The table is told to wait for this object before writing blocks.
+     */
+    void add_table(BrassTable * table);
+
+    /** Set where to find the revisions readers have pinned.
+     *
+     *  @param pins_	The BrassRevisionPins (which this object doesn't
+     *			take ownership of), or NULL to ignore pins.
+     */
+    void set_revision_pins(BrassRevisionPins * pins_) {
+	pins = pins_;
+	pins_current = false;
+    }
+
+    /** Tell the tables not to reuse blocks of pinned revisions.
+     *
+     *  Tables call this before their first change after a commit, but the
+     *  pins are only read for the first of them.  If a commit is being
+     *  completed in the background, the revision before it is treated as
+     *  pinned, since readers may still open it.
+     */
+    void update_pins();
+
+    /** Sync and finish the commit prepared on each table.
+     *
+     *  @param background	If true, return without waiting for the
+     *				syncs.  Any error is then reported by wait().
+     *  @param action		Action to run once the commit has completed
+     *				or failed, or NULL.  This object takes
+     *				ownership of it.
+     *
+     *  If the commit fails, all the tables are closed, since the state on
+     *  disk no longer matches the state in memory.
+     */
+    void commit(bool background, BrassCommitAction * action = NULL);
+
+    /** Wait for a commit being completed in the background.
+     *
+     *  Does nothing if there isn't one.  If the commit failed, all the
+     *  tables are closed and the exception is rethrown.
+     */
+    void wait();
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_COMMITTER_H
@@ -24,7 +24,9 @@
 #include <xapian/compactor.h>
 
 #include <algorithm>
+#include <map>
 #include <queue>
+#include <set>
 
 #include <cstdio>
 
@@ -33,10 +35,17 @@
 #include "safesysstat.h"
 
 #include "brass_table.h"
+#include "brass_bitmap.h"
 #include "brass_compact.h"
 #include "brass_cursor.h"
+#include "brass_postlist.h"
+#include "autoptr.h"
 #include "internaltypes.h"
+#include "iothrottle.h"
+#include "mutex.h"
 #include "pack.h"
+#include "str.h"
+#include "threadpool.h"
 #include "utils.h"
 #include "valuestats.h"
 
@@ -50,6 +59,16 @@ using namespace std;
 // the same name in other flint-derived backends.
 namespace BrassCompact {
 
+/** Memory to use for reading ahead in the inputs to a multipass merge.
+ *
+ *  This is shared between the inputs, but each gets at least
+ *  MIN_MERGE_READAHEAD.
+ */
+const size_t MERGE_READAHEAD_MEMORY = 64 * 1024 * 1024;
+
+/// The least to read at once from each input to a multipass merge.
+const size_t MIN_MERGE_READAHEAD = 256 * 1024;
+
 static inline bool
 is_metainfo_key(const string & key)
 {
@@ -74,6 +93,24 @@ is_valuechunk_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xd8';
 }
 
+static inline bool
+is_valueindex_slots_key(const string & key)
+{
+    return key.size() == 2 && key[0] == '\0' && key[1] == '\xda';
+}
+
+static inline bool
+is_valueindex_key(const string & key)
+{
+    return key.size() > 2 && key[0] == '\0' && key[1] == '\xdc';
+}
+
+static inline bool
+is_bitmap_key(const string & key)
+{
+    return key.size() > 1 && key[0] == '\0' && key[1] == '\xde';
+}
+
 static inline bool
 is_doclenchunk_key(const string & key)
 {
@@ -101,7 +138,11 @@ class PostlistCursor : private BrassCursor {
     }
 
     bool next() {
-	if (!BrassCursor::next()) return false;
+	// Bitmaps are rebuilt for the merged posting lists, so skip the
+	// input ones.
+	do {
+	    if (!BrassCursor::next()) return false;
+	} while (is_bitmap_key(current_key));
 	// We put all chunks into the non-initial chunk form here, then fix up
 	// the first chunk for each term in the merged database as we merge.
 	read_tag();
@@ -128,6 +169,26 @@ class PostlistCursor : private BrassCursor {
 	    pack_uint_preserving_sort(key, did);
 	    return true;
 	}
+	if (is_valueindex_slots_key(key)) return true;
+	if (is_valueindex_key(key)) {
+	    const char * p = key.data();
+	    const char * end = p + key.length();
+	    p += 2;
+	    Xapian::valueno slot;
+	    string value;
+	    Xapian::docid did;
+	    if (!unpack_uint(&p, end, &slot) ||
+		!unpack_string_preserving_sort(&p, end, value) ||
+		!unpack_uint_preserving_sort(&p, end, &did) || p != end)
+		throw Xapian::DatabaseCorruptError("bad value index key");
+	    did += offset;
+
+	    key.assign("\0\xdc", 2);
+	    pack_uint(key, slot);
+	    pack_string_preserving_sort(key, value);
+	    pack_uint_preserving_sort(key, did);
+	    return true;
+	}
 
 	// Adjust key if this is *NOT* an initial chunk.
 	// key is: pack_string_preserving_sort(key, tname)
@@ -194,26 +255,56 @@ encode_valuestats(Xapian::doccount freq,
     return value;
 }
 
+/** Set whether a postlist chunk is the last in its posting list.
+ *
+ *  The flag is stored in the lowest bit of the first byte of the chunk
+ *  header - the other bits say how the chunk is encoded, which we keep.
+ */
+static inline void
+set_is_last_chunk(string & tag, bool is_last)
+{
+    tag[0] = char((tag[0] & ~1) | (is_last ? 1 : 0));
+}
+
+/** Open source table @a in to be read through in order.
+ *
+ *  Any limit on the I/O rate set for output table @a out applies to reading
+ *  @a in too.
+ *
+ *  If @a readahead is non-zero, @a in is read in chunks of that many bytes.
+ */
+static void
+open_source(BrassTable * in, const BrassTable * out, size_t readahead = 0)
+{
+    in->set_io_throttle(out->get_io_throttle());
+    in->open();
+    in->advise_sequential();
+    if (readahead) in->set_readahead(readahead);
+}
+
 static void
 merge_postlists(Xapian::Compactor & compactor,
 		BrassTable * out, vector<Xapian::docid>::const_iterator offset,
 		vector<string>::const_iterator b,
 		vector<string>::const_iterator e,
-		Xapian::docid last_docid)
+		Xapian::docid last_docid, size_t readahead)
 {
     totlen_t tot_totlen = 0;
     Xapian::termcount doclen_lbound = static_cast<Xapian::termcount>(-1);
     Xapian::termcount wdf_ubound = 0;
     Xapian::termcount doclen_ubound = 0;
+    bool packed_postlists = false;
     priority_queue<PostlistCursor *, vector<PostlistCursor *>, PostlistCursorGt> pq;
+    size_t inputs = 0;
     for ( ; b != e; ++b, ++offset) {
 	BrassTable *in = new BrassTable("postlist", *b, true);
-	in->open();
+	open_source(in, out, readahead);
 	if (in->empty()) {
 	    // Skip empty tables.
 	    delete in;
 	    continue;
 	}
+	++inputs;
 
 	// PostlistCursor takes ownership of BrassTable in and is
 	// responsible for deleting it.
@@ -249,6 +340,19 @@ merge_postlists(Xapian::Compactor & compactor,
 	    doclen_ubound_tmp += wdf_ubound_tmp;
 	    doclen_ubound = max(doclen_ubound, doclen_ubound_tmp);
 
+	    brass_revision_number_t oldest_changeset_tmp;
+	    if (!unpack_uint(&data, end, &oldest_changeset_tmp)) {
+		throw Xapian::DatabaseCorruptError("Tag containing meta information is corrupt.");
+	    }
+
+	    // If any of the inputs writes packed posting lists, so does the
+	    // output.
+	    bool packed_postlists_tmp;
+	    if (!unpack_bool(&data, end, &packed_postlists_tmp)) {
+		throw Xapian::DatabaseCorruptError("Tag containing meta information is corrupt.");
+	    }
+	    packed_postlists = packed_postlists || packed_postlists_tmp;
+
 	    totlen_t totlen = 0;
 	    if (!unpack_uint_last(&data, end, &totlen)) {
 		throw Xapian::DatabaseCorruptError("Tag containing meta information is corrupt.");
@@ -271,6 +375,9 @@ merge_postlists(Xapian::Compactor & compactor,
 	pack_uint(tag, doclen_lbound);
 	pack_uint(tag, wdf_ubound);
 	pack_uint(tag, doclen_ubound - wdf_ubound);
+	// The output has no changesets.
+	pack_uint(tag, 0u);
+	pack_bool(tag, packed_postlists);
 	pack_uint_last(tag, tot_totlen);
 	out->add(string(1, '\0'), tag);
     }
@@ -399,8 +506,67 @@ merge_postlists(Xapian::Compactor & compactor,
 	}
     }
 
+    // Merge the lists of slots with a value index.  The output only has an
+    // index for a slot if every input does, since we can't cheaply build
+    // the missing entries here.
+    set<Xapian::valueno> indexed_slots;
+    {
+	map<Xapian::valueno, size_t> counts;
+	while (!pq.empty()) {
+	    PostlistCursor * cur = pq.top();
+	    if (!is_valueindex_slots_key(cur->key)) break;
+	    const char * p = cur->tag.data();
+	    const char * end = p + cur->tag.size();
+	    while (p != end) {
+		Xapian::valueno slot;
+		if (!unpack_uint(&p, end, &slot))
+		    throw Xapian::DatabaseCorruptError("Bad list of value index slots");
+		++counts[slot];
+	    }
+	    pq.pop();
+	    if (cur->next()) {
+		pq.push(cur);
+	    } else {
+		delete cur;
+	    }
+	}
+
+	string tag;
+	map<Xapian::valueno, size_t>::const_iterator i;
+	for (i = counts.begin(); i != counts.end(); ++i) {
+	    if (i->second == inputs) {
+		indexed_slots.insert(i->first);
+		pack_uint(tag, i->first);
+	    }
+	}
+	if (!tag.empty()) out->add(string("\0\xda", 2), tag);
+    }
+
+    // Merge value index entries.  Their keys have already been adjusted for
+    // the docid offsets, so they come off the queue in the right order.
+    while (!pq.empty()) {
+	PostlistCursor * cur = pq.top();
+	const string & key = cur->key;
+	if (!is_valueindex_key(key)) break;
+	if (!indexed_slots.empty()) {
+	    const char * p = key.data() + 2;
+	    Xapian::valueno slot;
+	    if (!unpack_uint(&p, key.data() + key.size(), &slot))
+		throw Xapian::DatabaseCorruptError("bad value index key");
+	    if (indexed_slots.find(slot) != indexed_slots.end())
+		out->add(key, string());
+	}
+	pq.pop();
+	if (cur->next()) {
+	    pq.push(cur);
+	} else {
+	    delete cur;
+	}
+    }
+
     Xapian::termcount tf = 0, cf = 0; // Initialise to avoid warnings.
     vector<pair<Xapian::docid, string> > tags;
+    vector<string> bitmap_terms;
     while (true) {
 	PostlistCursor * cur = NULL;
 	if (!pq.empty()) {
@@ -415,7 +581,7 @@ merge_postlists(Xapian::Compactor & compactor,
 		pack_uint(first_tag, cf);
 		pack_uint(first_tag, tags[0].first - 1);
 		string tag = tags[0].second;
-		tag[0] = (tags.size() == 1) ? '1' : '0';
+		set_is_last_chunk(tag, tags.size() == 1);
 		first_tag += tag;
 		out->add(last_key, first_tag);
 
@@ -431,9 +597,16 @@ merge_postlists(Xapian::Compactor & compactor,
 		i = tags.begin();
 		while (++i != tags.end()) {
 		    tag = i->second;
-		    tag[0] = (i + 1 == tags.end()) ? '1' : '0';
+		    set_is_last_chunk(tag, i + 1 == tags.end());
 		    out->add(pack_brass_postlist_key(term, i->first), tag);
 		}
+
+		// In the final pass, note which terms are dense enough to
+		// get a bitmap.
+		if (last_docid && !is_doclenchunk_key(last_key) &&
+		    Brass::want_bitmap(tf, last_docid, false)) {
+		    bitmap_terms.push_back(term);
+		}
 	    }
 	    tags.clear();
 	    if (cur == NULL) break;
@@ -449,6 +622,13 @@ merge_postlists(Xapian::Compactor & compactor,
 	    delete cur;
 	}
     }
+
+    // Write the bitmaps once the posting lists are all in place, so the
+    // keys for them are added as one sorted run.
+    vector<string>::const_iterator t;
+    for (t = bitmap_terms.begin(); t != bitmap_terms.end(); ++t) {
+	BrassPostListTable::write_bitmap(out, *t);
+    }
 }
 
 struct MergeCursor : public BrassCursor {
@@ -479,7 +659,7 @@ merge_spellings(BrassTable * out,
     priority_queue<MergeCursor *, vector<MergeCursor *>, CursorGt> pq;
     for ( ; b != e; ++b) {
 	BrassTable *in = new BrassTable("spelling", *b, true, DONT_COMPRESS, true);
-	in->open();
+	open_source(in, out);
 	if (!in->empty()) {
 	    // The MergeCursor takes ownership of BrassTable in and is
 	    // responsible for deleting it.
@@ -593,7 +773,7 @@ merge_synonyms(BrassTable * out,
     priority_queue<MergeCursor *, vector<MergeCursor *>, CursorGt> pq;
     for ( ; b != e; ++b) {
 	BrassTable *in = new BrassTable("synonym", *b, true, DONT_COMPRESS, true);
-	in->open();
+	open_source(in, out);
 	if (!in->empty()) {
 	    // The MergeCursor takes ownership of BrassTable in and is
 	    // responsible for deleting it.
@@ -671,61 +851,61 @@ merge_synonyms(BrassTable * out,
     }
 }
 
+/** Wait for all of @a tasks, then delete them.
+ *
+ *  If any of them failed, the exception from the first to fail is rethrown.
+ */
+template<class T>
 static void
-multimerge_postlists(Xapian::Compactor & compactor,
-		     BrassTable * out, const char * tmpdir,
-		     Xapian::docid last_docid,
-		     vector<string> tmp, vector<Xapian::docid> off)
+wait_for_tasks(ThreadPool & pool, vector<T *> & tasks)
 {
-    unsigned int c = 0;
-    while (tmp.size() > 3) {
-	vector<string> tmpout;
-	tmpout.reserve(tmp.size() / 2);
-	vector<Xapian::docid> newoff;
-	newoff.resize(tmp.size() / 2);
-	for (unsigned int i = 0, j; i < tmp.size(); i = j) {
-	    j = i + 2;
-	    if (j == tmp.size() - 1) ++j;
-
-	    string dest = tmpdir;
-	    char buf[64];
-	    sprintf(buf, "/tmp%u_%u.", c, i / 2);
-	    dest += buf;
-
-	    // Don't compress temporary tables, even if the final table would
-	    // be.
-	    BrassTable tmptab("postlist", dest, false);
-	    // Use maximum blocksize for temporary tables.
-	    tmptab.create_and_open(65536);
-
-	    merge_postlists(compactor, &tmptab, off.begin() + i,
-			    tmp.begin() + i, tmp.begin() + j, 0);
-	    if (c > 0) {
-		for (unsigned int k = i; k < j; ++k) {
-		    unlink((tmp[k] + "DB").c_str());
-		    unlink((tmp[k] + "baseA").c_str());
-		    unlink((tmp[k] + "baseB").c_str());
-		}
-	    }
-	    tmpout.push_back(dest);
-	    tmptab.flush_db();
-	    tmptab.commit(1);
+    size_t failed = tasks.size();
+    for (size_t k = 0; k != tasks.size(); ++k) {
+	try {
+	    pool.wait(tasks[k]);
+	} catch (...) {
+	    if (failed == tasks.size()) failed = k;
 	}
-	swap(tmp, tmpout);
-	swap(off, newoff);
-	++c;
     }
-    merge_postlists(compactor,
-		    out, off.begin(), tmp.begin(), tmp.end(), last_docid);
-    if (c > 0) {
-	for (size_t k = 0; k < tmp.size(); ++k) {
-	    unlink((tmp[k] + "DB").c_str());
-	    unlink((tmp[k] + "baseA").c_str());
-	    unlink((tmp[k] + "baseB").c_str());
+    try {
+	// Rethrow the exception (if any).
+	if (failed != tasks.size()) pool.wait(tasks[failed]);
+    } catch (...) {
+	for (size_t k = 0; k != tasks.size(); ++k) {
+	    delete tasks[k];
 	}
+	throw;
+    }
+    for (size_t k = 0; k != tasks.size(); ++k) {
+	delete tasks[k];
     }
 }
 
+/** Wrapper which stops several threads calling a Compactor's methods at once.
+ *
+ *  The user's subclass won't expect to be called from more than one thread.
+ */
+class LockedCompactor : public Xapian::Compactor {
+    Xapian::Compactor & compactor;
+
+    Mutex mutex;
+
+  public:
+    explicit LockedCompactor(Xapian::Compactor & compactor_)
+	: compactor(compactor_) { }
+
+    void set_status(const string & table, const string & status) {
+	MutexLock lock(mutex);
+	compactor.set_status(table, status);
+    }
+
+    string resolve_duplicate_metadata(const string & key,
+				      size_t num_tags, const string tags[]) {
+	MutexLock lock(mutex);
+	return compactor.resolve_duplicate_metadata(key, num_tags, tags);
+    }
+};
+
 static void
 merge_docid_keyed(const char * tablename,
 		  BrassTable *out, const vector<string> & inputs,
@@ -735,7 +915,7 @@ merge_docid_keyed(const char * tablename,
 	Xapian::docid off = offset[i];
 
 	BrassTable in(tablename, inputs[i], true, DONT_COMPRESS, lazy);
-	in.open();
+	open_source(&in, out);
 	if (in.empty()) continue;
 
 	BrassCursor cur(&in);
@@ -769,6 +949,201 @@ merge_docid_keyed(const char * tablename,
     }
 }
 
+enum table_type {
+    POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
+};
+
+struct table_list {
+    // The "base name" of the table.
+    const char * name;
+    // The type.
+    table_type type;
+    // zlib compression strategy to use on tags.
+    int compress_strategy;
+    // Create tables after position lazily.
+    bool lazy;
+};
+
+/// Compact one table.
+class TableCompactTask : public ThreadTask {
+    Xapian::Compactor & compactor;
+    const char * destdir;
+    const table_list * t;
+    const vector<string> & sources;
+    const vector<Xapian::docid> & offset;
+    size_t block_size;
+    Xapian::Compactor::compaction_level compaction;
+    bool multipass;
+    Xapian::docid last_docid;
+    IOThrottle * io_throttle;
+
+  protected:
+    void run() { compact(); }
+
+  public:
+    TableCompactTask(Xapian::Compactor & compactor_,
+		     const char * destdir_, const table_list * t_,
+		     const vector<string> & sources_,
+		     const vector<Xapian::docid> & offset_,
+		     size_t block_size_,
+		     Xapian::Compactor::compaction_level compaction_,
+		     bool multipass_, Xapian::docid last_docid_,
+		     IOThrottle * io_throttle_)
+	: compactor(compactor_), destdir(destdir_), t(t_), sources(sources_),
+	  offset(offset_), block_size(block_size_), compaction(compaction_),
+	  multipass(multipass_), last_docid(last_docid_),
+	  io_throttle(io_throttle_) { }
+
+    void compact();
+};
+
+void
+TableCompactTask::compact()
+{
+    // The postlist table requires an N-way merge, adjusting the
+    // headers of various blocks.  The spelling and synonym tables also
+    // need special handling.  The other tables have keys sorted in
+    // docid order, so we can merge them by simply copying all the keys
+    // from each source table in turn.
+    compactor.set_status(t->name, string());
+
+    string dest = destdir;
+    dest += '/';
+    dest += t->name;
+    dest += '.';
+
+    bool output_will_exist = !t->lazy;
+
+    // Sometimes stat can fail for benign reasons (e.g. >= 2GB file
+    // on certain systems).
+    bool bad_stat = false;
+
+    off_t in_size = 0;
+
+    vector<string> inputs;
+    inputs.reserve(sources.size());
+    size_t inputs_present = 0;
+    for (vector<string>::const_iterator src = sources.begin();
+	 src != sources.end(); ++src) {
+	string s(*src);
+	s += t->name;
+	s += '.';
+
+	struct stat sb;
+	if (stat(s + "DB", &sb) == 0) {
+	    in_size += sb.st_size / 1024;
+	    output_will_exist = true;
+	    ++inputs_present;
+	} else if (errno != ENOENT) {
+	    // We get ENOENT for an optional table.
+	    bad_stat = true;
+	    output_will_exist = true;
+	    ++inputs_present;
+	}
+	inputs.push_back(s);
+    }
+
+    // If any inputs lack a termlist table, suppress it in the output.
+    if (t->type == TERMLIST && inputs_present != sources.size()) {
+	if (inputs_present != 0) {
+	    string m = str(inputs_present);
+	    m += " of ";
+	    m += str(sources.size());
+	    m += " inputs present, so suppressing output";
+	    compactor.set_status(t->name, m);
+	    return;
+	}
+	output_will_exist = false;
+    }
+
+    if (!output_will_exist) {
+	compactor.set_status(t->name, "doesn't exist");
+	return;
+    }
+
+    BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
+    if (!t->lazy) {
+	out.create_and_open(block_size);
+    } else {
+	out.erase();
+	out.set_block_size(block_size);
+    }
+
+    out.set_io_throttle(io_throttle);
+    out.set_full_compaction(compaction != compactor.STANDARD);
+    if (compaction == compactor.FULLER) out.set_max_item_size(1);
+
+    switch (t->type) {
+	case POSTLIST:
+	    if (multipass && inputs.size() > 3) {
+		// Rather than merging in several passes via temporary
+		// tables, merge all the inputs at once but read each in
+		// large chunks, so the disk seeks between inputs much less
+		// often.
+		size_t readahead = max(MERGE_READAHEAD_MEMORY / inputs.size(),
+				       MIN_MERGE_READAHEAD);
+		merge_postlists(compactor, &out, offset.begin(),
+				inputs.begin(), inputs.end(),
+				last_docid, readahead);
+	    } else {
+		merge_postlists(compactor, &out, offset.begin(),
+				inputs.begin(), inputs.end(),
+				last_docid, 0);
+	    }
+	    break;
+	case SPELLING:
+	    merge_spellings(&out, inputs.begin(), inputs.end());
+	    break;
+	case SYNONYM:
+	    merge_synonyms(&out, inputs.begin(), inputs.end());
+	    break;
+	default:
+	    // Position, Record, Termlist
+	    merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
+	    break;
+    }
+
+    // Commit as revision 1.
+    out.flush_db();
+    out.commit(1);
+
+    off_t out_size = 0;
+    if (!bad_stat) {
+	struct stat sb;
+	if (stat(dest + "DB", &sb) == 0) {
+	    out_size = sb.st_size / 1024;
+	} else {
+	    bad_stat = (errno != ENOENT);
+	}
+    }
+    if (bad_stat) {
+	compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
+    } else {
+	string status;
+	if (out_size == in_size) {
+	    status = "Size unchanged (";
+	} else {
+	    off_t delta;
+	    if (out_size < in_size) {
+		delta = in_size - out_size;
+		status = "Reduced by ";
+	    } else {
+		delta = out_size - in_size;
+		status = "INCREASED by ";
+	    }
+	    status += str(100 * delta / in_size);
+	    status += "% ";
+	    status += str(delta);
+	    status += "K (";
+	    status += str(in_size);
+	    status += "K -> ";
+	}
+	status += str(out_size);
+	status += "K)";
+	compactor.set_status(t->name, status);
+    }
+}
+
 }
 
 using namespace BrassCompact;
@@ -778,21 +1153,8 @@ compact_brass(Xapian::Compactor & compactor,
 	      const char * destdir, const vector<string> & sources,
 	      const vector<Xapian::docid> & offset, size_t block_size,
 	      Xapian::Compactor::compaction_level compaction, bool multipass,
-	      Xapian::docid last_docid) {
-    enum table_type {
-	POSTLIST, RECORD, TERMLIST, POSITION, VALUE, SPELLING, SYNONYM
-    };
-    struct table_list {
-	// The "base name" of the table.
-	const char * name;
-	// The type.
-	table_type type;
-	// zlib compression strategy to use on tags.
-	int compress_strategy;
-	// Create tables after position lazily.
-	bool lazy;
-    };
-
+	      Xapian::docid last_docid, unsigned threads,
+	      size_t io_rate_limit) {
     static const table_list tables[] = {
 	// name		type		compress_strategy	lazy
 	{ "postlist",	POSTLIST,	DONT_COMPRESS,		false },
@@ -805,140 +1167,31 @@ compact_brass(Xapian::Compactor & compactor,
     const table_list * tables_end = tables +
 	(sizeof(tables) / sizeof(tables[0]));
 
-    for (const table_list * t = tables; t < tables_end; ++t) {
-	// The postlist table requires an N-way merge, adjusting the
-	// headers of various blocks.  The spelling and synonym tables also
-	// need special handling.  The other tables have keys sorted in
-	// docid order, so we can merge them by simply copying all the keys
-	// from each source table in turn.
-	compactor.set_status(t->name, string());
-
-	string dest = destdir;
-	dest += '/';
-	dest += t->name;
-	dest += '.';
-
-	bool output_will_exist = !t->lazy;
-
-	// Sometimes stat can fail for benign reasons (e.g. >= 2GB file
-	// on certain systems).
-	bool bad_stat = false;
-
-	off_t in_size = 0;
-
-	vector<string> inputs;
-	inputs.reserve(sources.size());
-	size_t inputs_present = 0;
-	for (vector<string>::const_iterator src = sources.begin();
-	     src != sources.end(); ++src) {
-	    string s(*src);
-	    s += t->name;
-	    s += '.';
-
-	    struct stat sb;
-	    if (stat(s + "DB", &sb) == 0) {
-		in_size += sb.st_size / 1024;
-		output_will_exist = true;
-		++inputs_present;
-	    } else if (errno != ENOENT) {
-		// We get ENOENT for an optional table.
-		bad_stat = true;
-		output_will_exist = true;
-		++inputs_present;
-	    }
-	    inputs.push_back(s);
-	}
-
-	// If any inputs lack a termlist table, suppress it in the output.
-	if (t->type == TERMLIST && inputs_present != sources.size()) {
-	    if (inputs_present != 0) {
-		string m = str(inputs_present);
-		m += " of ";
-		m += str(sources.size());
-		m += " inputs present, so suppressing output";
-		compactor.set_status(t->name, m);
-		continue;
-	    }
-	    output_will_exist = false;
-	}
-
-	if (!output_will_exist) {
-	    compactor.set_status(t->name, "doesn't exist");
-	    continue;
-	}
+    // Shared by all the tables, so the limit applies to the total I/O.
+    AutoPtr<IOThrottle> io_throttle;
+    if (io_rate_limit) io_throttle.reset(new IOThrottle(io_rate_limit));
 
-	BrassTable out(t->name, dest, false, t->compress_strategy, t->lazy);
-	if (!t->lazy) {
-	    out.create_and_open(block_size);
-	} else {
-	    out.erase();
-	    out.set_block_size(block_size);
+    if (threads <= 1) {
+	for (const table_list * t = tables; t < tables_end; ++t) {
+	    TableCompactTask task(compactor, destdir, t, sources, offset,
+				  block_size, compaction, multipass,
+				  last_docid, io_throttle.get());
+	    task.compact();
 	}
+	return;
+    }
 
-	out.set_full_compaction(compaction != compactor.STANDARD);
-	if (compaction == compactor.FULLER) out.set_max_item_size(1);
-
-	switch (t->type) {
-	    case POSTLIST:
-		if (multipass && inputs.size() > 3) {
-		    multimerge_postlists(compactor, &out, destdir, last_docid,
-					 inputs, offset);
-		} else {
-		    merge_postlists(compactor, &out, offset.begin(),
-				    inputs.begin(), inputs.end(),
-				    last_docid);
-		}
-		break;
-	    case SPELLING:
-		merge_spellings(&out, inputs.begin(), inputs.end());
-		break;
-	    case SYNONYM:
-		merge_synonyms(&out, inputs.begin(), inputs.end());
-		break;
-	    default:
-		// Position, Record, Termlist
-		merge_docid_keyed(t->name, &out, inputs, offset, t->lazy);
-		break;
-	}
-
-	// Commit as revision 1.
-	out.flush_db();
-	out.commit(1);
-
-	off_t out_size = 0;
-	if (!bad_stat) {
-	    struct stat sb;
-	    if (stat(dest + "DB", &sb) == 0) {
-		out_size = sb.st_size / 1024;
-	    } else {
-		bad_stat = (errno != ENOENT);
-	    }
-	}
-	if (bad_stat) {
-	    compactor.set_status(t->name, "Done (couldn't stat all the DB files)");
-	} else {
-	    string status;
-	    if (out_size == in_size) {
-		status = "Size unchanged (";
-	    } else {
-		off_t delta;
-		if (out_size < in_size) {
-		    delta = in_size - out_size;
-		    status = "Reduced by ";
-		} else {
-		    delta = out_size - in_size;
-		    status = "INCREASED by ";
-		}
-		status += str(100 * delta / in_size);
-		status += "% ";
-		status += str(delta);
-		status += "K (";
-		status += str(in_size);
-		status += "K -> ";
-	    }
-	    status += str(out_size);
-	    status += "K)";
-	    compactor.set_status(t->name, status);
-	}
+    // The tables are independent, so compact them in parallel.  The
+    // postlist table is usually the slowest, so start it first.
+    LockedCompactor locked_compactor(compactor);
+    ThreadPool pool(min(threads, unsigned(tables_end - tables)));
+    vector<TableCompactTask *> tasks;
+    for (const table_list * t = tables; t < tables_end; ++t) {
+	tasks.push_back(new TableCompactTask(locked_compactor, destdir, t,
+					     sources, offset, block_size,
+					     compaction, multipass,
+					     last_docid, io_throttle.get()));
+	pool.start(tasks.back());
     }
+    wait_for_tasks(pool, tasks);
 }
@@ -58,14 +58,15 @@ BrassCursor::BrassCursor(const BrassTable *B_)
 	  tag_status(UNREAD),
 	  B(B_),
 	  version(B_->cursor_version),
-	  level(B_->level)
+	  level(B_->level),
+	  blocks_mapped(B_->mapping != NULL)
 {
     B->cursor_created_since_last_modification = true;
     C = new Brass::Cursor[level + 1];
 
     for (int j = 0; j < level; j++) {
         C[j].n = BLK_UNUSED;
-	C[j].p = new byte[B->block_size];
+	if (!blocks_mapped) C[j].p = new byte[B->block_size];
     }
     C[level].n = B->C[level].n;
     C[level].p = B->C[level].p;
@@ -75,12 +76,28 @@ void
 BrassCursor::rebuild()
 {
     int new_level = B->level;
+    bool new_blocks_mapped = (B->mapping != NULL);
+    if (new_blocks_mapped != blocks_mapped) {
+	// The table has been reopened and has started or stopped mapping the
+	// DB file, so we need to start or stop owning block buffers.
+	for (int j = 0; j < level; ++j) {
+	    if (blocks_mapped) {
+		C[j].p = new byte[B->block_size];
+	    } else {
+		delete [] C[j].p;
+		C[j].p = NULL;
+	    }
+	}
+	blocks_mapped = new_blocks_mapped;
+    }
     if (new_level <= level) {
 	for (int i = 0; i < new_level; i++) {
 	    C[i].n = BLK_UNUSED;
 	}
-	for (int j = new_level; j < level; ++j) {
-	    delete C[j].p;
+	if (!blocks_mapped) {
+	    for (int j = new_level; j < level; ++j) {
+		delete [] C[j].p;
+	    }
 	}
     } else {
 	Cursor * old_C = C;
@@ -89,9 +106,9 @@ BrassCursor::rebuild()
 	    C[i].p = old_C[i].p;
 	    C[i].n = BLK_UNUSED;
 	}
-	delete old_C;
+	delete [] old_C;
 	for (int j = level; j < new_level; j++) {
-	    C[j].p = new byte[B->block_size];
+	    if (!blocks_mapped) C[j].p = new byte[B->block_size];
 	    C[j].n = BLK_UNUSED;
 	}
     }
@@ -105,8 +122,10 @@ BrassCursor::~BrassCursor()
 {
     // Use the value of level stored in the cursor rather than the
     // Btree, since the Btree might have been deleted already.
-    for (int j = 0; j < level; j++) {
-	delete [] C[j].p;
+    if (!blocks_mapped) {
+	for (int j = 0; j < level; j++) {
+	    delete [] C[j].p;
+	}
     }
     delete [] C;
 }
@@ -111,6 +111,13 @@ class XAPIAN_VISIBILITY_DEFAULT BrassCursor {
 	/** The value of level in the Btree structure. */
 	int level;
 
+	/** Whether the block pointers in C point into the table's mapping of
+	 *  the DB file.
+	 *
+	 *  If false, C[0] to C[level - 1] each have a block buffer we own.
+	 */
+	bool blocks_mapped;
+
 	/** Get the key.
 	 *
 	 *  The key of the item at the cursor is copied into key.
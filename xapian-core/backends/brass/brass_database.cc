@@ -35,6 +35,7 @@
 #include "contiguousalldocspostlist.h"
 #include "brass_alldocspostlist.h"
 #include "brass_alltermslist.h"
+#include "brass_bitmap.h"
 #include "brass_replicate_internal.h"
 #include "brass_document.h"
 #include "../flint_lock.h"
@@ -49,6 +50,7 @@
 #include "debuglog.h"
 #include "io_utils.h"
 #include "pack.h"
+#include "realtime.h"
 #include "remoteconnection.h"
 #include "replication.h"
 #include "replicationprotocol.h"
@@ -67,6 +69,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <cstdio> // For rename().
 #include "autoptr.h"
 #include <string>
 
@@ -103,7 +106,7 @@ const int MAX_OPEN_RETRIES = 100;
 BrassDatabase::BrassDatabase(const string &brass_dir, int action,
 			     unsigned int block_size)
 	: db_dir(brass_dir),
-	  readonly(action == XAPIAN_DB_READONLY),
+	  readonly((action & XAPIAN_DB_ACTION_MASK) == XAPIAN_DB_READONLY),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
@@ -112,16 +115,32 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int action,
 	  synonym_table(db_dir, readonly),
 	  spelling_table(db_dir, readonly),
 	  record_table(db_dir, readonly),
+	  pins(db_dir),
 	  lock(db_dir),
 	  max_changesets(0)
 {
     LOGCALL_CTOR(DB, "BrassDatabase", brass_dir | action | block_size);
 
-    if (action == XAPIAN_DB_READONLY) {
+    int flags = action & ~XAPIAN_DB_ACTION_MASK;
+    action &= XAPIAN_DB_ACTION_MASK;
+
+    if (readonly) {
+	if (flags & Xapian::DB_MMAP) set_use_mmap();
 	open_tables_consistent();
+	pin_revision();
 	return;
     }
 
+    // Commit the tables in the same order as we always have, with the record
+    // table last.
+    committer.add_table(&postlist_table);
+    committer.add_table(&position_table);
+    committer.add_table(&termlist_table);
+    committer.add_table(&synonym_table);
+    committer.add_table(&spelling_table);
+    committer.add_table(&record_table);
+    committer.set_revision_pins(&pins);
+
     if (action != Xapian::DB_OPEN && !database_exists()) {
 
 	// Create the directory for the database, if it doesn't exist
@@ -139,7 +158,7 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int action,
 	}
 	get_database_write_lock(true);
 
-	create_and_open_tables(block_size);
+	create_and_open_tables(block_size, flags);
 	return;
     }
 
@@ -152,7 +171,7 @@ BrassDatabase::BrassDatabase(const string &brass_dir, int action,
     get_database_write_lock(false);
     // if we're overwriting, pretend the db doesn't exist
     if (action == Xapian::DB_CREATE_OR_OVERWRITE) {
-	create_and_open_tables(block_size);
+	create_and_open_tables(block_size, flags);
 	return;
     }
 
@@ -182,9 +201,9 @@ BrassDatabase::database_exists() {
 }
 
 void
-BrassDatabase::create_and_open_tables(unsigned int block_size)
+BrassDatabase::create_and_open_tables(unsigned int block_size, int flags)
 {
-    LOGCALL_VOID(DB, "BrassDatabase::create_and_open_tables", NO_ARGS);
+    LOGCALL_VOID(DB, "BrassDatabase::create_and_open_tables", block_size | flags);
     // The caller is expected to create the database directory if it doesn't
     // already exist.
 
@@ -207,6 +226,12 @@ BrassDatabase::create_and_open_tables(unsigned int block_size)
     }
 
     stats.zero();
+    if (flags & Xapian::DB_PACKED_POSTLISTS) {
+	// Store the setting now, so it persists even if no documents are
+	// added before the database is closed.
+	stats.set_packed_postlists(true);
+	stats.write(postlist_table);
+    }
 }
 
 bool
@@ -224,11 +249,24 @@ BrassDatabase::open_tables_consistent()
     brass_revision_number_t cur_rev = record_table.get_open_revision_number();
 
     // Check the version file unless we're reopening.
-    if (cur_rev == 0) version_file.read_and_check();
+    if (cur_rev == 0) {
+	version_file.read_and_check();
+	if (readonly) set_block_cache_ids();
+    }
 
     record_table.open();
     brass_revision_number_t revision = record_table.get_open_revision_number();
 
+    if (readonly && revision < cur_rev) {
+	// The revision has gone backwards so the database must have been
+	// replaced.  Reread the version file to get the new UUID so we don't
+	// use blocks cached from the old database, and start again.
+	version_file.read_and_check();
+	set_block_cache_ids();
+	record_table.open();
+	revision = record_table.get_open_revision_number();
+    }
+
     if (cur_rev && cur_rev == revision) {
 	// We're reopening a database and the revision hasn't changed so we
 	// don't need to do anything.
@@ -286,11 +324,29 @@ BrassDatabase::open_tables_consistent()
     return true;
 }
 
+void
+BrassDatabase::pin_revision()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::pin_revision", NO_ARGS);
+    Assert(readonly);
+    int tries_left = MAX_OPEN_RETRIES;
+    while (true) {
+	bool pinned = pins.pin(get_revision_number());
+	set_revision_pinned(pinned);
+	if (!pinned || (tries_left--) <= 0) return;
+	// Check the revision is still the latest.  The writer looks for pins
+	// before its first change after each commit, so a revision pinned
+	// while it's still the latest is protected in time.
+	if (!open_tables_consistent()) return;
+    }
+}
+
 void
 BrassDatabase::open_tables(brass_revision_number_t revision)
 {
     LOGCALL_VOID(DB, "BrassDatabase::open_tables", revision);
     version_file.read_and_check();
+    if (readonly) set_block_cache_ids();
     record_table.open(revision);
 
     // Set the block_size for optional tables as they may not currently exist.
@@ -309,6 +365,64 @@ BrassDatabase::open_tables(brass_revision_number_t revision)
     postlist_table.open(revision);
 }
 
+void
+BrassDatabase::set_block_cache_ids()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::set_block_cache_ids", NO_ARGS);
+    string db_id(version_file.get_uuid(), 16);
+    // A copy of a database has the same UUID, so include where it is too.
+    struct stat statbuf;
+    if (stat(db_dir.c_str(), &statbuf) == 0) {
+	db_id += str(static_cast<unsigned long long>(statbuf.st_dev));
+	db_id += ':';
+	db_id += str(static_cast<unsigned long long>(statbuf.st_ino));
+    }
+    postlist_table.set_block_cache_id(db_id);
+    position_table.set_block_cache_id(db_id);
+    termlist_table.set_block_cache_id(db_id);
+    synonym_table.set_block_cache_id(db_id);
+    spelling_table.set_block_cache_id(db_id);
+    record_table.set_block_cache_id(db_id);
+}
+
+void
+BrassDatabase::set_revision_pinned(bool pinned)
+{
+    LOGCALL_VOID(DB, "BrassDatabase::set_revision_pinned", pinned);
+    postlist_table.set_revision_pinned(pinned);
+    position_table.set_revision_pinned(pinned);
+    termlist_table.set_revision_pinned(pinned);
+    synonym_table.set_revision_pinned(pinned);
+    spelling_table.set_revision_pinned(pinned);
+    record_table.set_revision_pinned(pinned);
+}
+
+void
+BrassDatabase::set_use_mmap()
+{
+    LOGCALL_VOID(DB, "BrassDatabase::set_use_mmap", NO_ARGS);
+    postlist_table.set_use_mmap();
+    position_table.set_use_mmap();
+    termlist_table.set_use_mmap();
+    synonym_table.set_use_mmap();
+    spelling_table.set_use_mmap();
+    record_table.set_use_mmap();
+}
+
+Xapian::Database::Internal *
+BrassDatabase::open_concurrent_reader() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "BrassDatabase::open_concurrent_reader", NO_ARGS);
+    // A writable database may have changes which aren't yet committed.
+    if (!readonly) RETURN(NULL);
+    int action = XAPIAN_DB_READONLY;
+    if (postlist_table.get_use_mmap()) action |= Xapian::DB_MMAP;
+    AutoPtr<BrassDatabase> db(new BrassDatabase(db_dir, action));
+    // The new handle must see the same revision as this one.
+    if (db->get_revision_number() != get_revision_number()) RETURN(NULL);
+    RETURN(db.release());
+}
+
 brass_revision_number_t
 BrassDatabase::get_revision_number() const
 {
@@ -381,10 +495,112 @@ BrassDatabase::get_changeset_revisions(const string & path,
 				    "changeset at " + path);
 }
 
+namespace {
+
+/** Complete a changeset once the commit it records has been synced.
+ *
+ *  The changeset is written to a temporary file so that replication can't
+ *  pick it up until the revision it leads to is visible.  Changesets which
+ *  are no longer wanted are removed at the same point.
+ */
+class BrassChangeset : public BrassCommitAction {
+    /// The file descriptor of the temporary file.
+    int fd;
+
+    /// The temporary file which the changeset is written to.
+    string tmp_name;
+
+    /// The name the changeset is published under.
+    string changes_name;
+
+    /// Data to be appended to the changeset once the commit is done.
+    string tail;
+
+    /// The directory holding the changesets.
+    string db_dir;
+
+    /// Old changesets in the range [oldest, stop) are removed.
+    brass_revision_number_t oldest, stop;
+
+  public:
+    BrassChangeset(const string & db_dir_, brass_revision_number_t revision)
+	: fd(-1), db_dir(db_dir_), oldest(0), stop(0)
+    {
+	changes_name = db_dir + "/changes" + str(revision);
+	tmp_name = changes_name + ".tmp";
+#ifdef __WIN32__
+	fd = msvc_posix_open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
+#else
+	fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+#endif
+	if (fd < 0) {
+	    string message = string("Couldn't open changeset ")
+		    + tmp_name + " to write";
+	    throw Xapian::DatabaseError(message, errno);
+	}
+    }
+
+    ~BrassChangeset() {
+	if (fd >= 0) (void)::close(fd);
+    }
+
+    int get_fd() const { return fd; }
+
+    void set_tail(const string & tail_) { tail = tail_; }
+
+    void set_prune_range(brass_revision_number_t oldest_,
+			 brass_revision_number_t stop_) {
+	oldest = oldest_;
+	stop = stop_;
+    }
+
+    void committed() {
+	io_write(fd, tail.data(), tail.size());
+	int h = fd;
+	fd = -1;
+	if (::close(h) < 0) {
+	    throw Xapian::DatabaseError("Couldn't close changeset " +
+					tmp_name, errno);
+	}
+#ifdef __WIN32__
+	if (msvc_posix_rename(tmp_name.c_str(), changes_name.c_str()) < 0)
+#else
+	if (rename(tmp_name.c_str(), changes_name.c_str()) < 0)
+#endif
+	{
+	    throw Xapian::DatabaseError("Couldn't rename changeset " +
+					tmp_name, errno);
+	}
+
+	// If nothing went wrong only one file should be deleted, otherwise
+	// attempts will be made to clean up more.
+	for (brass_revision_number_t rev = oldest; rev < stop; ++rev) {
+	    if (io_unlink(db_dir + "/changes" + str(rev))) {
+		LOGLINE(DB, "Removed changeset " << rev);
+	    } else {
+		LOGLINE(DB, "Skipping changeset " << rev <<
+			", likely removed before");
+	    }
+	}
+    }
+
+    void failed() {
+	if (fd >= 0) {
+	    (void)::close(fd);
+	    fd = -1;
+	}
+	(void)io_unlink(tmp_name);
+	(void)io_unlink(changes_name);
+    }
+};
+
+}
+
 void
-BrassDatabase::set_revision_number(brass_revision_number_t new_revision)
+BrassDatabase::set_revision_number(brass_revision_number_t new_revision,
+				   bool background)
 {
-    LOGCALL_VOID(DB, "BrassDatabase::set_revision_number", new_revision);
+    LOGCALL_VOID(DB, "BrassDatabase::set_revision_number", new_revision | background);
 
     value_manager.merge_changes();
 
@@ -395,9 +611,8 @@ BrassDatabase::set_revision_number(brass_revision_number_t new_revision)
     spelling_table.flush_db();
     record_table.flush_db();
 
-    int changes_fd = -1;
-    string changes_name;
-    
+    AutoPtr<BrassChangeset> changeset;
+
     // always check max_changesets for modification since last revision
     const char *p = getenv("XAPIAN_MAX_CHANGESETS");
     if (p) {
@@ -410,22 +625,12 @@ BrassDatabase::set_revision_number(brass_revision_number_t new_revision)
 	brass_revision_number_t old_revision = get_revision_number();
 	if (old_revision) {
 	    // Don't generate a changeset for the first revision.
-	    changes_name = db_dir + "/changes" + str(old_revision);
-#ifdef __WIN32__
-	    changes_fd = msvc_posix_open(changes_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY);
-#else
-	    changes_fd = open(changes_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
-#endif
-	    if (changes_fd < 0) {
-		string message = string("Couldn't open changeset ")
-			+ changes_name + " to write";
-		throw Xapian::DatabaseError(message, errno);
-	    }
+	    changeset.reset(new BrassChangeset(db_dir, old_revision));
 	}
     }
 
+    int changes_fd = changeset.get() ? changeset->get_fd() : -1;
     try {
-	fdcloser closefd(changes_fd);
 	if (changes_fd >= 0) {
 	    string buf;
 	    brass_revision_number_t old_revision = get_revision_number();
@@ -454,46 +659,46 @@ BrassDatabase::set_revision_number(brass_revision_number_t new_revision)
 	    postlist_table.write_changed_blocks(changes_fd);
 	}
 
-	postlist_table.commit(new_revision, changes_fd);
-	position_table.commit(new_revision, changes_fd);
-	termlist_table.commit(new_revision, changes_fd);
-	synonym_table.commit(new_revision, changes_fd);
-	spelling_table.commit(new_revision, changes_fd);
-
-	string changes_tail; // Data to be appended to the changes file
-	if (changes_fd >= 0) {
+	postlist_table.prepare_commit(new_revision, changes_fd);
+	position_table.prepare_commit(new_revision, changes_fd);
+	termlist_table.prepare_commit(new_revision, changes_fd);
+	synonym_table.prepare_commit(new_revision, changes_fd);
+	spelling_table.prepare_commit(new_revision, changes_fd);
+	record_table.prepare_commit(new_revision, changes_fd);
+
+	if (changeset.get()) {
+	    // The end marker is only written once the tables have been
+	    // synced, so a changeset is never complete before the revision
+	    // it leads to is.
+	    string changes_tail;
 	    changes_tail += '\0';
 	    pack_uint(changes_tail, new_revision);
+	    changeset->set_tail(changes_tail);
+
+	    // Only remove the oldest changesets if we successfully write a
+	    // new changeset and we have a revision number greater than
+	    // max_changesets.
+	    if (max_changesets < new_revision) {
+		brass_revision_number_t oldest_changeset =
+		    stats.get_oldest_changeset();
+		brass_revision_number_t stop_changeset =
+		    new_revision - max_changesets;
+		if (oldest_changeset < stop_changeset) {
+		    changeset->set_prune_range(oldest_changeset,
+					       stop_changeset);
+		    stats.set_oldest_changeset(stop_changeset - 1);
+		}
+	    }
 	}
-	record_table.commit(new_revision, changes_fd, &changes_tail);
-
     } catch (...) {
 	// Remove the changeset, if there was one.
-	if (changes_fd >= 0) {
-	    (void)io_unlink(changes_name);
-	}
-
+	if (changeset.get()) changeset->failed();
 	throw;
     }
-    
-    // Only remove the oldest_changeset if we successfully write a new changeset and
-    // we have a revision number greater than max_changesets
-    if (changes_fd >= 0 && max_changesets < new_revision) {
-	// use the oldest changeset we know about to begin deleting to the stop_changeset
-	// if nothing went wrong only one file should be deleted, otherwise
-	// attempts will be made to clean up more
-	brass_revision_number_t oldest_changeset = stats.get_oldest_changeset();
-	brass_revision_number_t stop_changeset = new_revision - max_changesets;
-	while (oldest_changeset < stop_changeset) {
-	    if (io_unlink(db_dir + "/changes" + str(oldest_changeset))) {
-		LOGLINE(DB, "Removed changeset " << oldest_changeset);
-	    } else {
-		LOGLINE(DB, "Skipping changeset " << oldest_changeset << 
-			", likely removed before");
-	    }
-	    stats.set_oldest_changeset(oldest_changeset++);
-	}
-    }
+
+    // Sync all the tables at once, then make the new revision visible and
+    // publish the changeset.  If the commit fails, the changeset is removed.
+    committer.commit(background, changeset.release());
 }
 
 bool
@@ -501,19 +706,27 @@ BrassDatabase::reopen()
 {
     LOGCALL(DB, bool, "BrassDatabase::reopen", NO_ARGS);
     if (!readonly) return false;
-    return open_tables_consistent();
+    if (!open_tables_consistent()) return false;
+    pin_revision();
+    return true;
 }
 
 void
 BrassDatabase::close()
 {
     LOGCALL_VOID(DB, "BrassDatabase::close", NO_ARGS);
+    try {
+	committer.wait();
+    } catch (...) {
+	// The tables have been closed, which is what we want anyway.
+    }
     postlist_table.close(true);
     position_table.close(true);
     termlist_table.close(true);
     synonym_table.close(true);
     spelling_table.close(true);
     record_table.close(true);
+    pins.release();
     lock.release();
 }
 
@@ -532,6 +745,8 @@ BrassDatabase::get_database_write_lock(bool creating)
 	}
 	lock.throw_databaselockerror(why, db_dir, explanation);
     }
+    // Make sure readers can pin the revision they open.
+    pins.create_file();
 }
 
 void
@@ -735,9 +950,13 @@ BrassDatabase::modifications_failed(brass_revision_number_t old_revision,
 }
 
 void
-BrassDatabase::apply()
+BrassDatabase::apply(bool background)
 {
-    LOGCALL_VOID(DB, "BrassDatabase::apply", NO_ARGS);
+    LOGCALL_VOID(DB, "BrassDatabase::apply", background);
+    // Report any error from a commit still being completed in the
+    // background, and make sure it's on disk before we return.
+    committer.wait();
+
     if (!postlist_table.is_modified() &&
 	!position_table.is_modified() &&
 	!termlist_table.is_modified() &&
@@ -752,7 +971,7 @@ BrassDatabase::apply()
     brass_revision_number_t new_revision = get_next_revision_number();
 
     try {
-	set_revision_number(new_revision);
+	set_revision_number(new_revision, background);
     } catch (const Xapian::Error &e) {
 	modifications_failed(old_revision, new_revision, e.get_description());
 	throw;
@@ -766,6 +985,7 @@ void
 BrassDatabase::cancel()
 {
     LOGCALL_VOID(DB, "BrassDatabase::cancel", NO_ARGS);
+    committer.wait();
     postlist_table.cancel();
     position_table.cancel();
     termlist_table.cancel();
@@ -903,6 +1123,22 @@ BrassDatabase::open_post_list(const string& term) const
     RETURN(new BrassPostList(ptrtothis, term, true));
 }
 
+DocidBitmap *
+BrassDatabase::open_docid_bitmap(const string& term) const
+{
+    LOGCALL(DB, DocidBitmap *, "BrassDatabase::open_docid_bitmap", term);
+    if (term.empty()) RETURN(NULL);
+    // Bitmaps are deleted when the termfreq falls below
+    // BITMAP_MIN_TERMFREQ / 2, so don't look for one for rarer terms.
+    Xapian::doccount termfreq = postlist_table.get_termfreq(term);
+    if (termfreq < Brass::BITMAP_MIN_TERMFREQ / 2 ||
+	!postlist_table.key_exists(Brass::make_bitmap_key(term))) {
+	RETURN(NULL);
+    }
+    RETURN(new BrassDocidBitmap(this, term, termfreq,
+				postlist_table.cursor_get()));
+}
+
 ValueList *
 BrassDatabase::open_value_list(Xapian::valueno slot) const
 {
@@ -911,6 +1147,16 @@ BrassDatabase::open_value_list(Xapian::valueno slot) const
     RETURN(new BrassValueList(slot, ptrtothis));
 }
 
+bool
+BrassDatabase::get_value_range_docids(Xapian::valueno slot,
+				      const string & begin, const string & end,
+				      Xapian::doccount limit,
+				      vector<Xapian::docid> & dids) const
+{
+    LOGCALL(DB, bool, "BrassDatabase::get_value_range_docids", slot | begin | end | limit | Literal("[dids]"));
+    RETURN(value_manager.get_range_docids(slot, begin, end, limit, dids));
+}
+
 TermList *
 BrassDatabase::open_term_list(Xapian::docid did) const
 {
@@ -1033,6 +1279,13 @@ BrassDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+string
+BrassDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "BrassDatabase::get_revision_key", NO_ARGS);
+    RETURN(make_revision_key(db_dir));
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 BrassWritableDatabase::BrassWritableDatabase(const string &dir, int action,
@@ -1040,6 +1293,10 @@ BrassWritableDatabase::BrassWritableDatabase(const string &dir, int action,
 	: BrassDatabase(dir, action, block_size),
 	  change_count(0),
 	  flush_threshold(0),
+	  flush_memory_limit(0),
+	  commit_window(0),
+	  last_commit_time(0),
+	  commit_deferred(false),
 	  modify_shortcut_document(NULL),
 	  modify_shortcut_docid(0)
 {
@@ -1067,6 +1324,42 @@ BrassWritableDatabase::commit()
     apply();
 }
 
+void
+BrassWritableDatabase::commit_async()
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::commit_async", NO_ARGS);
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    if (commit_window > 0) {
+	if (RealTime::now() < last_commit_time + commit_window) {
+	    // Leave these changes to be committed along with those from a
+	    // later call.
+	    commit_deferred = true;
+	    return;
+	}
+    }
+    if (change_count) flush_postlist_changes();
+    apply(true);
+}
+
+void
+BrassWritableDatabase::wait_for_commit()
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::wait_for_commit", NO_ARGS);
+    if (commit_deferred) {
+	commit();
+    } else {
+	committer.wait();
+    }
+}
+
+void
+BrassWritableDatabase::set_commit_window(double seconds)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::set_commit_window", seconds);
+    commit_window = seconds;
+}
+
 void
 BrassWritableDatabase::flush_postlist_changes() const
 {
@@ -1076,6 +1369,30 @@ BrassWritableDatabase::flush_postlist_changes() const
     change_count = 0;
 }
 
+bool
+BrassWritableDatabase::count_change_and_check_flush(Xapian::doccount changes) const
+{
+    change_count += changes;
+    if (!flush_memory_limit) return change_count >= flush_threshold;
+    size_t memory_used = inverter.get_memory_used();
+    memory_used += value_manager.get_memory_used();
+    return memory_used >= flush_memory_limit;
+}
+
+void
+BrassWritableDatabase::set_flush_memory_limit(size_t bytes)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::set_flush_memory_limit", bytes);
+    flush_memory_limit = bytes;
+}
+
+void
+BrassWritableDatabase::set_value_index(Xapian::valueno slot, bool enabled)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::set_value_index", slot | enabled);
+    value_manager.set_index(slot, enabled);
+}
+
 void
 BrassWritableDatabase::close()
 {
@@ -1088,10 +1405,12 @@ BrassWritableDatabase::close()
 }
 
 void
-BrassWritableDatabase::apply()
+BrassWritableDatabase::apply(bool background)
 {
+    if (commit_window > 0) last_commit_time = RealTime::now();
+    commit_deferred = false;
     value_manager.set_value_stats(value_stats);
-    BrassDatabase::apply();
+    BrassDatabase::apply(background);
 }
 
 Xapian::docid
@@ -1107,9 +1426,10 @@ BrassWritableDatabase::add_document(const Xapian::Document & document)
 
 Xapian::docid
 BrassWritableDatabase::add_document_(Xapian::docid did,
-				     const Xapian::Document & document)
+				     const Xapian::Document & document,
+				     bool batch)
 {
-    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_document_", did | document);
+    LOGCALL(DB, Xapian::docid, "BrassWritableDatabase::add_document_", did | document | batch);
     Assert(did != 0);
     try {
 	// Add the record using that document ID.
@@ -1159,10 +1479,7 @@ BrassWritableDatabase::add_document_(Xapian::docid did,
 	throw;
     }
 
-    // FIXME: this should be done by checking memory usage, not the number of
-    // changes.  We could also look at the amount of data the inverter object
-    // currently holds.
-    if (++change_count >= flush_threshold) {
+    if (!batch && count_change_and_check_flush()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1226,7 +1543,7 @@ BrassWritableDatabase::delete_document(Xapian::docid did)
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (count_change_and_check_flush()) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1237,6 +1554,15 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 					const Xapian::Document & document)
 {
     LOGCALL_VOID(DB, "BrassWritableDatabase::replace_document", did | document);
+    replace_document_(did, document, false);
+}
+
+void
+BrassWritableDatabase::replace_document_(Xapian::docid did,
+					 const Xapian::Document & document,
+					 bool batch)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::replace_document_", did | document | batch);
     Assert(did != 0);
 
     try {
@@ -1244,7 +1570,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    stats.set_last_docid(did);
 	    // If this docid is above the highwatermark, then we can't be
 	    // replacing an existing document.
-	    (void)add_document_(did, document);
+	    (void)add_document_(did, document, batch);
 	    return;
 	}
 
@@ -1252,7 +1578,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    // We can replace an *unused* docid <= last_docid too.
 	    intrusive_ptr<const BrassDatabase> ptrtothis(this);
 	    if (!postlist_table.document_exists(did, ptrtothis)) {
-		(void)add_document_(did, document);
+		(void)add_document_(did, document, batch);
 		return;
 	    }
 	    throw Xapian::FeatureUnavailableError("Database has no termlist");
@@ -1292,6 +1618,10 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    stats.delete_document(old_doclen);
 	    brass_doclen_t new_doclen = old_doclen;
 
+	    // Set if any term is added or removed, or any wdf changes.  If
+	    // not, the stored termlist is already correct.
+	    bool termlist_changed = false;
+
 	    string old_tname, new_tname;
 
 	    termlist.next();
@@ -1317,6 +1647,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 		    inverter.remove_posting(did, old_tname, old_wdf);
 		    if (pos_modified)
 			position_table.delete_positionlist(did, old_tname);
+		    termlist_changed = true;
 		    termlist.next();
 		} else if (cmp > 0) {
 		    // Term new_tname as been added.
@@ -1334,6 +1665,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 				pos, term.positionlist_end(), false);
 			}
 		    }
+		    termlist_changed = true;
 		    ++term;
 		} else if (cmp == 0) {
 		    // Term already exists: look for wdf and positionlist changes.
@@ -1348,6 +1680,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 		    if (old_wdf != new_wdf) {
 		    	new_doclen += new_wdf - old_wdf;
 			inverter.update_posting(did, new_tname, old_wdf, new_wdf);
+			termlist_changed = true;
 		    }
 
 		    if (pos_modified) {
@@ -1368,7 +1701,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    LOGLINE(DB, "Calculated doclen for replacement document " << did << " as " << new_doclen);
 
 	    // Set the termlist.
-	    if (termlist_table.is_open())
+	    if (termlist_changed && termlist_table.is_open())
 		termlist_table.set_termlist(did, document, new_doclen);
 
 	    // Set the new document length
@@ -1387,7 +1720,7 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	    value_manager.replace_document(did, document, value_stats);
 	}
     } catch (const Xapian::DocNotFoundError &) {
-	(void)add_document_(did, document);
+	(void)add_document_(did, document, batch);
 	return;
     } catch (...) {
 	// If an error occurs while replacing a document, or doing any other
@@ -1398,7 +1731,101 @@ BrassWritableDatabase::replace_document(Xapian::docid did,
 	throw;
     }
 
-    if (++change_count >= flush_threshold) {
+    if (!batch && count_change_and_check_flush()) {
+	flush_postlist_changes();
+	if (!transaction_active()) apply();
+    }
+}
+
+void
+BrassWritableDatabase::add_documents(const vector<Xapian::Document> & documents,
+				     vector<Xapian::docid> & dids)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::add_documents", documents.size() | dids.size());
+    dids.reserve(dids.size() + documents.size());
+    vector<Xapian::Document>::const_iterator i;
+    for (i = documents.begin(); i != documents.end(); ++i) {
+	// Make sure the docid counter doesn't overflow.
+	if (stats.get_last_docid() == Xapian::docid(-1))
+	    throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+	dids.push_back(add_document_(stats.get_next_docid(), *i, true));
+    }
+
+    // Only check whether to flush once for the whole batch.
+    if (count_change_and_check_flush(documents.size())) {
+	flush_postlist_changes();
+	if (!transaction_active()) apply();
+    }
+}
+
+/// Order positions in a batch of replacements by their document ids.
+class CmpBatchDocids {
+    const vector<Xapian::docid> & dids;
+
+  public:
+    explicit CmpBatchDocids(const vector<Xapian::docid> & dids_) : dids(dids_) { }
+
+    bool operator()(size_t a, size_t b) const { return dids[a] < dids[b]; }
+};
+
+void
+BrassWritableDatabase::replace_documents(const vector<Xapian::docid> & dids,
+					 const vector<Xapian::Document> & documents)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::replace_documents", dids.size() | documents.size());
+    Assert(dids.size() == documents.size());
+
+    // Replace the documents in ascending docid order, so that we read the
+    // old termlists and records in the order they're stored.  Use a stable
+    // sort so that if a docid appears more than once, the last document for
+    // it still wins.
+    vector<size_t> order;
+    order.reserve(dids.size());
+    for (size_t k = 0; k != dids.size(); ++k) order.push_back(k);
+    stable_sort(order.begin(), order.end(), CmpBatchDocids(dids));
+
+    vector<size_t>::const_iterator k;
+    for (k = order.begin(); k != order.end(); ++k) {
+	replace_document_(dids[*k], documents[*k], true);
+    }
+
+    // Only check whether to flush once for the whole batch.
+    if (count_change_and_check_flush(dids.size())) {
+	flush_postlist_changes();
+	if (!transaction_active()) apply();
+    }
+}
+
+void
+BrassWritableDatabase::replace_documents(const vector<string> & unique_terms,
+					 const vector<Xapian::Document> & documents,
+					 vector<Xapian::docid> & dids)
+{
+    LOGCALL_VOID(DB, "BrassWritableDatabase::replace_documents", unique_terms.size() | documents.size() | dids.size());
+    Assert(unique_terms.size() == documents.size());
+    dids.reserve(dids.size() + documents.size());
+    for (size_t k = 0; k != unique_terms.size(); ++k) {
+	// Look up each term when we get to it, since an earlier document in
+	// the batch may have added or replaced a document it indexes.
+	intrusive_ptr<LeafPostList> pl(open_post_list(unique_terms[k]));
+	pl->next();
+	if (pl->at_end()) {
+	    if (stats.get_last_docid() == Xapian::docid(-1))
+		throw Xapian::DatabaseError("Run out of docids - you'll have to use copydatabase to eliminate any gaps before you can add more documents");
+	    dids.push_back(add_document_(stats.get_next_docid(), documents[k],
+					 true));
+	    continue;
+	}
+	Xapian::docid did = pl->get_docid();
+	replace_document_(did, documents[k], true);
+	while (pl->next(), !pl->at_end()) {
+	    delete_document(pl->get_docid());
+	}
+	dids.push_back(did);
+    }
+
+    // Only check whether to flush once for the whole batch.
+    if (count_change_and_check_flush(unique_terms.size())) {
 	flush_postlist_changes();
 	if (!transaction_active()) apply();
     }
@@ -1497,6 +1924,16 @@ BrassWritableDatabase::open_post_list(const string& tname) const
     RETURN(new BrassPostList(ptrtothis, tname, true));
 }
 
+DocidBitmap *
+BrassWritableDatabase::open_docid_bitmap(const string& tname) const
+{
+    LOGCALL(DB, DocidBitmap *, "BrassWritableDatabase::open_docid_bitmap", tname);
+    // Flush any buffered changes for this term's postlist, which also
+    // brings its bitmap up to date.
+    inverter.flush_post_list(postlist_table, tname);
+    RETURN(BrassDatabase::open_docid_bitmap(tname));
+}
+
 ValueList *
 BrassWritableDatabase::open_value_list(Xapian::valueno slot) const
 {
@@ -1508,6 +1945,19 @@ BrassWritableDatabase::open_value_list(Xapian::valueno slot) const
     RETURN(BrassDatabase::open_value_list(slot));
 }
 
+bool
+BrassWritableDatabase::get_value_range_docids(Xapian::valueno slot,
+					      const string & begin,
+					      const string & end,
+					      Xapian::doccount limit,
+					      vector<Xapian::docid> & dids) const
+{
+    LOGCALL(DB, bool, "BrassWritableDatabase::get_value_range_docids", slot | begin | end | limit | Literal("[dids]"));
+    // As for open_value_list(), flush any changes so the index is up to date.
+    if (change_count) value_manager.merge_changes();
+    RETURN(BrassDatabase::get_value_range_docids(slot, begin, end, limit, dids));
+}
+
 TermList *
 BrassWritableDatabase::open_allterms(const string & prefix) const
 {
@@ -1607,3 +2057,11 @@ BrassWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+string
+BrassWritableDatabase::get_revision_key() const
+{
+    // Uncommitted changes don't change the revision, so results can't be
+    // cached.
+    return string();
+}
@@ -25,8 +25,10 @@
 #define OM_HGUARD_BRASS_DATABASE_H
 
 #include "database.h"
+#include "brass_committer.h"
 #include "brass_dbstats.h"
 #include "brass_inverter.h"
+#include "brass_pins.h"
 #include "brass_positionlist.h"
 #include "brass_postlist.h"
 #include "brass_record.h"
@@ -106,6 +108,20 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	BrassRecordTable record_table;
 
+	/** The revisions readers have pinned.
+	 *
+	 *  A reader pins the revision it has open, and a writer avoids
+	 *  reusing blocks of pinned revisions.
+	 */
+	BrassRevisionPins pins;
+
+	/** Syncs the tables when committing.
+	 *
+	 *  This must be destroyed before the tables, since it may be syncing
+	 *  them in the background.
+	 */
+	BrassCommitter committer;
+
 	/// Lock object.
 	FlintLock lock;
 
@@ -123,8 +139,12 @@ class BrassDatabase : public Xapian::Database::Internal {
 
 	/** Create new tables, and open them.
 	 *  Any existing tables will be removed first.
+	 *
+	 *  @param blocksize	Block size, in bytes, to use for the tables.
+	 *  @param flags	Flags passed when opening the database (e.g.
+	 *			Xapian::DB_PACKED_POSTLISTS).
 	 */
-	void create_and_open_tables(unsigned int blocksize);
+	void create_and_open_tables(unsigned int blocksize, int flags);
 
 	/** Open all tables at most recent consistent revision.
 	 *
@@ -136,6 +156,14 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	bool open_tables_consistent();
 
+	/** Pin the revision a reader has open.
+	 *
+	 *  If a newer revision has appeared, the writer may have started
+	 *  reusing blocks before it could see the pin, so we move to the
+	 *  newer revision and pin that instead.
+	 */
+	void pin_revision();
+
 	/** Get a write lock on the database, or throw an
 	 *  Xapian::DatabaseLockError if failure.
 	 *
@@ -145,6 +173,22 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 */
 	void get_database_write_lock(bool creating);
 
+	/** Tell the tables which database they belong to, so they can use
+	 *  the process-wide block cache.
+	 */
+	void set_block_cache_ids();
+
+	/** Tell the tables whether we have the revision they're open at
+	 *  pinned.
+	 */
+	void set_revision_pinned(bool pinned);
+
+	/** Tell the tables to access their files via mmap() when opened.
+	 *
+	 *  Used when the database is opened read-only with Xapian::DB_MMAP.
+	 */
+	void set_use_mmap();
+
 	/** Open tables at specified revision number.
 	 *
 	 *  @exception Xapian::InvalidArgumentError is thrown if the specified
@@ -175,14 +219,25 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *          be greater than the latest revision number (see
 	 *          get_latest_revision_number()), or undefined behaviour will
 	 *          result.
+	 *
+	 *  @param background	If true, return once the changes have been
+	 *			written, leaving the tables to be synced to disk
+	 *			in the background (see BrassCommitter).
 	 */
-	void set_revision_number(brass_revision_number_t new_revision);
+	void set_revision_number(brass_revision_number_t new_revision,
+				 bool background = false);
 
 	/** Re-open tables to recover from an overwritten condition,
 	 *  or just get most up-to-date version.
 	 */
 	bool reopen();
 
+	/** Open this revision of the database again.
+	 *
+	 *  Only supported for a read-only database.
+	 */
+	Xapian::Database::Internal * open_concurrent_reader() const;
+
 	/** Close all the tables permanently.
 	 */
 	void close();
@@ -203,8 +258,11 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *  tables on disk will be left in an unmodified state (though possibly
 	 *  with increased revision numbers), and the outstanding changes will
 	 *  be lost.
+	 *
+	 *  If @a background is true, errors syncing the changes to disk are
+	 *  reported by a later call instead.
 	 */
-	void apply();
+	void apply(bool background = false);
 
 	/** Cancel any outstanding changes to the tables.
 	 */
@@ -235,6 +293,11 @@ class BrassDatabase : public Xapian::Database::Internal {
 	 *
 	 *  @param dbdir directory holding brass tables
 	 *
+	 *  @param action  XAPIAN_DB_READONLY (optionally ored with
+	 *		   Xapian::DB_MMAP) to open for reading, otherwise the
+	 *		   action to take when opening for writing (optionally
+	 *		   ored with Xapian::DB_PACKED_POSTLISTS).
+	 *
 	 *  @param block_size Block size, in bytes, to use when creating
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
@@ -269,7 +332,13 @@ class BrassDatabase : public Xapian::Database::Internal {
 	bool has_positions() const;
 
 	LeafPostList * open_post_list(const string & tname) const;
+	DocidBitmap * open_docid_bitmap(const string & tname) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
+	bool get_value_range_docids(Xapian::valueno slot,
+				    const std::string & begin,
+				    const std::string & end,
+				    Xapian::doccount limit,
+				    std::vector<Xapian::docid> & dids) const;
 	Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
 	PositionList * open_position_list(Xapian::docid did, const string & term) const;
@@ -291,6 +360,7 @@ class BrassDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	string get_revision_key() const;
 	//@}
 
 };
@@ -307,9 +377,32 @@ class BrassWritableDatabase : public BrassDatabase {
 	 */
 	mutable Xapian::doccount change_count;
 
-	/// If change_count reaches this threshold we automatically flush.
+	/** If change_count reaches this threshold we automatically flush.
+	 *
+	 *  This isn't used if flush_memory_limit is set.
+	 */
 	Xapian::doccount flush_threshold;
 
+	/** If the buffered changes use more than this much memory, we
+	 *  automatically flush.
+	 *
+	 *  0 means to use flush_threshold instead.
+	 */
+	size_t flush_memory_limit;
+
+	/** Calls to commit_async() within this many seconds of the last
+	 *  commit are deferred.  0 means never to defer them.
+	 */
+	double commit_window;
+
+	/// When the last commit started (only tracked if commit_window > 0).
+	double last_commit_time;
+
+	/** True if a call to commit_async() was deferred and no commit has
+	 *  happened since.
+	 */
+	bool commit_deferred;
+
 	/** A pointer to the last document which was returned by
 	 *  open_document(), or NULL if there is no such valid document.  This
 	 *  is used purely for comparing with a supplied document to help with
@@ -325,11 +418,20 @@ class BrassWritableDatabase : public BrassDatabase {
 	/// Flush any unflushed postlist changes, but don't commit them.
 	void flush_postlist_changes() const;
 
+	/** Count document changes, and check whether we should flush.
+	 *
+	 *  @param changes	The number of documents changed (default 1).
+	 *
+	 *  @return	true if the buffered changes have reached the document
+	 *		count threshold or the memory limit.
+	 */
+	bool count_change_and_check_flush(Xapian::doccount changes = 1) const;
+
 	/// Close all the tables permanently.
 	void close();
 
 	/// Apply changes.
-	void apply();
+	void apply(bool background = false);
 
 	//@{
 	/** Implementation of virtual methods: see Database::Internal for
@@ -337,11 +439,19 @@ class BrassWritableDatabase : public BrassDatabase {
 	 */
 	void commit();
 
+	void commit_async();
+
+	void wait_for_commit();
+
+	void set_commit_window(double seconds);
+
 	/** Cancel pending modifications to the database. */
 	void cancel();
 
 	Xapian::docid add_document(const Xapian::Document & document);
-	Xapian::docid add_document_(Xapian::docid did, const Xapian::Document & document);
+	Xapian::docid add_document_(Xapian::docid did,
+				    const Xapian::Document & document,
+				    bool batch = false);
 	// Stop the default implementation of delete_document(term) and
 	// replace_document(term) from being hidden.  This isn't really
 	// a problem as we only try to call them through the base class
@@ -354,9 +464,31 @@ class BrassWritableDatabase : public BrassDatabase {
 	void delete_document(Xapian::docid did);
 	void replace_document(Xapian::docid did, const Xapian::Document & document);
 
+	/** Replace a document.
+	 *
+	 *  If @a batch is true, the caller is responsible for counting the
+	 *  change and flushing if necessary (this also applies to
+	 *  add_document_()).
+	 */
+	void replace_document_(Xapian::docid did,
+			       const Xapian::Document & document,
+			       bool batch);
+
+	void add_documents(const vector<Xapian::Document> & documents,
+			   vector<Xapian::docid> & dids);
+	void replace_documents(const vector<Xapian::docid> & dids,
+			       const vector<Xapian::Document> & documents);
+	void replace_documents(const vector<string> & unique_terms,
+			       const vector<Xapian::Document> & documents,
+			       vector<Xapian::docid> & dids);
+
 	Xapian::Document::Internal * open_document(Xapian::docid did,
 						   bool lazy) const;
 
+	void set_flush_memory_limit(size_t bytes);
+
+	void set_value_index(Xapian::valueno slot, bool enabled);
+
 	//@}
 
     public:
@@ -386,7 +518,13 @@ class BrassWritableDatabase : public BrassDatabase {
 	bool term_exists(const string & tname) const;
 
 	LeafPostList * open_post_list(const string & tname) const;
+	DocidBitmap * open_docid_bitmap(const string & tname) const;
 	ValueList * open_value_list(Xapian::valueno slot) const;
+	bool get_value_range_docids(Xapian::valueno slot,
+				    const std::string & begin,
+				    const std::string & end,
+				    Xapian::doccount limit,
+				    std::vector<Xapian::docid> & dids) const;
 	TermList * open_allterms(const string & prefix) const;
 
 	void add_spelling(const string & word, Xapian::termcount freqinc) const;
@@ -400,6 +538,7 @@ class BrassWritableDatabase : public BrassDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+	string get_revision_key() const;
 	//@}
 };
 
@@ -37,6 +37,8 @@ BrassDatabaseStats::read(BrassPostListTable & postlist_table)
     if (!postlist_table.get_exact_entry(DATABASE_STATS_KEY, data)) {
 	// If there's no entry yet, then all the values are zero.
 	zero();
+	postlist_table.set_packed_postlists(packed_postlists);
+	postlist_table.set_last_docid(last_docid);
 	return;
     }
 
@@ -48,11 +50,14 @@ BrassDatabaseStats::read(BrassPostListTable & postlist_table)
 	unpack_uint(&p, end, &wdf_ubound) &&
 	unpack_uint(&p, end, &doclen_ubound) &&
 	unpack_uint(&p, end, &oldest_changeset) &&
+	unpack_bool(&p, end, &packed_postlists) &&
 	unpack_uint_last(&p, end, &total_doclen)) {
 	// doclen_ubound should always be >= wdf_ubound, so we store the
 	// difference as it may encode smaller.  wdf_ubound is likely to
 	// be larger than doclen_lbound.
 	doclen_ubound += wdf_ubound;
+	postlist_table.set_packed_postlists(packed_postlists);
+	postlist_table.set_last_docid(last_docid);
 	return;
     }
 
@@ -74,9 +79,12 @@ BrassDatabaseStats::write(BrassPostListTable & postlist_table) const
     // be larger than doclen_lbound.
     pack_uint(data, doclen_ubound - wdf_ubound);
     pack_uint(data, oldest_changeset);
+    pack_bool(data, packed_postlists);
     // Micro-optimisation: total_doclen is likely to be the largest value, so
     // store it last as pack_uint_last() uses a slightly more compact encoding
     // - this could save us a few bytes!
     pack_uint_last(data, total_doclen);
     postlist_table.add(DATABASE_STATS_KEY, data);
+    postlist_table.set_packed_postlists(packed_postlists);
+    postlist_table.set_last_docid(last_docid);
 }
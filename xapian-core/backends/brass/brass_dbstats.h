@@ -55,10 +55,13 @@ class BrassDatabaseStats {
     /// Oldest changeset removed when max_changesets is set
     brass_revision_number_t oldest_changeset;
 
+    /// Whether posting list chunks are written in the packed form.
+    bool packed_postlists;
+
   public:
     BrassDatabaseStats()
 	: total_doclen(0), last_docid(0), doclen_lbound(0), doclen_ubound(0),
-	  wdf_ubound(0), oldest_changeset(0) { }
+	  wdf_ubound(0), oldest_changeset(0), packed_postlists(false) { }
 
     totlen_t get_total_doclen() const { return total_doclen; }
 
@@ -76,6 +79,8 @@ class BrassDatabaseStats {
 
     brass_revision_number_t get_oldest_changeset() const { return oldest_changeset; }
 
+    bool get_packed_postlists() const { return packed_postlists; }
+
     void zero() {
 	total_doclen = 0;
 	last_docid = 0;
@@ -83,6 +88,7 @@ class BrassDatabaseStats {
 	doclen_ubound = 0;
 	wdf_ubound = 0;
 	oldest_changeset = 0;
+	packed_postlists = false;
     }
 
     void read(BrassPostListTable & postlist_table);
@@ -91,6 +97,8 @@ class BrassDatabaseStats {
 
     void set_oldest_changeset(brass_revision_number_t changeset) { oldest_changeset = changeset; }
 
+    void set_packed_postlists(bool packed) { packed_postlists = packed; }
+
     void add_document(Xapian::termcount doclen) {
 	if (total_doclen == 0 || (doclen && doclen < doclen_lbound))
 	    doclen_lbound = doclen;
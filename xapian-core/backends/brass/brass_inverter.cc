@@ -24,11 +24,39 @@
 
 #include "brass_postlist.h"
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
+/// Compare changes by docid only, so stable_sort keeps them in the order made.
+struct CmpByDocid {
+    bool operator()(const pair<Xapian::docid, Xapian::termcount> & a,
+		    const pair<Xapian::docid, Xapian::termcount> & b) const {
+	return a.first < b.first;
+    }
+};
+
+void
+Inverter::PostingChanges::sort_changes() const
+{
+    stable_sort(pl_changes.begin(), pl_changes.end(), CmpByDocid());
+
+    // Keep only the last change made to each document.
+    vector<pair<Xapian::docid, Xapian::termcount> >::iterator i, j;
+    j = pl_changes.begin();
+    for (i = pl_changes.begin(); i != pl_changes.end(); ++i) {
+	if (i + 1 != pl_changes.end() && (i + 1)->first == i->first)
+	    continue;
+	*j++ = *i;
+    }
+    pl_changes.erase(j, pl_changes.end());
+    pl_changes_sorted = true;
+}
+
 void
 Inverter::flush_doclengths(BrassPostListTable & table)
 {
@@ -43,7 +71,9 @@ Inverter::flush_post_list(BrassPostListTable & table, const string & term)
     i = postlist_changes.find(term);
     if (i == postlist_changes.end()) return;
 
-    // Flush buffered changes for just this term's postlist.
+    // Flush buffered changes for just this term's postlist.  Merging may
+    // drop superseded changes, so update the memory estimate first.
+    postlist_changes_memory -= changes_memory(i->first, i->second);
     table.merge_changes(term, i->second);
     postlist_changes.erase(i);
 }
@@ -56,6 +86,7 @@ Inverter::flush_all_post_lists(BrassPostListTable & table)
 	table.merge_changes(i->first, i->second);
     }
     postlist_changes.clear();
+    postlist_changes_memory = 0;
 }
 
 void
@@ -69,6 +100,7 @@ Inverter::flush_post_lists(BrassPostListTable & table, const string & pfx)
     end = postlist_changes.upper_bound(pfx);
 
     for (i = begin; i != end; ++i) {
+	postlist_changes_memory -= changes_memory(i->first, i->second);
 	table.merge_changes(i->first, i->second);
     }
 
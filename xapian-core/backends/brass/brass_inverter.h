@@ -25,6 +25,8 @@
 
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "omassert.h"
 #include "str.h"
@@ -35,6 +37,24 @@ class BrassPostListTable;
 /** Magic wdf value used for a deleted posting. */
 const Xapian::termcount DELETED_POSTING = Xapian::termcount(-1);
 
+/** Estimate of the memory used to buffer the change to one posting.
+ *
+ *  This is the size of a vector entry, allowing for the vector's spare
+ *  capacity.
+ */
+const size_t POSTING_CHANGE_MEMORY = 12;
+
+/** Estimate of the memory used to buffer the change to one document length.
+ *
+ *  This is roughly the size of a std::map node and its contents.
+ */
+const size_t DOCLEN_CHANGE_MEMORY = 48;
+
+/** Estimate of the memory used to buffer the changes to a term, not counting
+ *  the term itself or the changes to its postings.
+ */
+const size_t TERM_CHANGES_MEMORY = 128;
+
 /** Class which "inverts the file". */
 class Inverter {
     friend class BrassPostListTable;
@@ -49,38 +69,56 @@ class Inverter {
 	/// Change in collection frequency.
 	Xapian::termcount_diff cf_delta;
 
-	/// Changes to this term's postlist.
-	std::map<Xapian::docid, Xapian::termcount> pl_changes;
+	/** Changes to this term's postlist.
+	 *
+	 *  Changes are just appended, which avoids allocating a node per
+	 *  posting.  Documents are usually added in ascending docid order, in
+	 *  which case this is already sorted - otherwise we sort it and drop
+	 *  all but the last change to each document when it's next needed.
+	 */
+	mutable std::vector<std::pair<Xapian::docid, Xapian::termcount> > pl_changes;
+
+	/// Is pl_changes in ascending docid order with no docid repeated?
+	mutable bool pl_changes_sorted;
+
+	/// Append a change to pl_changes.
+	void append_change(Xapian::docid did, Xapian::termcount wdf) {
+	    if (!pl_changes.empty() && did <= pl_changes.back().first)
+		pl_changes_sorted = false;
+	    pl_changes.push_back(std::make_pair(did, wdf));
+	}
+
+	/// Sort pl_changes and keep only the last change to each document.
+	void sort_changes() const;
 
       public:
 	/// Constructor for an added posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf)
-	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, wdf));
-	}
+	    : tf_delta(1), cf_delta(Xapian::termcount_diff(wdf)),
+	      pl_changes(1, std::make_pair(did, wdf)), pl_changes_sorted(true)
+	{ }
 
 	/// Constructor for a removed posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount wdf, bool)
-	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, DELETED_POSTING));
-	}
+	    : tf_delta(-1), cf_delta(-Xapian::termcount_diff(wdf)),
+	      pl_changes(1, std::make_pair(did, DELETED_POSTING)),
+	      pl_changes_sorted(true)
+	{ }
 
 	/// Constructor for an updated posting.
 	PostingChanges(Xapian::docid did, Xapian::termcount old_wdf,
 		       Xapian::termcount new_wdf)
-	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf))
-	{
-	    pl_changes.insert(std::make_pair(did, new_wdf));
-	}
+	    : tf_delta(0), cf_delta(Xapian::termcount_diff(new_wdf - old_wdf)),
+	      pl_changes(1, std::make_pair(did, new_wdf)),
+	      pl_changes_sorted(true)
+	{ }
 
 	/// Add a posting.
 	void add_posting(Xapian::docid did, Xapian::termcount wdf) {
 	    ++tf_delta;
 	    cf_delta += wdf;
 	    // Add did to term's postlist
-	    pl_changes[did] = wdf;
+	    append_change(did, wdf);
 	}
 
 	/// Remove a posting.
@@ -88,14 +126,21 @@ class Inverter {
 	    --tf_delta;
 	    cf_delta -= wdf;
 	    // Remove did from term's postlist.
-	    pl_changes[did] = DELETED_POSTING;
+	    append_change(did, DELETED_POSTING);
 	}
 
 	/// Update a posting.
 	void update_posting(Xapian::docid did, Xapian::termcount old_wdf,
 			    Xapian::termcount new_wdf) {
 	    cf_delta += new_wdf - old_wdf;
-	    pl_changes[did] = new_wdf;
+	    append_change(did, new_wdf);
+	}
+
+	/// Get the changes to this term's postlist, in ascending docid order.
+	const std::vector<std::pair<Xapian::docid, Xapian::termcount> > &
+	get_changes() const {
+	    if (!pl_changes_sorted) sort_changes();
+	    return pl_changes;
 	}
 
 	/// Get the term frequency delta.
@@ -103,25 +148,47 @@ class Inverter {
 
 	/// Get the collection frequency delta.
 	Xapian::termcount_diff get_cfdelta() const { return cf_delta; }
+
+	/** Get the number of buffered changes.
+	 *
+	 *  This may count more than one change to the same posting.
+	 */
+	size_t size() const { return pl_changes.size(); }
     };
 
     /// Buffered changes to postlists.
     std::map<std::string, PostingChanges> postlist_changes;
 
+    /// Estimate of the memory used by postlist_changes.
+    size_t postlist_changes_memory;
+
+    /// Estimate of the memory used to buffer the changes for a term.
+    static size_t changes_memory(const std::string & term,
+				 const PostingChanges & changes) {
+	return TERM_CHANGES_MEMORY + term.size() +
+	       changes.size() * POSTING_CHANGE_MEMORY;
+    }
+
   public:
     /// Buffered changes to document lengths.
     std::map<Xapian::docid, Xapian::termcount> doclen_changes;
 
   public:
+    Inverter() : postlist_changes_memory(0) { }
+
     void add_posting(Xapian::docid did, const std::string & term,
 		     Xapian::doccount wdf) {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf))).first;
+	    postlist_changes_memory += changes_memory(term, i->second);
 	} else {
+	    size_t old_size = i->second.size();
 	    i->second.add_posting(did, wdf);
+	    postlist_changes_memory +=
+		(i->second.size() - old_size) * POSTING_CHANGE_MEMORY;
 	}
     }
 
@@ -130,10 +197,14 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, wdf, false)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, wdf, false))).first;
+	    postlist_changes_memory += changes_memory(term, i->second);
 	} else {
+	    size_t old_size = i->second.size();
 	    i->second.remove_posting(did, wdf);
+	    postlist_changes_memory +=
+		(i->second.size() - old_size) * POSTING_CHANGE_MEMORY;
 	}
     }
 
@@ -143,16 +214,31 @@ class Inverter {
 	std::map<std::string, PostingChanges>::iterator i;
 	i = postlist_changes.find(term);
 	if (i == postlist_changes.end()) {
-	    postlist_changes.insert(
-		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf)));
+	    i = postlist_changes.insert(
+		std::make_pair(term, PostingChanges(did, old_wdf, new_wdf))).first;
+	    postlist_changes_memory += changes_memory(term, i->second);
 	} else {
+	    size_t old_size = i->second.size();
 	    i->second.update_posting(did, old_wdf, new_wdf);
+	    postlist_changes_memory +=
+		(i->second.size() - old_size) * POSTING_CHANGE_MEMORY;
 	}
     }
 
     void clear() {
 	doclen_changes.clear();
 	postlist_changes.clear();
+	postlist_changes_memory = 0;
+    }
+
+    /** Get an estimate of the memory used to buffer changes.
+     *
+     *  This is approximate, but is proportional to the memory actually used
+     *  (which depends on the C++ library and malloc implementation).
+     */
+    size_t get_memory_used() const {
+	return postlist_changes_memory +
+	       doclen_changes.size() * DOCLEN_CHANGE_MEMORY;
     }
 
     void set_doclength(Xapian::docid did, Xapian::termcount doclen, bool add) {
@@ -0,0 +1,246 @@
+/** @file brass_packedchunk.cc
+ * @brief Bit-packed encoding of brass posting list chunks.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#include <config.h>
+
+#include "brass_packedchunk.h"
+
+#include "pack.h"
+
+using namespace std;
+
+/// Return the number of bits needed to represent @a value.
+static inline unsigned
+bits_needed(unsigned value)
+{
+    unsigned bits = 0;
+    while (value) {
+	++bits;
+	value >>= 1;
+    }
+    return bits;
+}
+
+/// Return the number of bytes @a n values of @a bits bits each pack into.
+static inline size_t
+packed_size(unsigned n, unsigned bits)
+{
+    return (size_t(n) * bits + 7) / 8;
+}
+
+/// Append @a n values of @a bits bits each to @a out.
+static void
+pack_bits(string & out, const unsigned * values, unsigned n, unsigned bits)
+{
+    if (bits == 0) return;
+    unsigned long long acc = 0;
+    unsigned have = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	acc |= static_cast<unsigned long long>(values[i]) << have;
+	have += bits;
+	while (have >= 8) {
+	    out += char(acc & 0xff);
+	    acc >>= 8;
+	    have -= 8;
+	}
+    }
+    if (have) out += char(acc & 0xff);
+}
+
+/** Decode @a n values of @a bits bits each from @a p.
+ *
+ *  The caller must have checked there are packed_size(n, bits) bytes
+ *  available.
+ */
+static inline void
+unpack_bits(const unsigned char * p, unsigned * values, unsigned n,
+	    unsigned bits)
+{
+    if (bits == 0) {
+	for (unsigned i = 0; i != n; ++i) values[i] = 0;
+	return;
+    }
+    const unsigned long long mask = (1ull << bits) - 1;
+    unsigned long long acc = 0;
+    unsigned have = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	while (have < bits) {
+	    acc |= static_cast<unsigned long long>(*p++) << have;
+	    have += 8;
+	}
+	values[i] = unsigned(acc & mask);
+	acc >>= bits;
+	have -= bits;
+    }
+}
+
+/// Append a group of @a n entries to @a out.
+static void
+pack_group(string & out, const unsigned * gaps, const unsigned * wdfs,
+	   unsigned n)
+{
+    unsigned max_gap = 0, max_wdf = 0;
+    for (unsigned i = 0; i != n; ++i) {
+	max_gap |= gaps[i];
+	max_wdf |= wdfs[i];
+    }
+    unsigned gap_bits = bits_needed(max_gap);
+    unsigned wdf_bits = bits_needed(max_wdf);
+    out += char(n - 1);
+    out += char(gap_bits);
+    out += char(wdf_bits);
+    pack_bits(out, gaps, n, gap_bits);
+    pack_bits(out, wdfs, n, wdf_bits);
+}
+
+/** Decode the gaps of the next group, without decoding the wdfs.
+ *
+ *  @return The number of entries, or 0 if the data is bad.
+ */
+static unsigned
+unpack_group_gaps(const char ** posptr, const char * end, unsigned * gaps)
+{
+    const unsigned char * p = reinterpret_cast<const unsigned char *>(*posptr);
+    const unsigned char * e = reinterpret_cast<const unsigned char *>(end);
+    if (e - p < 3) return 0;
+    unsigned n = p[0] + 1;
+    unsigned gap_bits = p[1];
+    unsigned wdf_bits = p[2];
+    if (n > Brass::PACKED_GROUP_SIZE || gap_bits > 32 || wdf_bits > 32)
+	return 0;
+    p += 3;
+    size_t gap_bytes = packed_size(n, gap_bits);
+    size_t wdf_bytes = packed_size(n, wdf_bits);
+    if (size_t(e - p) < gap_bytes + wdf_bytes) return 0;
+    unpack_bits(p, gaps, n, gap_bits);
+    p += gap_bytes + wdf_bytes;
+    *posptr = reinterpret_cast<const char *>(p);
+    return n;
+}
+
+/** Decode the wdfs of a group which unpack_group_gaps() has checked.
+ *
+ *  @param group	The start of the group.
+ */
+static void
+unpack_group_wdfs(const char * group, unsigned * wdfs)
+{
+    const unsigned char * p = reinterpret_cast<const unsigned char *>(group);
+    unsigned n = p[0] + 1;
+    unsigned gap_bits = p[1];
+    unsigned wdf_bits = p[2];
+    p += 3 + packed_size(n, gap_bits);
+    unpack_bits(p, wdfs, n, wdf_bits);
+}
+
+/** Decode the gaps and wdfs of the next group.
+ *
+ *  @return The number of entries, or 0 if the data is bad.
+ */
+static unsigned
+unpack_group(const char ** posptr, const char * end,
+	     unsigned * gaps, unsigned * wdfs)
+{
+    const char * group = *posptr;
+    unsigned n = unpack_group_gaps(posptr, end, gaps);
+    if (n) unpack_group_wdfs(group, wdfs);
+    return n;
+}
+
+namespace Brass {
+
+bool
+pack_chunk_body(const char * pos, const char * end, string & out)
+{
+    unsigned gaps[PACKED_GROUP_SIZE];
+    unsigned wdfs[PACKED_GROUP_SIZE];
+    unsigned n = 0;
+    bool first = true;
+    while (pos != end) {
+	if (first) {
+	    gaps[n] = 0;
+	    first = false;
+	} else if (!unpack_uint(&pos, end, &gaps[n])) {
+	    return false;
+	}
+	if (!unpack_uint(&pos, end, &wdfs[n])) return false;
+	if (++n == PACKED_GROUP_SIZE) {
+	    pack_group(out, gaps, wdfs, n);
+	    n = 0;
+	}
+    }
+    if (n) pack_group(out, gaps, wdfs, n);
+    return true;
+}
+
+bool
+unpack_chunk_body(const char * pos, const char * end, string & out)
+{
+    unsigned gaps[PACKED_GROUP_SIZE];
+    unsigned wdfs[PACKED_GROUP_SIZE];
+    bool first = true;
+    while (pos != end) {
+	unsigned n = unpack_group(&pos, end, gaps, wdfs);
+	if (n == 0) return false;
+	for (unsigned i = 0; i != n; ++i) {
+	    if (first) {
+		if (gaps[i] != 0) return false;
+		first = false;
+	    } else {
+		pack_uint(out, gaps[i]);
+	    }
+	    pack_uint(out, wdfs[i]);
+	}
+    }
+    return true;
+}
+
+unsigned
+unpack_chunk_group(const char ** posptr, const char * end,
+		   Xapian::docid prev_did,
+		   Xapian::docid * dids, Xapian::termcount * wdfs)
+{
+    const char * group = *posptr;
+    unsigned n = unpack_chunk_group_dids(posptr, end, prev_did, dids);
+    if (n) unpack_group_wdfs(group, wdfs);
+    return n;
+}
+
+unsigned
+unpack_chunk_group_dids(const char ** posptr, const char * end,
+			Xapian::docid prev_did, Xapian::docid * dids)
+{
+    unsigned n = unpack_group_gaps(posptr, end, dids);
+    // Turn the gaps into docids.
+    for (unsigned i = 0; i != n; ++i) {
+	prev_did += dids[i] + 1;
+	dids[i] = prev_did;
+    }
+    return n;
+}
+
+void
+unpack_chunk_group_wdfs(const char * group, Xapian::termcount * wdfs)
+{
+    unpack_group_wdfs(group, wdfs);
+}
+
+}
@@ -0,0 +1,120 @@
+/** @file brass_packedchunk.h
+ * @brief Bit-packed encoding of brass posting list chunks.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_PACKEDCHUNK_H
+#define XAPIAN_INCLUDED_BRASS_PACKEDCHUNK_H
+
+#include "xapian/types.h"
+#include "xapian/visibility.h"
+
+#include <string>
+
+/** The body of a packed posting list chunk is a sequence of groups, each
+ *  holding up to PACKED_GROUP_SIZE entries:
+ *
+ *  1)  the number of entries in the group, minus one (one byte).
+ *  2)  the number of bits used for each docid gap (one byte, 0 to 32).
+ *  3)  the number of bits used for each wdf (one byte, 0 to 32).
+ *  4)  the docid gaps, bit-packed least significant bit first.
+ *  5)  the wdfs, bit-packed in the same way.
+ *
+ *  The gap for an entry is the difference between its docid and the previous
+ *  entry's docid, minus one.  The gap for the first entry in a chunk is
+ *  always zero (the first docid is given by the chunk key).
+ *
+ *  Since every value in a group has the same width, a whole group can be
+ *  decoded into arrays in one tight loop, rather than one variable-length
+ *  integer at a time.
+ */
+namespace Brass {
+
+/// The maximum number of entries in each group in a packed chunk.
+const unsigned PACKED_GROUP_SIZE = 128;
+
+/** Convert a chunk body from the unpacked form to the packed form.
+ *
+ *  The unpacked form is the wdf of the first entry, followed by the docid
+ *  gap and wdf of each subsequent entry, all encoded with pack_uint().
+ *
+ *  @param pos	Start of the unpacked chunk body.
+ *  @param end	End of the unpacked chunk body.
+ *  @param out	String to append the packed form to.
+ *
+ *  @return	false if the unpacked data couldn't be decoded.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+bool pack_chunk_body(const char * pos, const char * end, std::string & out);
+
+/** Convert a chunk body from the packed form to the unpacked form.
+ *
+ *  @param pos	Start of the packed chunk body.
+ *  @param end	End of the packed chunk body.
+ *  @param out	String to append the unpacked form to.
+ *
+ *  @return	false if the packed data couldn't be decoded.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+bool unpack_chunk_body(const char * pos, const char * end, std::string & out);
+
+/** Decode the next group of a packed chunk.
+ *
+ *  @param posptr	Pointer to the start of the group, which is updated
+ *			to point to the start of the next group.
+ *  @param end		End of the packed chunk body.
+ *  @param prev_did	The docid of the entry before the group (for the
+ *			first group in a chunk, one less than the first docid
+ *			in the chunk).
+ *  @param dids		Array of PACKED_GROUP_SIZE entries to store the
+ *			docids in.
+ *  @param wdfs		Array of PACKED_GROUP_SIZE entries to store the wdfs
+ *			in.
+ *
+ *  @return	The number of entries decoded, or 0 if the data couldn't be
+ *		decoded.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+unsigned unpack_chunk_group(const char ** posptr, const char * end,
+			    Xapian::docid prev_did,
+			    Xapian::docid * dids, Xapian::termcount * wdfs);
+
+/** Decode just the docids of the next group of a packed chunk.
+ *
+ *  This is cheaper than unpack_chunk_group() when skipping over groups to
+ *  find a docid, as only the group the search stops in needs its wdfs.
+ *  Parameters and return value are as for unpack_chunk_group().
+ */
+XAPIAN_VISIBILITY_DEFAULT
+unsigned unpack_chunk_group_dids(const char ** posptr, const char * end,
+				 Xapian::docid prev_did, Xapian::docid * dids);
+
+/** Decode the wdfs of a group of a packed chunk.
+ *
+ *  @param group	The start of the group, which must have been passed
+ *			to unpack_chunk_group_dids() successfully.
+ *  @param wdfs		Array of PACKED_GROUP_SIZE entries to store the wdfs
+ *			in.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void unpack_chunk_group_wdfs(const char * group, Xapian::termcount * wdfs);
+
+}
+
+#endif // XAPIAN_INCLUDED_BRASS_PACKEDCHUNK_H
@@ -0,0 +1,179 @@
+/** @file brass_pins.cc
+ * @brief Let readers pin the revision of a brass database they're using.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "brass_pins.h"
+
+#include "xapian/error.h"
+
+#include "safeerrno.h"
+#include "safefcntl.h"
+#include "safeunistd.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+
+#include <algorithm>
+#include <utility>
+
+using namespace std;
+
+#ifdef F_OFD_SETLK
+
+/// Set an open file description lock on the byte at @a offset.
+static bool
+set_pin_lock(int fd, short type, brass_revision_number_t offset)
+{
+    struct flock fl;
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = offset;
+    fl.l_len = 1;
+    fl.l_pid = 0;
+    while (fcntl(fd, F_OFD_SETLK, &fl) == -1) {
+	if (errno != EINTR) return false;
+    }
+    return true;
+}
+
+bool
+BrassRevisionPins::open_file(bool create)
+{
+    if (fd >= 0) return true;
+    if (create) {
+	fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+    } else {
+	// Readers only need read access to take a shared lock, and may not
+	// have write access to the database directory.
+	fd = ::open(filename.c_str(), O_RDONLY | O_BINARY);
+	if (fd < 0 && errno == ENOENT) {
+	    // No writer has opened the database since pins were added, so
+	    // create the file ourselves - otherwise we'd take no pin, and a
+	    // writer which opened the database later would reuse our blocks.
+	    fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_BINARY, 0666);
+	    // Nothing can write to a database on a read-only filesystem, so
+	    // it doesn't need pins.
+	    if (fd < 0 && errno == EROFS) return false;
+	}
+    }
+    if (fd < 0) {
+	throw Xapian::DatabaseOpeningError("Couldn't open " + filename, errno);
+    }
+    return true;
+}
+
+bool
+BrassRevisionPins::pin(brass_revision_number_t new_revision)
+{
+    LOGCALL(DB, bool, "BrassRevisionPins::pin", new_revision);
+    if (pinned && revision == new_revision) RETURN(true);
+    if (!open_file(false)) RETURN(false);
+    // Pin the new revision before unpinning the old one, so the writer never
+    // sees neither pinned.
+    if (!set_pin_lock(fd, F_RDLCK, new_revision)) RETURN(false);
+    if (pinned) (void)set_pin_lock(fd, F_UNLCK, revision);
+    revision = new_revision;
+    pinned = true;
+    RETURN(true);
+}
+
+void
+BrassRevisionPins::get_pinned(brass_revision_number_t limit,
+			      vector<brass_revision_number_t> & revisions)
+{
+    LOGCALL_VOID(DB, "BrassRevisionPins::get_pinned", limit | revisions.size());
+    (void)open_file(true);
+
+    // F_OFD_GETLK reports one of the locks which conflict with the range
+    // asked about, so split the range around each lock found and keep
+    // looking in the parts either side.
+    size_t first = revisions.size();
+    vector<pair<brass_revision_number_t, brass_revision_number_t> > ranges;
+    ranges.push_back(make_pair(brass_revision_number_t(0), limit));
+    while (!ranges.empty()) {
+	brass_revision_number_t start = ranges.back().first;
+	brass_revision_number_t end = ranges.back().second;
+	ranges.pop_back();
+	if (start >= end) continue;
+
+	struct flock fl;
+	fl.l_type = F_WRLCK;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = start;
+	fl.l_len = end - start;
+	fl.l_pid = 0;
+	if (fcntl(fd, F_OFD_GETLK, &fl) == -1) {
+	    if (errno == EINTR) {
+		ranges.push_back(make_pair(start, end));
+		continue;
+	    }
+	    // We can't tell which of the revisions we haven't checked yet are
+	    // pinned, so reusing any of their blocks wouldn't be safe.
+	    throw Xapian::DatabaseError("Couldn't check for pinned revisions in " +
+					filename, errno);
+	}
+	if (fl.l_type == F_UNLCK) continue;
+
+	brass_revision_number_t lock_start = max(start,
+		brass_revision_number_t(fl.l_start));
+	brass_revision_number_t lock_end = end;
+	if (fl.l_len != 0 && fl.l_start + fl.l_len < off_t(end))
+	    lock_end = brass_revision_number_t(fl.l_start + fl.l_len);
+	for (brass_revision_number_t r = lock_start; r < lock_end; ++r) {
+	    revisions.push_back(r);
+	}
+	ranges.push_back(make_pair(start, lock_start));
+	ranges.push_back(make_pair(lock_end, end));
+    }
+    sort(revisions.begin() + first, revisions.end());
+}
+
+#else
+
+bool
+BrassRevisionPins::open_file(bool)
+{
+    return false;
+}
+
+bool
+BrassRevisionPins::pin(brass_revision_number_t)
+{
+    return false;
+}
+
+void
+BrassRevisionPins::get_pinned(brass_revision_number_t,
+			      vector<brass_revision_number_t> &)
+{
+}
+
+#endif
+
+void
+BrassRevisionPins::release()
+{
+    pinned = false;
+    if (fd < 0) return;
+    // Closing the file releases our lock.
+    (void)::close(fd);
+    fd = -1;
+}
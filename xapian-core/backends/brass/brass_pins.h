@@ -0,0 +1,111 @@
+/** @file brass_pins.h
+ * @brief Let readers pin the revision of a brass database they're using.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BRASS_PINS_H
+#define XAPIAN_INCLUDED_BRASS_PINS_H
+
+#include "brass_types.h"
+
+#include <string>
+#include <vector>
+
+/** Revisions of a database which readers are using.
+ *
+ *  A reader pins the revision it has open by holding a shared lock on the
+ *  byte at that offset in the file "pinlock" in the database directory, and
+ *  the writer avoids reusing blocks which a pinned revision refers to.  The
+ *  locks are released by the OS if a reader exits without cleaning up.
+ *
+ *  This needs open file description locks (F_OFD_SETLK), since these are
+ *  visible between different open files in the same process, and aren't
+ *  released when another descriptor for the same file is closed.  Where
+ *  they aren't available, pin() does nothing and get_pinned() finds
+ *  nothing, so readers behave as they would without pins.
+ */
+class BrassRevisionPins {
+    /// Don't allow assignment.
+    void operator=(const BrassRevisionPins &);
+
+    /// Don't allow copying.
+    BrassRevisionPins(const BrassRevisionPins &);
+
+    std::string filename;
+
+    /// File descriptor for the pin file, or -1 if not open.
+    int fd;
+
+    /// The revision we have pinned (only valid if pinned is true).
+    brass_revision_number_t revision;
+
+    bool pinned;
+
+    /** Open the pin file.
+     *
+     *  @param create	Open for writing, creating the file if necessary (as
+     *			the writer does).  Otherwise the file is opened for
+     *			reading, and only created if it doesn't exist.
+     *
+     *  @return false if pins aren't supported here, or if @a create is
+     *		false and the file doesn't exist and can't be created
+     *		because the filesystem is read-only.  Other failures throw
+     *		Xapian::DatabaseOpeningError.
+     */
+    bool open_file(bool create);
+
+  public:
+    explicit BrassRevisionPins(const std::string & db_dir)
+	: filename(db_dir), fd(-1), revision(0), pinned(false) {
+	filename += "/pinlock";
+    }
+
+    ~BrassRevisionPins() { release(); }
+
+    /** Create the pin file if it doesn't already exist.
+     *
+     *  Called by the writer when it opens the database, so readers find the
+     *  file there to lock.
+     */
+    void create_file() { (void)open_file(true); }
+
+    /** Pin revision @a new_revision, releasing any revision already pinned.
+     *
+     *  @return true if the revision is now pinned, false if pins aren't
+     *		supported here (e.g. the database is on a read-only
+     *		filesystem and has no pin file).
+     */
+    bool pin(brass_revision_number_t new_revision);
+
+    /// Release any pinned revision.
+    void release();
+
+    /** Find which revisions below @a limit are pinned by readers.
+     *
+     *  Throws Xapian::DatabaseError if the pins can't be checked, rather
+     *  than returning a partial list.
+     *
+     *  @param limit	    Only look for revisions less than this.
+     *  @param revisions    The pinned revisions are appended to this in
+     *			    ascending order.
+     */
+    void get_pinned(brass_revision_number_t limit,
+		    std::vector<brass_revision_number_t> & revisions);
+};
+
+#endif // XAPIAN_INCLUDED_BRASS_PINS_H
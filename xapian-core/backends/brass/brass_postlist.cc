@@ -24,12 +24,17 @@
 
 #include "brass_postlist.h"
 
+#include "brass_bitmap.h"
 #include "brass_cursor.h"
 #include "brass_database.h"
+#include "brass_packedchunk.h"
 #include "debuglog.h"
 #include "noreturn.h"
 #include "pack.h"
 #include "str.h"
+#include "stringutils.h"
+
+#include <algorithm>
 
 using Xapian::Internal::intrusive_ptr;
 
@@ -91,6 +96,12 @@ BrassPostListTable::document_exists(Xapian::docid did,
 // Or indexing speed.  Or something...
 const unsigned int CHUNKSIZE = 2000;
 
+/** The most chunks skip_to() will step through to reach the target.
+ *
+ *  Further skips search the B-tree for the right chunk instead.
+ */
+const unsigned int SKIP_TO_MAX_CHUNK_STEPS = 4;
+
 /** PostlistChunkWriter is a wrapper which acts roughly as an
  *  output iterator on a postlist chunk, taking care of the
  *  messy details.  It's intended to be used with deletion and
@@ -102,18 +113,23 @@ class Brass::PostlistChunkWriter {
 	PostlistChunkWriter(const string &orig_key_,
 			    bool is_first_chunk_,
 			    const string &tname_,
-			    bool is_last_chunk_);
+			    bool is_last_chunk_,
+			    bool packed_);
 
 	/// Append an entry to this chunk.
 	void append(BrassTable * table, Xapian::docid did,
 		    Xapian::termcount wdf);
 
-	/// Append a block of raw entries to this chunk.
+	/** Append a block of raw entries to this chunk.
+	 *
+	 *  @a s must be in the unpacked form.
+	 */
 	void raw_append(Xapian::docid first_did_, Xapian::docid current_did_,
-			const string & s) {
+			Xapian::termcount max_wdf_, const string & s) {
 	    Assert(!started);
 	    first_did = first_did_;
 	    current_did = current_did_;
+	    max_wdf = max_wdf_;
 	    if (!s.empty()) {
 		chunk.append(s);
 		started = true;
@@ -133,9 +149,20 @@ class Brass::PostlistChunkWriter {
 	bool is_last_chunk;
 	bool started;
 
+	/** Whether to write the chunk in the packed form.
+	 *
+	 *  The entries are always accumulated in the unpacked form (so we can
+	 *  keep track of the size of the chunk cheaply), and converted when the
+	 *  chunk is flushed.
+	 */
+	bool packed;
+
 	Xapian::docid first_did;
 	Xapian::docid current_did;
 
+	/// The highest wdf in this chunk.
+	Xapian::termcount max_wdf;
+
 	string chunk;
 };
 
@@ -229,20 +256,34 @@ read_wdf(const char ** posptr, const char * end, Xapian::termcount * wdf_ptr)
     if (!unpack_uint(posptr, end, wdf_ptr)) report_read_error(*posptr);
 }
 
+/// Flag in the first byte of a chunk header set for the last chunk.
+const int CHUNK_IS_LAST = 1;
+
+/// Flag in the first byte of a chunk header set if the chunk is packed.
+const int CHUNK_IS_PACKED = 2;
+
 /// Read the start of a chunk.
 static Xapian::docid
 read_start_of_chunk(const char ** posptr,
 		    const char * end,
 		    Xapian::docid first_did_in_chunk,
-		    bool * is_last_chunk_ptr)
+		    bool * is_last_chunk_ptr,
+		    bool * is_packed_ptr,
+		    Xapian::termcount * max_wdf_ptr)
 {
-    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr));
+    LOGCALL_STATIC(DB, Xapian::docid, "read_start_of_chunk", reinterpret_cast<const void*>(posptr) | reinterpret_cast<const void*>(end) | first_did_in_chunk | reinterpret_cast<const void*>(is_last_chunk_ptr) | reinterpret_cast<const void*>(is_packed_ptr) | reinterpret_cast<const void*>(max_wdf_ptr));
     Assert(is_last_chunk_ptr);
-
-    // Read whether this is the last chunk
-    if (!unpack_bool(posptr, end, is_last_chunk_ptr))
-	report_read_error(*posptr);
+    Assert(is_packed_ptr);
+
+    // Read whether this is the last chunk, and how it is encoded.
+    if (*posptr == end) report_read_error(NULL);
+    int flags = *(*posptr)++ - '0';
+    if (flags & ~(CHUNK_IS_LAST | CHUNK_IS_PACKED))
+	report_read_error(NULL);
+    *is_last_chunk_ptr = (flags & CHUNK_IS_LAST);
+    *is_packed_ptr = (flags & CHUNK_IS_PACKED);
     LOGVALUE(DB, *is_last_chunk_ptr);
+    LOGVALUE(DB, *is_packed_ptr);
 
     // Read what the final document ID in this chunk is.
     Xapian::docid increase_to_last;
@@ -250,6 +291,10 @@ read_start_of_chunk(const char ** posptr,
 	report_read_error(*posptr);
     Xapian::docid last_did_in_chunk = first_did_in_chunk + increase_to_last;
     LOGVALUE(DB, last_did_in_chunk);
+
+    // Read the highest wdf in this chunk.
+    if (!unpack_uint(posptr, end, max_wdf_ptr))
+	report_read_error(*posptr);
     RETURN(last_did_in_chunk);
 }
 
@@ -258,6 +303,7 @@ read_start_of_chunk(const char ** posptr,
  *  entries in a postlist.
  */
 class Brass::PostlistChunkReader {
+    /// The entries, in the unpacked form.
     string data;
 
     const char *pos;
@@ -272,7 +318,8 @@ class Brass::PostlistChunkReader {
     /** Initialise the postlist chunk reader.
      *
      *  @param first_did  First document id in this chunk.
-     *  @param data       The tag string with the header removed.
+     *  @param data       The tag string with the header removed, in the
+     *			  unpacked form.
      */
     PostlistChunkReader(Xapian::docid first_did, const string & data_)
 	: data(data_), pos(data.data()), end(pos + data.length()), at_end(data.empty()), did(first_did)
@@ -312,13 +359,16 @@ PostlistChunkReader::next()
 PostlistChunkWriter::PostlistChunkWriter(const string &orig_key_,
 					 bool is_first_chunk_,
 					 const string &tname_,
-					 bool is_last_chunk_)
+					 bool is_last_chunk_,
+					 bool packed_)
 	: orig_key(orig_key_),
 	  tname(tname_), is_first_chunk(is_first_chunk_),
 	  is_last_chunk(is_last_chunk_),
-	  started(false)
+	  started(false),
+	  packed(packed_),
+	  max_wdf(0)
 {
-    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_);
+    LOGCALL_CTOR(DB, "PostlistChunkWriter", orig_key_ | is_first_chunk_ | tname_ | is_last_chunk_ | packed_);
 }
 
 void
@@ -338,6 +388,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	    is_last_chunk = save_is_last_chunk;
 	    is_first_chunk = false;
 	    first_did = did;
+	    max_wdf = 0;
 	    chunk.resize(0);
 	    orig_key = BrassPostListTable::make_key(tname, first_did);
 	} else {
@@ -345,6 +396,7 @@ PostlistChunkWriter::append(BrassTable * table, Xapian::docid did,
 	}
     }
     current_did = did;
+    if (wdf > max_wdf) max_wdf = wdf;
     pack_uint(chunk, wdf);
 }
 
@@ -366,13 +418,19 @@ make_start_of_first_chunk(Xapian::doccount entries,
  */
 static inline string
 make_start_of_chunk(bool new_is_last_chunk,
+		    bool new_is_packed,
 		    Xapian::docid new_first_did,
-		    Xapian::docid new_final_did)
+		    Xapian::docid new_final_did,
+		    Xapian::termcount new_max_wdf)
 {
     Assert(new_final_did >= new_first_did);
     string chunk;
-    pack_bool(chunk, new_is_last_chunk);
+    int flags = 0;
+    if (new_is_last_chunk) flags |= CHUNK_IS_LAST;
+    if (new_is_packed) flags |= CHUNK_IS_PACKED;
+    chunk += char('0' + flags);
     pack_uint(chunk, new_final_did - new_first_did);
+    pack_uint(chunk, new_max_wdf);
     return chunk;
 }
 
@@ -381,15 +439,18 @@ write_start_of_chunk(string & chunk,
 		     unsigned int start_of_chunk_header,
 		     unsigned int end_of_chunk_header,
 		     bool is_last_chunk,
+		     bool is_packed,
 		     Xapian::docid first_did_in_chunk,
-		     Xapian::docid last_did_in_chunk)
+		     Xapian::docid last_did_in_chunk,
+		     Xapian::termcount max_wdf)
 {
     Assert((size_t)(end_of_chunk_header - start_of_chunk_header) <= chunk.size());
 
     chunk.replace(start_of_chunk_header,
 		  end_of_chunk_header - start_of_chunk_header,
-		  make_start_of_chunk(is_last_chunk, first_did_in_chunk,
-				      last_did_in_chunk));
+		  make_start_of_chunk(is_last_chunk, is_packed,
+				      first_did_in_chunk, last_did_in_chunk,
+				      max_wdf));
 }
 
 void
@@ -479,10 +540,12 @@ PostlistChunkWriter::flush(BrassTable *table)
 	    const char *tagend = tagpos + cursor->current_tag.size();
 
 	    // Read the chunk header
-	    bool new_is_last_chunk;
+	    bool new_is_last_chunk, new_is_packed;
+	    Xapian::termcount new_max_wdf;
 	    Xapian::docid new_last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, new_first_did,
-				    &new_is_last_chunk);
+				    &new_is_last_chunk, &new_is_packed,
+				    &new_max_wdf);
 
 	    string chunk_data(tagpos, tagend);
 
@@ -493,8 +556,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 	    string tag;
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, new_first_did);
 	    tag += make_start_of_chunk(new_is_last_chunk,
+					      new_is_packed,
 					      new_first_did,
-					      new_last_did_in_chunk);
+					      new_last_did_in_chunk,
+					      new_max_wdf);
 	    tag += chunk_data;
 	    table->add(orig_key, tag);
 	    return;
@@ -541,11 +606,13 @@ PostlistChunkWriter::flush(BrassTable *table)
 		if (!unpack_uint_preserving_sort(&keypos, keyend, &first_did_in_chunk))
 		    report_read_error(keypos);
 	    }
-	    bool wrong_is_last_chunk;
+	    bool wrong_is_last_chunk, prev_is_packed;
+	    Xapian::termcount prev_max_wdf;
 	    string::size_type start_of_chunk_header = tagpos - tag.data();
 	    Xapian::docid last_did_in_chunk =
 		read_start_of_chunk(&tagpos, tagend, first_did_in_chunk,
-				    &wrong_is_last_chunk);
+				    &wrong_is_last_chunk, &prev_is_packed,
+				    &prev_max_wdf);
 	    string::size_type end_of_chunk_header = tagpos - tag.data();
 
 	    // write new is_last flag
@@ -553,8 +620,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 				 start_of_chunk_header,
 				 end_of_chunk_header,
 				 true, // is_last_chunk
+				 prev_is_packed,
 				 first_did_in_chunk,
-				 last_did_in_chunk);
+				 last_did_in_chunk,
+				 prev_max_wdf);
 	    table->add(cursor->current_key, tag);
 	}
     } else {
@@ -567,6 +636,15 @@ PostlistChunkWriter::flush(BrassTable *table)
 	 */
 	string tag;
 
+	string body;
+	if (packed) {
+	    if (!pack_chunk_body(chunk.data(), chunk.data() + chunk.size(),
+				 body))
+		throw Xapian::DatabaseCorruptError("Bad posting list chunk data");
+	} else {
+	    swap(body, chunk);
+	}
+
 	/* First write the header, which depends on whether this is the
 	 * first chunk.
 	 */
@@ -592,8 +670,9 @@ PostlistChunkWriter::flush(BrassTable *table)
 
 	    tag = make_start_of_first_chunk(num_ent, coll_freq, first_did);
 
-	    tag += make_start_of_chunk(is_last_chunk, first_did, current_did);
-	    tag += chunk;
+	    tag += make_start_of_chunk(is_last_chunk, packed, first_did,
+				       current_did, max_wdf);
+	    tag += body;
 	    table->add(key, tag);
 	    return;
 	}
@@ -632,9 +711,10 @@ PostlistChunkWriter::flush(BrassTable *table)
 	}
 
 	// ...and write the start of this chunk.
-	tag = make_start_of_chunk(is_last_chunk, first_did, current_did);
+	tag = make_start_of_chunk(is_last_chunk, packed, first_did, current_did,
+				  max_wdf);
 
-	tag += chunk;
+	tag += body;
 	table->add(new_key, tag);
     }
 }
@@ -663,11 +743,21 @@ void BrassPostList::read_number_of_entries(const char ** posptr,
  *
  *  A chunk (except for the first chunk) contains:
  *
- *  1)  bool - true if this is the last chunk.
+ *  1)  flags - '0' plus CHUNK_IS_LAST if this is the last chunk, plus
+ *      CHUNK_IS_PACKED if the entries are packed.
  *  2)  difference between final docid in chunk and first docid.
- *  3)  wdf for the first item.
- *  4)  increment in docid to next item, followed by wdf for the item.
- *  5)  (4) repeatedly.
+ *  3)  the highest wdf of any item in the chunk.
+ *  4)  wdf for the first item.
+ *  5)  increment in docid to next item, followed by wdf for the item.
+ *  6)  (5) repeatedly.
+ *
+ *  If the chunk is packed, (4) to (6) are replaced by groups of bit-packed
+ *  entries as described in brass_packedchunk.h.  Which form new chunks are
+ *  written in is a property of the database, set when it is created, but
+ *  both forms can be read whatever it is set to.
+ *
+ *  The highest wdf allows BrassPostList to skip over whole chunks which
+ *  can't contain a document with enough weight to be interesting.
  *
  *  The first chunk begins with the number of entries, the collection
  *  frequency, then the docid of the first document, then has the header of a
@@ -693,6 +783,12 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
 	end = 0;
 	first_did_in_chunk = 0;
 	last_did_in_chunk = 0;
+	max_wdf_in_chunk = 0;
+	max_weight_in_chunk = -1;
+	is_packed_chunk = false;
+	group_size = group_pos = 0;
+	group_start = NULL;
+	have_group_wdfs = false;
 	return;
     }
     cursor->read_tag();
@@ -702,8 +798,10 @@ BrassPostList::BrassPostList(intrusive_ptr<const BrassDatabase> this_db_,
     did = read_start_of_first_chunk(&pos, end, &number_of_entries, NULL);
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    read_first_entry_in_chunk();
     LOGLINE(DB, "Initial docid " << did);
 }
 
@@ -721,10 +819,68 @@ BrassPostList::get_doclength() const
     RETURN(this_db->get_doclength(did));
 }
 
+void
+BrassPostList::read_group(Xapian::docid prev_did)
+{
+    LOGCALL_VOID(DB, "BrassPostList::read_group", prev_did);
+    read_group_dids(prev_did);
+    read_group_wdfs();
+}
+
+void
+BrassPostList::read_group_dids(Xapian::docid prev_did)
+{
+    LOGCALL_VOID(DB, "BrassPostList::read_group_dids", prev_did);
+    group_start = pos;
+    group_size = Brass::unpack_chunk_group_dids(&pos, end, prev_did,
+						group_dids);
+    if (group_size == 0) {
+	throw Xapian::DatabaseCorruptError("Bad packed posting list chunk for `" +
+					   term + "'");
+    }
+    group_pos = 0;
+    have_group_wdfs = false;
+}
+
+void
+BrassPostList::read_group_wdfs()
+{
+    LOGCALL_VOID(DB, "BrassPostList::read_group_wdfs", NO_ARGS);
+    Brass::unpack_chunk_group_wdfs(group_start, group_wdfs);
+    have_group_wdfs = true;
+}
+
+void
+BrassPostList::read_first_entry_in_chunk()
+{
+    LOGCALL_VOID(DB, "BrassPostList::read_first_entry_in_chunk", NO_ARGS);
+    if (!is_packed_chunk) {
+	read_wdf(&pos, end, &wdf);
+	return;
+    }
+    read_group(first_did_in_chunk - 1);
+    did = group_dids[0];
+    wdf = group_wdfs[0];
+}
+
 bool
 BrassPostList::next_in_chunk()
 {
     LOGCALL(DB, bool, "BrassPostList::next_in_chunk", NO_ARGS);
+    if (is_packed_chunk) {
+	if (++group_pos == group_size) {
+	    if (pos == end) {
+		--group_pos;
+		RETURN(false);
+	    }
+	    read_group(did);
+	}
+	did = group_dids[group_pos];
+	wdf = group_wdfs[group_pos];
+	Assert(did <= last_did_in_chunk);
+	RETURN(true);
+    }
+
     if (pos == end) RETURN(false);
 
     read_did_increase(&pos, end, &did);
@@ -780,8 +936,10 @@ BrassPostList::next_chunk()
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    read_first_entry_in_chunk();
 }
 
 PositionList *
@@ -805,13 +963,13 @@ PostList *
 BrassPostList::next(Xapian::weight w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::next", w_min);
-    (void)w_min; // no warning
 
     if (!have_started) {
 	have_started = true;
     } else {
 	if (!next_in_chunk()) next_chunk();
     }
+    skip_chunks_below(w_min);
 
     if (is_at_end) {
 	LOGLINE(DB, "Moved to end");
@@ -873,14 +1031,38 @@ BrassPostList::move_to_chunk_containing(Xapian::docid desired_did)
 
     first_did_in_chunk = did;
     last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
-					    &is_last_chunk);
-    read_wdf(&pos, end, &wdf);
+					    &is_last_chunk, &is_packed_chunk,
+					    &max_wdf_in_chunk);
+    max_weight_in_chunk = -1;
+    read_first_entry_in_chunk();
 
     // Possible, since desired_did might be after end of this chunk and before
     // the next.
     if (desired_did > last_did_in_chunk) next_chunk();
 }
 
+bool
+BrassPostList::step_to_chunk_containing(Xapian::docid desired_did)
+{
+    LOGCALL(DB, bool, "BrassPostList::step_to_chunk_containing", desired_did);
+    AssertRel(desired_did,>,last_did_in_chunk);
+    // Guess how many chunks on desired_did is from the range of docids this
+    // chunk covers.  Stepping the cursor on to the next chunk is much cheaper
+    // than searching the B-tree from the root, so for short skips (as when
+    // intersecting with a list of similar density) we step, but longer skips
+    // would read the tags of too many chunks we don't need.
+    Xapian::docid span = last_did_in_chunk - first_did_in_chunk + 1;
+    if ((desired_did - last_did_in_chunk - 1) / span >= SKIP_TO_MAX_CHUNK_STEPS)
+	RETURN(false);
+    for (unsigned i = 0; i != SKIP_TO_MAX_CHUNK_STEPS; ++i) {
+	next_chunk();
+	if (is_at_end || desired_did <= last_did_in_chunk)
+	    RETURN(true);
+    }
+    // The chunks ahead are denser than this one was.
+    RETURN(false);
+}
+
 bool
 BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 {
@@ -889,6 +1071,38 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
 	RETURN(true);
 
     if (desired_did <= last_did_in_chunk) {
+	if (is_packed_chunk) {
+	    // Skip whole groups until we reach the one containing
+	    // desired_did, only decoding the docids of those we skip over.
+	    while (group_dids[group_size - 1] < desired_did) {
+		if (pos == end) {
+		    // last_did_in_chunk must be wrong.
+		    Assert(false);
+		    group_pos = group_size - 1;
+		    RETURN(false);
+		}
+		read_group_dids(group_dids[group_size - 1]);
+	    }
+	    if (!have_group_wdfs) read_group_wdfs();
+
+	    // Gallop forward from the current entry to bracket desired_did,
+	    // then binary chop - short skips (as when intersecting with a
+	    // list of similar density) only look at a few entries, while
+	    // long ones don't scan the whole group.
+	    unsigned lo = group_pos, step = 1;
+	    while (lo + step < group_size &&
+		   group_dids[lo + step] < desired_did) {
+		lo += step;
+		step <<= 1;
+	    }
+	    unsigned hi = min(lo + step, group_size - 1);
+	    group_pos = lower_bound(group_dids + lo, group_dids + hi + 1,
+				    desired_did) - group_dids;
+	    AssertRel(group_pos,<,group_size);
+	    did = group_dids[group_pos];
+	    wdf = group_wdfs[group_pos];
+	    RETURN(true);
+	}
 	while (pos != end) {
 	    read_did_increase(&pos, end, &did);
 	    if (did >= desired_did) {
@@ -904,6 +1118,7 @@ BrassPostList::move_forward_in_chunk_to_at_least(Xapian::docid desired_did)
     }
 
     pos = end;
+    if (is_packed_chunk) group_pos = group_size - 1;
     RETURN(false);
 }
 
@@ -911,17 +1126,20 @@ PostList *
 BrassPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
 {
     LOGCALL(DB, PostList *, "BrassPostList::skip_to", desired_did | w_min);
-    (void)w_min; // no warning
     // We've started now - if we hadn't already, we're already positioned
     // at start so there's no need to actually do anything.
     have_started = true;
 
     // Don't skip back, and don't need to do anything if already there.
-    if (is_at_end || desired_did <= did) RETURN(NULL);
+    if (is_at_end || desired_did <= did) {
+	skip_chunks_below(w_min);
+	RETURN(NULL);
+    }
 
     // Move to correct chunk
     if (!current_chunk_contains(desired_did)) {
-	move_to_chunk_containing(desired_did);
+	if (!step_to_chunk_containing(desired_did))
+	    move_to_chunk_containing(desired_did);
 	// Might be at_end now, so we need to check before trying to move
 	// forward in chunk.
 	if (is_at_end) RETURN(NULL);
@@ -931,6 +1149,7 @@ BrassPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
     bool have_document = move_forward_in_chunk_to_at_least(desired_did);
     (void)have_document;
     Assert(have_document);
+    skip_chunks_below(w_min);
 
     if (is_at_end) {
 	LOGLINE(DB, "Skipped to end");
@@ -941,6 +1160,20 @@ BrassPostList::skip_to(Xapian::docid desired_did, Xapian::weight w_min)
     RETURN(NULL);
 }
 
+void
+BrassPostList::skip_chunks_below(Xapian::weight w_min)
+{
+    LOGCALL_VOID(DB, "BrassPostList::skip_chunks_below", w_min);
+    if (w_min <= 0 || !weight) return;
+    while (!is_at_end) {
+	if (max_weight_in_chunk < 0)
+	    max_weight_in_chunk = get_maxweight_for_wdf(max_wdf_in_chunk);
+	if (max_weight_in_chunk >= w_min) return;
+	LOGLINE(DB, "Skipping chunk ending at docid " << last_did_in_chunk << " with max weight " << max_weight_in_chunk);
+	next_chunk();
+    }
+}
+
 // Used for doclens.
 bool
 BrassPostList::jump_to(Xapian::docid desired_did)
@@ -1005,7 +1238,8 @@ BrassPostListTable::get_chunk(const string &tname,
 	    throw Xapian::DatabaseCorruptError("Attempted to delete or modify an entry in a non-existent posting list for " + tname);
 
 	*from = NULL;
-	*to = new PostlistChunkWriter(string(), true, tname, true);
+	*to = new PostlistChunkWriter(string(), true, tname, true,
+				      packed_postlists);
 	RETURN(Xapian::docid(-1));
     }
 
@@ -1026,20 +1260,33 @@ BrassPostListTable::get_chunk(const string &tname,
 	}
     }
 
-    bool is_last_chunk;
+    bool is_last_chunk, is_packed;
+    Xapian::termcount max_wdf;
     Xapian::docid last_did_in_chunk;
-    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk, &is_last_chunk);
+    last_did_in_chunk = read_start_of_chunk(&pos, end, first_did_in_chunk,
+					    &is_last_chunk, &is_packed,
+					    &max_wdf);
     *to = new PostlistChunkWriter(cursor->current_key, is_first_chunk, tname,
-				  is_last_chunk);
+				  is_last_chunk, packed_postlists);
+    // The reader and writer work with the unpacked form.
+    string data;
+    if (is_packed) {
+	if (!Brass::unpack_chunk_body(pos, end, data)) {
+	    throw Xapian::DatabaseCorruptError("Bad packed posting list chunk for `" +
+					       tname + "'");
+	}
+    } else {
+	data.assign(pos, end);
+    }
     if (did > last_did_in_chunk) {
 	// This is the shortcut.  Not very pretty, but I'll leave refactoring
 	// until I've a clearer picture of everything which needs to be done.
 	// (FIXME)
 	*from = NULL;
-	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk,
-			  string(pos, end));
+	(*to)->raw_append(first_did_in_chunk, last_did_in_chunk, max_wdf,
+			  data);
     } else {
-	*from = new PostlistChunkReader(first_did_in_chunk, string(pos, end));
+	*from = new PostlistChunkReader(first_did_in_chunk, data);
     }
     if (is_last_chunk) RETURN(Xapian::docid(-1));
 
@@ -1078,7 +1325,7 @@ BrassPostListTable::merge_doclen_changes(const map<Xapian::docid, Xapian::termco
     if (!key_exists(current_key)) {
 	LOGLINE(DB, "Adding dummy first chunk");
 	string newtag = make_start_of_first_chunk(0, 0, 0);
-	newtag += make_start_of_chunk(true, 0, 0);
+	newtag += make_start_of_chunk(true, false, 0, 0, 0);
 	add(current_key, newtag);
     }
 
@@ -1134,6 +1381,7 @@ void
 BrassPostListTable::merge_changes(const string &term,
 				  const Inverter::PostingChanges & changes)
 {
+    Xapian::doccount old_termfreq, termfreq;
     {
 	// Rewrite the first chunk of this posting list with the updated
 	// termfreq and collfreq.
@@ -1144,27 +1392,33 @@ BrassPostListTable::merge_changes(const string &term,
 	// Read start of first chunk to get termfreq and collfreq.
 	const char *pos = tag.data();
 	const char *end = pos + tag.size();
-	Xapian::doccount termfreq;
 	Xapian::termcount collfreq;
 	Xapian::docid firstdid, lastdid;
-	bool islast;
+	Xapian::termcount maxwdf;
+	bool islast, ispacked;
 	if (pos == end) {
 	    termfreq = 0;
 	    collfreq = 0;
 	    firstdid = 0;
 	    lastdid = 0;
+	    maxwdf = 0;
 	    islast = true;
+	    ispacked = false;
 	} else {
 	    firstdid = read_start_of_first_chunk(&pos, end,
 						 &termfreq, &collfreq);
 	    // Handle the generic start of chunk header.
-	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast);
+	    lastdid = read_start_of_chunk(&pos, end, firstdid, &islast,
+					  &ispacked, &maxwdf);
 	}
 
+	old_termfreq = termfreq;
 	termfreq += changes.get_tfdelta();
 	if (termfreq == 0) {
 	    // All postings deleted!  So we can shortcut by zapping the
 	    // posting list.
+	    if (old_termfreq >= Brass::BITMAP_MIN_TERMFREQ / 2)
+		delete_bitmap(term);
 	    if (islast) {
 		// Only one entry for this posting list.
 		del(current_key);
@@ -1185,7 +1439,8 @@ BrassPostListTable::merge_changes(const string &term,
 
 	// Rewrite start of first chunk to update termfreq and collfreq.
 	string newhdr = make_start_of_first_chunk(termfreq, collfreq, firstdid);
-	newhdr += make_start_of_chunk(islast, firstdid, lastdid);
+	newhdr += make_start_of_chunk(islast, ispacked, firstdid, lastdid,
+				      maxwdf);
 	if (pos == end) {
 	    add(current_key, newhdr);
 	} else {
@@ -1194,15 +1449,17 @@ BrassPostListTable::merge_changes(const string &term,
 	    add(current_key, tag);
 	}
     }
-    map<Xapian::docid, Xapian::termcount>::const_iterator j;
-    j = changes.pl_changes.begin();
-    Assert(j != changes.pl_changes.end()); // This case is caught above.
+    const vector<pair<Xapian::docid, Xapian::termcount> > & pl_changes =
+	changes.get_changes();
+    vector<pair<Xapian::docid, Xapian::termcount> >::const_iterator j;
+    j = pl_changes.begin();
+    Assert(j != pl_changes.end()); // This case is caught above.
 
     Xapian::docid max_did;
     PostlistChunkReader *from;
     PostlistChunkWriter *to;
     max_did = get_chunk(term, j->first, false, &from, &to);
-    for ( ; j != changes.pl_changes.end(); ++j) {
+    for ( ; j != pl_changes.end(); ++j) {
 	Xapian::docid did = j->first;
 
 next_chunk:
@@ -1241,4 +1498,144 @@ next_chunk:
     }
     to->flush(this);
     delete to;
+
+    merge_bitmap_changes(term, old_termfreq, termfreq, pl_changes);
 }
+
+void
+BrassPostListTable::merge_bitmap_changes(const string & term,
+					 Xapian::doccount old_termfreq,
+					 Xapian::doccount termfreq,
+					 const vector<pair<Xapian::docid, Xapian::termcount> > & changes)
+{
+    LOGCALL_VOID(DB, "BrassPostListTable::merge_bitmap_changes", term | old_termfreq | termfreq | changes.size());
+    using namespace Brass;
+    // A term only keeps its bitmap while its termfreq is at least half
+    // BITMAP_MIN_TERMFREQ, so we only need to look for one in that case.
+    bool have = (old_termfreq >= BITMAP_MIN_TERMFREQ / 2 &&
+		 key_exists(make_bitmap_key(term)));
+    if (!want_bitmap(termfreq, last_docid, have)) {
+	if (have) delete_bitmap(term);
+	return;
+    }
+    if (!have) {
+	write_bitmap(this, term);
+	return;
+    }
+
+    // Update each block with changes in.
+    vector<uint8> words(DocidBitmap::BLOCK_WORDS);
+    vector<pair<Xapian::docid, Xapian::termcount> >::const_iterator j;
+    j = changes.begin();
+    while (j != changes.end()) {
+	Xapian::docid block = j->first >> DocidBitmap::BLOCK_SHIFT;
+	string key = make_bitmap_key(term, block);
+	string tag;
+	if (get_exact_entry(key, tag)) {
+	    decode_bitmap_block(tag, &words[0]);
+	} else {
+	    fill(words.begin(), words.end(), uint8(0));
+	}
+	do {
+	    unsigned bit = j->first & (DocidBitmap::BLOCK_SIZE - 1);
+	    uint8 mask = uint8(1) << (bit & 63);
+	    if (j->second == Xapian::termcount(-1)) {
+		words[bit >> 6] &= ~mask;
+	    } else {
+		words[bit >> 6] |= mask;
+	    }
+	} while (++j != changes.end() &&
+		 (j->first >> DocidBitmap::BLOCK_SHIFT) == block);
+	encode_bitmap_block(&words[0], tag);
+	if (tag.empty()) {
+	    del(key);
+	} else {
+	    add(key, tag);
+	}
+    }
+}
+
+/** Add the docids in a posting list chunk to a term's new bitmap.
+ *
+ *  @param pos		Start of the chunk header (after the header for the
+ *			first chunk, if this is the first chunk).
+ *  @param end		End of the chunk.
+ *  @param first_did	The first docid in the chunk.
+ *  @param writer	The BitmapWriter to add the docids to.
+ */
+static void
+add_chunk_to_bitmap(const char * pos, const char * end,
+		    Xapian::docid first_did, Brass::BitmapWriter & writer)
+{
+    bool is_last, is_packed;
+    Xapian::termcount max_wdf;
+    (void)read_start_of_chunk(&pos, end, first_did, &is_last, &is_packed,
+			      &max_wdf);
+    if (is_packed) {
+	Xapian::docid dids[Brass::PACKED_GROUP_SIZE];
+	Xapian::termcount wdfs[Brass::PACKED_GROUP_SIZE];
+	Xapian::docid prev_did = first_did - 1;
+	while (pos != end) {
+	    unsigned n = Brass::unpack_chunk_group(&pos, end, prev_did,
+						   dids, wdfs);
+	    if (n == 0)
+		throw Xapian::DatabaseCorruptError("Bad posting list chunk data");
+	    for (unsigned i = 0; i != n; ++i) {
+		writer.add(dids[i]);
+	    }
+	    prev_did = dids[n - 1];
+	}
+	return;
+    }
+
+    Xapian::docid did = first_did;
+    Xapian::termcount wdf;
+    read_wdf(&pos, end, &wdf);
+    writer.add(did);
+    while (pos != end) {
+	read_did_increase(&pos, end, &did);
+	read_wdf(&pos, end, &wdf);
+	writer.add(did);
+    }
+}
+
+void
+BrassPostListTable::write_bitmap(BrassTable * table, const string & term)
+{
+    LOGCALL_STATIC_VOID(DB, "BrassPostListTable::write_bitmap", table | term);
+    Brass::BitmapWriter writer(table, term);
+    AutoPtr<BrassCursor> cursor(table->cursor_get());
+    if (!cursor->find_entry(make_key(term))) {
+	throw Xapian::DatabaseCorruptError("Postlist for term with bitmap not found");
+    }
+    cursor->read_tag();
+    const char * pos = cursor->current_tag.data();
+    const char * end = pos + cursor->current_tag.size();
+    Xapian::docid first_did = read_start_of_first_chunk(&pos, end, 0, 0);
+    add_chunk_to_bitmap(pos, end, first_did, writer);
+    while (cursor->next()) {
+	const char * kpos = cursor->current_key.data();
+	const char * kend = kpos + cursor->current_key.size();
+	if (!check_tname_in_key_lite(&kpos, kend, term)) break;
+	if (!unpack_uint_preserving_sort(&kpos, kend, &first_did))
+	    report_read_error(kpos);
+	cursor->read_tag();
+	pos = cursor->current_tag.data();
+	end = pos + cursor->current_tag.size();
+	add_chunk_to_bitmap(pos, end, first_did, writer);
+    }
+    writer.flush();
+}
+
+void
+BrassPostListTable::delete_bitmap(const string & term)
+{
+    LOGCALL_VOID(DB, "BrassPostListTable::delete_bitmap", term);
+    string prefix = Brass::make_bitmap_key(term);
+    MutableBrassCursor cursor(this);
+    if (!cursor.find_entry(prefix)) return;
+    while (cursor.del()) {
+	if (!startswith(cursor.current_key, prefix)) break;
+    }
+}
+
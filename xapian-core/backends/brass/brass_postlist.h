@@ -27,6 +27,7 @@
 #include <xapian/database.h>
 
 #include "brass_inverter.h"
+#include "brass_packedchunk.h"
 #include "brass_types.h"
 #include "brass_positionlist.h"
 #include "leafpostlist.h"
@@ -52,6 +53,31 @@ class BrassPostListTable : public BrassTable {
 	/// PostList for looking up document lengths.
 	mutable AutoPtr<BrassPostList> doclen_pl;
 
+	/// Whether to write new and modified chunks in the packed form.
+	bool packed_postlists;
+
+	/** The highest docid used in the database, as at the last time the
+	 *  statistics were read or written.
+	 *
+	 *  This is used to decide which terms should have a bitmap.
+	 */
+	Xapian::docid last_docid;
+
+	/** Update the bitmap for a term after merging changes.
+	 *
+	 *  @param term		The term.
+	 *  @param old_termfreq	The term's termfreq before the changes.
+	 *  @param termfreq	The term's termfreq after the changes.
+	 *  @param changes	The changes (in ascending docid order).
+	 */
+	void merge_bitmap_changes(const string & term,
+				  Xapian::doccount old_termfreq,
+				  Xapian::doccount termfreq,
+				  const vector<pair<Xapian::docid, Xapian::termcount> > & changes);
+
+	/// Delete the bitmap for a term.
+	void delete_bitmap(const string & term);
+
     public:
 	/** Create a new table object.
 	 *
@@ -67,7 +93,7 @@ class BrassPostListTable : public BrassTable {
 	 */
 	BrassPostListTable(const string & path_, bool readonly_)
 	    : BrassTable("postlist", path_ + "/postlist.", readonly_),
-	      doclen_pl()
+	      doclen_pl(), packed_postlists(false), last_docid(0)
 	{ }
 
 	bool open(brass_revision_number_t revno) {
@@ -75,6 +101,21 @@ class BrassPostListTable : public BrassTable {
 	    return BrassTable::open(revno);
 	}
 
+	/// Set whether to write chunks in the packed form.
+	void set_packed_postlists(bool packed) { packed_postlists = packed; }
+
+	/// Set the highest docid used in the database.
+	void set_last_docid(Xapian::docid did) { last_docid = did; }
+
+	/** Build a bitmap for a term from its posting list.
+	 *
+	 *  @param table	The postlist table to read the posting list from
+	 *			and write the bitmap to.  Any existing bitmap for
+	 *			the term must already have been deleted.
+	 *  @param term		The term.
+	 */
+	static void write_bitmap(BrassTable * table, const string & term);
+
 	/// Merge changes for a term.
 	void merge_changes(const string &term, const Inverter::PostingChanges & changes);
 
@@ -141,6 +182,9 @@ class BrassPostList : public LeafPostList {
 	/// True if this is the last chunk.
 	bool is_last_chunk;
 
+	/// True if the current chunk is in the packed form.
+	bool is_packed_chunk;
+
 	/// Whether we've run off the end of the list yet.
 	bool is_at_end;
 
@@ -153,6 +197,16 @@ class BrassPostList : public LeafPostList {
 	/// The last document id in this chunk.
 	Xapian::docid last_did_in_chunk;
 
+	/// The highest wdf in this chunk.
+	Xapian::termcount max_wdf_in_chunk;
+
+	/** Upper bound on the weight of any entry in this chunk.
+	 *
+	 *  Calculated from max_wdf_in_chunk when first needed, and negative
+	 *  until then.
+	 */
+	Xapian::weight max_weight_in_chunk;
+
 	/// Position of iteration through current chunk.
 	const char * pos;
 
@@ -168,12 +222,54 @@ class BrassPostList : public LeafPostList {
 	/// The number of entries in the posting list.
 	Xapian::doccount number_of_entries;
 
+	/// The docids in the current group of a packed chunk.
+	Xapian::docid group_dids[Brass::PACKED_GROUP_SIZE];
+
+	/// The wdfs in the current group of a packed chunk.
+	Xapian::termcount group_wdfs[Brass::PACKED_GROUP_SIZE];
+
+	/// The number of entries in the current group of a packed chunk.
+	unsigned group_size;
+
+	/// The index of the current entry in the current group.
+	unsigned group_pos;
+
+	/// The start of the current group of a packed chunk.
+	const char * group_start;
+
+	/// True if group_wdfs has been decoded for the current group.
+	bool have_group_wdfs;
+
 	/// Copying is not allowed.
 	BrassPostList(const BrassPostList &);
 
 	/// Assignment is not allowed.
 	void operator=(const BrassPostList &);
 
+	/** Decode the next group of a packed chunk.
+	 *
+	 *  @param prev_did	The docid of the entry before the group.
+	 */
+	void read_group(Xapian::docid prev_did);
+
+	/** Decode just the docids of the next group of a packed chunk.
+	 *
+	 *  The wdfs are decoded by read_group_wdfs() if we stop in this group.
+	 *
+	 *  @param prev_did	The docid of the entry before the group.
+	 */
+	void read_group_dids(Xapian::docid prev_did);
+
+	/// Decode the wdfs of the current group of a packed chunk.
+	void read_group_wdfs();
+
+	/** Read the first entry in the chunk.
+	 *
+	 *  Called after the chunk header has been read, with did set to the
+	 *  first docid in the chunk.
+	 */
+	void read_first_entry_in_chunk();
+
 	/** Move to the next item in the chunk, if possible.
 	 *  If already at the end of the chunk, returns false.
 	 */
@@ -208,6 +304,19 @@ class BrassPostList : public LeafPostList {
 	 */
 	void move_to_chunk_containing(Xapian::docid desired_did);
 
+	/** Step forward through the following chunks to reach desired_did.
+	 *
+	 *  This is used by skip_to() when desired_did is a little way past
+	 *  the end of the current chunk, since it avoids searching the B-tree
+	 *  again.
+	 *
+	 *  @return true if we're now on the chunk which desired_did is in (or
+	 *	    would be in), or at the end of the list; false if
+	 *	    desired_did looks too far away, in which case
+	 *	    move_to_chunk_containing() should be used.
+	 */
+	bool step_to_chunk_containing(Xapian::docid desired_did);
+
 	/** Scan forward in the current chunk for the specified document ID.
 	 *
 	 *  This is particularly efficient if the desired document ID is
@@ -219,6 +328,15 @@ class BrassPostList : public LeafPostList {
 	 */
 	bool move_forward_in_chunk_to_at_least(Xapian::docid desired_did);
 
+	/** Skip chunks which can't contain an entry with weight >= w_min.
+	 *
+	 *  If the upper bound on the weight of the current chunk is less than
+	 *  @a w_min, move to the start of the next chunk, and repeat until a
+	 *  chunk which might contain such an entry is found (or we run off the
+	 *  end of the list).
+	 */
+	void skip_chunks_below(Xapian::weight w_min);
+
     public:
 	/// Default constructor.
 	BrassPostList(Xapian::Internal::intrusive_ptr<const BrassDatabase> this_db_,
@@ -50,6 +50,11 @@
 // #define DANGEROUS
 
 #include <sys/types.h>
+#include "safefcntl.h"
+#include "safesysstat.h"
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 // Trying to include the correct headers with the correct defines set to
 // get pread() and pwrite() prototyped on every platform without breaking any
@@ -68,10 +73,14 @@ PWRITE_PROTOTYPE
 #include <climits>   /* for CHAR_BIT */
 
 #include "brass_btreebase.h"
+#include "brass_committer.h"
 #include "brass_cursor.h"
 
+#include "../blockcache.h"
+
 #include "debuglog.h"
 #include "io_utils.h"
+#include "iothrottle.h"
 #include "omassert.h"
 #include "pack.h"
 #include "unaligned.h"
@@ -180,17 +189,65 @@ static inline byte *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
-/// read_block(n, p) reads block n of the DB file to address p.
+/// read_block(n, p) reads block n of the table to address p.
 void
 BrassTable::read_block(uint4 n, byte * p) const
 {
     // Log the value of p, not the contents of the block it points to...
     LOGCALL_VOID(DB, "BrassTable::read_block", n | (void*)p);
+    if (cache_id) {
+	if (BlockCache::lookup(cache_id, cache_revision, prev_cache_revision,
+			       n, p, block_size))
+	    return;
+	read_block_from_file(n, p);
+	// If the block has been overwritten by a later revision, don't cache
+	// it - the caller will report the problem.
+	if (REVISION(p) <= revision_number)
+	    BlockCache::insert(cache_id, cache_revision, n, p, block_size);
+	return;
+    }
+    read_block_from_file(n, p);
+}
+
+/** locate_block(n, p) makes p point to block n of the table.
+ *
+ *  If the DB file is mapped, p is set to point to the block in the mapping.
+ *  Otherwise p must point to a buffer, which the block is read into.
+ */
+void
+BrassTable::locate_block(uint4 n, byte *& p) const
+{
+    LOGCALL_VOID(DB, "BrassTable::locate_block", n | (void*)p);
+    if (mapping) {
+	// The revision we're reading can't refer to blocks beyond the end of
+	// the file as it was when we opened it, so if we get here we must have
+	// followed a pointer from a block which has since been overwritten.
+	if (rare(n >= mapping_blocks)) set_overwritten();
+	p = mapping + size_t(n) * block_size;
+	return;
+    }
+    read_block(n, p);
+}
+
+/// read_block_from_file(n, p) reads block n of the DB file to address p.
+void
+BrassTable::read_block_from_file(uint4 n, byte * p) const
+{
+    LOGCALL_VOID(DB, "BrassTable::read_block_from_file", n | (void*)p);
     /* Use the base bit_map_size not the bitmap's size, because
      * the latter is uninitialised in readonly mode.
      */
     Assert(n / CHAR_BIT < base.get_bit_map_size());
 
+    if (readahead_blocks) {
+	if (n - readahead_first >= readahead_count) read_blocks_ahead(n);
+	memcpy(p, readahead_buf + size_t(n - readahead_first) * block_size,
+	       block_size);
+	return;
+    }
+
+    if (io_throttle) io_throttle->account(block_size);
+
 #ifdef HAVE_PREAD
     off_t offset = off_t(block_size) * n;
     int m = block_size;
@@ -227,6 +284,53 @@ BrassTable::read_block(uint4 n, byte * p) const
 #endif
 }
 
+/// read_blocks_ahead(n) reads block n and those after it into readahead_buf.
+void
+BrassTable::read_blocks_ahead(uint4 n) const
+{
+    LOGCALL_VOID(DB, "BrassTable::read_blocks_ahead", n);
+    readahead_count = 0;
+    // Don't read past the last block this revision could use.
+    uint4 blocks = readahead_blocks;
+    uint4 limit = base.get_bit_map_size() * CHAR_BIT;
+    if (n < limit && limit - n < blocks) blocks = limit - n;
+    size_t want = size_t(blocks) * block_size;
+
+    if (io_throttle) io_throttle->account(want);
+
+    char * p = reinterpret_cast<char *>(readahead_buf);
+    off_t offset = off_t(block_size) * n;
+    size_t got = 0;
+#ifdef HAVE_PREAD
+    // Read until we have all we asked for or reach the end of the file.
+    while (got < want) {
+	ssize_t bytes_read = pread(handle, p + got, want - got,
+				   offset + got);
+	if (bytes_read == -1) {
+	    if (errno == EINTR) continue;
+	    string message = "Error reading block " + str(n) + ": ";
+	    message += strerror(errno);
+	    throw Xapian::DatabaseError(message);
+	}
+	if (bytes_read == 0) break;
+	got += bytes_read;
+    }
+#else
+    if (lseek(handle, offset, SEEK_SET) == -1) {
+	string message = "Error seeking to block: ";
+	message += strerror(errno);
+	throw Xapian::DatabaseError(message);
+    }
+    got = io_read(handle, p, want, block_size);
+#endif
+    if (got < block_size) {
+	string message = "Error reading block " + str(n) + ": got end of file";
+	throw Xapian::DatabaseError(message);
+    }
+    readahead_first = n;
+    readahead_count = uint4(got / block_size);
+}
+
 /** write_block(n, p) writes block n in the DB file from address p.
  *  When writing we check to see if the DB file has already been
  *  modified. If not (so this is the first write) the old base is
@@ -247,6 +351,11 @@ BrassTable::write_block(uint4 n, const byte * p) const
     /* write revision is okay */
     AssertEqParanoid(REVISION(p), latest_revision_number + 1);
 
+    // If the last commit hasn't been synced yet, the previous revision is
+    // the latest one safely on disk, so we mustn't remove its base file or
+    // overwrite any of its blocks.
+    if (committer) committer->wait();
+
     if (both_bases) {
 	// Delete the old base before modifying the database.
 	//
@@ -260,6 +369,8 @@ BrassTable::write_block(uint4 n, const byte * p) const
 	latest_revision_number = revision_number;
     }
 
+    if (io_throttle) io_throttle->account(block_size);
+
 #ifdef HAVE_PWRITE
     off_t offset = off_t(block_size) * n;
     int m = block_size;
@@ -345,7 +456,7 @@ BrassTable::block_to_cursor(Brass::Cursor * C_, int j, uint4 n) const
     LOGCALL_VOID(DB, "BrassTable::block_to_cursor", (void*)C_ | j | n);
     if (n == C_[j].n) return;
     byte * p = C_[j].p;
-    Assert(p);
+    Assert(p || mapping);
 
     // FIXME: only needs to be done in write mode
     if (C_[j].rewrite) {
@@ -361,7 +472,8 @@ BrassTable::block_to_cursor(Brass::Cursor * C_, int j, uint4 n) const
 	if (p != C[j].p)
 	    memcpy(p, C[j].p, block_size);
     } else {
-	read_block(n, p);
+	locate_block(n, p);
+	C_[j].p = p;
     }
 
     C_[j].n = n;
@@ -1017,6 +1129,10 @@ BrassTable::add(const string &key, string tag, bool already_compressed)
 
     if (handle < 0) create_and_open(block_size);
 
+    // Before the first change in a revision, find out which blocks we
+    // mustn't reuse.
+    if (!Btree_modified && committer) committer->update_pins();
+
     form_key(key);
 
     bool compressed = false;
@@ -1148,6 +1264,9 @@ BrassTable::del(const string &key)
     if (key.size() > BRASS_BTREE_MAX_KEY_LEN) RETURN(false);
 
     if (key.empty()) RETURN(false);
+
+    if (!Btree_modified && committer) committer->update_pins();
+
     form_key(key);
 
     int n = delete_kt();  /* there are n items to delete */
@@ -1402,6 +1521,14 @@ BrassTable::basic_open(bool revision_supplied, brass_revision_number_t revision_
 
 	/* basep now points to the most recent base block */
 
+	if (writable && committer && other_base != 0 &&
+	    other_base->get_revision() < basep->get_revision()) {
+	    // Readers may still be using the previous revision, so keep its
+	    // bitmap in case they've pinned it.
+	    other_base->get_bit_map_at_start(
+		old_bit_maps[other_base->get_revision()]);
+	}
+
 	/* Avoid copying the bitmap etc. - swap contents with the base
 	 * object in the vector, since it'll be destroyed anyway soon.
 	 */
@@ -1467,6 +1594,7 @@ BrassTable::read_root()
 	     * it's not greater than the current one. */
 	    SET_REVISION(p, 0);
 	    C[0].n = 0;
+	    root_revision = 0;
 	} else {
 	    /* writing - */
 	    SET_REVISION(p, latest_revision_number + 1);
@@ -1476,7 +1604,8 @@ BrassTable::read_root()
 	/* using a root block stored on disk */
 	block_to_cursor(C, level, root);
 
-	if (REVISION(C[level].p) > revision_number) set_overwritten();
+	root_revision = REVISION(C[level].p);
+	if (root_revision > revision_number) set_overwritten();
 	/* although this is unlikely */
     }
 }
@@ -1568,7 +1697,23 @@ BrassTable::BrassTable(const char * tablename_, const string & path_,
 	  compress_strategy(compress_strategy_),
 	  deflate_zstream(NULL),
 	  inflate_zstream(NULL),
-	  lazy(lazy_)
+	  lazy(lazy_),
+	  cache_id(0),
+	  cache_revision(0),
+	  prev_cache_revision(0),
+	  revision_pinned(false),
+	  root_revision(0),
+	  io_throttle(NULL),
+	  committer(NULL),
+	  commit_pending(false),
+	  use_mmap(false),
+	  mapping(NULL),
+	  mapping_size(0),
+	  mapping_blocks(0),
+	  readahead_buf(NULL),
+	  readahead_blocks(0),
+	  readahead_first(0),
+	  readahead_count(0)
 {
     LOGCALL_CTOR(DB, "BrassTable", tablename_ | path_ | readonly_ | compress_strategy_ | lazy_);
 }
@@ -1679,6 +1824,39 @@ BrassTable::erase()
     (void)io_unlink(name + "DB");
 }
 
+void
+BrassTable::set_block_cache_id(const string & db_id)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_block_cache_id", db_id);
+    if (writable) return;
+    cache_id = BlockCache::get_table_id(db_id, tablename);
+}
+
+void
+BrassTable::advise_sequential() const
+{
+    LOGCALL_VOID(DB, "BrassTable::advise_sequential", NO_ARGS);
+#ifdef HAVE_POSIX_FADVISE
+    if (handle >= 0)
+	(void)posix_fadvise(handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void
+BrassTable::set_readahead(size_t bytes)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_readahead", bytes);
+    if (writable) return;
+    delete [] readahead_buf;
+    readahead_buf = NULL;
+    readahead_count = 0;
+    readahead_blocks = 0;
+    size_t blocks = bytes / block_size;
+    if (blocks < 2) return;
+    readahead_buf = new byte[blocks * block_size];
+    readahead_blocks = uint4(blocks);
+}
+
 void
 BrassTable::set_block_size(unsigned int block_size_)
 {
@@ -1742,6 +1920,8 @@ BrassTable::~BrassTable() {
 	(void) inflateEnd(inflate_zstream);
 	delete inflate_zstream;
     }
+
+    delete [] readahead_buf;
 }
 
 void BrassTable::close(bool permanent) {
@@ -1753,6 +1933,8 @@ void BrassTable::close(bool permanent) {
 	(void)::close(handle);
 	handle = -1;
     }
+    commit_pending = false;
+    readahead_count = 0;
 
     if (permanent) {
 	handle = -2;
@@ -1760,10 +1942,15 @@ void BrassTable::close(bool permanent) {
 	// still be used to look up cached content.
 	return;
     }
+    // Cursors on this table point to blocks we're about to release, so make
+    // them rebuild before they're next used.
+    ++cursor_version;
     for (int j = level; j >= 0; j--) {
-	delete [] C[j].p;
+	// If the file is mapped, the pointers point into the mapping.
+	if (!mapping) delete [] C[j].p;
 	C[j].p = 0;
     }
+    unmap_file();
     delete [] split_p;
     split_p = 0;
 
@@ -1801,7 +1988,23 @@ BrassTable::commit(brass_revision_number_t revision, int changes_fd,
 		   const string * changes_tail)
 {
     LOGCALL_VOID(DB, "BrassTable::commit", revision | changes_fd | changes_tail);
+    prepare_commit(revision, changes_fd, changes_tail);
+    try {
+	sync_commit();
+	finish_commit();
+    } catch (...) {
+	BrassTable::close();
+	throw;
+    }
+}
+
+void
+BrassTable::prepare_commit(brass_revision_number_t revision, int changes_fd,
+			   const string * changes_tail)
+{
+    LOGCALL_VOID(DB, "BrassTable::prepare_commit", revision | changes_fd | changes_tail);
     Assert(writable);
+    Assert(!commit_pending);
 
     if (revision <= revision_number) {
 	throw Xapian::DatabaseError("New revision too low");
@@ -1816,6 +2019,8 @@ BrassTable::commit(brass_revision_number_t revision, int changes_fd,
     }
 
     try {
+	brass_revision_number_t old_revision = revision_number;
+
 	if (faked_root_block) {
 	    /* We will use a dummy bitmap. */
 	    base.clear_bit_map();
@@ -1844,43 +2049,19 @@ BrassTable::commit(brass_revision_number_t revision, int changes_fd,
 
 	// Save to "<table>.tmp" and then rename to "<table>.base<letter>" so
 	// that a reader can't try to read a partially written base file.
+	// The sync of the new base file is left to sync_commit(), so that it
+	// can be done at the same time as the sync of the DB file.
 	string tmp = name;
 	tmp += "tmp";
-	string basefile = name;
-	basefile += "base";
-	basefile += char(base_letter);
-	base.write_to_file(tmp, base_letter, tablename, changes_fd, changes_tail);
-
-	// Do this as late as possible to allow maximum time for writes to
-	// happen, and so the calls to io_sync() are adjacent which may be
-	// more efficient, at least with some Linux kernel versions.
-	if (!io_sync(handle)) {
-	    (void)::close(handle);
-	    handle = -1;
-	    (void)unlink(tmp);
-	    throw Xapian::DatabaseError("Can't commit new revision - failed to flush DB to disk");
-	}
-
-#if defined __WIN32__
-	if (msvc_posix_rename(tmp.c_str(), basefile.c_str()) < 0)
-#else
-	if (rename(tmp.c_str(), basefile.c_str()) < 0)
-#endif
-	{
-	    // With NFS, rename() failing may just mean that the server crashed
-	    // after successfully renaming, but before reporting this, and then
-	    // the retried operation fails.  So we need to check if the source
-	    // file still exists, which we do by calling unlink(), since we want
-	    // to remove the temporary file anyway.
-	    int saved_errno = errno;
-	    if (unlink(tmp) == 0 || errno != ENOENT) {
-		string msg("Couldn't update base file ");
-		msg += basefile;
-		msg += ": ";
-		msg += strerror(saved_errno);
-		throw Xapian::DatabaseError(msg);
-	    }
-	}
+	base.write_to_file(tmp, base_letter, tablename, changes_fd,
+			   changes_tail, false);
+	commit_pending = true;
+
+	// The DB file won't be modified again until the new base file is
+	// in place (see write_block()), so we can move on to the new
+	// revision in memory now.  Readers may have pinned the revision
+	// we're moving on from, so keep its bitmap.
+	if (committer) base.get_bit_map_at_start(old_bit_maps[old_revision]);
 	base.commit();
 
 	read_root();
@@ -1889,11 +2070,111 @@ BrassTable::commit(brass_revision_number_t revision, int changes_fd,
 	changed_c = DIR_START;
 	seq_count = SEQ_START_POINT;
     } catch (...) {
+	commit_pending = false;
 	BrassTable::close();
 	throw;
     }
 }
 
+void
+BrassTable::sync_commit() const
+{
+    LOGCALL_VOID(DB, "BrassTable::sync_commit", NO_ARGS);
+    if (!commit_pending) return;
+
+    string tmp = name;
+    tmp += "tmp";
+#ifdef __WIN32__
+    int h = msvc_posix_open(tmp.c_str(), O_WRONLY | O_BINARY);
+#else
+    int h = ::open(tmp.c_str(), O_WRONLY | O_BINARY);
+#endif
+    if (h < 0) {
+	throw Xapian::DatabaseError("Can't commit new revision - failed to "
+				    "reopen new base file " + tmp, errno);
+    }
+    fdcloser closefd(h);
+
+    // Do this as late as possible to allow maximum time for writes to
+    // happen, and so the calls to io_sync() are adjacent which may be
+    // more efficient, at least with some Linux kernel versions.
+    if (!io_sync(handle) || !io_sync(h)) {
+	throw Xapian::DatabaseError("Can't commit new revision - failed to "
+				    "flush DB to disk", errno);
+    }
+}
+
+void
+BrassTable::finish_commit()
+{
+    LOGCALL_VOID(DB, "BrassTable::finish_commit", NO_ARGS);
+    if (!commit_pending) return;
+    commit_pending = false;
+
+    string tmp = name;
+    tmp += "tmp";
+    string basefile = name;
+    basefile += "base";
+    basefile += char(base_letter);
+#if defined __WIN32__
+    if (msvc_posix_rename(tmp.c_str(), basefile.c_str()) < 0)
+#else
+    if (rename(tmp.c_str(), basefile.c_str()) < 0)
+#endif
+    {
+	// With NFS, rename() failing may just mean that the server crashed
+	// after successfully renaming, but before reporting this, and then
+	// the retried operation fails.  So we need to check if the source
+	// file still exists, which we do by calling unlink(), since we want
+	// to remove the temporary file anyway.
+	int saved_errno = errno;
+	if (unlink(tmp) == 0 || errno != ENOENT) {
+	    string msg("Couldn't update base file ");
+	    msg += basefile;
+	    msg += ": ";
+	    msg += strerror(saved_errno);
+	    throw Xapian::DatabaseError(msg);
+	}
+    }
+}
+
+void
+BrassTable::set_pinned_revisions(const vector<brass_revision_number_t> & revisions)
+{
+    LOGCALL_VOID(DB, "BrassTable::set_pinned_revisions", revisions.size());
+    if (handle < 0) return;
+
+    string pinned;
+    uint4 pinned_below = 0;
+    map<brass_revision_number_t, string> kept;
+    vector<brass_revision_number_t>::const_iterator r;
+    for (r = revisions.begin(); r != revisions.end(); ++r) {
+	// The blocks of the revision we're open at are never reused.
+	if (*r >= revision_number) break;
+	map<brass_revision_number_t, string>::iterator i;
+	i = old_bit_maps.find(*r);
+	if (i == old_bit_maps.end()) {
+	    // We don't know which blocks this revision uses, so don't reuse
+	    // any which are already in the DB file.
+	    struct stat statbuf;
+	    if (fstat(handle, &statbuf) < 0) {
+		throw Xapian::DatabaseError("Couldn't stat DB file", errno);
+	    }
+	    pinned_below = statbuf.st_size / block_size;
+	    continue;
+	}
+	const string & bit_map = i->second;
+	if (pinned.size() < bit_map.size()) pinned.resize(bit_map.size());
+	for (size_t k = 0; k != bit_map.size(); ++k) {
+	    pinned[k] |= bit_map[k];
+	}
+	kept[*r].swap(i->second);
+    }
+    // Forget the bitmaps of revisions which are no longer pinned.
+    old_bit_maps.swap(kept);
+    base.set_pinned_blocks(pinned, pinned_below);
+}
+
 void
 BrassTable::write_changed_blocks(int changes_fd)
 {
@@ -2017,29 +2298,188 @@ BrassTable::do_open_to_read(bool revision_supplied, brass_revision_number_t revi
 	}
 	throw Xapian::DatabaseOpeningError("Failed to open table for reading");
     }
+    prev_cache_revision = cache_revision = revision_number;
+
+    // There's nothing to map if the root block is faked, and read_root()
+    // needs a buffer to construct the fake root block in.
+    if (use_mmap && !faked_root_block) map_file();
 
     for (int j = 0; j <= level; j++) {
 	C[j].n = BLK_UNUSED;
-	C[j].p = new byte[block_size];
+	if (!mapping) C[j].p = new byte[block_size];
     }
 
     read_root();
     RETURN(true);
 }
 
+void
+BrassTable::map_file()
+{
+    LOGCALL_VOID(DB, "BrassTable::map_file", NO_ARGS);
+    Assert(!mapping);
+#ifdef HAVE_MMAP
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) < 0) return;
+    // All the blocks in the revision we've opened were written before its
+    // base file, so the file is already long enough to contain them.
+    off_t blocks = statbuf.st_size / block_size;
+    if (blocks == 0 || blocks > off_t(BLK_UNUSED)) return;
+    size_t size = size_t(blocks) * block_size;
+    // Check the file isn't too big to map (possible on 32-bit platforms).
+    if (off_t(size / block_size) != blocks) return;
+    void * p = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+    if (p == MAP_FAILED) {
+	LOGLINE(DB, "mmap() failed (" << strerror(errno) << ") - reading blocks from the file instead");
+	return;
+    }
+    mapping = static_cast<byte *>(p);
+    mapping_size = size;
+    mapping_blocks = uint4(blocks);
+#endif
+}
+
+void
+BrassTable::unmap_file()
+{
+    LOGCALL_VOID(DB, "BrassTable::unmap_file", NO_ARGS);
+#ifdef HAVE_MMAP
+    if (mapping) {
+	(void)munmap(static_cast<void *>(mapping), mapping_size);
+	mapping = NULL;
+	mapping_size = 0;
+	mapping_blocks = 0;
+    }
+#endif
+}
+
+bool
+BrassTable::reopen_if_unchanged(bool revision_supplied,
+				brass_revision_number_t revision_)
+{
+    LOGCALL(DB, bool, "BrassTable::reopen_if_unchanged", revision_supplied | revision_);
+    if (writable || handle < 0) RETURN(false);
+
+    // If the DB file has been replaced, none of what we have is any use.
+    struct stat file_stat, handle_stat;
+    if (stat((name + "DB").c_str(), &file_stat) < 0 ||
+	fstat(handle, &handle_stat) < 0 ||
+	file_stat.st_ino != handle_stat.st_ino ||
+	file_stat.st_dev != handle_stat.st_dev) {
+	RETURN(false);
+    }
+
+    // Pick a base in the same way as basic_open(), but don't read the
+    // bitmaps since readers don't need them.
+    static const char basenames[2] = { 'A', 'B' };
+    BrassTable_base bases[2];
+    bool base_ok[2];
+    int chosen = -1;
+    brass_revision_number_t latest = 0;
+    string err_msg;
+    for (int i = 0; i < 2; ++i) {
+	base_ok[i] = bases[i].read(name, basenames[i], false, err_msg);
+	if (!base_ok[i]) continue;
+	brass_revision_number_t rev = bases[i].get_revision();
+	if (rev > latest) latest = rev;
+	if (revision_supplied) {
+	    if (rev == revision_) chosen = i;
+	} else if (chosen < 0 || rev >= bases[chosen].get_revision()) {
+	    chosen = i;
+	}
+    }
+    // Leave it to a full open to report any problem.
+    if (chosen < 0) RETURN(false);
+
+    BrassTable_base & newbase = bases[chosen];
+    if (newbase.get_block_size() != block_size ||
+	newbase.get_root() != root ||
+	int(newbase.get_level()) != level ||
+	newbase.get_have_fakeroot() != faked_root_block) {
+	RETURN(false);
+    }
+
+    if (!faked_root_block) {
+	// The root block might have been freed and then reused since we read
+	// it, so check it still has the same revision stamp.  Any change to
+	// the B-tree writes a new root block, so if it does then nothing in
+	// the B-tree has changed.
+	brass_revision_number_t rev;
+	if (mapping && root < mapping_blocks) {
+	    rev = REVISION(mapping + size_t(root) * block_size);
+	} else {
+	    byte * p = new byte[block_size];
+	    try {
+		read_block_from_file(root, p);
+	    } catch (...) {
+		delete [] p;
+		throw;
+	    }
+	    rev = REVISION(p);
+	    delete [] p;
+	}
+	if (rev != root_revision) RETURN(false);
+    }
+
+    base.swap(newbase);
+    revision_number = base.get_revision();
+    latest_revision_number = latest;
+    item_count = base.get_item_count();
+    sequential = base.get_sequential();
+    both_bases = base_ok[0] && base_ok[1];
+    base_letter = basenames[chosen];
+    RETURN(true);
+}
+
+bool
+BrassTable::reopen_to_read(bool revision_supplied,
+			   brass_revision_number_t revision_)
+{
+    LOGCALL(DB, bool, "BrassTable::reopen_to_read", revision_supplied | revision_);
+    // The blocks cached for the revision we have open are still valid for a
+    // later revision if the writer can't have reused any of them - either
+    // because we've had our revision pinned, or because the later revision
+    // is the next one (a commit can't reuse a block the revision before it
+    // uses).
+    brass_revision_number_t old_revision = revision_number;
+    brass_revision_number_t old_cache_revision = cache_revision;
+    bool carry_forward = false;
+    struct stat old_stat;
+    if (cache_id && handle >= 0 && fstat(handle, &old_stat) == 0)
+	carry_forward = true;
+    bool old_revision_pinned = revision_pinned;
+
+    close();
+    if (!do_open_to_read(revision_supplied, revision_)) RETURN(false);
+
+    if (carry_forward && revision_number > old_revision &&
+	(old_revision_pinned || revision_number == old_revision + 1)) {
+	// Check the DB file hasn't been replaced.
+	struct stat new_stat;
+	if (handle >= 0 && fstat(handle, &new_stat) == 0 &&
+	    new_stat.st_ino == old_stat.st_ino &&
+	    new_stat.st_dev == old_stat.st_dev) {
+	    prev_cache_revision = old_cache_revision;
+	}
+    }
+    RETURN(true);
+}
+
 void
 BrassTable::open()
 {
     LOGCALL_VOID(DB, "BrassTable::open", NO_ARGS);
     LOGLINE(DB, "opening at path " << name);
-    close();
+    if (reopen_if_unchanged(false, 0)) return;
 
     if (!writable) {
 	// Any errors are thrown if revision_supplied is false
-	(void)do_open_to_read(false, 0);
+	(void)reopen_to_read(false, 0);
 	return;
     }
 
+    close();
+
     // Any errors are thrown if revision_supplied is false.
     (void)do_open_to_write(false, 0);
 }
@@ -2049,10 +2489,10 @@ BrassTable::open(brass_revision_number_t revision)
 {
     LOGCALL(DB, bool, "BrassTable::open", revision);
     LOGLINE(DB, "opening for particular revision at path " << name);
-    close();
+    if (reopen_if_unchanged(true, revision)) RETURN(true);
 
     if (!writable) {
-	if (do_open_to_read(true, revision)) {
+	if (reopen_to_read(true, revision)) {
 	    AssertEq(revision_number, revision);
 	    RETURN(true);
 	} else {
@@ -2061,6 +2501,7 @@ BrassTable::open(brass_revision_number_t revision)
 	}
     }
 
+    close();
     if (!do_open_to_write(true, revision)) {
 	// Can't open at the requested revision.
 	close();
@@ -2106,7 +2547,7 @@ BrassTable::prev_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		    read_block(n, p);
 		}
 	    } else {
-		read_block(n, p);
+		locate_block(n, p);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -2116,6 +2557,7 @@ BrassTable::prev_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 	    if (GET_LEVEL(p) == 0) break;
 	}
 	c = DIR_END(p);
+	C_[0].p = p;
 	C_[0].n = n;
     }
     c -= D2;
@@ -2160,7 +2602,7 @@ BrassTable::next_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 		    read_block(n, p);
 		}
 	    } else {
-		read_block(n, p);
+		locate_block(n, p);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -2170,6 +2612,7 @@ BrassTable::next_for_sequential(Brass::Cursor * C_, int /*dummy*/) const
 	    if (GET_LEVEL(p) == 0) break;
 	}
 	c = DIR_START;
+	C_[0].p = p;
 	C_[0].n = n;
     }
     C_[0].c = c;
@@ -2188,6 +2631,9 @@ BrassTable::prev_default(Brass::Cursor * C_, int j) const
     if (c == DIR_START) {
 	if (j == level) RETURN(false);
 	if (!prev_default(C_, j + 1)) RETURN(false);
+	// Moving the parent loads a new block into C_[j], which may be at a
+	// different address if the file is mapped.
+	p = C_[j].p;
 	c = DIR_END(p);
     }
     c -= D2;
@@ -2211,6 +2657,9 @@ BrassTable::next_default(Brass::Cursor * C_, int j) const
     if (c >= DIR_END(p)) {
 	if (j == level) RETURN(false);
 	if (!next_default(C_, j + 1)) RETURN(false);
+	// Moving the parent loads a new block into C_[j], which may be at a
+	// different address if the file is mapped.
+	p = C_[j].p;
 	c = DIR_START;
     }
     C_[j].c = c;
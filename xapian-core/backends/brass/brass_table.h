@@ -37,7 +37,9 @@
 #include "unaligned.h"
 
 #include <algorithm>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <zlib.h>
 
@@ -290,6 +292,9 @@ public:
  *  Tags which are null strings _are_ valid, and are different from a
  *  tag simply not being in the table.
  */
+class BrassCommitter;
+class IOThrottle;
+
 class XAPIAN_VISIBILITY_DEFAULT BrassTable {
     friend class BrassCursor; /* Should probably fix this. */
     private:
@@ -402,6 +407,39 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	void commit(brass_revision_number_t revision, int changes_fd = -1,
 		    const std::string * changes_tail = NULL);
 
+	/** Commit outstanding changes, but don't sync them to disk yet.
+	 *
+	 *  This does the first part of commit(): the new base file is
+	 *  written to a temporary file, and the table moves to the new
+	 *  revision in memory.  The new revision isn't visible to readers
+	 *  until sync_commit() and then finish_commit() have been called.
+	 *
+	 *  Until then, no blocks may be written to the DB file (see
+	 *  set_committer()), and the table mustn't be closed or cancelled.
+	 *
+	 *  Parameters are as for commit().
+	 */
+	void prepare_commit(brass_revision_number_t revision,
+			    int changes_fd = -1,
+			    const std::string * changes_tail = NULL);
+
+	/** Sync the DB file and the new base file to disk.
+	 *
+	 *  This only uses file descriptors and paths, so may be called from
+	 *  another thread while this table is being read.  Does nothing if
+	 *  there's no commit prepared.
+	 *
+	 *  @exception Xapian::DatabaseError if the sync fails.
+	 */
+	void sync_commit() const;
+
+	/** Make the new revision visible by renaming the base file into place.
+	 *
+	 *  This may be called from another thread in the same way as
+	 *  sync_commit().  Does nothing if there's no commit prepared.
+	 */
+	void finish_commit();
+
 	/** Append the list of blocks changed to a changeset file.
 	 *
 	 *  @param changes_fd  The file descriptor to write changes to.
@@ -492,6 +530,87 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	/// Erase this table from disk.
 	void erase();
 
+	/** Use the process-wide block cache for reads from this table.
+	 *
+	 *  Has no effect if the table is writable.
+	 *
+	 *  @param db_id	String uniquely identifying the database this
+	 *			table is part of.
+	 */
+	void set_block_cache_id(const std::string & db_id);
+
+	/** Say whether the reader has the revision this table is open at
+	 *  pinned.
+	 *
+	 *  While it is, the writer won't reuse any of the blocks that revision
+	 *  uses, so the blocks cached for it can be carried forward when the
+	 *  table is reopened.
+	 */
+	void set_revision_pinned(bool pinned) { revision_pinned = pinned; }
+
+	/** Access the DB file via mmap() when the table is opened.
+	 *
+	 *  Has no effect if the table is writable.  If mmap() isn't available
+	 *  or fails, blocks are read from the file as usual.
+	 */
+	void set_use_mmap() { use_mmap = !writable; }
+
+	/// Will the DB file be accessed via mmap()?
+	bool get_use_mmap() const { return use_mmap; }
+
+	/** Limit the rate of reads from and writes to the DB file.
+	 *
+	 *  @param throttle	The IOThrottle to report I/O to (which the table
+	 *			doesn't take ownership of), or NULL for no limit.
+	 */
+	void set_io_throttle(IOThrottle * throttle) { io_throttle = throttle; }
+
+	/// Get the IOThrottle set by set_io_throttle(), or NULL if none.
+	IOThrottle * get_io_throttle() const { return io_throttle; }
+
+	/** Wait for commits of the table by @a committer to complete before
+	 *  writing any blocks.
+	 *
+	 *  @param committer_	The BrassCommitter (which the table doesn't take
+	 *			ownership of), or NULL.
+	 */
+	void set_committer(BrassCommitter * committer_) {
+	    committer = committer_;
+	}
+
+	/** Don't reuse blocks used by @a revisions.
+	 *
+	 *  The bitmaps of revisions since the table was opened for writing are
+	 *  kept until a call to this method which doesn't list them.  If a
+	 *  revision's bitmap isn't known, no block in the DB file is reused.
+	 *
+	 *  @param revisions	The revisions readers have pinned, in ascending
+	 *			order.
+	 */
+	void set_pinned_revisions(
+		const std::vector<brass_revision_number_t> & revisions);
+
+	/** Tell the OS the DB file is going to be read sequentially.
+	 *
+	 *  This makes the OS read further ahead, which speeds up reading a
+	 *  whole table in order (as compaction does).  It's only a hint, and
+	 *  has no effect if the table isn't open or the OS doesn't support it.
+	 */
+	void advise_sequential() const;
+
+	/** Read the DB file in chunks of up to @a bytes.
+	 *
+	 *  Each read which misses the blocks already read ahead reads that
+	 *  block and those following it into a buffer, so reading a table in
+	 *  block order (as compaction does) uses a few large reads rather
+	 *  than one per block, even if reads of other files come in between.
+	 *
+	 *  Call after opening the table.  Has no effect if the table is
+	 *  writable, and @a bytes less than two blocks turns off reading
+	 *  ahead.
+	 */
+	void set_readahead(size_t bytes);
+
 	/** Set the block size.
 	 *
 	 *  It's only safe to do this before the table is created.
@@ -624,9 +743,38 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 			      bool create_db = false);
 	bool basic_open(bool revision_supplied, brass_revision_number_t revision);
 
+	/** Switch a table open for reading to a new revision without
+	 *  reopening it, if the B-tree hasn't changed since it was opened.
+	 *
+	 *  The file handle, mapping, cursor blocks and block cache entries are
+	 *  all kept, and existing cursors stay valid.
+	 *
+	 *  Return true iff the table is now open at the revision asked for
+	 *  (the latest if @a revision_supplied is false).
+	 */
+	bool reopen_if_unchanged(bool revision_supplied,
+				 brass_revision_number_t revision_);
+
+	/** Reopen a table open for reading at a new revision.
+	 *
+	 *  Blocks cached for the revision the table was open at are carried
+	 *  forward as they're next read, if the writer can't have reused any
+	 *  of them since.
+	 *
+	 *  Return true iff the table is now open at the revision asked for,
+	 *  as do_open_to_read() does.
+	 */
+	bool reopen_to_read(bool revision_supplied,
+			    brass_revision_number_t revision_);
+
 	bool find(Brass::Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_from_file(uint4 n, byte *p) const;
+	void read_blocks_ahead(uint4 n) const;
+	void locate_block(uint4 n, byte *&p) const;
+	void map_file();
+	void unmap_file();
 	void write_block(uint4 n, const byte *p) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Brass::Cursor *C_, int j, uint4 n) const;
@@ -794,6 +942,80 @@ class XAPIAN_VISIBILITY_DEFAULT BrassTable {
 	/// If true, don't create the table until it's needed.
 	bool lazy;
 
+	/** Id of this table in the block cache, or 0 if reads from this table
+	 *  don't use the block cache.
+	 */
+	unsigned cache_id;
+
+	/** The revision to use in block cache keys.
+	 *
+	 *  This is the revision the table was opened at, which may be older
+	 *  than revision_number if reopen_if_unchanged() has since moved the
+	 *  table on to a later revision with the same B-tree.
+	 */
+	brass_revision_number_t cache_revision;
+
+	/** Blocks cached for this revision can also be used.
+	 *
+	 *  This is the cache_revision the table had before reopen_to_read()
+	 *  moved it on, or the same as cache_revision if there aren't any
+	 *  blocks which can be carried forward.
+	 */
+	brass_revision_number_t prev_cache_revision;
+
+	/// True if the reader has the revision we're open at pinned.
+	bool revision_pinned;
+
+	/** The revision stamp of the root block when the table was opened (0
+	 *  if the root block is faked).
+	 */
+	brass_revision_number_t root_revision;
+
+	/// Where to report reads and writes of the DB file, or NULL.
+	IOThrottle * io_throttle;
+
+	/// What to wait for before writing blocks, or NULL.
+	BrassCommitter * committer;
+
+	/** Bitmaps of blocks used by revisions older than the one open, which
+	 *  readers may have pinned.
+	 */
+	std::map<brass_revision_number_t, std::string> old_bit_maps;
+
+	/** True if prepare_commit() has written a new base file which
+	 *  finish_commit() hasn't yet renamed into place.
+	 */
+	bool commit_pending;
+
+	/// Whether to try to access the DB file via mmap() when reading.
+	bool use_mmap;
+
+	/** The DB file mapped into memory, or NULL if it isn't mapped.
+	 *
+	 *  When the file is mapped, the block pointers in the built-in cursor
+	 *  and in cursors created on this table point into the mapping rather
+	 *  than to buffers of their own.
+	 */
+	byte * mapping;
+
+	/// The size of mapping in bytes.
+	size_t mapping_size;
+
+	/// The number of whole blocks in mapping.
+	uint4 mapping_blocks;
+
+	/// Buffer for blocks read ahead by set_readahead(), or NULL.
+	mutable byte * readahead_buf;
+
+	/// The size of readahead_buf in blocks (0 if not reading ahead).
+	uint4 readahead_blocks;
+
+	/// The block number of the first block in readahead_buf.
+	mutable uint4 readahead_first;
+
+	/// The number of blocks currently held in readahead_buf.
+	mutable uint4 readahead_count;
+
 	/* Debugging methods */
 //	void report_block_full(int m, int n, const byte * p);
 
@@ -29,6 +29,7 @@
 #include "debuglog.h"
 #include "document.h"
 #include "pack.h"
+#include "stringutils.h"
 
 #include "xapian/error.h"
 #include "xapian/valueiterator.h"
@@ -129,6 +130,20 @@ ValueChunkReader::skip_to(Xapian::docid target)
     p = NULL;
 }
 
+void
+BrassValueManager::set_change(map<Xapian::docid, string> & slot_changes,
+			      Xapian::docid did, const string & val)
+{
+    map<Xapian::docid, string>::iterator i = slot_changes.lower_bound(did);
+    if (i == slot_changes.end() || i->first != did) {
+	i = slot_changes.insert(i, make_pair(did, string()));
+	changes_memory += VALUE_CHANGE_MEMORY;
+    }
+    changes_memory += val.size();
+    changes_memory -= i->second.size();
+    i->second = val;
+}
+
 void
 BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
 			     const string & val)
@@ -138,7 +153,7 @@ BrassValueManager::add_value(Xapian::docid did, Xapian::valueno slot,
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
-    i->second[did] = val;
+    set_change(i->second, did, val);
 }
 
 void
@@ -149,7 +164,7 @@ BrassValueManager::remove_value(Xapian::docid did, Xapian::valueno slot)
     if (i == changes.end()) {
 	i = changes.insert(make_pair(slot, map<Xapian::docid, string>())).first;
     }
-    i->second[did] = string();
+    set_change(i->second, did, string());
 }
 
 Xapian::docid
@@ -201,6 +216,9 @@ class ValueUpdater {
 
     Xapian::valueno slot;
 
+    /// True if there's a value index for slot to keep up to date.
+    bool indexed;
+
     string ctag;
 
     ValueChunkReader reader;
@@ -241,8 +259,10 @@ class ValueUpdater {
     }
 
   public:
-    ValueUpdater(BrassPostListTable * table_, Xapian::valueno slot_)
-       	: table(table_), slot(slot_), first_did(0), last_allowed_did(0) { }
+    ValueUpdater(BrassPostListTable * table_, Xapian::valueno slot_,
+		 bool indexed_)
+       	: table(table_), slot(slot_), indexed(indexed_), first_did(0),
+	  last_allowed_did(0) { }
 
     ~ValueUpdater() {
 	while (!reader.at_end()) {
@@ -313,10 +333,23 @@ class ValueUpdater {
 	    append_to_stream(reader.get_docid(), reader.get_value());
 	    reader.next();
 	}
-	if (!reader.at_end() && reader.get_docid() == did) reader.next();
+	bool index_changed = indexed;
+	if (!reader.at_end() && reader.get_docid() == did) {
+	    if (indexed) {
+		const string & old_value = reader.get_value();
+		if (old_value == value) {
+		    index_changed = false;
+		} else {
+		    table->del(make_valueindex_key(slot, old_value, did));
+		}
+	    }
+	    reader.next();
+	}
 	if (!value.empty()) {
 	    // Add/update entry for did.
 	    append_to_stream(did, value);
+	    if (index_changed)
+		table->add(make_valueindex_key(slot, value, did), string());
 	}
     }
 };
@@ -344,7 +377,7 @@ BrassValueManager::merge_changes()
 	map<Xapian::valueno, map<Xapian::docid, string> >::const_iterator i;
 	for (i = changes.begin(); i != changes.end(); ++i) {
 	    Xapian::valueno slot = i->first;
-	    Brass::ValueUpdater updater(postlist_table, slot);
+	    Brass::ValueUpdater updater(postlist_table, slot, is_indexed(slot));
 	    const map<Xapian::docid, string> & slot_changes = i->second;
 	    map<Xapian::docid, string>::const_iterator j;
 	    for (j = slot_changes.begin(); j != slot_changes.end(); ++j) {
@@ -352,7 +385,131 @@ BrassValueManager::merge_changes()
 	    }
 	}
 	changes.clear();
+	changes_memory = 0;
+    }
+}
+
+void
+BrassValueManager::read_indexed_slots() const
+{
+    if (indexed_slots_read) return;
+    indexed_slots.clear();
+    string tag;
+    if (postlist_table->get_exact_entry(make_valueindex_slots_key(), tag)) {
+	const char * p = tag.data();
+	const char * end = p + tag.size();
+	while (p != end) {
+	    Xapian::valueno slot;
+	    if (!unpack_uint(&p, end, &slot))
+		throw Xapian::DatabaseCorruptError("Bad list of value index slots");
+	    indexed_slots.insert(slot);
+	}
     }
+    indexed_slots_read = true;
+}
+
+void
+BrassValueManager::set_index(Xapian::valueno slot, bool enabled)
+{
+    LOGCALL_VOID(DB, "BrassValueManager::set_index", slot | enabled);
+    if (is_indexed(slot) == enabled) return;
+
+    // Make sure the value stream is up to date, and that merging changes
+    // later will update the index from the state we leave it in.
+    merge_changes();
+
+    // Entries are added or deleted a chunk's worth at a time, rather than
+    // while iterating with the cursor, which would then need rebuilding
+    // after every change.
+    AutoPtr<BrassCursor> cursor(postlist_table->cursor_get());
+    vector<string> keys;
+    if (enabled) {
+	// Build the index from the value stream.
+	(void)cursor->find_entry_ge(make_valuechunk_key(slot, 1));
+	while (!cursor->after_end()) {
+	    Xapian::docid first_did = docid_from_key(slot, cursor->current_key);
+	    if (!first_did) break;
+	    cursor->read_tag();
+	    const string & chunk = cursor->current_tag;
+	    ValueChunkReader reader(chunk.data(), chunk.size(), first_did);
+	    for ( ; !reader.at_end(); reader.next()) {
+		keys.push_back(make_valueindex_key(slot, reader.get_value(),
+						   reader.get_docid()));
+	    }
+	    vector<string>::const_iterator i;
+	    for (i = keys.begin(); i != keys.end(); ++i) {
+		postlist_table->add(*i, string());
+	    }
+	    keys.clear();
+	    cursor->next();
+	}
+	indexed_slots.insert(slot);
+    } else {
+	const string prefix = make_valueindex_prefix(slot);
+	while (true) {
+	    (void)cursor->find_entry_ge(prefix);
+	    while (!cursor->after_end() && keys.size() < 1000 &&
+		   startswith(cursor->current_key, prefix)) {
+		keys.push_back(cursor->current_key);
+		cursor->next();
+	    }
+	    if (keys.empty()) break;
+	    vector<string>::const_iterator i;
+	    for (i = keys.begin(); i != keys.end(); ++i) {
+		postlist_table->del(*i);
+	    }
+	    keys.clear();
+	}
+	indexed_slots.erase(slot);
+    }
+
+    string tag;
+    set<Xapian::valueno>::const_iterator i;
+    for (i = indexed_slots.begin(); i != indexed_slots.end(); ++i) {
+	pack_uint(tag, *i);
+    }
+    if (tag.empty()) {
+	postlist_table->del(make_valueindex_slots_key());
+    } else {
+	postlist_table->add(make_valueindex_slots_key(), tag);
+    }
+}
+
+bool
+BrassValueManager::get_range_docids(Xapian::valueno slot,
+				    const string & begin, const string & end,
+				    Xapian::doccount limit,
+				    vector<Xapian::docid> & dids) const
+{
+    LOGCALL(DB, bool, "BrassValueManager::get_range_docids", slot | begin | end | limit | Literal("[dids]"));
+    Assert(dids.empty());
+    if (!is_indexed(slot)) RETURN(false);
+
+    const string prefix = make_valueindex_prefix(slot);
+    string key = prefix;
+    pack_string_preserving_sort(key, begin);
+    AutoPtr<BrassCursor> cursor(postlist_table->cursor_get());
+    (void)cursor->find_entry_ge(key);
+    string value;
+    for ( ; !cursor->after_end(); cursor->next()) {
+	const string & k = cursor->current_key;
+	if (!startswith(k, prefix)) break;
+	const char * p = k.data() + prefix.size();
+	const char * k_end = k.data() + k.size();
+	Xapian::docid did;
+	if (!unpack_string_preserving_sort(&p, k_end, value) ||
+	    !unpack_uint_preserving_sort(&p, k_end, &did) || p != k_end) {
+	    throw Xapian::DatabaseCorruptError("Bad value index key");
+	}
+	if (!end.empty() && value > end) break;
+	if (dids.size() == limit) {
+	    dids.clear();
+	    RETURN(false);
+	}
+	dids.push_back(did);
+    }
+    sort(dids.begin(), dids.end());
+    RETURN(true);
 }
 
 void
@@ -369,15 +526,7 @@ BrassValueManager::add_document(Xapian::docid did, const Xapian::Document &doc,
 	string value = *it;
 
         // Update the statistics.
-        std::pair<map<Xapian::valueno, ValueStats>::iterator, bool> i;
-        i = value_stats.insert(make_pair(slot, ValueStats()));
-	ValueStats & stats = i.first->second;
-        if (i.second) {
-            // There were no statistics stored already, so read them.
-            get_value_stats(slot, stats);
-        }
-
-        // Now, modify the stored statistics.
+	ValueStats & stats = get_value_stats_for_update(slot, value_stats);
         if ((stats.freq)++ == 0) {
             // If the value count was previously zero, set the upper and lower
             // bounds to the newly added value.
@@ -431,23 +580,23 @@ BrassValueManager::delete_document(Xapian::docid did,
 	slot += prev_slot + 1;
 	prev_slot = slot;
 
-        std::pair<map<Xapian::valueno, ValueStats>::iterator, bool> i;
-        i = value_stats.insert(make_pair(slot, ValueStats()));
-	ValueStats & stats = i.first->second;
-        if (i.second) {
-            // There were no statistics stored already, so read them.
-            get_value_stats(slot, stats);
-        }
+	remove_value_and_stats(did, slot, value_stats);
+    }
+}
 
-        // Now, modify the stored statistics.
-        AssertRelParanoid(stats.freq, >, 0);
-        if (--(stats.freq) == 0) {
-            stats.lower_bound.resize(0);
-            stats.upper_bound.resize(0);
-        }
- 
-	remove_value(did, slot);
+void
+BrassValueManager::remove_value_and_stats(Xapian::docid did,
+					  Xapian::valueno slot,
+					  map<Xapian::valueno, ValueStats> & value_stats)
+{
+    ValueStats & stats = get_value_stats_for_update(slot, value_stats);
+    AssertRelParanoid(stats.freq, >, 0);
+    if (--(stats.freq) == 0) {
+	stats.lower_bound.resize(0);
+	stats.upper_bound.resize(0);
     }
+
+    remove_value(did, slot);
 }
 
 void
@@ -459,8 +608,73 @@ BrassValueManager::replace_document(Xapian::docid did,
     // been already.  (If we don't do this before deleting the old values,
     // replacing a document with itself will lose the values.)
     doc.internal->need_values();
-    delete_document(did, value_stats);
-    add_document(did, doc, value_stats);
+
+    map<Xapian::valueno, string> old_values;
+    get_all_values(old_values, did);
+
+    // Walk the old and new values in slot order and only update the slots
+    // which have actually changed - a reindexed document often has most or
+    // all of its values unchanged, and then we don't touch the value chunks,
+    // the statistics or the list of slots used.
+    string slots_used;
+    bool slots_changed = false;
+    Xapian::valueno prev_slot = static_cast<Xapian::valueno>(-1);
+    map<Xapian::valueno, string>::const_iterator old_it = old_values.begin();
+    Xapian::ValueIterator it = doc.values_begin();
+    while (it != doc.values_end()) {
+	Xapian::valueno slot = it.get_valueno();
+	while (old_it != old_values.end() && old_it->first < slot) {
+	    // Value removed.
+	    remove_value_and_stats(did, old_it->first, value_stats);
+	    slots_changed = true;
+	    ++old_it;
+	}
+
+	string value = *it;
+	if (old_it == old_values.end() || old_it->first != slot) {
+	    // Value added.
+	    ValueStats & stats = get_value_stats_for_update(slot, value_stats);
+	    if ((stats.freq)++ == 0) {
+		stats.lower_bound = value;
+		stats.upper_bound = value;
+	    } else if (value < stats.lower_bound) {
+		stats.lower_bound = value;
+	    } else if (value > stats.upper_bound) {
+		stats.upper_bound = value;
+	    }
+	    add_value(did, slot, value);
+	    slots_changed = true;
+	} else {
+	    if (value != old_it->second) {
+		// Value changed - the frequency stays the same.
+		ValueStats & stats = get_value_stats_for_update(slot,
+								value_stats);
+		if (stats.freq == 1) {
+		    // This is the only document with a value in this slot.
+		    stats.lower_bound = value;
+		    stats.upper_bound = value;
+		} else if (value < stats.lower_bound) {
+		    stats.lower_bound = value;
+		} else if (value > stats.upper_bound) {
+		    stats.upper_bound = value;
+		}
+		add_value(did, slot, value);
+	    }
+	    ++old_it;
+	}
+
+	pack_uint(slots_used, slot - prev_slot - 1);
+	prev_slot = slot;
+	++it;
+    }
+    while (old_it != old_values.end()) {
+	// Value removed.
+	remove_value_and_stats(did, old_it->first, value_stats);
+	slots_changed = true;
+	++old_it;
+    }
+
+    if (slots_changed) swap(slots[did], slots_used);
 }
 
 string
@@ -515,6 +729,19 @@ BrassValueManager::get_all_values(map<Xapian::valueno, string> & values,
     }
 }
 
+ValueStats &
+BrassValueManager::get_value_stats_for_update(Xapian::valueno slot,
+					      map<Xapian::valueno, ValueStats> & value_stats) const
+{
+    pair<map<Xapian::valueno, ValueStats>::iterator, bool> i;
+    i = value_stats.insert(make_pair(slot, ValueStats()));
+    if (i.second) {
+	// There were no statistics stored already, so read them.
+	get_value_stats(slot, i.first->second);
+    }
+    return i.first->second;
+}
+
 void
 BrassValueManager::get_value_stats(Xapian::valueno slot) const
 {
@@ -29,7 +29,9 @@
 #include "xapian/types.h"
 
 #include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 namespace Brass {
 
@@ -43,6 +45,37 @@ make_valuechunk_key(Xapian::valueno slot, Xapian::docid did)
     return key;
 }
 
+/** Generate the key for the list of slots which have a value index. */
+inline std::string
+make_valueindex_slots_key()
+{
+    return std::string("\0\xda", 2);
+}
+
+/** Generate the prefix of the value index keys for a slot. */
+inline std::string
+make_valueindex_prefix(Xapian::valueno slot)
+{
+    std::string key("\0\xdc", 2);
+    pack_uint(key, slot);
+    return key;
+}
+
+/** Generate the key for a value index entry.
+ *
+ *  The entries for a slot sort in order of value, then docid.  The tag is
+ *  empty.
+ */
+inline std::string
+make_valueindex_key(Xapian::valueno slot, const std::string & value,
+		    Xapian::docid did)
+{
+    std::string key = make_valueindex_prefix(slot);
+    pack_string_preserving_sort(key, value);
+    pack_uint_preserving_sort(key, did);
+    return key;
+}
+
 inline Xapian::docid
 docid_from_key(Xapian::valueno required_slot, const std::string & key)
 {
@@ -71,6 +104,13 @@ class BrassPostListTable;
 class BrassTermListTable;
 struct ValueStats;
 
+/** Estimate of the memory used to buffer a change to a value, not counting
+ *  the value itself.
+ *
+ *  This is roughly the size of a std::map node and its contents.
+ */
+const size_t VALUE_CHANGE_MEMORY = 64;
+
 class BrassValueManager {
     /** The value number for the most recently used value statistics.
      *
@@ -90,6 +130,22 @@ class BrassValueManager {
 
     std::map<Xapian::valueno, std::map<Xapian::docid, std::string> > changes;
 
+    /// Estimate of the memory used by changes.
+    size_t changes_memory;
+
+    /// The slots which have a value index (if indexed_slots_read).
+    mutable std::set<Xapian::valueno> indexed_slots;
+
+    /// True if indexed_slots has been read from the table.
+    mutable bool indexed_slots_read;
+
+    /// Read the list of slots with a value index, if not already read.
+    void read_indexed_slots() const;
+
+    /// Set the change to the value for @a did in one slot's changes.
+    void set_change(std::map<Xapian::docid, std::string> & slot_changes,
+		    Xapian::docid did, const std::string & val);
+
     void add_value(Xapian::docid did, Xapian::valueno slot,
 		   const std::string & val);
 
@@ -104,13 +160,26 @@ class BrassValueManager {
 
     void get_value_stats(Xapian::valueno slot, ValueStats & stats) const;
 
+    /** Get the entry for @a slot in @a value_stats.
+     *
+     *  The stored statistics are read if there isn't an entry yet.
+     */
+    ValueStats & get_value_stats_for_update(Xapian::valueno slot,
+		std::map<Xapian::valueno, ValueStats> & value_stats) const;
+
+    /// Remove the value in @a slot for @a did and update the statistics.
+    void remove_value_and_stats(Xapian::docid did, Xapian::valueno slot,
+		std::map<Xapian::valueno, ValueStats> & value_stats);
+
   public:
     /** Create a new BrassValueManager object. */
     BrassValueManager(BrassPostListTable * postlist_table_,
 		      BrassTermListTable * termlist_table_)
 	: mru_slot(Xapian::BAD_VALUENO),
 	  postlist_table(postlist_table_),
-	  termlist_table(termlist_table_) { }
+	  termlist_table(termlist_table_),
+	  changes_memory(0),
+	  indexed_slots_read(false) { }
 
     // Merge in batched-up changes.
     void merge_changes();
@@ -153,19 +222,51 @@ class BrassValueManager {
      */
     void set_value_stats(std::map<Xapian::valueno, ValueStats> & value_stats);
 
+    /// Return true if there's a value index for @a slot.
+    bool is_indexed(Xapian::valueno slot) const {
+	read_indexed_slots();
+	return indexed_slots.find(slot) != indexed_slots.end();
+    }
+
+    /** Add or remove the value index for @a slot.
+     *
+     *  Any buffered changes are merged first, and a new index is built from
+     *  the value stream.
+     */
+    void set_index(Xapian::valueno slot, bool enabled);
+
+    /** Find the documents with a value in a range using the value index.
+     *
+     *  See Database::Internal::get_value_range_docids() for the
+     *  parameters.  Buffered changes must have been merged first.
+     */
+    bool get_range_docids(Xapian::valueno slot,
+			  const std::string & begin, const std::string & end,
+			  Xapian::doccount limit,
+			  std::vector<Xapian::docid> & dids) const;
+
     void reset() {
 	/// Ignore any old cached valuestats.
 	mru_slot = Xapian::BAD_VALUENO;
+	// And the list of indexed slots, which may have changed.
+	indexed_slots_read = false;
     }
 
     bool is_modified() const {
 	return !changes.empty();
     }
 
+    /// Get an estimate of the memory used to buffer changes.
+    size_t get_memory_used() const {
+	return changes_memory + slots.size() * VALUE_CHANGE_MEMORY;
+    }
+
     void cancel() {
 	// Discard batched-up changes.
 	slots.clear();
 	changes.clear();
+	changes_memory = 0;
+	indexed_slots_read = false;
     }
 };
 
@@ -44,7 +44,9 @@
 using namespace std;
 
 // YYYYMMDDX where X allows multiple format revisions in a day
-#define BRASS_VERSION 201103110
+#define BRASS_VERSION 202610161
+// 202610161 1.3.0 Optional bit-packed postlist chunks
+// 202610160 1.3.0 Postlist chunk headers store the highest wdf in the chunk
 // 201103110 1.2.5 Bump for new max changesets dbstats
 // 200912150 1.1.4 Brass debuts.
 
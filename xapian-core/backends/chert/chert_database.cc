@@ -106,7 +106,7 @@ const int MAX_OPEN_RETRIES = 100;
 ChertDatabase::ChertDatabase(const string &chert_dir, int action,
 			     unsigned int block_size)
 	: db_dir(chert_dir),
-	  readonly(action == XAPIAN_DB_READONLY),
+	  readonly((action & XAPIAN_DB_ACTION_MASK) == XAPIAN_DB_READONLY),
 	  version_file(db_dir),
 	  postlist_table(db_dir, readonly),
 	  position_table(db_dir, readonly),
@@ -120,7 +120,11 @@ ChertDatabase::ChertDatabase(const string &chert_dir, int action,
 {
     LOGCALL_CTOR(DB, "ChertDatabase", chert_dir | action | block_size);
 
-    if (action == XAPIAN_DB_READONLY) {
+    int flags = action & ~XAPIAN_DB_ACTION_MASK;
+    action &= XAPIAN_DB_ACTION_MASK;
+
+    if (readonly) {
+	if (flags & Xapian::DB_MMAP) set_use_mmap();
 	open_tables_consistent();
 	return;
     }
@@ -227,11 +231,24 @@ ChertDatabase::open_tables_consistent()
     chert_revision_number_t cur_rev = record_table.get_open_revision_number();
 
     // Check the version file unless we're reopening.
-    if (cur_rev == 0) version_file.read_and_check();
+    if (cur_rev == 0) {
+	version_file.read_and_check();
+	if (readonly) set_block_cache_ids();
+    }
 
     record_table.open();
     chert_revision_number_t revision = record_table.get_open_revision_number();
 
+    if (readonly && revision < cur_rev) {
+	// The revision has gone backwards so the database must have been
+	// replaced.  Reread the version file to get the new UUID so we don't
+	// use blocks cached from the old database, and start again.
+	version_file.read_and_check();
+	set_block_cache_ids();
+	record_table.open();
+	revision = record_table.get_open_revision_number();
+    }
+
     if (cur_rev && cur_rev == revision) {
 	// We're reopening a database and the revision hasn't changed so we
 	// don't need to do anything.
@@ -294,6 +311,7 @@ ChertDatabase::open_tables(chert_revision_number_t revision)
 {
     LOGCALL_VOID(DB, "ChertDatabase::open_tables", revision);
     version_file.read_and_check();
+    if (readonly) set_block_cache_ids();
     record_table.open(revision);
 
     // Set the block_size for optional tables as they may not currently exist.
@@ -312,6 +330,52 @@ ChertDatabase::open_tables(chert_revision_number_t revision)
     postlist_table.open(revision);
 }
 
+void
+ChertDatabase::set_block_cache_ids()
+{
+    LOGCALL_VOID(DB, "ChertDatabase::set_block_cache_ids", NO_ARGS);
+    string db_id(version_file.get_uuid(), 16);
+    // A copy of a database has the same UUID, so include where it is too.
+    struct stat statbuf;
+    if (stat(db_dir.c_str(), &statbuf) == 0) {
+	db_id += str(static_cast<unsigned long long>(statbuf.st_dev));
+	db_id += ':';
+	db_id += str(static_cast<unsigned long long>(statbuf.st_ino));
+    }
+    postlist_table.set_block_cache_id(db_id);
+    position_table.set_block_cache_id(db_id);
+    termlist_table.set_block_cache_id(db_id);
+    synonym_table.set_block_cache_id(db_id);
+    spelling_table.set_block_cache_id(db_id);
+    record_table.set_block_cache_id(db_id);
+}
+
+void
+ChertDatabase::set_use_mmap()
+{
+    LOGCALL_VOID(DB, "ChertDatabase::set_use_mmap", NO_ARGS);
+    postlist_table.set_use_mmap();
+    position_table.set_use_mmap();
+    termlist_table.set_use_mmap();
+    synonym_table.set_use_mmap();
+    spelling_table.set_use_mmap();
+    record_table.set_use_mmap();
+}
+
+Xapian::Database::Internal *
+ChertDatabase::open_concurrent_reader() const
+{
+    LOGCALL(DB, Xapian::Database::Internal *, "ChertDatabase::open_concurrent_reader", NO_ARGS);
+    // A writable database may have changes which aren't yet committed.
+    if (!readonly) RETURN(NULL);
+    int action = XAPIAN_DB_READONLY;
+    if (postlist_table.get_use_mmap()) action |= Xapian::DB_MMAP;
+    AutoPtr<ChertDatabase> db(new ChertDatabase(db_dir, action));
+    // The new handle must see the same revision as this one.
+    if (db->get_revision_number() != get_revision_number()) RETURN(NULL);
+    RETURN(db.release());
+}
+
 chert_revision_number_t
 ChertDatabase::get_revision_number() const
 {
@@ -1016,6 +1080,13 @@ ChertDatabase::get_uuid() const
     RETURN(version_file.get_uuid_string());
 }
 
+string
+ChertDatabase::get_revision_key() const
+{
+    LOGCALL(DB, string, "ChertDatabase::get_revision_key", NO_ARGS);
+    RETURN(make_revision_key(db_dir));
+}
+
 ///////////////////////////////////////////////////////////////////////////
 
 ChertWritableDatabase::ChertWritableDatabase(const string &dir, int action,
@@ -1682,3 +1753,11 @@ ChertWritableDatabase::invalidate_doc_object(Xapian::Document::Internal * obj) c
 	modify_shortcut_docid = 0;
     }
 }
+
+string
+ChertWritableDatabase::get_revision_key() const
+{
+    // Uncommitted changes don't change the revision, so results can't be
+    // cached.
+    return string();
+}
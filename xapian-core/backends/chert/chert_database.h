@@ -144,6 +144,17 @@ class ChertDatabase : public Xapian::Database::Internal {
 	 */
 	void get_database_write_lock(bool creating);
 
+	/** Tell the tables which database they belong to, so they can use
+	 *  the process-wide block cache.
+	 */
+	void set_block_cache_ids();
+
+	/** Tell the tables to access their files via mmap() when opened.
+	 *
+	 *  Used when the database is opened read-only with Xapian::DB_MMAP.
+	 */
+	void set_use_mmap();
+
 	/** Open tables at specified revision number.
 	 *
 	 *  @exception Xapian::InvalidArgumentError is thrown if the specified
@@ -182,6 +193,12 @@ class ChertDatabase : public Xapian::Database::Internal {
 	 */
 	bool reopen();
 
+	/** Open this revision of the database again.
+	 *
+	 *  Only supported for a read-only database.
+	 */
+	Xapian::Database::Internal * open_concurrent_reader() const;
+
 	/** Close all the tables permanently.
 	 */
 	void close();
@@ -233,6 +250,10 @@ class ChertDatabase : public Xapian::Database::Internal {
 	 *
 	 *  @param dbdir directory holding chert tables
 	 *
+	 *  @param action  XAPIAN_DB_READONLY (optionally ored with
+	 *		   Xapian::DB_MMAP) to open for reading, otherwise the
+	 *		   action to take when opening for writing.
+	 *
 	 *  @param block_size Block size, in bytes, to use when creating
 	 *                    tables.  This is only important, and has the
 	 *                    correct value, when the database is being
@@ -289,6 +310,7 @@ class ChertDatabase : public Xapian::Database::Internal {
 				    Xapian::ReplicationInfo * info);
 	string get_revision_info() const;
 	string get_uuid() const;
+	string get_revision_key() const;
 	//@}
 
 };
@@ -443,6 +465,7 @@ class ChertWritableDatabase : public ChertDatabase {
 
 	void set_metadata(const string & key, const string & value);
 	void invalidate_doc_object(Xapian::Document::Internal * obj) const;
+	string get_revision_key() const;
 	//@}
 };
 
@@ -50,6 +50,10 @@
 // #define DANGEROUS
 
 #include <sys/types.h>
+#include "safesysstat.h"
+#ifdef HAVE_MMAP
+# include <sys/mman.h>
+#endif
 
 // Trying to include the correct headers with the correct defines set to
 // get pread() and pwrite() prototyped on every platform without breaking any
@@ -70,6 +74,8 @@ PWRITE_PROTOTYPE
 #include "chert_btreebase.h"
 #include "chert_cursor.h"
 
+#include "../blockcache.h"
+
 #include "io_utils.h"
 #include "omassert.h"
 #include "debuglog.h"
@@ -181,12 +187,50 @@ static inline byte *zeroed_new(size_t size)
 
 #define BYTE_PAIR_RANGE (1 << 2 * CHAR_BIT)
 
-/// read_block(n, p) reads block n of the DB file to address p.
+/// read_block(n, p) reads block n of the table to address p.
 void
 ChertTable::read_block(uint4 n, byte * p) const
 {
     // Log the value of p, not the contents of the block it points to...
     LOGCALL_VOID(DB, "ChertTable::read_block", n | (void*)p);
+    if (cache_id) {
+	if (BlockCache::lookup(cache_id, revision_number, n, p, block_size))
+	    return;
+	read_block_from_file(n, p);
+	// If the block has been overwritten by a later revision, don't cache
+	// it - the caller will report the problem.
+	if (REVISION(p) <= revision_number)
+	    BlockCache::insert(cache_id, revision_number, n, p, block_size);
+	return;
+    }
+    read_block_from_file(n, p);
+}
+
+/** locate_block(n, p) makes p point to block n of the table.
+ *
+ *  If the DB file is mapped, p is set to point to the block in the mapping.
+ *  Otherwise p must point to a buffer, which the block is read into.
+ */
+void
+ChertTable::locate_block(uint4 n, byte *& p) const
+{
+    LOGCALL_VOID(DB, "ChertTable::locate_block", n | (void*)p);
+    if (mapping) {
+	// The revision we're reading can't refer to blocks beyond the end of
+	// the file as it was when we opened it, so if we get here we must have
+	// followed a pointer from a block which has since been overwritten.
+	if (rare(n >= mapping_blocks)) set_overwritten();
+	p = mapping + size_t(n) * block_size;
+	return;
+    }
+    read_block(n, p);
+}
+
+/// read_block_from_file(n, p) reads block n of the DB file to address p.
+void
+ChertTable::read_block_from_file(uint4 n, byte * p) const
+{
+    LOGCALL_VOID(DB, "ChertTable::read_block_from_file", n | (void*)p);
     /* Use the base bit_map_size not the bitmap's size, because
      * the latter is uninitialised in readonly mode.
      */
@@ -346,7 +390,7 @@ ChertTable::block_to_cursor(Cursor * C_, int j, uint4 n) const
     LOGCALL_VOID(DB, "ChertTable::block_to_cursor", (void*)C_ | j | n);
     if (n == C_[j].n) return;
     byte * p = C_[j].p;
-    Assert(p);
+    Assert(p || mapping);
 
     // FIXME: only needs to be done in write mode
     if (C_[j].rewrite) {
@@ -362,7 +406,8 @@ ChertTable::block_to_cursor(Cursor * C_, int j, uint4 n) const
 	if (p != C[j].p)
 	    memcpy(p, C[j].p, block_size);
     } else {
-	read_block(n, p);
+	locate_block(n, p);
+	C_[j].p = p;
     }
 
     C_[j].n = n;
@@ -1571,7 +1616,12 @@ ChertTable::ChertTable(const char * tablename_, const string & path_,
 	  compress_strategy(compress_strategy_),
 	  deflate_zstream(NULL),
 	  inflate_zstream(NULL),
-	  lazy(lazy_)
+	  lazy(lazy_),
+	  cache_id(0),
+	  use_mmap(false),
+	  mapping(NULL),
+	  mapping_size(0),
+	  mapping_blocks(0)
 {
     LOGCALL_CTOR(DB, "ChertTable", tablename_ | path_ | readonly_ | compress_strategy_ | lazy_);
 }
@@ -1683,6 +1733,14 @@ ChertTable::erase()
     (void)io_unlink(name + "DB");
 }
 
+void
+ChertTable::set_block_cache_id(const string & db_id)
+{
+    LOGCALL_VOID(DB, "ChertTable::set_block_cache_id", db_id);
+    if (writable) return;
+    cache_id = BlockCache::get_table_id(db_id, tablename);
+}
+
 void
 ChertTable::set_block_size(unsigned int block_size_)
 {
@@ -1764,10 +1822,15 @@ void ChertTable::close(bool permanent) {
 	// still be used to look up cached content.
 	return;
     }
+    // Cursors on this table point to blocks we're about to release, so make
+    // them rebuild before they're next used.
+    ++cursor_version;
     for (int j = level; j >= 0; j--) {
-	delete [] C[j].p;
+	// If the file is mapped, the pointers point into the mapping.
+	if (!mapping) delete [] C[j].p;
 	C[j].p = 0;
     }
+    unmap_file();
     delete [] split_p;
     split_p = 0;
 
@@ -2023,15 +2086,59 @@ ChertTable::do_open_to_read(bool revision_supplied, chert_revision_number_t revi
 	throw Xapian::DatabaseOpeningError("Failed to open table for reading");
     }
 
+    // There's nothing to map if the root block is faked, and read_root()
+    // needs a buffer to construct the fake root block in.
+    if (use_mmap && !faked_root_block) map_file();
+
     for (int j = 0; j <= level; j++) {
 	C[j].n = BLK_UNUSED;
-	C[j].p = new byte[block_size];
+	if (!mapping) C[j].p = new byte[block_size];
     }
 
     read_root();
     RETURN(true);
 }
 
+void
+ChertTable::map_file()
+{
+    LOGCALL_VOID(DB, "ChertTable::map_file", NO_ARGS);
+    Assert(!mapping);
+#ifdef HAVE_MMAP
+    struct stat statbuf;
+    if (fstat(handle, &statbuf) < 0) return;
+    // All the blocks in the revision we've opened were written before its
+    // base file, so the file is already long enough to contain them.
+    off_t blocks = statbuf.st_size / block_size;
+    if (blocks == 0 || blocks > off_t(BLK_UNUSED)) return;
+    size_t size = size_t(blocks) * block_size;
+    // Check the file isn't too big to map (possible on 32-bit platforms).
+    if (off_t(size / block_size) != blocks) return;
+    void * p = mmap(NULL, size, PROT_READ, MAP_SHARED, handle, 0);
+    if (p == MAP_FAILED) {
+	LOGLINE(DB, "mmap() failed (" << strerror(errno) << ") - reading blocks from the file instead");
+	return;
+    }
+    mapping = static_cast<byte *>(p);
+    mapping_size = size;
+    mapping_blocks = uint4(blocks);
+#endif
+}
+
+void
+ChertTable::unmap_file()
+{
+    LOGCALL_VOID(DB, "ChertTable::unmap_file", NO_ARGS);
+#ifdef HAVE_MMAP
+    if (mapping) {
+	(void)munmap(static_cast<void *>(mapping), mapping_size);
+	mapping = NULL;
+	mapping_size = 0;
+	mapping_blocks = 0;
+    }
+#endif
+}
+
 void
 ChertTable::open()
 {
@@ -2111,7 +2218,7 @@ ChertTable::prev_for_sequential(Cursor * C_, int /*dummy*/) const
 		    read_block(n, p);
 		}
 	    } else {
-		read_block(n, p);
+		locate_block(n, p);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -2121,6 +2228,7 @@ ChertTable::prev_for_sequential(Cursor * C_, int /*dummy*/) const
 	    if (GET_LEVEL(p) == 0) break;
 	}
 	c = DIR_END(p);
+	C_[0].p = p;
 	C_[0].n = n;
     }
     c -= D2;
@@ -2165,7 +2273,7 @@ ChertTable::next_for_sequential(Cursor * C_, int /*dummy*/) const
 		    read_block(n, p);
 		}
 	    } else {
-		read_block(n, p);
+		locate_block(n, p);
 	    }
 	    if (writable) AssertEq(revision_number, latest_revision_number);
 	    if (REVISION(p) > revision_number + writable) {
@@ -2175,6 +2283,7 @@ ChertTable::next_for_sequential(Cursor * C_, int /*dummy*/) const
 	    if (GET_LEVEL(p) == 0) break;
 	}
 	c = DIR_START;
+	C_[0].p = p;
 	C_[0].n = n;
     }
     C_[0].c = c;
@@ -2193,6 +2302,9 @@ ChertTable::prev_default(Cursor * C_, int j) const
     if (c == DIR_START) {
 	if (j == level) RETURN(false);
 	if (!prev_default(C_, j + 1)) RETURN(false);
+	// Moving the parent loads a new block into C_[j], which may be at a
+	// different address if the file is mapped.
+	p = C_[j].p;
 	c = DIR_END(p);
     }
     c -= D2;
@@ -2216,6 +2328,9 @@ ChertTable::next_default(Cursor * C_, int j) const
     if (c >= DIR_END(p)) {
 	if (j == level) RETURN(false);
 	if (!next_default(C_, j + 1)) RETURN(false);
+	// Moving the parent loads a new block into C_[j], which may be at a
+	// different address if the file is mapped.
+	p = C_[j].p;
 	c = DIR_START;
     }
     C_[j].c = c;
@@ -488,6 +488,25 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 	/// Erase this table from disk.
 	void erase();
 
+	/** Use the process-wide block cache for reads from this table.
+	 *
+	 *  Has no effect if the table is writable.
+	 *
+	 *  @param db_id	String uniquely identifying the database this
+	 *			table is part of.
+	 */
+	void set_block_cache_id(const std::string & db_id);
+
+	/** Access the DB file via mmap() when the table is opened.
+	 *
+	 *  Has no effect if the table is writable.  If mmap() isn't available
+	 *  or fails, blocks are read from the file as usual.
+	 */
+	void set_use_mmap() { use_mmap = !writable; }
+
+	/// Will the DB file be accessed via mmap()?
+	bool get_use_mmap() const { return use_mmap; }
+
 	/** Set the block size.
 	 *
 	 *  It's only safe to do this before the table is created.
@@ -623,6 +642,10 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 	bool find(Cursor *) const;
 	int delete_kt();
 	void read_block(uint4 n, byte *p) const;
+	void read_block_from_file(uint4 n, byte *p) const;
+	void locate_block(uint4 n, byte *&p) const;
+	void map_file();
+	void unmap_file();
 	void write_block(uint4 n, const byte *p) const;
 	XAPIAN_NORETURN(void set_overwritten() const);
 	void block_to_cursor(Cursor *C_, int j, uint4 n) const;
@@ -790,6 +813,28 @@ class XAPIAN_VISIBILITY_DEFAULT ChertTable {
 	/// If true, don't create the table until it's needed.
 	bool lazy;
 
+	/** Id of this table in the block cache, or 0 if reads from this table
+	 *  don't use the block cache.
+	 */
+	unsigned cache_id;
+
+	/// Whether to try to access the DB file via mmap() when reading.
+	bool use_mmap;
+
+	/** The DB file mapped into memory, or NULL if it isn't mapped.
+	 *
+	 *  When the file is mapped, the block pointers in the built-in cursor
+	 *  and in cursors created on this table point into the mapping rather
+	 *  than to buffers of their own.
+	 */
+	byte * mapping;
+
+	/// The size of mapping in bytes.
+	size_t mapping_size;
+
+	/// The number of whole blocks in mapping.
+	uint4 mapping_blocks;
+
 	/* Debugging methods */
 //	void report_block_full(int m, int n, const byte * p);
 
@@ -29,10 +29,14 @@
 
 #include "leafpostlist.h"
 #include "omassert.h"
+#include "safesysstat.h"
+#include "serialise.h"
 #include "slowvaluelist.h"
+#include "str.h"
 
 #include <algorithm>
 #include <string>
+#include <vector>
 
 using namespace std;
 using Xapian::Internal::intrusive_ptr;
@@ -123,6 +127,35 @@ Database::Internal::cancel()
     Assert(false);
 }
 
+void
+Database::Internal::commit_async()
+{
+    if (transaction_active())
+	throw Xapian::InvalidOperationError("Can't commit during a transaction");
+    commit();
+}
+
+void
+Database::Internal::wait_for_commit()
+{
+}
+
+void
+Database::Internal::set_commit_window(double)
+{
+}
+
+void
+Database::Internal::set_flush_memory_limit(size_t)
+{
+}
+
+void
+Database::Internal::set_value_index(Xapian::valueno, bool)
+{
+    throw Xapian::UnimplementedError("This backend doesn't support value indexes");
+}
+
 void
 Database::Internal::begin_transaction(bool flushed)
 {
@@ -218,12 +251,64 @@ Database::Internal::replace_document(const string & unique_term,
     return did;
 }
 
+void
+Database::Internal::add_documents(const vector<Xapian::Document> & documents,
+				  vector<Xapian::docid> & dids)
+{
+    dids.reserve(dids.size() + documents.size());
+    vector<Xapian::Document>::const_iterator i;
+    for (i = documents.begin(); i != documents.end(); ++i) {
+	dids.push_back(add_document(*i));
+    }
+}
+
+void
+Database::Internal::replace_documents(const vector<Xapian::docid> & dids,
+				      const vector<Xapian::Document> & documents)
+{
+    Assert(dids.size() == documents.size());
+    for (size_t k = 0; k != dids.size(); ++k) {
+	replace_document(dids[k], documents[k]);
+    }
+}
+
+void
+Database::Internal::replace_documents(const vector<string> & unique_terms,
+				      const vector<Xapian::Document> & documents,
+				      vector<Xapian::docid> & dids)
+{
+    Assert(unique_terms.size() == documents.size());
+    dids.reserve(dids.size() + documents.size());
+    for (size_t k = 0; k != unique_terms.size(); ++k) {
+	dids.push_back(replace_document(unique_terms[k], documents[k]));
+    }
+}
+
+DocidBitmap *
+Database::Internal::open_docid_bitmap(const string &) const
+{
+    // Only implemented for some database backends - others just use the
+    // posting list.
+    return NULL;
+}
+
 ValueList *
 Database::Internal::open_value_list(Xapian::valueno slot) const
 {
     return new SlowValueList(Xapian::Database(const_cast<Database::Internal*>(this)), slot);
 }
 
+bool
+Database::Internal::get_value_range_docids(Xapian::valueno,
+					   const string &, const string &,
+					   Xapian::doccount,
+					   vector<Xapian::docid> &) const
+{
+    // Only implemented for some database backends - others just scan the
+    // value stream.
+    return false;
+}
+
 TermList *
 Database::Internal::open_spelling_termlist(const string &) const
 {
@@ -360,6 +445,30 @@ Database::Internal::get_uuid() const
     return string();
 }
 
+string
+Database::Internal::get_revision_key() const
+{
+    return string();
+}
+
+string
+Database::Internal::make_revision_key(const string & dir) const
+{
+    string uuid = get_uuid();
+    if (uuid.empty()) return string();
+    struct stat statbuf;
+    if (stat(dir.c_str(), &statbuf) != 0) return string();
+    string key = encode_length(uuid.size());
+    key += uuid;
+    string location = str(static_cast<unsigned long long>(statbuf.st_dev));
+    location += ':';
+    location += str(static_cast<unsigned long long>(statbuf.st_ino));
+    key += encode_length(location.size());
+    key += location;
+    key += get_revision_info();
+    return key;
+}
+
 void
 Database::Internal::invalidate_doc_object(Xapian::Document::Internal *) const
 {
@@ -372,4 +481,10 @@ Database::Internal::as_remotedatabase()
     return NULL;
 }
 
+Database::Internal *
+Database::Internal::open_concurrent_reader() const
+{
+    return NULL;
+}
+
 }
@@ -28,6 +28,7 @@
 #include "xapian/error.h"
 #include "xapian/version.h" // For XAPIAN_HAS_XXX_BACKEND.
 
+#include "database.h"
 #include "debuglog.h"
 #include "fileutils.h"
 #include "str.h"
@@ -89,7 +90,7 @@ InMemory::open() {
 #endif
 
 static void
-open_stub(Database &db, const string &file)
+open_stub(Database &db, const string &file, int flags = 0)
 {
     // A stub database is a text file with one or more lines of this format:
     // <dbtype> <serialised db object>
@@ -113,14 +114,14 @@ open_stub(Database &db, const string &file)
 
 	if (type == "auto") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Database(line));
+	    db.add_database(Database(line, flags));
 	    continue;
 	}
 
 #ifdef XAPIAN_HAS_CHERT_BACKEND
 	if (type == "chert") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Chert::open(line));
+	    db.add_database(Database(new ChertDatabase(line, XAPIAN_DB_READONLY | (flags & DB_MMAP))));
 	    continue;
 	}
 #endif
@@ -128,7 +129,7 @@ open_stub(Database &db, const string &file)
 #ifdef XAPIAN_HAS_BRASS_BACKEND
 	if (type == "brass") {
 	    resolve_relative_path(line, file);
-	    db.add_database(Brass::open(line));
+	    db.add_database(Database(new BrassDatabase(line, XAPIAN_DB_READONLY | (flags & DB_MMAP))));
 	    continue;
 	}
 #endif
@@ -309,9 +310,16 @@ Auto::open_stub(const string &file, int action)
     RETURN(db);
 }
 
-Database::Database(const string &path)
+/** Open the database at @a path (which may be a stub) and add it to @a db.
+ *
+ *  @a flags are as for Database::Database(const string &, int).
+ */
+static void
+open_database(Database &db, const string &path, int flags)
 {
-    LOGCALL_CTOR(API, "Database", path);
+    // Backends treat their action argument as XAPIAN_DB_READONLY with flags
+    // ored in, so only pass on flags we know about.
+    int action = XAPIAN_DB_READONLY | (flags & DB_MMAP);
 
     struct stat statbuf;
     if (stat(path, &statbuf) == -1) {
@@ -320,7 +328,7 @@ Database::Database(const string &path)
 
     if (S_ISREG(statbuf.st_mode)) {
 	// The path is a file, so assume it is a stub database file.
-	open_stub(*this, path);
+	open_stub(db, path, flags);
 	return;
     }
 
@@ -330,14 +338,14 @@ Database::Database(const string &path)
 
 #ifdef XAPIAN_HAS_CHERT_BACKEND
     if (file_exists(path + "/iamchert")) {
-	internal.push_back(new ChertDatabase(path));
+	db.internal.push_back(new ChertDatabase(path, action));
 	return;
     }
 #endif
 
 #ifdef XAPIAN_HAS_BRASS_BACKEND
     if (file_exists(path + "/iambrass")) {
-	internal.push_back(new BrassDatabase(path));
+	db.internal.push_back(new BrassDatabase(path, action));
 	return;
     }
 #endif
@@ -353,7 +361,19 @@ Database::Database(const string &path)
 	throw DatabaseOpeningError("Couldn't detect type of database");
     }
 
-    open_stub(*this, stub_file);
+    open_stub(db, stub_file, flags);
+}
+
+Database::Database(const string &path)
+{
+    LOGCALL_CTOR(API, "Database", path);
+    open_database(*this, path, 0);
+}
+
+Database::Database(const string &path, int flags)
+{
+    LOGCALL_CTOR(API, "Database", path | flags);
+    open_database(*this, path, flags);
 }
 
 #if defined XAPIAN_HAS_CHERT_BACKEND || \
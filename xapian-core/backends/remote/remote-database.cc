@@ -41,6 +41,7 @@
 #include "stringutils.h" // For STRINGIZE().
 #include "weightinternal.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -85,6 +86,11 @@ RemoteDatabase::RemoteDatabase(int fd, double timeout_,
 
     update_stats(MSG_MAX);
 
+#ifdef HAVE_ZLIB_H
+    // Ask the server to compress large replies.  There's no reply to this.
+    send_message(MSG_COMPRESSION, string());
+#endif
+
     if (writable) update_stats(MSG_WRITEACCESS);
 }
 
@@ -303,6 +309,119 @@ RemoteDatabase::open_document(Xapian::docid did, bool /*lazy*/) const
     return new RemoteDocument(this, did, doc_data, values);
 }
 
+/** The most documents to have requested without reading their replies.
+ *
+ *  The server stops reading requests while it's waiting to send replies
+ *  we haven't read yet, so this needs to be small enough that the requests
+ *  fit in the socket buffers.
+ */
+const size_t MAX_PENDING_DOCS = 64;
+
+/// The most documents to ask for in one MSG_DOCUMENTS message.
+const size_t DOCUMENT_BATCH_SIZE = MAX_PENDING_DOCS / 2;
+
+void
+RemoteDatabase::request_document(Xapian::docid did) const
+{
+    Assert(did);
+
+    unsent_docs.push_back(did);
+    if (unsent_docs.size() >= DOCUMENT_BATCH_SIZE) send_document_requests();
+}
+
+void
+RemoteDatabase::send_document_requests() const
+{
+    if (unsent_docs.empty()) return;
+
+    while (pending_docs.size() + unsent_docs.size() > MAX_PENDING_DOCS)
+	read_pending_document();
+
+    string message;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = unsent_docs.begin(); i != unsent_docs.end(); ++i) {
+	message += encode_length(*i);
+    }
+
+    // Call link.send_message() directly, since our send_message() would wait
+    // for the replies to the documents already requested.
+    double end_time = RealTime::end_time(timeout);
+    link.send_message(MSG_DOCUMENTS, message, end_time);
+    pending_docs.insert(pending_docs.end(),
+			unsent_docs.begin(), unsent_docs.end());
+    unsent_docs.clear();
+}
+
+Xapian::Document::Internal *
+RemoteDatabase::collect_document(Xapian::docid did) const
+{
+    map<Xapian::docid, FetchedDocument>::iterator i = fetched_docs.find(did);
+    if (i == fetched_docs.end() &&
+	find(unsent_docs.begin(), unsent_docs.end(), did) != unsent_docs.end()) {
+	send_document_requests();
+    }
+    while (i == fetched_docs.end()) {
+	if (find(pending_docs.begin(), pending_docs.end(), did) ==
+		pending_docs.end()) {
+	    // It wasn't requested (or was thrown away), so fetch it now.
+	    return open_document(did, false);
+	}
+	read_pending_document();
+	i = fetched_docs.find(did);
+    }
+
+    if (i->second.failed) {
+	string error;
+	swap(error, i->second.data);
+	fetched_docs.erase(i);
+	unserialise_error(error, "REMOTE:", context);
+    }
+    Xapian::Document::Internal * doc =
+	new RemoteDocument(this, did, i->second.data, i->second.values);
+    fetched_docs.erase(i);
+    return doc;
+}
+
+void
+RemoteDatabase::read_pending_document() const
+{
+    Assert(!pending_docs.empty());
+    Xapian::docid did = pending_docs.front();
+    pending_docs.pop_front();
+    FetchedDocument & doc = fetched_docs[did];
+    doc.failed = false;
+    doc.values.clear();
+
+    // We read the messages directly from link, as get_message() would throw
+    // any exception the server sent, which we need to keep until the
+    // document is collected.
+    double end_time = RealTime::end_time(timeout);
+    int type = link.get_message(doc.data, end_time);
+    if (type == REPLY_DOCDATA) {
+	string message;
+	while ((type = link.get_message(message, end_time)) == REPLY_VALUE) {
+	    const char * p = message.data();
+	    const char * p_end = p + message.size();
+	    Xapian::valueno slot = decode_length(&p, p_end, false);
+	    doc.values.insert(make_pair(slot, string(p, p_end)));
+	}
+	if (type == REPLY_EXCEPTION) swap(doc.data, message);
+    }
+    if (type == REPLY_EXCEPTION) {
+	doc.failed = true;
+	doc.values.clear();
+    } else if (type != REPLY_DONE) {
+	fetched_docs.erase(did);
+	throw_bad_message(context);
+    }
+}
+
+void
+RemoteDatabase::read_pending_documents() const
+{
+    while (!pending_docs.empty()) read_pending_document();
+}
+
 bool
 RemoteDatabase::update_stats(message_type msg_code) const
 {
@@ -521,6 +640,28 @@ RemoteDatabase::get_message(string &result, reply_type required_type) const
 void
 RemoteDatabase::send_message(message_type type, const string &message) const
 {
+    // Read any replies still to come for documents requested by
+    // request_document(), so the next reply is the one to this message.
+    read_pending_documents();
+    switch (type) {
+	case MSG_QUERY:
+	    // Documents fetched for an earlier MSet but not collected probably
+	    // aren't wanted, so don't keep them around indefinitely -
+	    // collect_document() just asks the server again if they are.
+	case MSG_REOPEN:
+	case MSG_CANCEL:
+	case MSG_ADDDOCUMENT:
+	case MSG_DELETEDOCUMENT:
+	case MSG_DELETEDOCUMENTTERM:
+	case MSG_REPLACEDOCUMENT:
+	case MSG_REPLACEDOCUMENTTERM:
+	    // Documents we've already read may now be out of date.
+	    fetched_docs.clear();
+	    break;
+	default:
+	    break;
+    }
+
     double end_time = RealTime::end_time(timeout);
     link.send_message(static_cast<unsigned char>(type), message, end_time);
 }
@@ -536,6 +677,19 @@ RemoteDatabase::do_close()
     // Only call dtor_called() if we're writable.
     if (writable) dtor_called();
 
+    // If we're going to wait below, first read the replies to any documents
+    // which were requested but not collected, so we're waiting for the
+    // connection to close rather than for those.
+    if (writable) {
+	try {
+	    read_pending_documents();
+	} catch (...) {
+	}
+    }
+    unsent_docs.clear();
+    pending_docs.clear();
+    fetched_docs.clear();
+
     // If we're writable, wait for a confirmation of the close, so we know that
     // changes have been written and flushed, and the database write lock
     // released.  For the non-writable case, there's no need to wait, so don't
@@ -613,6 +767,22 @@ RemoteDatabase::get_remote_stats(bool nowait, Xapian::Weight::Internal &out)
     return true;
 }
 
+bool
+RemoteDatabase::wait_for_replies(const vector<const RemoteDatabase *> & dbs)
+{
+    vector<const RemoteConnection *> links;
+    links.reserve(dbs.size());
+    double timeout = 0.0;
+    vector<const RemoteDatabase *>::const_iterator i;
+    for (i = dbs.begin(); i != dbs.end(); ++i) {
+	links.push_back(&(*i)->link);
+	double db_timeout = (*i)->timeout;
+	if (db_timeout != 0.0 && (timeout == 0.0 || db_timeout < timeout))
+	    timeout = db_timeout;
+    }
+    return RemoteConnection::wait_for_input(links, RealTime::end_time(timeout));
+}
+
 void
 RemoteDatabase::send_global_stats(Xapian::doccount first,
 				  Xapian::doccount maxitems,
@@ -735,6 +905,82 @@ RemoteDatabase::replace_document(const std::string & unique_term,
     return decode_length(&p, p_end, false);
 }
 
+/// Append a document to a batch message, prefixed by its length.
+static void
+append_batch_document(string & message, const Xapian::Document & doc)
+{
+    string serialised = serialise_document(doc);
+    message += encode_length(serialised.size());
+    message += serialised;
+}
+
+/// Decode the document ids in the reply to a batch message.
+static void
+decode_docids(const string & message, vector<Xapian::docid> & dids)
+{
+    const char * p = message.data();
+    const char * p_end = p + message.size();
+    while (p != p_end) {
+	dids.push_back(decode_length(&p, p_end, false));
+    }
+}
+
+void
+RemoteDatabase::add_documents(const vector<Xapian::Document> & documents,
+			      vector<Xapian::docid> & dids)
+{
+    cached_stats_valid = false;
+    mru_slot = Xapian::BAD_VALUENO;
+
+    string message;
+    vector<Xapian::Document>::const_iterator i;
+    for (i = documents.begin(); i != documents.end(); ++i) {
+	append_batch_document(message, *i);
+    }
+
+    send_message(MSG_ADDDOCUMENTS, message);
+
+    get_message(message, REPLY_ADDDOCUMENT);
+    decode_docids(message, dids);
+}
+
+void
+RemoteDatabase::replace_documents(const vector<Xapian::docid> & dids,
+				  const vector<Xapian::Document> & documents)
+{
+    cached_stats_valid = false;
+    mru_slot = Xapian::BAD_VALUENO;
+
+    string message;
+    for (size_t k = 0; k != dids.size(); ++k) {
+	message += encode_length(dids[k]);
+	append_batch_document(message, documents[k]);
+    }
+
+    send_message(MSG_REPLACEDOCUMENTS, message);
+}
+
+void
+RemoteDatabase::replace_documents(const vector<string> & unique_terms,
+				  const vector<Xapian::Document> & documents,
+				  vector<Xapian::docid> & dids)
+{
+    cached_stats_valid = false;
+    mru_slot = Xapian::BAD_VALUENO;
+
+    string message;
+    for (size_t k = 0; k != unique_terms.size(); ++k) {
+	message += encode_length(unique_terms[k].size());
+	message += unique_terms[k];
+	append_batch_document(message, documents[k]);
+    }
+
+    send_message(MSG_REPLACEDOCUMENTTERMS, message);
+
+    get_message(message, REPLY_ADDDOCUMENT);
+    decode_docids(message, dids);
+}
+
 string
 RemoteDatabase::get_uuid() const
 {
@@ -28,8 +28,10 @@
 
 #include "internaltypes.h"
 
+#include "brass_bitmap.h"
 #include "brass_check.h"
 #include "brass_cursor.h"
+#include "brass_packedchunk.h"
 #include "brass_table.h"
 #include "brass_types.h"
 #include "pack.h"
@@ -48,10 +50,29 @@ is_user_metadata_key(const string & key)
     return key.size() > 1 && key[0] == '\0' && key[1] == '\xc0';
 }
 
+/// Read the flags byte at the start of a postlist chunk header.
+static bool
+unpack_chunk_flags(const char ** p, const char * end,
+		   bool * is_last_chunk, bool * is_packed)
+{
+    if (*p == end) return false;
+    unsigned flags = unsigned(*(*p)++ - '0');
+    if (flags > 3) return false;
+    *is_last_chunk = (flags & 1);
+    *is_packed = (flags & 2);
+    return true;
+}
+
 struct VStats : public ValueStats {
     Xapian::doccount freq_real;
 
-    VStats() : ValueStats(), freq_real(0) {}
+    /// The number of entries in the value index for the slot.
+    Xapian::doccount index_freq;
+
+    /// True if the slot is in the list of slots with a value index.
+    bool indexed;
+
+    VStats() : ValueStats(), freq_real(0), index_freq(0), indexed(false) {}
 };
 
 size_t
@@ -77,6 +98,9 @@ check_brass_table(const char * tablename, string filename, int opts,
     if (strcmp(tablename, "postlist") == 0) {
 	// Now check the structure of each postlist in the table.
 	map<Xapian::valueno, VStats> valuestats;
+	// The number of docids in the bitmap for each term with one which we
+	// haven't reached the postings for yet.
+	map<string, Xapian::doccount> bitmap_freqs;
 	string current_term;
 	Xapian::docid lastdid = 0;
 	Xapian::termcount termfreq = 0, collfreq = 0;
@@ -95,6 +119,8 @@ check_brass_table(const char * tablename, string filename, int opts,
 		Xapian::termcount doclen_lbound;
 		Xapian::termcount doclen_ubound;
 		Xapian::termcount wdf_ubound;
+		brass_revision_number_t oldest_changeset;
+		bool packed_postlists;
 
 		const char * data = cursor->current_tag.data();
 		const char * end = data + cursor->current_tag.size();
@@ -110,6 +136,12 @@ check_brass_table(const char * tablename, string filename, int opts,
 		} else if (!unpack_uint(&data, end, &doclen_ubound)) {
 		    cout << "Tag containing meta information is corrupt (couldn't read doclen_ubound)." << endl;
 		    ++errors;
+		} else if (!unpack_uint(&data, end, &oldest_changeset)) {
+		    cout << "Tag containing meta information is corrupt (couldn't read oldest_changeset)." << endl;
+		    ++errors;
+		} else if (!unpack_bool(&data, end, &packed_postlists)) {
+		    cout << "Tag containing meta information is corrupt (couldn't read packed_postlists)." << endl;
+		    ++errors;
 		} else if (!unpack_uint_last(&data, end, &total_doclen)) {
 		    cout << "Tag containing meta information is corrupt (couldn't read total_doclen)." << endl;
 		    ++errors;
@@ -180,9 +212,9 @@ check_brass_table(const char * tablename, string filename, int opts,
 		    }
 		}
 
-		bool is_last_chunk;
-		if (!unpack_bool(&pos, end, &is_last_chunk)) {
-		    cout << "Failed to unpack last chunk flag for doclen" << endl;
+		bool is_last_chunk, is_packed;
+		if (!unpack_chunk_flags(&pos, end, &is_last_chunk, &is_packed)) {
+		    cout << "Failed to unpack chunk flags for doclen" << endl;
 		    ++errors;
 		    continue;
 		}
@@ -193,6 +225,23 @@ check_brass_table(const char * tablename, string filename, int opts,
 		    continue;
 		}
 		lastdid += did;
+		Xapian::termcount max_doclen, actual_max_doclen = 0;
+		if (!unpack_uint(&pos, end, &max_doclen)) {
+		    cout << "Failed to unpack max doclen" << endl;
+		    ++errors;
+		    continue;
+		}
+		// Check the entries of a packed chunk in the unpacked form.
+		string unpacked;
+		if (is_packed) {
+		    if (!Brass::unpack_chunk_body(pos, end, unpacked)) {
+			cout << "Failed to unpack packed doclen chunk" << endl;
+			++errors;
+			continue;
+		    }
+		    pos = unpacked.data();
+		    end = pos + unpacked.size();
+		}
 		bool bad = false;
 		while (true) {
 		    Xapian::termcount doclen;
@@ -202,6 +251,7 @@ check_brass_table(const char * tablename, string filename, int opts,
 			bad = true;
 			break;
 		    }
+		    if (doclen > actual_max_doclen) actual_max_doclen = doclen;
 
 		    if (did > db_last_docid) {
 			cout << "document id " << did << " in doclen stream "
@@ -246,6 +296,11 @@ check_brass_table(const char * tablename, string filename, int opts,
 		if (bad) {
 		    continue;
 		}
+		if (max_doclen != actual_max_doclen) {
+		    cout << "max doclen " << max_doclen << " != highest doclen "
+			 << "in chunk " << actual_max_doclen << endl;
+		    ++errors;
+		}
 		if (is_last_chunk) {
 		    if (did != lastdid) {
 			cout << "lastdid " << lastdid << " != last did " << did
@@ -384,6 +439,155 @@ check_brass_table(const char * tablename, string filename, int opts,
 		continue;
 	    }
 
+	    if (key.size() == 2 && key[0] == '\0' && key[1] == '\xda') {
+		// List of slots with a value index.
+		cursor->read_tag();
+		const char * p = cursor->current_tag.data();
+		const char * end = p + cursor->current_tag.size();
+		while (p != end) {
+		    Xapian::valueno slot;
+		    if (!unpack_uint(&p, end, &slot)) {
+			cout << "Bad list of value index slots" << endl;
+			++errors;
+			break;
+		    }
+		    valuestats[slot].indexed = true;
+		}
+		continue;
+	    }
+
+	    if (key.size() >= 2 && key[0] == '\0' && key[1] == '\xdc') {
+		// Value index entry.
+		const char * p = key.data();
+		const char * end = p + key.length();
+		p += 2;
+		Xapian::valueno slot;
+		if (!unpack_uint(&p, end, &slot)) {
+		    cout << "Bad value index key (no slot)" << endl;
+		    ++errors;
+		    continue;
+		}
+		string value;
+		if (!unpack_string_preserving_sort(&p, end, value)) {
+		    cout << "Bad value index key (no value)" << endl;
+		    ++errors;
+		    continue;
+		}
+		Xapian::docid did;
+		if (!unpack_uint_preserving_sort(&p, end, &did)) {
+		    cout << "Bad value index key (no docid)" << endl;
+		    ++errors;
+		    continue;
+		}
+		if (p != end) {
+		    cout << "Bad value index key (trailing junk)" << endl;
+		    ++errors;
+		    continue;
+		}
+
+		VStats & v = valuestats[slot];
+		if (!v.indexed) {
+		    cout << "Value index entry for slot " << slot
+			 << " which isn't indexed" << endl;
+		    ++errors;
+		}
+		++v.index_freq;
+		if (value < v.lower_bound || value > v.upper_bound) {
+		    cout << "Value index entry for slot " << slot
+			 << " has value outside bounds: '" << value << "'"
+			 << endl;
+		    ++errors;
+		}
+		if (did > db_last_docid) {
+		    cout << "document id " << did << " in value index "
+			 << "is larger than get_last_docid() "
+			 << db_last_docid << endl;
+		    ++errors;
+		}
+		continue;
+	    }
+
+	    if (key.size() >= 2 && key[0] == '\0' && key[1] == '\xde') {
+		// Docid bitmap for a term.
+		const char * p = key.data();
+		const char * end = p + key.length();
+		p += 2;
+		string term;
+		if (!unpack_string_preserving_sort(&p, end, term)) {
+		    cout << "Bad bitmap key (no term)" << endl;
+		    ++errors;
+		    continue;
+		}
+		if (p == end) {
+		    // The entry marking that the term has a bitmap.
+		    bitmap_freqs[term] = 0;
+		    continue;
+		}
+		Xapian::docid block;
+		if (!unpack_uint_preserving_sort(&p, end, &block) || p != end) {
+		    cout << "Bad bitmap key (bad block)" << endl;
+		    ++errors;
+		    continue;
+		}
+		map<string, Xapian::doccount>::iterator b;
+		b = bitmap_freqs.find(term);
+		if (b == bitmap_freqs.end()) {
+		    cout << "Bitmap block for term `" << term << "' which "
+			    "has no bitmap" << endl;
+		    ++errors;
+		    continue;
+		}
+		if (block > (db_last_docid >> DocidBitmap::BLOCK_SHIFT)) {
+		    cout << "Bitmap block " << block << " for term `" << term
+			 << "' is after get_last_docid() " << db_last_docid
+			 << endl;
+		    ++errors;
+		}
+
+		cursor->read_tag();
+		p = cursor->current_tag.data();
+		end = p + cursor->current_tag.size();
+		size_t len = end - p;
+		Xapian::doccount count = 0;
+		if (len == Brass::BITMAP_TAG_SIZE) {
+		    while (p != end) {
+			unsigned char ch = *p++;
+			while (ch) {
+			    ch &= ch - 1;
+			    ++count;
+			}
+		    }
+		} else if (len == 0 || len % 2 != 0 ||
+			   len > Brass::BITMAP_TAG_SIZE) {
+		    cout << "Bad bitmap block size " << len << " for term `"
+			 << term << "'" << endl;
+		    ++errors;
+		    continue;
+		} else {
+		    unsigned prev = 0;
+		    while (p != end) {
+			unsigned v = (unsigned(static_cast<unsigned char>(p[0])) << 8) |
+				     static_cast<unsigned char>(p[1]);
+			if (count && v <= prev) {
+			    cout << "Docids in bitmap block for term `" << term
+				 << "' not in ascending order" << endl;
+			    ++errors;
+			    break;
+			}
+			prev = v;
+			++count;
+			p += 2;
+		    }
+		}
+		if (count == 0) {
+		    cout << "Empty bitmap block for term `" << term << "'"
+			 << endl;
+		    ++errors;
+		}
+		b->second += count;
+		continue;
+	    }
+
 	    const char * pos, * end;
 
 	    // Get term from key.
@@ -472,9 +676,9 @@ check_brass_table(const char * tablename, string filename, int opts,
 		end = pos + cursor->current_tag.size();
 	    }
 
-	    bool is_last_chunk;
-	    if (!unpack_bool(&pos, end, &is_last_chunk)) {
-		cout << "Failed to unpack last chunk flag" << endl;
+	    bool is_last_chunk, is_packed;
+	    if (!unpack_chunk_flags(&pos, end, &is_last_chunk, &is_packed)) {
+		cout << "Failed to unpack chunk flags" << endl;
 		++errors;
 		continue;
 	    }
@@ -485,6 +689,23 @@ check_brass_table(const char * tablename, string filename, int opts,
 		continue;
 	    }
 	    lastdid += did;
+	    Xapian::termcount max_wdf, actual_max_wdf = 0;
+	    if (!unpack_uint(&pos, end, &max_wdf)) {
+		cout << "Failed to unpack max wdf" << endl;
+		++errors;
+		continue;
+	    }
+	    // Check the entries of a packed chunk in the unpacked form.
+	    string unpacked;
+	    if (is_packed) {
+		if (!Brass::unpack_chunk_body(pos, end, unpacked)) {
+		    cout << "Failed to unpack packed chunk" << endl;
+		    ++errors;
+		    continue;
+		}
+		pos = unpacked.data();
+		end = pos + unpacked.size();
+	    }
 	    bool bad = false;
 	    while (true) {
 		Xapian::termcount wdf;
@@ -494,6 +715,7 @@ check_brass_table(const char * tablename, string filename, int opts,
 		    bad = true;
 		    break;
 		}
+		if (wdf > actual_max_wdf) actual_max_wdf = wdf;
 		++tf;
 		cf += wdf;
 
@@ -517,6 +739,11 @@ check_brass_table(const char * tablename, string filename, int opts,
 	    if (bad) {
 		continue;
 	    }
+	    if (max_wdf != actual_max_wdf) {
+		cout << "max wdf " << max_wdf << " != highest wdf in chunk "
+		     << actual_max_wdf << endl;
+		++errors;
+	    }
 	    if (is_last_chunk) {
 		if (tf != termfreq) {
 		    cout << "termfreq " << termfreq << " != # of entries "
@@ -533,6 +760,17 @@ check_brass_table(const char * tablename, string filename, int opts,
 			 << endl;
 		    ++errors;
 		}
+		map<string, Xapian::doccount>::iterator b;
+		b = bitmap_freqs.find(current_term);
+		if (b != bitmap_freqs.end()) {
+		    if (b->second != termfreq) {
+			cout << "Bitmap for term `" << current_term << "' has "
+			     << b->second << " docids but termfreq is "
+			     << termfreq << endl;
+			++errors;
+		    }
+		    bitmap_freqs.erase(b);
+		}
 		current_term.resize(0);
 	    }
 	}
@@ -541,6 +779,12 @@ check_brass_table(const char * tablename, string filename, int opts,
 		 << endl;
 	    ++errors;
 	}
+	map<string, Xapian::doccount>::const_iterator b;
+	for (b = bitmap_freqs.begin(); b != bitmap_freqs.end(); ++b) {
+	    cout << "Bitmap for term `" << b->first << "' which has no "
+		    "postings" << endl;
+	    ++errors;
+	}
 
 	map<Xapian::valueno, VStats>::const_iterator i;
 	for (i = valuestats.begin(); i != valuestats.end(); ++i) {
@@ -550,6 +794,12 @@ check_brass_table(const char * tablename, string filename, int opts,
 		     << i->second.freq_real << endl;
 		++errors;
 	    }
+	    if (i->second.indexed && i->second.index_freq != i->second.freq) {
+		cout << "Value index for slot " << i->first << " has "
+		     << i->second.index_freq << " entries but the value "
+		     "frequency is " << i->second.freq << endl;
+		++errors;
+	    }
 	}
     } else if (strcmp(tablename, "record") == 0) {
 	// Now check the contents of the record table.  Any data is valid as
@@ -37,6 +37,7 @@ using namespace std;
 #define OPT_HELP 1
 #define OPT_VERSION 2
 #define OPT_NO_RENUMBER 3
+#define OPT_IO_LIMIT 4
 
 static void show_usage() {
     cout << "Usage: "PROG_NAME" [OPTIONS] SOURCE_DATABASE... DESTINATION_DATABASE\n\n"
@@ -48,7 +49,12 @@ static void show_usage() {
 "                    update the compacted database)\n"
 "  -m, --multipass   If merging more than 3 databases, merge the postlists in\n"
 "                    multiple passes (which is generally faster but requires\n"
-"                    more disk space for temporary files)\n"
+"                    more disk space for temporary files), or for brass in\n"
+"                    one pass reading each database in large chunks\n"
+"  -j, --threads=N   Use N threads to compact tables in parallel (default 1)\n"
+"      --io-limit=RATE\n"
+"                    Limit the total rate of reads and writes to RATE bytes\n"
+"                    per second, or K or M per second (e.g. 20M)\n"
 "      --no-renumber Preserve the numbering of document ids (useful if you have\n"
 "                    external references to them, or have set them to match\n"
 "                    unique ids from an external source).  Currently this\n"
@@ -61,11 +67,15 @@ static void show_usage() {
 class MyCompactor : public Xapian::Compactor {
     bool quiet;
 
+    bool threaded;
+
   public:
-    MyCompactor() : quiet(false) { }
+    MyCompactor() : quiet(false), threaded(false) { }
 
     void set_quiet(bool quiet_) { quiet = quiet_; }
 
+    void set_threaded(bool threaded_) { threaded = threaded_; }
+
     void set_status(const string & table, const string & status);
 
     string
@@ -79,6 +89,15 @@ MyCompactor::set_status(const string & table, const string & status)
 {
     if (quiet)
 	return;
+    if (threaded) {
+	// Updates for different tables may be interleaved, so put each on
+	// its own line.
+	if (!status.empty())
+	    cout << table << ": " << status << endl;
+	else
+	    cout << table << " ..." << endl;
+	return;
+    }
     if (!status.empty())
 	cout << '\r' << table << ": " << status << endl;
     else
@@ -103,11 +122,13 @@ MyCompactor::resolve_duplicate_metadata(const string & key,
 int
 main(int argc, char **argv)
 {
-    const char * opts = "b:nFmq";
+    const char * opts = "b:nFmj:q";
     const struct option long_opts[] = {
 	{"fuller",	no_argument, 0, 'F'},
 	{"no-full",	no_argument, 0, 'n'},
 	{"multipass",	no_argument, 0, 'm'},
+	{"threads",	required_argument, 0, 'j'},
+	{"io-limit",	required_argument, 0, OPT_IO_LIMIT},
 	{"blocksize",	required_argument, 0, 'b'},
 	{"no-renumber", no_argument, 0, OPT_NO_RENUMBER},
 	{"quiet",	no_argument, 0, 'q'},
@@ -147,6 +168,36 @@ main(int argc, char **argv)
 	    case 'm':
 		compactor.set_multipass(true);
 		break;
+	    case 'j': {
+		char *p;
+		unsigned long threads = strtoul(optarg, &p, 10);
+		if (*p || threads == 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be at least 1" << endl;
+		    exit(1);
+		}
+		compactor.set_threads(threads);
+		compactor.set_threaded(threads > 1);
+		break;
+	    }
+	    case OPT_IO_LIMIT: {
+		char *p;
+		size_t rate = strtoul(optarg, &p, 10);
+		if (*p == 'K' || *p == 'k') {
+		    ++p;
+		    rate *= 1024;
+		} else if (*p == 'M' || *p == 'm') {
+		    ++p;
+		    rate *= 1024 * 1024;
+		}
+		if (*p || rate == 0) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for io-limit" << endl;
+		    exit(1);
+		}
+		compactor.set_io_rate_limit(rate);
+		break;
+	    }
 	    case OPT_NO_RENUMBER:
 		compactor.set_renumber(false);
 		break;
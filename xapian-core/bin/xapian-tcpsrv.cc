@@ -22,6 +22,7 @@
 
 #include <config.h>
 
+#include <climits>
 #include <cstdlib>
 
 #include "safeerrno.h"
@@ -53,6 +54,8 @@ const int MSECS_ACTIVE_TIMEOUT_DEFAULT = 15000;
 
 #define OPT_HELP 1
 #define OPT_VERSION 2
+#define OPT_THREADS 3
+#define OPT_MAX_CONNECTIONS 4
 
 static const char * opts = "I:p:a:i:t:oqw";
 static const struct option long_opts[] = {
@@ -64,6 +67,8 @@ static const struct option long_opts[] = {
     {"one-shot",	no_argument,		0, 'o'},
     {"quiet",		no_argument,		0, 'q'},
     {"writable",	no_argument,		0, 'w'},
+    {"threads",		required_argument,	0, OPT_THREADS},
+    {"max-connections",	required_argument,	0, OPT_MAX_CONNECTIONS},
     {"help",		no_argument,		0, OPT_HELP},
     {"version",		no_argument,		0, OPT_VERSION},
     {NULL, 0, 0, 0}
@@ -81,6 +86,11 @@ static void show_usage() {
 "  --one-shot              serve a single connection and exit\n"
 "  --quiet                 disable information messages to stdout\n"
 "  --writable              allow updates (only one database directory allowed)\n"
+"  --threads N             serve connections from one process using a pool of\n"
+"                          N threads, rather than forking for each connection\n"
+"                          (not allowed with --writable)\n"
+"  --max-connections N     with --threads, serve at most N connections at once\n"
+"                          (default no limit)\n"
 "  --help                  display this help and exit\n"
 "  --version               output version information and exit" << endl;
 }
@@ -94,6 +104,8 @@ int main(int argc, char **argv) {
     bool one_shot = false;
     bool verbose = true;
     bool writable = false;
+    unsigned threads = 0;
+    unsigned max_connections = 0;
     bool syntax_error = false;
 
     int c;
@@ -130,6 +142,29 @@ int main(int argc, char **argv) {
 	    case 'w':
 		writable = true;
 		break;
+	    case OPT_THREADS: {
+		char *p;
+		unsigned long n = strtoul(optarg, &p, 10);
+		if (*p || n == 0 || n > UINT_MAX) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for threads, must be at least 1" << endl;
+		    exit(1);
+		}
+		threads = n;
+		break;
+	    }
+	    case OPT_MAX_CONNECTIONS: {
+		char *p;
+		unsigned long n = strtoul(optarg, &p, 10);
+		if (*p || n == 0 || n > UINT_MAX) {
+		    cerr << PROG_NAME": Bad value '" << optarg
+			 << "' passed for max-connections, must be at least 1"
+			 << endl;
+		    exit(1);
+		}
+		max_connections = n;
+		break;
+	    }
 	    default:
 		syntax_error = true;
 	}
@@ -151,6 +186,11 @@ int main(int argc, char **argv) {
 	exit(1);
     }
 
+    if (writable && threads) {
+	cerr << "Error: '--threads' can't be used with '--writable'." << endl;
+	exit(1);
+    }
+
     try {
 	vector<string> dbnames;
 	// Try to open the database(s) so we report problems now instead of
@@ -183,7 +223,9 @@ int main(int argc, char **argv) {
 
 	register_user_weighting_schemes(server);
 
-	if (one_shot) {
+	if (threads) {
+	    server.run_threaded(threads, max_connections, one_shot);
+	} else if (one_shot) {
 	    server.run_once();
 	} else {
 	    server.run();
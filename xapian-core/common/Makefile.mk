@@ -7,22 +7,26 @@ noinst_HEADERS +=\
 	common/database.h\
 	common/databasereplicator.h\
 	common/debuglog.h\
+	common/docidbitmap.h\
 	common/document.h\
 	common/documentterm.h\
 	common/emptypostlist.h\
 	common/esetinternal.h\
 	common/expandweight.h\
 	common/fileutils.h\
+	common/filtercache.h\
 	common/gnu_getopt.h\
 	common/inmemory_positionlist.h\
 	common/internaltypes.h\
 	common/io_utils.h\
+	common/iothrottle.h\
 	common/leafpostlist.h\
 	common/msvc_dirent.h\
 	common/msvc_posix_wrapper.h\
 	common/multialltermslist.h\
 	common/multimatch.h\
 	common/multivaluelist.h\
+	common/mutex.h\
 	common/noreturn.h\
 	common/omassert.h\
 	common/omenquireinternal.h\
@@ -66,6 +70,7 @@ noinst_HEADERS +=\
 	common/tcpclient.h\
 	common/tcpserver.h\
 	common/termlist.h\
+	common/threadpool.h\
 	common/unaligned.h\
 	common/utils.h\
 	common/valuelist.h\
@@ -83,7 +88,9 @@ lib_src +=\
 	common/closefrom.cc\
 	common/debuglog.cc\
 	common/fileutils.cc\
+	common/filtercache.cc\
 	common/io_utils.cc\
+	common/iothrottle.cc\
 	common/msvc_dirent.cc\
 	common/msvc_posix_wrapper.cc\
 	common/replicate_utils.cc\
@@ -92,6 +99,7 @@ lib_src +=\
 	common/socket_utils.cc\
 	common/str.cc\
 	common/stringutils.cc\
+	common/threadpool.cc\
 	common/utils.cc
 
 if USE_WIN32_UUID_API
@@ -25,7 +25,9 @@
 #define OM_HGUARD_DATABASE_H
 
 #include <string>
+#include <vector>
 
+#include "filtercache.h"
 #include "internaltypes.h"
 
 #include "xapian/intrusive_ptr.h"
@@ -38,6 +40,7 @@
 
 using namespace std;
 
+class DocidBitmap;
 class LeafPostList;
 class RemoteDatabase;
 
@@ -48,6 +51,13 @@ typedef Xapian::ValueIterator::Internal ValueList;
 // Used by brass and chert.
 const int XAPIAN_DB_READONLY = 0;
 
+/** Mask for the part of the action argument to the brass and chert database
+ *  constructors which gives the action (e.g. Xapian::DB_CREATE).
+ *
+ *  The remaining bits are flags such as Xapian::DB_MMAP.
+ */
+const int XAPIAN_DB_ACTION_MASK = 0xff;
+
 namespace Xapian {
 
 struct ReplicationInfo;
@@ -88,6 +98,17 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	void dtor_called();
 
+	/** Build a revision key for a database stored in directory @a dir.
+	 *
+	 *  Copies of a database share its UUID, and can be modified separately
+	 *  to give different contents at the same revision, so the key also
+	 *  includes the device and inode of @a dir to tell copies apart.
+	 *
+	 *  An empty string is returned if get_uuid() returns an empty string or
+	 *  @a dir can't be stat()ed.
+	 */
+	string make_revision_key(const string & dir) const;
+
     public:
 	/** Destroy the database.
 	 *
@@ -102,6 +123,13 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
         virtual ~Internal();
 
+	/** Cache of the documents matching filter subqueries.
+	 *
+	 *  The matcher uses this to look up and store filters, and the API
+	 *  layer clears it when the database changes.
+	 */
+	mutable FilterCache filter_cache;
+
 	/** Send a keep-alive signal to a remote database, to stop
 	 *  it from timing out.
 	 */
@@ -229,6 +257,21 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual LeafPostList * open_post_list(const string & tname) const = 0;
 
+	/** Open a bitmap of the documents which contain a given term.
+	 *
+	 *  Some backends store a bitmap as well as the posting list for terms
+	 *  which index a large proportion of the documents.  Boolean subqueries
+	 *  made up of such terms can then be combined a word at a time.
+	 *
+	 *  @param tname  The term.
+	 *
+	 *  @return	  A pointer to a new DocidBitmap, which must be deleted
+	 *		  by the caller, or NULL if there's no bitmap stored for
+	 *		  @a tname.  The default implementation always returns
+	 *		  NULL.
+	 */
+	virtual DocidBitmap * open_docid_bitmap(const string & tname) const;
+
 	/** Open a value stream.
 	 *
 	 *  This returns the value in a particular slot for each document.
@@ -240,6 +283,27 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual ValueList * open_value_list(Xapian::valueno slot) const;
 
+	/** Find the documents with a value in a range using a value index.
+	 *
+	 *  @param slot	The value slot.
+	 *  @param begin	The start of the range.
+	 *  @param end	The end of the range (inclusive), or empty for no
+	 *			upper limit.
+	 *  @param limit	Give up if more than this many documents match.
+	 *  @param dids	Vector to put the matching docids in, in ascending
+	 *			order.
+	 *
+	 *  @return true if @a dids was filled in, or false if there's no index
+	 *	    for @a slot or the limit was exceeded, in which case the
+	 *	    caller should scan the value stream instead.  The default
+	 *	    implementation always returns false.
+	 */
+	virtual bool get_value_range_docids(Xapian::valueno slot,
+					    const std::string & begin,
+					    const std::string & end,
+					    Xapian::doccount limit,
+					    std::vector<Xapian::docid> & dids) const;
+
 	/** Open a term list.
 	 *
 	 *  This is a list of all the terms contained by a given document.
@@ -409,9 +473,45 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual void commit();
 
+	/** Start committing pending modifications to the database.
+	 *
+	 *  See WritableDatabase::commit_async() for more information.  The
+	 *  default implementation calls commit().
+	 */
+	virtual void commit_async();
+
+	/** Wait for commits started by commit_async() to complete.
+	 *
+	 *  See WritableDatabase::wait_for_commit() for more information.
+	 *  The default implementation does nothing, which is correct for
+	 *  backends which don't override commit_async().
+	 */
+	virtual void wait_for_commit();
+
+	/** Set the window within which calls to commit_async() are grouped.
+	 *
+	 *  See WritableDatabase::set_commit_window() for more information.
+	 *  The default implementation ignores this.
+	 */
+	virtual void set_commit_window(double seconds);
+
 	/** Cancel pending modifications to the database. */
 	virtual void cancel();
 
+	/** Set the memory limit for buffering modifications.
+	 *
+	 *  See WritableDatabase::set_flush_memory_limit() for more
+	 *  information.  Backends which don't buffer modifications can
+	 *  ignore this, which the default implementation does.
+	 */
+	virtual void set_flush_memory_limit(size_t bytes);
+
+	/** Add or remove the index of the values in a slot.
+	 *
+	 *  See WritableDatabase::set_value_index() for more information.
+	 */
+	virtual void set_value_index(Xapian::valueno slot, bool enabled);
+
 	/** Begin a transaction.
 	 *
 	 *  See WritableDatabase::begin_transaction() for more information.
@@ -462,6 +562,34 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	virtual Xapian::docid replace_document(const string & unique_term,
 					       const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  See WritableDatabase::add_documents() for more information.  The
+	 *  document ids are appended to @a dids.  The default implementation
+	 *  calls add_document() for each document.
+	 */
+	virtual void add_documents(const vector<Xapian::Document> & documents,
+				   vector<Xapian::docid> & dids);
+
+	/** Replace several documents in the database.
+	 *
+	 *  See WritableDatabase::replace_documents() for more information.
+	 *  The default implementation calls replace_document() for each
+	 *  document.
+	 */
+	virtual void replace_documents(const vector<Xapian::docid> & dids,
+				       const vector<Xapian::Document> & documents);
+
+	/** Replace any documents matching each of several terms.
+	 *
+	 *  See WritableDatabase::replace_documents() for more information.
+	 *  The document ids are appended to @a dids.  The default
+	 *  implementation calls replace_document() for each term.
+	 */
+	virtual void replace_documents(const vector<string> & unique_terms,
+				       const vector<Xapian::Document> & documents,
+				       vector<Xapian::docid> & dids);
+
 	/** Request and later collect a document from the database.
 	 *  Multiple documents can be requested with request_document(),
 	 *  and then collected with collect_document().  Allows the backend
@@ -502,6 +630,20 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 */
 	virtual string get_uuid() const;
 
+	/** Get a string identifying the revision of the database which is open.
+	 *
+	 *  This is used to key caches of search results, so it must differ
+	 *  between any two databases which could give different results for a
+	 *  search, and change whenever anything which could affect the results
+	 *  of a search does.
+	 *
+	 *  An empty string is returned if the backend can't identify the
+	 *  revision, or if the contents can change without the revision
+	 *  changing (as for a database open for writing).  The default
+	 *  implementation always returns an empty string.
+	 */
+	virtual string get_revision_key() const;
+
 	/** Notify the database that document is no longer valid.
 	 *
 	 *  This is used to invalidate references to a document kept by a
@@ -522,6 +664,17 @@ class Database::Internal : public Xapian::Internal::intrusive_base {
 	 *  database.
 	 */
 	virtual RemoteDatabase * as_remotedatabase();
+
+	/** Open another handle on the same revision of this database.
+	 *
+	 *  The new handle can be used by another thread while this one is in
+	 *  use, which allows the matcher to split a database into ranges of
+	 *  document ids and match them in parallel.
+	 *
+	 *  @return The new handle, or NULL if this isn't supported (the
+	 *	    default) or the revision is no longer available.
+	 */
+	virtual Internal * open_concurrent_reader() const;
 };
 
 }
@@ -0,0 +1,98 @@
+/** @file docidbitmap.h
+ * @brief Abstract base class for sets of docids read as bitmaps.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDBITMAP_H
+#define XAPIAN_INCLUDED_DOCIDBITMAP_H
+
+#include "internaltypes.h"
+
+#include "xapian/types.h"
+
+#include <string>
+
+/** Abstract base class for sets of docids read as bitmaps.
+ *
+ *  The docids are split into blocks of BLOCK_SIZE, and block @a b holds
+ *  docids from b * BLOCK_SIZE to (b + 1) * BLOCK_SIZE - 1.  A block is read
+ *  as BLOCK_WORDS 64-bit words, so sets can be combined a word at a time.
+ *
+ *  This is used for the boolean parts of a query where every term has a
+ *  bitmap stored for it (see Database::Internal::open_docid_bitmap()).
+ */
+class DocidBitmap {
+    /// Don't allow assignment.
+    void operator=(const DocidBitmap &);
+
+    /// Don't allow copying.
+    DocidBitmap(const DocidBitmap &);
+
+  protected:
+    /// Only constructable as a base class for derived classes.
+    DocidBitmap() { }
+
+  public:
+    /// log2 of the number of docids in each block.
+    static const unsigned BLOCK_SHIFT = 16;
+
+    /// The number of docids in each block.
+    static const unsigned BLOCK_SIZE = 1u << BLOCK_SHIFT;
+
+    /// The number of 64-bit words in the bitmap for a block.
+    static const unsigned BLOCK_WORDS = BLOCK_SIZE / 64;
+
+    /// Returned by find_block() when there are no more blocks.
+    static const Xapian::docid NO_BLOCK = Xapian::docid(-1);
+
+    virtual ~DocidBitmap() { }
+
+    /** Find the first block at or after @a block which may contain docids.
+     *
+     *  Calls must be made with @a block in ascending order.
+     *
+     *  @return	The block number, or NO_BLOCK if there are no docids in
+     *		or after @a block.
+     */
+    virtual Xapian::docid find_block(Xapian::docid block) = 0;
+
+    /** Read the bitmap for a block.
+     *
+     *  @param block	The block to read.  This must be no less than the
+     *			block last passed to find_block(), and no greater
+     *			than the block it returned.
+     *  @param words	Array of BLOCK_WORDS words to set.  Bit @a j of
+     *			word @a i is set if docid
+     *			block * BLOCK_SIZE + i * 64 + j is in the set.
+     */
+    virtual void read_block(Xapian::docid block, uint8 * words) = 0;
+
+    /// Return a lower bound on the number of docids in the set.
+    virtual Xapian::doccount get_termfreq_min() const = 0;
+
+    /// Return an estimate of the number of docids in the set.
+    virtual Xapian::doccount get_termfreq_est() const = 0;
+
+    /// Return an upper bound on the number of docids in the set.
+    virtual Xapian::doccount get_termfreq_max() const = 0;
+
+    /// Return a string description of this object.
+    virtual std::string get_description() const = 0;
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDBITMAP_H
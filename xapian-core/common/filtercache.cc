@@ -0,0 +1,78 @@
+/** @file filtercache.cc
+ * @brief Cache of the documents matching filter subqueries.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "filtercache.h"
+
+#include "debuglog.h"
+
+using namespace std;
+
+void
+FilterCache::set_max_size(size_t bytes)
+{
+    LOGCALL_VOID(MATCH, "FilterCache::set_max_size", bytes);
+    max_size = bytes;
+    // Discard the least recently used entries until we're within the limit.
+    while (size > max_size) {
+	map<string, Entry>::iterator i = entries.find(lru.back());
+	size -= entry_size(i->first, i->second.list.get());
+	entries.erase(i);
+	lru.pop_back();
+    }
+}
+
+const DocidList *
+FilterCache::find(const string & key)
+{
+    LOGCALL(MATCH, const DocidList *, "FilterCache::find", key);
+    map<string, Entry>::iterator i = entries.find(key);
+    if (i == entries.end()) RETURN(NULL);
+    ++hits;
+    // Move the key to the front of the list.
+    lru.splice(lru.begin(), lru, i->second.lru_pos);
+    RETURN(i->second.list.get());
+}
+
+void
+FilterCache::add(const string & key, const DocidList * list)
+{
+    LOGCALL_VOID(MATCH, "FilterCache::add", key | list);
+    Xapian::Internal::intrusive_ptr<const DocidList> ref(list);
+    size_t bytes = entry_size(key, list);
+    if (bytes > max_size || entries.find(key) != entries.end()) return;
+
+    lru.push_front(key);
+    Entry & entry = entries[key];
+    entry.list = ref;
+    entry.lru_pos = lru.begin();
+    size += bytes;
+    set_max_size(max_size);
+}
+
+void
+FilterCache::clear()
+{
+    LOGCALL_VOID(MATCH, "FilterCache::clear", NO_ARGS);
+    entries.clear();
+    lru.clear();
+    size = 0;
+}
@@ -0,0 +1,127 @@
+/** @file filtercache.h
+ * @brief Cache of the documents matching filter subqueries.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_FILTERCACHE_H
+#define XAPIAN_INCLUDED_FILTERCACHE_H
+
+#include "xapian/intrusive_ptr.h"
+#include "xapian/types.h"
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+/// A sorted list of document ids, which can be shared.
+class DocidList : public Xapian::Internal::intrusive_base {
+  public:
+    /// The document ids, in ascending order.
+    std::vector<Xapian::docid> dids;
+};
+
+/** Cache of the documents matching filter subqueries.
+ *
+ *  Each database has one of these, keyed by the serialised subquery.  The
+ *  entries are only valid for the revision the database has open, so the
+ *  cache must be cleared when that changes, or the database is modified.
+ *
+ *  When the total size of the entries exceeds the limit, the least recently
+ *  used entries are discarded.
+ */
+class FilterCache {
+    /// Don't allow assignment.
+    void operator=(const FilterCache &);
+
+    /// Don't allow copying.
+    FilterCache(const FilterCache &);
+
+    /// Keys in order of use, most recently used first.
+    typedef std::list<std::string> lru_list;
+
+    struct Entry {
+	/// The documents matching the subquery.
+	Xapian::Internal::intrusive_ptr<const DocidList> list;
+
+	/// The position of this entry's key in lru.
+	lru_list::iterator lru_pos;
+    };
+
+    /// The cached entries.
+    std::map<std::string, Entry> entries;
+
+    /// Keys in order of use.
+    lru_list lru;
+
+    /// The maximum total size of the entries in bytes (0 for no caching).
+    size_t max_size;
+
+    /// The total size of the entries in bytes.
+    size_t size;
+
+    /// The number of times find() has found an entry.
+    unsigned long hits;
+
+    /// Return the number of bytes we count for an entry.
+    static size_t entry_size(const std::string & key, const DocidList * list) {
+	return key.size() + list->dids.size() * sizeof(Xapian::docid);
+    }
+
+  public:
+    FilterCache() : max_size(0), size(0), hits(0) { }
+
+    /// Set the maximum total size of the entries in bytes.
+    void set_max_size(size_t bytes);
+
+    /// Return true if the cache is enabled.
+    bool enabled() const { return max_size != 0; }
+
+    /** Return true if an entry with up to @a n documents could be cached.
+     *
+     *  This allows the caller to avoid building lists which add() would
+     *  just discard.
+     */
+    bool fits(const std::string & key, Xapian::doccount n) const {
+	return key.size() + size_t(n) * sizeof(Xapian::docid) <= max_size;
+    }
+
+    /// Return the number of times find() has found an entry.
+    unsigned long get_hits() const { return hits; }
+
+    /** Look up the documents matching a subquery.
+     *
+     *  @return	The documents, or NULL if they aren't cached.
+     */
+    const DocidList * find(const std::string & key);
+
+    /** Cache the documents matching a subquery.
+     *
+     *  If the list is too big to cache, it is just released.
+     *
+     *  @param key	The serialised subquery.
+     *  @param list	The documents, which the cache takes a reference to.
+     */
+    void add(const std::string & key, const DocidList * list);
+
+    /// Discard all the entries.
+    void clear();
+};
+
+#endif // XAPIAN_INCLUDED_FILTERCACHE_H
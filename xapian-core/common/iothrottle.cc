@@ -0,0 +1,52 @@
+/** @file iothrottle.cc
+ * @brief Limit the rate at which I/O is performed.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "iothrottle.h"
+
+#include "realtime.h"
+
+/** The most I/O (in seconds' worth at the limit) which can be saved up.
+ *
+ *  If no I/O is performed for a while, this much can then be done in a burst
+ *  before we start to sleep.
+ */
+const double MAX_BURST = 1.0;
+
+void
+IOThrottle::account(size_t n)
+{
+    double until;
+    {
+	MutexLock lock(mutex);
+	double now = RealTime::now();
+	if (bytes == 0) {
+	    start = now;
+	} else if (start + bytes / rate < now - MAX_BURST) {
+	    // We've been idle, so only allow a limited burst.
+	    start = now - MAX_BURST;
+	    bytes = 0;
+	}
+	bytes += n;
+	until = start + bytes / rate;
+    }
+    RealTime::sleep(until);
+}
@@ -0,0 +1,61 @@
+/** @file iothrottle.h
+ * @brief Limit the rate at which I/O is performed.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_IOTHROTTLE_H
+#define XAPIAN_INCLUDED_IOTHROTTLE_H
+
+#include <cstddef>
+
+#include "mutex.h"
+
+/** Limit the rate at which I/O is performed.
+ *
+ *  Each read or write is reported to account(), which sleeps as needed to
+ *  keep the average rate within the limit.  One IOThrottle may be shared by
+ *  several threads, in which case the limit applies to their total I/O.
+ */
+class IOThrottle {
+    /// Protects the members below.
+    Mutex mutex;
+
+    /// The maximum rate in bytes per second.
+    double rate;
+
+    /// The time from which the I/O in @a bytes has been counted.
+    double start;
+
+    /// The number of bytes of I/O since @a start.
+    double bytes;
+
+    /// Don't allow copying.
+    IOThrottle(const IOThrottle &);
+
+    /// Don't allow assignment.
+    void operator=(const IOThrottle &);
+
+  public:
+    /// Limit I/O to @a rate_ bytes per second.
+    explicit IOThrottle(double rate_) : rate(rate_), start(0), bytes(0) { }
+
+    /// Account for @a n bytes of I/O, sleeping if we're ahead of the limit.
+    void account(size_t n);
+};
+
+#endif // XAPIAN_INCLUDED_IOTHROTTLE_H
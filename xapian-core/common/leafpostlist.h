@@ -80,6 +80,14 @@ class LeafPostList : public PostList {
     Xapian::doccount get_termfreq_est() const;
 
     Xapian::weight get_maxweight() const;
+
+    /** Return an upper bound on get_weight() for entries with wdf at most
+     *  @a wdf_max.
+     *
+     *  Backends which record the maximum wdf for a block of entries can use
+     *  this to skip blocks which can't contribute enough weight.
+     */
+    Xapian::weight get_maxweight_for_wdf(Xapian::termcount wdf_max) const;
     Xapian::weight get_weight() const;
     Xapian::weight recalc_maxweight();
 
@@ -23,16 +23,51 @@
 #ifndef OM_HGUARD_MULTIMATCH_H
 #define OM_HGUARD_MULTIMATCH_H
 
+#include "mutex.h"
 #include "omqueryinternal.h"
 #include "submatch.h"
+#include "threadpool.h"
 
 #include <vector>
 
 #include "xapian/weight.h"
 
+/** The minimum weight for the matches being run on worker threads.
+ *
+ *  Once one of them has enough documents for the MSet, documents with a
+ *  lower weight can't make the final MSet, so the others can skip them.
+ */
+class SharedMinWeight {
+    Mutex mutex;
+
+    Xapian::weight min_weight;
+
+  public:
+    SharedMinWeight() : min_weight(0) { }
+
+    /// Return the current minimum weight.
+    Xapian::weight get() {
+	MutexLock lock(mutex);
+	return min_weight;
+    }
+
+    /// Raise the minimum weight to at least @a w, and return the result.
+    Xapian::weight raise(Xapian::weight w) {
+	MutexLock lock(mutex);
+	if (w > min_weight) min_weight = w;
+	return min_weight;
+    }
+};
+
 class MultiMatch
 {
     private:
+	/** Minimum weight shared by the matches on worker threads.
+	 *
+	 *  This is declared before leaves so that it outlives them.
+	 */
+	SharedMinWeight worker_min_weight;
+
 	/// Vector of the items.
 	std::vector<Xapian::Internal::intrusive_ptr<SubMatch> > leaves;
 
@@ -70,15 +105,40 @@ class MultiMatch
 	/** Is each sub-database remote? */
 	vector<bool> is_remote;
 
+	/** Is each sub-database matched separately?
+	 *
+	 *  This is true for remote sub-databases, and local sub-databases
+	 *  matched on a worker thread.  The SubMatch for such a sub-database
+	 *  returns an MSetPostList, and has already applied any match spies
+	 *  and match deciders.
+	 */
+	vector<bool> is_matched_separately;
+
 	/// The matchspies to use.
 	const vector<Xapian::MatchSpy *> & matchspies;
 
+	/// The first document id to match, or 0 to match all documents.
+	Xapian::docid range_first_did;
+
+	/// The last document id to match (if range_first_did isn't 0).
+	Xapian::docid range_last_did;
+
+	/// Minimum weight to share with other matches, or NULL.
+	SharedMinWeight * shared_min_weight;
+
 	/** get the maxweight that the postlist pl may return, calling
 	 *  recalc_maxweight if recalculate_w_max is set, and unsetting it.
 	 *  Must only be called on the top of the postlist tree.
 	 */
         Xapian::weight getorrecalc_maxweight(PostList *pl);
 
+	/** Does a query use a PostingSource which couldn't be cloned?
+	 *
+	 *  Such a PostingSource is shared by the sub-databases, so they can't
+	 *  be matched on separate threads.
+	 */
+	static bool has_shared_source(const Xapian::Query::Internal * query);
+
 	/// Copying is not permitted.
 	MultiMatch(const MultiMatch &);
 
@@ -98,6 +158,8 @@ class MultiMatch
 	 *  @param matchspies_ Any the MatchSpy objects in use.
 	 *  @param have_sorter Is there a sorter in use?
 	 *  @param have_mdecider Is there a Xapian::MatchDecider in use?
+	 *  @param pool      Thread pool to match local sub-databases on, or NULL
+	 *		     to match them all in this thread.
 	 */
 	MultiMatch(const Xapian::Database &db_,
 		   const Xapian::Query::Internal * query,
@@ -115,7 +177,8 @@ class MultiMatch
 		   Xapian::Weight::Internal & stats,
 		   const Xapian::Weight *wtscheme,
 		   const vector<Xapian::MatchSpy *> & matchspies_,
-		   bool have_sorter, bool have_mdecider);
+		   bool have_sorter, bool have_mdecider,
+		   ThreadPool * pool);
 
 	/** Run the match and generate an MSet object.
 	 *
@@ -135,6 +198,23 @@ class MultiMatch
         void recalc_maxweight() {
 	    recalculate_w_max = true;
 	}
+
+	/** Only match documents in a range of document ids.
+	 *
+	 *  This is only supported when matching a single local database.
+	 */
+	void set_docid_range(Xapian::docid first_did, Xapian::docid last_did) {
+	    range_first_did = first_did;
+	    range_last_did = last_did;
+	}
+
+	/** Share a minimum weight with matches running on other threads.
+	 *
+	 *  Only used when sorting primarily by relevance.
+	 */
+	void set_shared_min_weight(SharedMinWeight * shared) {
+	    shared_min_weight = shared;
+	}
 };
 
 #endif /* OM_HGUARD_MULTIMATCH_H */
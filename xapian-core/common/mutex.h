@@ -0,0 +1,128 @@
+/** @file mutex.h
+ * @brief Portable mutex wrapper for process-wide shared state.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_MUTEX_H
+#define XAPIAN_INCLUDED_MUTEX_H
+
+// Xapian objects aren't shared between threads, so the library doesn't
+// normally need any locking.  The exception is state which is deliberately
+// shared by every object in the process (such as the block cache), which is
+// what this wrapper is for.
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#elif defined __WIN32__
+# include "safewindows.h"
+#endif
+
+/// A non-recursive mutex.
+class Mutex {
+#ifdef HAVE_PTHREAD
+    friend class Condition;
+
+
+    pthread_mutex_t mutex;
+#elif defined __WIN32__
+    CRITICAL_SECTION mutex;
+#endif
+
+    /// Don't allow copying.
+    Mutex(const Mutex &);
+
+    /// Don't allow assignment.
+    void operator=(const Mutex &);
+
+  public:
+    Mutex() {
+#ifdef HAVE_PTHREAD
+	(void)pthread_mutex_init(&mutex, NULL);
+#elif defined __WIN32__
+	InitializeCriticalSection(&mutex);
+#endif
+    }
+
+    ~Mutex() {
+#ifdef HAVE_PTHREAD
+	(void)pthread_mutex_destroy(&mutex);
+#elif defined __WIN32__
+	DeleteCriticalSection(&mutex);
+#endif
+    }
+
+    void lock() {
+#ifdef HAVE_PTHREAD
+	(void)pthread_mutex_lock(&mutex);
+#elif defined __WIN32__
+	EnterCriticalSection(&mutex);
+#endif
+    }
+
+    void unlock() {
+#ifdef HAVE_PTHREAD
+	(void)pthread_mutex_unlock(&mutex);
+#elif defined __WIN32__
+	LeaveCriticalSection(&mutex);
+#endif
+    }
+};
+
+/// Hold a lock on a Mutex for the lifetime of this object.
+class MutexLock {
+    Mutex & mutex;
+
+    /// Don't allow copying.
+    MutexLock(const MutexLock &);
+
+    /// Don't allow assignment.
+    void operator=(const MutexLock &);
+
+  public:
+    explicit MutexLock(Mutex & mutex_) : mutex(mutex_) { mutex.lock(); }
+
+    ~MutexLock() { mutex.unlock(); }
+};
+
+#ifdef HAVE_PTHREAD
+/// A condition variable, used with a Mutex.
+class Condition {
+    pthread_cond_t cond;
+
+    /// Don't allow copying.
+    Condition(const Condition &);
+
+    /// Don't allow assignment.
+    void operator=(const Condition &);
+
+  public:
+    Condition() { (void)pthread_cond_init(&cond, NULL); }
+
+    ~Condition() { (void)pthread_cond_destroy(&cond); }
+
+    /// Wait to be signalled - @a mutex must be locked by the caller.
+    void wait(Mutex & mutex) { (void)pthread_cond_wait(&cond, &mutex.mutex); }
+
+    /// Wake one waiting thread.
+    void signal() { (void)pthread_cond_signal(&cond); }
+
+    /// Wake all waiting threads.
+    void broadcast() { (void)pthread_cond_broadcast(&cond); }
+};
+#endif
+
+#endif // XAPIAN_INCLUDED_MUTEX_H
@@ -31,6 +31,9 @@
 #include "xapian/query.h"
 #include "xapian/keymaker.h"
 
+#include "autoptr.h"
+#include "threadpool.h"
+
 #include <algorithm>
 #include <cmath>
 #include <map>
@@ -161,6 +164,17 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	vector<MatchSpy *> spies;
 
+	/// The number of threads to use to run the match.
+	unsigned search_threads;
+
+	/** The worker threads to run the match on, or NULL.
+	 *
+	 *  This is mutable so that it can be created lazily when first
+	 *  required.
+	 */
+	mutable AutoPtr<ThreadPool> pool;
+
+
 	Internal(const Xapian::Database &databases, ErrorHandler * errorhandler_);
 	~Internal();
 
@@ -174,6 +188,20 @@ class Enquire::Internal : public Xapian::Internal::intrusive_base {
 
 	void set_query(const Query & query_, termcount qlen_);
 	const Query & get_query();
+
+	/** Return the key to cache the results of a search under.
+	 *
+	 *  The key identifies the query, the settings which affect which
+	 *  documents match and how they're ordered, and the revision of each
+	 *  database.  The number of results wanted isn't included - see
+	 *  ResultCache for how that's handled.
+	 *
+	 *  @return	The key, or an empty string if the results can't be
+	 *		cached.
+	 */
+	string get_result_cache_key(const RSet *omrset,
+				    const MatchDecider *mdecider) const;
+
 	MSet get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 		      Xapian::doccount check_at_least,
 		      const RSet *omrset,
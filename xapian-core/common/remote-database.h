@@ -29,6 +29,9 @@
 #include "valuestats.h"
 #include "xapian/weight.h"
 
+#include <deque>
+#include <map>
+
 namespace Xapian {
     class RSet;
 }
@@ -86,6 +89,47 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     mutable Xapian::valueno mru_slot;
 
+    /// Documents requested by request_document() which we haven't sent yet.
+    mutable vector<Xapian::docid> unsent_docs;
+
+    /** Documents requested by request_document() whose replies haven't been
+     *  read yet.
+     *
+     *  The server replies to messages in the order it receives them, so these
+     *  are in the order the replies will arrive.
+     */
+    mutable std::deque<Xapian::docid> pending_docs;
+
+    /// The reply to a MSG_DOCUMENT which has been read but not collected.
+    struct FetchedDocument {
+	/// True if the server sent an exception.
+	bool failed;
+
+	/// The document data, or the serialised exception if failed is true.
+	string data;
+
+	/// The document values.
+	map<Xapian::valueno, string> values;
+
+	FetchedDocument() : failed(false) { }
+    };
+
+    /** Documents which have been read from the server but not collected.
+     *
+     *  These are discarded when a new query is sent, or the database might
+     *  have changed.
+     */
+    mutable map<Xapian::docid, FetchedDocument> fetched_docs;
+
+    /// Send a MSG_DOCUMENTS message for the documents in unsent_docs.
+    void send_document_requests() const;
+
+    /// Read the reply for the first document in pending_docs.
+    void read_pending_document() const;
+
+    /// Read the replies for all the documents in pending_docs.
+    void read_pending_documents() const;
+
     bool update_stats(message_type msg_code = MSG_UPDATE) const;
 
   protected:
@@ -163,6 +207,18 @@ class RemoteDatabase : public Xapian::Database::Internal {
      */
     bool get_remote_stats(bool nowait, Xapian::Weight::Internal &out);
 
+    /// Is there a reply from the remote server waiting to be read?
+    bool reply_ready() const { return link.ready_to_read(); }
+
+    /** Wait until there's a reply waiting from any of several remote
+     *  servers.
+     *
+     *  We give up waiting after the shortest of the databases' timeouts.
+     *
+     *  @return	true if there's a reply waiting; false if we gave up.
+     */
+    static bool wait_for_replies(const vector<const RemoteDatabase *> & dbs);
+
     /// Send the global stats to the remote server.
     void send_global_stats(Xapian::doccount first,
 			   Xapian::doccount maxitems,
@@ -198,6 +254,18 @@ class RemoteDatabase : public Xapian::Database::Internal {
     /// Get a remote document.
     Xapian::Document::Internal * open_document(Xapian::docid did, bool lazy) const;
 
+    /** Request a document without waiting for the reply.
+     *
+     *  This allows MSet::fetch() to have requests for several documents in
+     *  flight at once, rather than waiting for a round trip for each.  The
+     *  requests are sent in batches, when there are enough of them or when
+     *  one of the documents is collected.
+     */
+    void request_document(Xapian::docid did) const;
+
+    /// Collect a document requested by request_document().
+    Xapian::Document::Internal * collect_document(Xapian::docid did) const;
+
     /// Get the document count.
     Xapian::doccount get_doccount() const;
 
@@ -242,6 +310,15 @@ class RemoteDatabase : public Xapian::Database::Internal {
     Xapian::docid replace_document(const std::string & unique_term,
 				   const Xapian::Document & document);
 
+    void add_documents(const vector<Xapian::Document> & documents,
+		       vector<Xapian::docid> & dids);
+
+    void replace_documents(const vector<Xapian::docid> & dids,
+			   const vector<Xapian::Document> & documents);
+    void replace_documents(const vector<string> & unique_terms,
+			   const vector<Xapian::Document> & documents,
+			   vector<Xapian::docid> & dids);
+
     std::string get_uuid() const;
 
     string get_metadata(const string & key) const;
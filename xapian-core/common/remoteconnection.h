@@ -22,6 +22,7 @@
 #define XAPIAN_INCLUDED_REMOTECONNECTION_H
 
 #include <string>
+#include <vector>
 
 #include "remoteprotocol.h"
 #include "safeunistd.h"
@@ -166,6 +167,23 @@ class RemoteConnection {
      */
     bool ready_to_read() const;
 
+    /** Wait until there is data available to read on any of several
+     *  connections.
+     *
+     *  @param links	The connections to wait for.
+     *  @param end_time	If this time is reached, give up waiting.  If
+     *			end_time is 0.0, wait for ever.
+     *
+     *  @return		true if there is data waiting to be read on at least
+     *			one of the connections; false if end_time was
+     *			reached.
+     */
+    static bool wait_for_input(const std::vector<const RemoteConnection *> & links,
+			       double end_time);
+
+    /// Is there input which has been read but not yet processed?
+    bool input_buffered() const { return !buffer.empty(); }
+
     /** Check what the next message type is.
      *
      *  This must not be called after a call to get_message_chunked() until
@@ -186,6 +204,9 @@ class RemoteConnection {
     char sniff_next_message_type(double end_time);
 
     /** Read one message from fdin.
+     *
+     *  If the message data was compressed by send_message(), it is
+     *  uncompressed.
      *
      *  @param[out] result	Message data.
      *  @param end_time		If this time is reached, then a timeout
@@ -258,8 +279,13 @@ class RemoteConnection {
      *				exception will be thrown.  If
      *				(end_time == 0.0) then the operation will
      *				never timeout.
+     *  @param compress		If true, compress the message data if that
+     *				makes it enough smaller to be worthwhile.
+     *				Only do this if the other end has said it
+     *				can read compressed messages.
      */
-    void send_message(char type, const std::string & s, double end_time);
+    void send_message(char type, const std::string & s, double end_time,
+		      bool compress = false);
 
     /** Send the contents of a file as a message.
      *
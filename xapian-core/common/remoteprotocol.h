@@ -46,8 +46,12 @@
 // 35: 1.1.5 Support for add_spelling() and remove_spelling().
 // 35.1: 1.2.4 Support for metadata_keys_begin().
 // 36: 1.3.0 REPLY_UPDATE and REPLY_GREETING merged, and more...
+// 36.1: New MSG_DOCUMENTS to fetch several documents, and MSG_COMPRESSION to
+//	 ask for large replies to be compressed.
+// 36.2: New MSG_ADDDOCUMENTS, MSG_REPLACEDOCUMENTS and
+//	 MSG_REPLACEDOCUMENTTERMS to modify several documents at once.
 #define XAPIAN_REMOTE_PROTOCOL_MAJOR_VERSION 36
-#define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 0
+#define XAPIAN_REMOTE_PROTOCOL_MINOR_VERSION 2
 
 /** Message types (client -> server).
  *
@@ -84,6 +88,11 @@ enum message_type {
     MSG_GETMSET,		// Get MSet
     MSG_SHUTDOWN,		// Shutdown
     MSG_METADATAKEYLIST,	// Iterator for metadata keys
+    MSG_DOCUMENTS,		// Get several documents
+    MSG_COMPRESSION,		// Compress large replies
+    MSG_ADDDOCUMENTS,		// Add several documents
+    MSG_REPLACEDOCUMENTS,	// Replace several documents
+    MSG_REPLACEDOCUMENTTERMS,	// Replace several documents by term
     MSG_MAX
 };
 
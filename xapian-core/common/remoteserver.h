@@ -66,6 +66,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      */
     double idle_timeout;
 
+    /// Has the client asked for large replies to be compressed?
+    bool compress_replies;
+
     /// The registry, which allows unserialisation of user subclasses.
     Xapian::Registry reg;
 
@@ -73,6 +76,14 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     message_type get_message(double timeout, std::string & result,
 			     message_type required_type = MSG_MAX);
 
+    /** Read a message from the client and act on it.
+     *
+     *  @param timeout	Timeout for the message to arrive (in seconds).
+     *
+     *  @return		false if the client closed the connection.
+     */
+    bool run_one_message(double timeout);
+
     /// Send a message to the client.
     void send_message(reply_type type, const std::string &message);
 
@@ -80,7 +91,8 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     void send_message(reply_type type, const std::string &message,
 		      double end_time) {
 	unsigned char type_as_char = static_cast<unsigned char>(type);
-	RemoteConnection::send_message(type_as_char, message, end_time);
+	RemoteConnection::send_message(type_as_char, message, end_time,
+				       compress_replies);
     }
 
     // all terms
@@ -89,6 +101,12 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // get document
     void msg_document(const std::string & message);
 
+    // get several documents
+    void msg_documents(const std::string & message);
+
+    // compress large replies
+    void msg_compression(const std::string & message);
+
     // term exists?
     void msg_termexists(const std::string & message);
 
@@ -149,6 +167,15 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
     // replace document with unique term
     void msg_replacedocumentterm(const std::string & message);
 
+    // add several documents
+    void msg_adddocuments(const std::string & message);
+
+    // replace several documents
+    void msg_replacedocuments(const std::string & message);
+
+    // replace several documents with unique terms
+    void msg_replacedocumentterms(const std::string & message);
+
     // get metadata
     void msg_getmetadata(const std::string & message);
 
@@ -193,6 +220,16 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteServer : private RemoteConnection {
      */
     void run();
 
+    /** Process the messages which the client has already started to send.
+     *
+     *  This should be called when the connection is ready to read.  It
+     *  processes messages until there's no more buffered input, and then
+     *  returns rather than waiting for the client to send more.
+     *
+     *  @return		false if the client closed the connection.
+     */
+    bool run_pending();
+
     /// Get the registry used for (un)serialisation.
     const Xapian::Registry & get_registry() const { return reg; }
 
@@ -58,6 +58,9 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
+    /// A connection served by run_threaded().
+    class Connection;
+
   public:
     /** Construct a RemoteTcpServer for a Database and start listening for
      *  connections.
@@ -83,6 +86,32 @@ class XAPIAN_VISIBILITY_DEFAULT RemoteTcpServer : public TcpServer {
      *  This method may be called by multiple threads.
      */
     void handle_one_connection(int socket);
+
+    /** Accept connections and service requests on a pool of threads.
+     *
+     *  Unlike run(), which forks a process for each connection, this serves
+     *  all connections from a single process.  Idle connections are watched
+     *  with epoll(), and when a client sends a request its connection is
+     *  passed to one of @a n_threads worker threads.
+     *
+     *  Each connection opens its own handles on the databases, just as a
+     *  forked child would, so a client sees the same revision until it
+     *  calls reopen().
+     *
+     *  @param n_threads	The number of worker threads.
+     *  @param max_connections	The maximum number of connections to have
+     *				open at once, or 0 for no limit.  Further
+     *				connections wait in the listen queue until
+     *				one is closed.
+     *  @param one_shot		If true, serve a single connection and then
+     *				return.
+     *
+     *  Only read-only servers are supported, and only on platforms with
+     *  pthreads and epoll() - Xapian::FeatureUnavailableError is thrown
+     *  otherwise.
+     */
+    void run_threaded(unsigned n_threads, unsigned max_connections,
+		      bool one_shot);
 };
 
 #endif // XAPIAN_INCLUDED_REMOTETCPSERVER_H
@@ -78,6 +78,14 @@ class SubMatch : public Xapian::Internal::intrusive_base {
 		 Xapian::MSet::Internal::TermFreqAndWeight> *termfreqandwts,
 	Xapian::termcount * total_subqs_ptr)
 	= 0;
+
+    /** Get the factor to convert weights to percentages.
+     *
+     *  Only meaningful for a SubMatch whose PostList is an MSetPostList (the
+     *  others report the number of subqueries instead), and only valid after
+     *  get_postlist_and_term_info() has been called.
+     */
+    virtual double get_percent_factor() const { return 0; }
 };
 
 #endif /* XAPIAN_INCLUDED_SUBMATCH_H */
@@ -76,6 +76,17 @@ class XAPIAN_VISIBILITY_DEFAULT TcpServer SOCKET_INITIALIZER_MIXIN {
     /** Accept a connection and return the filedescriptor for it. */
     int accept_connection();
 
+    /** Accept a connection and return the filedescriptor for it.
+     *
+     *  Unlike accept_connection(), if accept() fails then -1 is returned
+     *  (with errno set) rather than an exception being thrown, so the caller
+     *  can decide how to handle the error.
+     */
+    int try_accept_connection();
+
+    /** The socket we're listening on. */
+    int get_listen_socket() const { return listen_socket; }
+
   public:
     /** Construct a TcpServer and start listening for connections.
      *
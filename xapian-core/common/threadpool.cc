@@ -0,0 +1,200 @@
+/** @file threadpool.cc
+ * @brief Run tasks on a fixed set of worker threads.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "threadpool.h"
+
+#include "xapian/error.h"
+
+#include "omassert.h"
+
+#include <new>
+
+using namespace std;
+
+/// error_type value if run() didn't throw.
+const int TASK_OK = -1;
+
+/// error_type value if run() threw std::bad_alloc.
+const int TASK_BAD_ALLOC = -2;
+
+/// error_type value if run() threw something we don't know how to copy.
+const int TASK_UNKNOWN_ERROR = -3;
+
+ThreadTask::~ThreadTask() { }
+
+void
+ThreadTask::run_and_catch()
+{
+    error_type = TASK_OK;
+    try {
+	run();
+    } catch (const Xapian::Error & e) {
+	// The byte before the type name is the type code.
+	error_type = static_cast<unsigned char>(e.get_type()[-1]);
+	error_msg = e.get_msg();
+	error_context = e.get_context();
+	const char * err = e.get_error_string();
+	have_error_string = (err != NULL);
+	if (err) errno_string = err;
+    } catch (const bad_alloc &) {
+	error_type = TASK_BAD_ALLOC;
+    } catch (...) {
+	error_type = TASK_UNKNOWN_ERROR;
+    }
+}
+
+void
+ThreadTask::rethrow() const
+{
+    if (error_type == TASK_OK) return;
+    if (error_type == TASK_BAD_ALLOC) throw bad_alloc();
+    if (error_type == TASK_UNKNOWN_ERROR) {
+	throw Xapian::InternalError("Unknown exception thrown in worker thread");
+    }
+
+    // The names used here must match those errordispatch.h expects.
+    const string & msg = error_msg;
+    const string & context = error_context;
+    const char * error_string =
+	have_error_string ? errno_string.c_str() : NULL;
+    switch (char(error_type)) {
+#include "xapian/errordispatch.h"
+    }
+    throw Xapian::InternalError("Unknown exception type thrown in worker thread");
+}
+
+#ifdef HAVE_PTHREAD
+
+ThreadPool::ThreadPool(unsigned n_threads) : stopping(false)
+{
+    threads.reserve(n_threads);
+    while (n_threads--) {
+	pthread_t thread;
+	// If we can't create as many threads as requested, make do with
+	// those we have (if none, tasks are run by start()).
+	if (pthread_create(&thread, NULL, worker_thread, this) != 0) break;
+	threads.push_back(thread);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+	MutexLock lock(mutex);
+	stopping = true;
+	work_cond.broadcast();
+    }
+    vector<pthread_t>::const_iterator i;
+    for (i = threads.begin(); i != threads.end(); ++i) {
+	(void)pthread_join(*i, NULL);
+    }
+}
+
+unsigned
+ThreadPool::size() const
+{
+    return threads.size();
+}
+
+void *
+ThreadPool::worker_thread(void * pool)
+{
+    static_cast<ThreadPool *>(pool)->worker_loop();
+    return NULL;
+}
+
+void
+ThreadPool::worker_loop()
+{
+    MutexLock lock(mutex);
+    while (true) {
+	while (queue.empty() && !stopping)
+	    work_cond.wait(mutex);
+	// Run any queued tasks before exiting.
+	if (queue.empty()) break;
+	ThreadTask * task = queue.front();
+	queue.pop_front();
+
+	// Don't hold the lock while the task runs.  run_and_catch() doesn't
+	// throw, so the lock is always retaken before MutexLock releases it.
+	mutex.unlock();
+	task->run_and_catch();
+	mutex.lock();
+
+	task->done = true;
+	done_cond.broadcast();
+    }
+}
+
+void
+ThreadPool::start(ThreadTask * task)
+{
+    task->done = false;
+    if (threads.empty()) {
+	task->run_and_catch();
+	task->done = true;
+	return;
+    }
+    MutexLock lock(mutex);
+    Assert(!stopping);
+    queue.push_back(task);
+    work_cond.signal();
+}
+
+void
+ThreadPool::wait(ThreadTask * task)
+{
+    {
+	MutexLock lock(mutex);
+	while (!task->done)
+	    done_cond.wait(mutex);
+    }
+    task->rethrow();
+}
+
+#else
+
+ThreadPool::ThreadPool(unsigned) { }
+
+ThreadPool::~ThreadPool() { }
+
+unsigned
+ThreadPool::size() const
+{
+    return 0;
+}
+
+void
+ThreadPool::start(ThreadTask * task)
+{
+    task->run_and_catch();
+    task->done = true;
+}
+
+void
+ThreadPool::wait(ThreadTask * task)
+{
+    Assert(task->done);
+    task->rethrow();
+}
+
+#endif
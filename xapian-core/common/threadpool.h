@@ -0,0 +1,156 @@
+/** @file threadpool.h
+ * @brief Run tasks on a fixed set of worker threads.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_THREADPOOL_H
+#define XAPIAN_INCLUDED_THREADPOOL_H
+
+#include "mutex.h"
+
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#include <deque>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/** A unit of work to run on a ThreadPool.
+ *
+ *  Subclasses implement run().  Any Xapian::Error (or std::bad_alloc) which
+ *  run() throws is caught in the worker thread and rethrown by
+ *  ThreadPool::wait() in the thread which waits for the task.
+ */
+class ThreadTask {
+    friend class ThreadPool;
+
+    /// Don't allow copying.
+    ThreadTask(const ThreadTask &);
+
+    /// Don't allow assignment.
+    void operator=(const ThreadTask &);
+
+    /// True once run() has returned or thrown.
+    bool done;
+
+    /** The type of exception run() threw.
+     *
+     *  Negative if it didn't throw a Xapian::Error, otherwise the type code
+     *  of the Xapian::Error thrown.
+     */
+    int error_type;
+
+    /// The message of the Xapian::Error thrown, if any.
+    std::string error_msg;
+
+    /// The context of the Xapian::Error thrown, if any.
+    std::string error_context;
+
+    /** The error string of the Xapian::Error thrown, if any.
+     *
+     *  This isn't called error_string, since rethrow() needs a local of that
+     *  name for errordispatch.h.
+     */
+    std::string errno_string;
+
+    /// True if the Xapian::Error thrown had an error string.
+    bool have_error_string;
+
+    /// Call run(), recording any exception it throws.
+    void run_and_catch();
+
+    /// Rethrow any exception recorded by run_and_catch().
+    void rethrow() const;
+
+  protected:
+    /// Do the work of this task.
+    virtual void run() = 0;
+
+  public:
+    ThreadTask() : done(false), error_type(-1), have_error_string(false) { }
+
+    virtual ~ThreadTask();
+};
+
+/** A fixed set of worker threads which run ThreadTask objects in turn.
+ *
+ *  If threads aren't supported (or can't be created), tasks are run in the
+ *  calling thread by start() instead.
+ *
+ *  A task must be passed to wait() before it is destroyed or started again.
+ */
+class ThreadPool {
+#ifdef HAVE_PTHREAD
+    /// Protects the members below.
+    Mutex mutex;
+
+    /// Signalled when a task is queued, or the pool is shutting down.
+    Condition work_cond;
+
+    /// Signalled when a task has finished.
+    Condition done_cond;
+
+    /// The worker threads.
+    std::vector<pthread_t> threads;
+
+    /// Tasks waiting to be run.
+    std::deque<ThreadTask *> queue;
+
+    /// True once the destructor has asked the workers to exit.
+    bool stopping;
+
+    /// Entry point for the worker threads.
+    static void * worker_thread(void * pool);
+
+    /// Run queued tasks until the pool is shutting down.
+    void worker_loop();
+#endif
+
+    /// Don't allow copying.
+    ThreadPool(const ThreadPool &);
+
+    /// Don't allow assignment.
+    void operator=(const ThreadPool &);
+
+  public:
+    /// Create a pool with up to @a n_threads worker threads.
+    explicit ThreadPool(unsigned n_threads);
+
+    /// Wait for any queued tasks to run, then stop the worker threads.
+    ~ThreadPool();
+
+    /// The number of worker threads (0 if tasks run in the caller).
+    unsigned size() const;
+
+    /** Queue @a task to be run by a worker thread.
+     *
+     *  The task isn't owned by the pool.
+     */
+    void start(ThreadTask * task);
+
+    /** Wait for @a task to finish.
+     *
+     *  If the task threw an exception, it's rethrown here.
+     */
+    void wait(ThreadTask * task);
+};
+
+#endif // XAPIAN_INCLUDED_THREADPOOL_H
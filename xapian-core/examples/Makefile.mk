@@ -3,6 +3,7 @@ EXTRA_DIST +=\
 	examples/Makefile
 
 bin_PROGRAMS +=\
+	examples/bulkindex\
 	examples/copydatabase\
 	examples/delve\
 	examples/quest\
@@ -11,6 +12,9 @@ bin_PROGRAMS +=\
 	examples/simplesearch\
 	examples/xapian-metadata
 
+examples_bulkindex_SOURCES = examples/bulkindex.cc
+examples_bulkindex_LDADD = $(ldflags) $(libxapian_la)
+
 examples_copydatabase_SOURCES = examples/copydatabase.cc
 examples_copydatabase_LDADD = $(ldflags) $(libxapian_la)
 
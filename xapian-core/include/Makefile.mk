@@ -10,6 +10,8 @@ inc_HEADERS =\
 	include/xapian.h
 
 xapianinclude_HEADERS =\
+	include/xapian/blockcache.h\
+	include/xapian/bulkbuilder.h\
 	include/xapian/compactor.h\
 	include/xapian/database.h\
 	include/xapian/dbfactory.h\
@@ -28,6 +30,7 @@ xapianinclude_HEADERS =\
 	include/xapian/query.h\
 	include/xapian/queryparser.h\
 	include/xapian/registry.h\
+	include/xapian/resultcache.h\
 	include/xapian/stem.h\
 	include/xapian/termgenerator.h\
 	include/xapian/termiterator.h\
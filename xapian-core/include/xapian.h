@@ -31,6 +31,7 @@
 #include <xapian/errorhandler.h>
 
 // Access to databases, documents, etc.
+#include <xapian/blockcache.h>
 #include <xapian/database.h>
 #include <xapian/dbfactory.h>
 #include <xapian/document.h>
@@ -50,6 +51,7 @@
 #include <xapian/postingsource.h>
 #include <xapian/query.h>
 #include <xapian/queryparser.h>
+#include <xapian/resultcache.h>
 #include <xapian/valuesetmatchdecider.h>
 #include <xapian/weight.h>
 
@@ -65,6 +67,9 @@
 // Database compaction and merging
 #include <xapian/compactor.h>
 
+// Building a new database in bulk
+#include <xapian/bulkbuilder.h>
+
 // ELF visibility annotations for GCC.
 #include <xapian/visibility.h>
 
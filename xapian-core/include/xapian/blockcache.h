@@ -0,0 +1,61 @@
+/** @file blockcache.h
+ * @brief Control the process-wide B-tree block cache.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BLOCKCACHE_H
+#define XAPIAN_INCLUDED_BLOCKCACHE_H
+
+#include <cstddef>
+
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Set the size of the process-wide block cache.
+ *
+ *  Blocks read from brass and chert databases opened for reading are kept
+ *  in a cache shared by all Database objects in the process (including
+ *  those used from different threads), so frequently used blocks don't need
+ *  to be read from the file again.
+ *
+ *  The cache is disabled by default.  The initial size can also be set using
+ *  the environment variable XAPIAN_BLOCK_CACHE_SIZE.
+ *
+ *  @param size	The maximum number of bytes of block data to cache.  0
+ *		disables the cache and frees any cached blocks.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_block_cache_size(std::size_t size);
+
+/// Get the current size limit of the block cache (in bytes).
+XAPIAN_VISIBILITY_DEFAULT
+std::size_t get_block_cache_size();
+
+/// Return the number of reads which the block cache has satisfied.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_block_cache_hits();
+
+/// Return the number of reads which the block cache couldn't satisfy.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_block_cache_misses();
+
+}
+
+#endif // XAPIAN_INCLUDED_BLOCKCACHE_H
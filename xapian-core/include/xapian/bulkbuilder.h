@@ -0,0 +1,173 @@
+/** @file bulkbuilder.h
+ * @brief Build a new database from many documents using several threads.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BULKBUILDER_H
+#define XAPIAN_INCLUDED_BULKBUILDER_H
+
+#include <xapian/intrusive_ptr.h>
+#include <xapian/types.h>
+#include <xapian/visibility.h>
+#include <string>
+
+namespace Xapian {
+
+class Document;
+class TermGenerator;
+
+/** Turn the records passed to a BulkBuilder into documents.
+ *
+ *  Subclass this to control how records are indexed.
+ *
+ *  index() and setup() are called from several threads at once, so they
+ *  mustn't modify any state shared between calls without suitable locking.
+ *  Also, Xapian objects mustn't be shared between threads, so if index()
+ *  needs (for example) a Stem object, create it in setup().
+ */
+class XAPIAN_VISIBILITY_DEFAULT BulkIndexer {
+  public:
+    /// Default constructor.
+    BulkIndexer() { }
+
+    /// Virtual destructor, because we have virtual methods.
+    virtual ~BulkIndexer();
+
+    /** Prepare a TermGenerator for use by index().
+     *
+     *  This is called once per batch, on the worker thread which will index
+     *  that batch, with a newly constructed TermGenerator.
+     *
+     *  The default implementation does nothing.
+     */
+    virtual void setup(Xapian::TermGenerator & termgen) const;
+
+    /** Turn a record into a document.
+     *
+     *  This is called on a worker thread, with @a doc empty and already
+     *  set as the current document of @a termgen.
+     *
+     *  The default implementation stores @a record as the document data and
+     *  indexes it as text.
+     */
+    virtual void index(const std::string & record,
+		       Xapian::Document & doc,
+		       Xapian::TermGenerator & termgen) const;
+};
+
+/** Build a new brass database from many documents using several threads.
+ *
+ *  Each record passed to add_record() becomes a document, with the n-th
+ *  record added getting document id n.  Records are collected into
+ *  batches, and each batch is turned into documents by a BulkIndexer on a
+ *  worker thread, which writes them to a temporary database (a "run").
+ *  Once all records have been added, finish() merges the runs into the
+ *  final database in the same way as Xapian::Compactor.
+ *
+ *  This is usually much faster than adding the documents one at a time
+ *  using WritableDatabase and then compacting the result, but the output
+ *  database must be built from scratch.
+ */
+class XAPIAN_VISIBILITY_DEFAULT BulkBuilder {
+  public:
+    /// Class containing the implementation.
+    class Internal;
+
+  private:
+    /// @internal Reference counted internals.
+    Xapian::Internal::intrusive_ptr<Internal> internal;
+
+    /// Don't allow copying.
+    BulkBuilder(const BulkBuilder &);
+
+    /// Don't allow assignment.
+    void operator=(const BulkBuilder &);
+
+  public:
+    /** Constructor.
+     *
+     *  The records are indexed by the default BulkIndexer, which stores
+     *  each record as the document data and indexes it as text.
+     *
+     *  @param destdir	The directory to create the database in.  This
+     *			is created if it doesn't exist.  The runs are
+     *			written to a subdirectory of it.
+     *  @param threads	The number of worker threads to use (default 1).
+     *			If 0, or threads aren't supported on this
+     *			platform, the records are indexed by the calling
+     *			thread.
+     */
+    explicit BulkBuilder(const std::string & destdir, unsigned threads = 1);
+
+    /** Constructor.
+     *
+     *  @param destdir	The directory to create the database in.  This
+     *			is created if it doesn't exist.  The runs are
+     *			written to a subdirectory of it.
+     *  @param indexer	The BulkIndexer to turn records into documents.
+     *			This is used by the worker threads until finish()
+     *			returns or the BulkBuilder is destroyed, so it must
+     *			remain valid until then.
+     *  @param threads	The number of worker threads to use (default 1).
+     *			If 0, or threads aren't supported on this
+     *			platform, the records are indexed by the calling
+     *			thread.
+     */
+    BulkBuilder(const std::string & destdir,
+		const BulkIndexer & indexer,
+		unsigned threads = 1);
+
+    /** Destructor.
+     *
+     *  If finish() hasn't been called, the records added are discarded,
+     *  after waiting for any batches being indexed.
+     */
+    ~BulkBuilder();
+
+    /** Set the number of records in each batch.
+     *
+     *  Each batch is written to a separate run, so larger batches mean fewer
+     *  runs to merge, but more memory is used to hold the pending records
+     *  (up to one batch per thread, plus the batch being collected) and to
+     *  buffer the changes while writing each run.
+     *
+     *  The default is 100000.
+     */
+    void set_batch_size(Xapian::doccount batch_size);
+
+    /** Add a record.
+     *
+     *  The record will be passed to BulkIndexer::index() to produce the
+     *  document.
+     */
+    void add_record(const std::string & record);
+
+    /** Finish indexing, and merge the runs to produce the database.
+     *
+     *  If indexing any batch failed, the exception is rethrown here (or by
+     *  a later call to add_record()).  Once finish() has been called, or an
+     *  exception reporting a failed batch has been thrown, calling
+     *  add_record() or finish() throws Xapian::InvalidOperationError.
+     */
+    void finish();
+};
+
+}
+
+#endif /* XAPIAN_INCLUDED_BULKBUILDER_H */
@@ -73,9 +73,39 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      *  Default is false.  If set to true and merging more than 3 databases,
      *  merge the postlists in multiple passes, which is generally faster but
      *  requires more disk space for temporary files.
+     *
+     *  For brass databases the postlists are instead merged in a single pass
+     *  which reads each source in large chunks (sharing about 64MB between
+     *  the sources), so no temporary files are needed.
      */
     void set_multipass(bool multipass);
 
+    /** Set the number of threads to use.
+     *
+     *  Default is 1.  If set higher, the tables of a brass database are
+     *  compacted in parallel.  The compaction is
+     *  done by the calling thread if threads aren't supported on this
+     *  platform, or for a chert database.
+     *
+     *  When using more than one thread, set_status() and
+     *  resolve_duplicate_metadata() are called from worker threads (but
+     *  never from more than one thread at once), and status updates for
+     *  different tables may be interleaved.
+     */
+    void set_threads(unsigned threads);
+
+    /** Limit the rate at which the database files are read and written.
+     *
+     *  This is useful to stop compaction starving searches (or other
+     *  processes) of I/O on a live system.  The limit applies to the total of
+     *  all the reads and writes.  Currently this is only supported for brass
+     *  databases.
+     *
+     *  @param bytes_per_second	The maximum rate, or 0 for no limit (the
+     *				default).
+     */
+    void set_io_rate_limit(size_t bytes_per_second);
+
     /** Set the compaction level.
      *
      *  Values are:
@@ -122,9 +152,9 @@ class XAPIAN_VISIBILITY_DEFAULT Compactor {
      *
      *  The default implementation just returns tags[0].
      *
-     *  For multipass this will currently get called multiple times for the
-     *  same key if there are duplicates to resolve in each pass, but this
-     *  may change in the future.
+     *  For multipass with a chert database this will currently get called
+     *  multiple times for the same key if there are duplicates to resolve in
+     *  each pass, but this may change in the future.
      */
     virtual std::string
     resolve_duplicate_metadata(const std::string & key,
@@ -98,6 +98,15 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	 */
 	explicit Database(const std::string &path);
 
+	/** Open a Database, automatically determining the database
+	 *  backend to use.
+	 *
+	 * @param path directory that the database is stored in.
+	 * @param flags  Bitwise-or of flags controlling how the database is
+	 *		 opened.  Currently the only flag is Xapian::DB_MMAP.
+	 */
+	Database(const std::string &path, int flags);
+
 	/** @private @internal Create a Database from its internals.
 	 */
 	explicit Database(Internal *internal);
@@ -167,6 +176,30 @@ class XAPIAN_VISIBILITY_DEFAULT Database {
 	 */
 	virtual void close();
 
+	/** Set how much memory to use to cache the results of filters.
+	 *
+	 *  If set, the documents matching the right side of each OP_FILTER
+	 *  in a query are remembered, so later queries using the same
+	 *  filter can use them rather than evaluating it again.  This is
+	 *  useful if a few filters (e.g. on boolean prefixes or value ranges)
+	 *  are reused by many queries.  The first query using a filter reads
+	 *  all the documents which match it, so may be slower.  Filters which
+	 *  could match too many documents to fit in the cache are just
+	 *  evaluated as normal.
+	 *
+	 *  The cache is emptied when reopen() opens a new revision, and when
+	 *  the database is modified.  Remote databases don't currently cache
+	 *  filters.
+	 *
+	 *  @param bytes	The memory to use for each subdatabase (the least
+	 *			recently used filters are discarded to stay within
+	 *			this), or 0 to disable the cache (the default).
+	 */
+	void set_filter_cache_size(size_t bytes);
+
+	/// Return the number of filters which the filter cache has supplied.
+	unsigned long get_filter_cache_hits() const;
+
 	/// Return a string describing this object.
 	virtual std::string get_description() const;
 
@@ -501,6 +534,8 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *    none exists
 	 *  - Xapian::DB_OPEN open for read/write; fail if no db exists
 	 *
+	 *  Xapian::DB_PACKED_POSTLISTS may be ored with @a action.
+	 *
 	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
 	 *             database is in a corrupt state.
 	 *
@@ -554,7 +589,8 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 *  10000 documents added, deleted, or modified.  This value is rather
 	 *  conservative, and if you have a machine with plenty of memory,
 	 *  you can improve indexing throughput dramatically by setting
-	 *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value.
+	 *  XAPIAN_FLUSH_THRESHOLD in the environment to a larger value, or
+	 *  by calling set_flush_memory_limit().
 	 *
 	 *  This method was new in Xapian 1.1.0 - in earlier versions it was
 	 *  called flush().
@@ -567,6 +603,88 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	void commit();
 
+	/** Start committing pending modifications, without waiting for them
+	 *  to reach disk.
+	 *
+	 *  This writes the modifications in the same way as commit(), but
+	 *  the database files are synced to disk (and the new revision made
+	 *  visible to readers) in a background thread.  Most of the time
+	 *  commit() takes is usually spent waiting for these syncs, so this
+	 *  lets an indexer carry on (for example, preparing the next
+	 *  documents) meanwhile.
+	 *
+	 *  The next call which needs to write to the database files waits
+	 *  for the background commit to finish first, as do commit(),
+	 *  wait_for_commit() and close().  If syncing fails, the exception is
+	 *  thrown by that call, and the database is closed.
+	 *
+	 *  If a commit window has been set with set_commit_window(), calls
+	 *  made within the window after the last commit are deferred, and the
+	 *  modifications are committed along with those from a later call.
+	 *
+	 *  Currently only the brass backend commits in the background - for
+	 *  other backends this is the same as commit().
+	 *
+	 *  It's not valid to call commit_async() within a transaction.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while modifying the database, or syncing a previous
+	 *             commit failed.
+	 */
+	void commit_async();
+
+	/** Wait for modifications committed by commit_async() to reach disk.
+	 *
+	 *  If a call to commit_async() was deferred by the commit window,
+	 *  this commits now (along with any modifications made since).
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if the commit
+	 *             failed.
+	 */
+	void wait_for_commit();
+
+	/** Group calls to commit_async() made within a time window.
+	 *
+	 *  An application which commits frequently (for example, every
+	 *  second, so new documents are soon searchable) may spend much of
+	 *  its time syncing.  With a window set, a call to commit_async()
+	 *  made less than @a seconds after the last commit started doesn't
+	 *  commit - its modifications are committed by the next call to
+	 *  commit_async() after the window, or by commit(),
+	 *  wait_for_commit(), or close().  So modifications may take up to
+	 *  the window (plus the interval between calls) to become visible to
+	 *  readers.
+	 *
+	 *  Backends which don't support commit_async() ignore this.
+	 *
+	 *  @param seconds	The length of the window, or 0 to commit on every
+	 *			call (the default).
+	 */
+	void set_commit_window(double seconds);
+
+	/** Set how much memory to use to buffer modifications.
+	 *
+	 *  Modifications are buffered in memory, and written to disk (and
+	 *  committed, unless a transaction is in progress) automatically
+	 *  once enough have been made.  By default, this happens after a
+	 *  number of documents have been added, deleted, or modified (see
+	 *  commit()), which uses far more memory if the documents are large
+	 *  than if they're small.  If a memory limit is set, it is used
+	 *  instead of the document count.
+	 *
+	 *  The memory used is estimated from the number and size of the
+	 *  buffered changes to postings, document lengths, and values, so
+	 *  the process may use somewhat more or less than this.
+	 *
+	 *  Currently only the brass backend supports this - other backends
+	 *  ignore it.
+	 *
+	 *  @param bytes	Approximate number of bytes to buffer before
+	 *			automatically flushing, or 0 to use the
+	 *			document count (the default).
+	 */
+	void set_flush_memory_limit(size_t bytes);
+
 	/** Pre-1.1.0 name for commit().
 	 *
 	 *  Use commit() instead in new code.  This alias may be deprecated in
@@ -810,6 +928,81 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	Xapian::docid replace_document(const std::string & unique_term,
 				       const Xapian::Document & document);
 
+	/** Add several new documents to the database.
+	 *
+	 *  This has the same effect as calling add_document() for each
+	 *  document in turn, but can be much faster.  With the remote
+	 *  backend, the documents are sent in one message rather than
+	 *  waiting for a round trip for each, and the brass backend only
+	 *  checks whether it needs to flush once for the whole batch.
+	 *
+	 *  If adding any of the documents fails, an exception is thrown and
+	 *  all uncommitted modifications are discarded, as for
+	 *  add_document().
+	 *
+	 *  @param documents	The new documents to be added.
+	 *
+	 *  @return		The document IDs of the new documents, in the
+	 *			same order as @a documents.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	std::vector<Xapian::docid>
+	add_documents(const std::vector<Xapian::Document> & documents);
+
+	/** Replace several documents in the database.
+	 *
+	 *  This has the same effect as calling replace_document() for each
+	 *  document ID and document in turn, but can be much faster.  The
+	 *  brass backend replaces the documents in ascending document ID
+	 *  order, so the old versions are read in the order they're stored.
+	 *
+	 *  @param dids		The document IDs of the documents to be
+	 *			replaced.
+	 *  @param documents	The new documents, one for each document ID.
+	 *
+	 *  @exception Xapian::InvalidArgumentError will be thrown if @a dids
+	 *             and @a documents are different sizes, or any of @a
+	 *             dids is 0.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	void replace_documents(const std::vector<Xapian::docid> & dids,
+			       const std::vector<Xapian::Document> & documents);
+
+	/** Replace any documents matching each of several terms.
+	 *
+	 *  This has the same effect as calling replace_document() for each
+	 *  unique term and document in turn, but can be much faster.
+	 *
+	 *  @param unique_terms	The "unique" terms.
+	 *  @param documents	The new documents, one for each term.
+	 *
+	 *  @return		The document IDs the documents were given, in
+	 *			the same order as @a documents.
+	 *
+	 *  @exception Xapian::InvalidArgumentError will be thrown if @a
+	 *             unique_terms and @a documents are different sizes, or
+	 *             any of @a unique_terms is empty.
+	 *
+	 *  @exception Xapian::DatabaseError will be thrown if a problem occurs
+	 *             while writing to the database.
+	 *
+	 *  @exception Xapian::DatabaseCorruptError will be thrown if the
+	 *             database is in a corrupt state.
+	 */
+	std::vector<Xapian::docid>
+	replace_documents(const std::vector<std::string> & unique_terms,
+			  const std::vector<Xapian::Document> & documents);
+
 	/** Add a word to the spelling dictionary.
 	 *
 	 *  If the word is already present, its frequency is increased.
@@ -898,6 +1091,37 @@ class XAPIAN_VISIBILITY_DEFAULT WritableDatabase : public Database {
 	 */
 	void set_metadata(const std::string & key, const std::string & value);
 
+	/** Add or remove an index of the values in a slot.
+	 *
+	 *  The index lists the documents in order of their value in the slot,
+	 *  so a range query on the slot (Query::OP_VALUE_RANGE,
+	 *  Query::OP_VALUE_GE or Query::OP_VALUE_LE) can find the documents
+	 *  which match directly, rather than checking the value of every
+	 *  document which has one.  This makes a big difference to queries
+	 *  with a narrow range (a date or price filter, for example), and also
+	 *  means the matcher knows exactly how many documents the range
+	 *  matches.  The index is kept up to date as documents are added,
+	 *  replaced and deleted, which makes those operations a little
+	 *  slower.
+	 *
+	 *  When an index is added, it is built from the values already in the
+	 *  slot.  Like other modifications, adding or removing an index is
+	 *  only committed by the next commit().
+	 *
+	 *  When databases are compacted, the output only has an index for a
+	 *  slot if all the inputs do.
+	 *
+	 *  @param slot	The value slot.
+	 *
+	 *  @param enabled	true to add an index (if there isn't one already),
+	 *			false to remove it.
+	 *
+	 *  @exception Xapian::UnimplementedError will be thrown if the
+	 *             database backend in use doesn't support value indexes
+	 *             (currently only brass does).
+	 */
+	void set_value_index(Xapian::valueno slot, bool enabled = true);
+
 	/// Return a string describing this object.
 	std::string get_description() const;
 };
@@ -911,6 +1135,36 @@ const int DB_CREATE_OR_OVERWRITE = 3;
 /** Open for read/write; fail if no db exists. */
 const int DB_OPEN = 4;
 
+/** Access the files of a database opened for reading via mmap().
+ *
+ *  Blocks of brass and chert databases are then read in place from the
+ *  mapping rather than copied into buffers, which saves memory when many
+ *  databases or iterators are open.  Other backends ignore this flag, as do
+ *  platforms without mmap().
+ *
+ *  This is intended for databases which aren't modified while open.  If a
+ *  writer does modify the database, reading may fail with
+ *  Xapian::DatabaseModifiedError or Xapian::DatabaseCorruptError, and if the
+ *  database is overwritten or compacted in place the process may be killed
+ *  by SIGBUS.
+ */
+const int DB_MMAP = 0x100;
+
+/** Write posting lists in a bit-packed form when creating a database.
+ *
+ *  This may be ored with Xapian::DB_CREATE, Xapian::DB_CREATE_OR_OPEN or
+ *  Xapian::DB_CREATE_OR_OVERWRITE.  Entries in each chunk of a posting list
+ *  are then stored in groups of fixed-width bit-packed values, which are
+ *  much quicker to decode than the default variable-length encoding, at the
+ *  cost of a somewhat larger database for terms with irregular posting
+ *  lists.
+ *
+ *  The choice is recorded in the database, so only matters when it is
+ *  created, and is preserved by xapian-compact.  Currently only the brass
+ *  backend supports this - other backends ignore it.
+ */
+const int DB_PACKED_POSTLISTS = 0x200;
+
 }
 
 #endif /* XAPIAN_INCLUDED_DATABASE_H */
@@ -817,6 +817,29 @@ class XAPIAN_VISIBILITY_DEFAULT Enquire {
 	 */
 	void set_cutoff(int percent_cutoff, Xapian::weight weight_cutoff = 0);
 
+	/** Set the number of threads to use to run the match.
+	 *
+	 *  If the database being searched combines several local
+	 *  databases, each can be matched on a separate worker thread, and
+	 *  the results merged.  On a multi-core machine this can greatly
+	 *  reduce the time taken to run each query.  The worker threads are
+	 *  created when first needed, and kept until this Enquire object is
+	 *  destroyed or this method is called with a different value.
+	 *
+	 *  The match is run in the calling thread (as it is by default) if
+	 *  a MatchSpy, MatchDecider, KeyMaker, or PostingSource which can't
+	 *  be cloned is in use (since these may not be safe to call from
+	 *  several threads at once), if there's only one local database, or
+	 *  if threads aren't supported on this platform.  Remote databases
+	 *  are matched by the remote server, so aren't affected by this
+	 *  setting.
+	 *
+	 *  @param threads  Maximum number of threads to use (default 1,
+	 *		    which means the match is run in the calling thread).
+	 */
+	void set_search_threads(unsigned threads);
+
+
 	/** Set the sorting to be by relevance only.
 	 *
 	 *  This is the default.
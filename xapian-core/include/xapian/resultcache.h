@@ -0,0 +1,73 @@
+/** @file resultcache.h
+ * @brief Control the process-wide cache of search results.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301
+ * USA
+ */
+
+#ifndef XAPIAN_INCLUDED_RESULTCACHE_H
+#define XAPIAN_INCLUDED_RESULTCACHE_H
+
+#include <cstddef>
+
+#include <xapian/visibility.h>
+
+namespace Xapian {
+
+/** Set the size of the process-wide result cache.
+ *
+ *  The MSets which Enquire::get_mset() returns are kept in a cache shared by
+ *  all Enquire objects in the process (including those used from different
+ *  threads), keyed by the query, the Enquire settings which affect the
+ *  results, and the location and revision of each database searched.  Repeating a search,
+ *  or asking for a page of results within those already cached, is then
+ *  answered from the cache without running the match.  Results answered
+ *  from a search which was run for more items may have more accurate bounds
+ *  on the number of matches than running the search again would give.
+ *
+ *  A database only has results cached while it's open for reading at a
+ *  revision which its backend can identify (currently brass and chert), so
+ *  reopening a database at a new revision gives fresh results.  Searches
+ *  which use an RSet, a MatchDecider, a MatchSpy, a KeyMaker, an
+ *  ErrorHandler, or a Weight or PostingSource which can't be serialised
+ *  aren't cached.
+ *
+ *  The cache is disabled by default.  The initial size can also be set using
+ *  the environment variable XAPIAN_RESULT_CACHE_SIZE.
+ *
+ *  @param size	The maximum number of bytes to use (approximately) for
+ *		cached results.  0 disables the cache and frees any cached
+ *		results.
+ */
+XAPIAN_VISIBILITY_DEFAULT
+void set_result_cache_size(std::size_t size);
+
+/// Get the current size limit of the result cache (in bytes).
+XAPIAN_VISIBILITY_DEFAULT
+std::size_t get_result_cache_size();
+
+/// Return the number of searches which the result cache has answered.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_result_cache_hits();
+
+/// Return the number of cacheable searches which had to be run.
+XAPIAN_VISIBILITY_DEFAULT
+unsigned long get_result_cache_misses();
+
+}
+
+#endif // XAPIAN_INCLUDED_RESULTCACHE_H
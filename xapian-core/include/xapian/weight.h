@@ -228,6 +228,15 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
      */
     void init_(const Internal & stats, Xapian::termcount query_len_);
 
+    /** @private @internal Return an upper bound on get_sumpart() for
+     *  documents where the wdf is at most @a wdf_max.
+     *
+     *  This is the value get_maxpart() returns when the upper bound on the
+     *  wdf is reduced to @a wdf_max, which allows a backend to bound the
+     *  weight of a block of postings it knows the maximum wdf of.
+     */
+    Xapian::weight get_maxpart_for_wdf_(Xapian::termcount wdf_max) const;
+
     /** @private @internal Return true if the document length is needed.
      *
      *  If this method returns true, then the document length will be fetched
@@ -302,6 +311,16 @@ class XAPIAN_VISIBILITY_DEFAULT Weight {
     Xapian::termcount get_wdf_upper_bound() const {
 	return wdf_upper_bound_;
     }
+
+    /** Return an upper bound on get_sumpart() for documents where the wdf is
+     *  at most @a wdf_max.
+     *
+     *  @a wdf_max will be less than get_wdf_upper_bound().  Subclasses which
+     *  can give a tighter bound than get_maxpart() in this case should
+     *  override this method - the default implementation just returns
+     *  get_maxpart().
+     */
+    virtual Xapian::weight get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
 };
 
 /** Class implementing a "boolean" weighting scheme.
@@ -348,6 +367,8 @@ class XAPIAN_VISIBILITY_DEFAULT BM25Weight : public Weight {
 
     void init(double factor);
 
+    Xapian::weight get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
+
   public:
     /** Construct a BM25Weight.
      *
@@ -457,6 +478,8 @@ class XAPIAN_VISIBILITY_DEFAULT TradWeight : public Weight {
 
     void init(double factor);
 
+    Xapian::weight get_maxpart_for_wdf(Xapian::termcount wdf_max) const;
+
   public:
     /** Construct a TradWeight.
      *
@@ -1,9 +1,12 @@
 noinst_HEADERS +=\
 	matcher/andmaybepostlist.h\
+	matcher/bitmappostlist.h\
 	matcher/andnotpostlist.h\
 	matcher/branchpostlist.h\
 	matcher/collapser.h\
 	matcher/const_database_wrapper.h\
+	matcher/docidlistpostlist.h\
+	matcher/docidrangepostlist.h\
 	matcher/exactphrasepostlist.h\
 	matcher/externalpostlist.h\
 	matcher/extraweightpostlist.h\
@@ -18,6 +21,7 @@ noinst_HEADERS +=\
 	matcher/queryoptimiser.h\
 	matcher/remotesubmatch.h\
 	matcher/selectpostlist.h\
+	matcher/shardsubmatch.h\
 	matcher/synonympostlist.h\
 	matcher/valuegepostlist.h\
 	matcher/valuerangepostlist.h\
@@ -37,10 +41,13 @@ EXTRA_DIST +=\
 
 lib_src +=\
 	matcher/andmaybepostlist.cc\
+	matcher/bitmappostlist.cc\
 	matcher/andnotpostlist.cc\
 	matcher/branchpostlist.cc\
 	matcher/collapser.cc\
 	matcher/const_database_wrapper.cc\
+	matcher/docidlistpostlist.cc\
+	matcher/docidrangepostlist.cc\
 	matcher/exactphrasepostlist.cc\
 	matcher/externalpostlist.cc\
 	matcher/localsubmatch.cc\
@@ -54,6 +61,7 @@ lib_src +=\
 	matcher/phrasepostlist.cc\
 	matcher/queryoptimiser.cc\
 	matcher/selectpostlist.cc\
+	matcher/shardsubmatch.cc\
 	matcher/synonympostlist.cc\
 	matcher/valuegepostlist.cc\
 	matcher/valuerangepostlist.cc\
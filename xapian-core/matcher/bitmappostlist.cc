@@ -0,0 +1,438 @@
+/** @file bitmappostlist.cc
+ *  @brief PostList iterating a DocidBitmap, and operators combining them.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "bitmappostlist.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+#include "weightinternal.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+/// Return the index of the lowest set bit in non-zero @a word.
+static inline unsigned
+lowest_set_bit(uint8 word)
+{
+    Assert(word);
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    unsigned n = 0;
+    while ((word & 1) == 0) {
+	word >>= 1;
+	++n;
+    }
+    return n;
+#endif
+}
+
+template<class CLASS> struct delete_ptr {
+    void operator()(CLASS *p) { delete p; }
+};
+
+AndDocidBitmap::AndDocidBitmap(vector<DocidBitmap *> & bitmaps_,
+			       Xapian::doccount db_size_)
+    : db_size(db_size_), tmp(BLOCK_WORDS)
+{
+    AssertRel(bitmaps_.size(), >=, 2);
+    swap(bitmaps, bitmaps_);
+}
+
+AndDocidBitmap::~AndDocidBitmap()
+{
+    for_each(bitmaps.begin(), bitmaps.end(), delete_ptr<DocidBitmap>());
+}
+
+Xapian::docid
+AndDocidBitmap::find_block(Xapian::docid block)
+{
+    // Leapfrog between the sets until they all agree on the block - when a
+    // set returns a later block, it agrees with itself about that block.
+    size_t n = bitmaps.size();
+    size_t i = 0, agreed = 0;
+    while (agreed < n) {
+	Xapian::docid r = bitmaps[i]->find_block(block);
+	if (r == NO_BLOCK) return NO_BLOCK;
+	if (r != block) {
+	    block = r;
+	    agreed = 1;
+	} else {
+	    ++agreed;
+	}
+	if (++i == n) i = 0;
+    }
+    return block;
+}
+
+void
+AndDocidBitmap::read_block(Xapian::docid block, uint8 * words)
+{
+    bitmaps[0]->read_block(block, words);
+    for (size_t i = 1; i != bitmaps.size(); ++i) {
+	bitmaps[i]->read_block(block, &tmp[0]);
+	uint8 any = 0;
+	for (unsigned w = 0; w != BLOCK_WORDS; ++w) {
+	    words[w] &= tmp[w];
+	    any |= words[w];
+	}
+	// Nothing left to intersect with the remaining sets.
+	if (!any) return;
+    }
+}
+
+Xapian::doccount
+AndDocidBitmap::get_termfreq_min() const
+{
+    // As for MultiAndPostList - the sets may be maximally disjoint.
+    Xapian::doccount sum = bitmaps[0]->get_termfreq_min();
+    if (sum) {
+	for (size_t i = 1; i < bitmaps.size(); ++i) {
+	    Xapian::doccount sum_old = sum;
+	    sum += bitmaps[i]->get_termfreq_min();
+	    if (sum >= sum_old && sum <= db_size) {
+		// It's possible there's no overlap.
+		return 0;
+	    }
+	    sum -= db_size;
+	}
+    }
+    return sum;
+}
+
+Xapian::doccount
+AndDocidBitmap::get_termfreq_est() const
+{
+    // Estimate assuming independence.
+    double result(bitmaps[0]->get_termfreq_est());
+    for (size_t i = 1; i < bitmaps.size(); ++i) {
+	result = (result * bitmaps[i]->get_termfreq_est()) / db_size;
+    }
+    return static_cast<Xapian::doccount>(result + 0.5);
+}
+
+Xapian::doccount
+AndDocidBitmap::get_termfreq_max() const
+{
+    Xapian::doccount result = bitmaps[0]->get_termfreq_max();
+    for (size_t i = 1; i < bitmaps.size(); ++i) {
+	result = min(result, bitmaps[i]->get_termfreq_max());
+    }
+    return result;
+}
+
+string
+AndDocidBitmap::get_description() const
+{
+    string desc("(");
+    for (size_t i = 0; i != bitmaps.size(); ++i) {
+	if (i) desc += " AND ";
+	desc += bitmaps[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+OrDocidBitmap::OrDocidBitmap(vector<DocidBitmap *> & bitmaps_,
+			     Xapian::doccount db_size_)
+    : blocks(bitmaps_.size()), db_size(db_size_), tmp(BLOCK_WORDS)
+{
+    AssertRel(bitmaps_.size(), >=, 2);
+    swap(bitmaps, bitmaps_);
+}
+
+OrDocidBitmap::~OrDocidBitmap()
+{
+    for_each(bitmaps.begin(), bitmaps.end(), delete_ptr<DocidBitmap>());
+}
+
+Xapian::docid
+OrDocidBitmap::find_block(Xapian::docid block)
+{
+    Xapian::docid result = NO_BLOCK;
+    for (size_t i = 0; i != bitmaps.size(); ++i) {
+	// A set's last answer is still right if it's not before block.
+	if (blocks[i] <= block)
+	    blocks[i] = bitmaps[i]->find_block(block);
+	result = min(result, blocks[i]);
+    }
+    return result;
+}
+
+void
+OrDocidBitmap::read_block(Xapian::docid block, uint8 * words)
+{
+    memset(words, 0, BLOCK_WORDS * sizeof(uint8));
+    for (size_t i = 0; i != bitmaps.size(); ++i) {
+	if (blocks[i] != block) continue;
+	bitmaps[i]->read_block(block, &tmp[0]);
+	for (unsigned w = 0; w != BLOCK_WORDS; ++w) {
+	    words[w] |= tmp[w];
+	}
+    }
+}
+
+Xapian::doccount
+OrDocidBitmap::get_termfreq_min() const
+{
+    Xapian::doccount result = 0;
+    for (size_t i = 0; i < bitmaps.size(); ++i) {
+	result = max(result, bitmaps[i]->get_termfreq_min());
+    }
+    return result;
+}
+
+Xapian::doccount
+OrDocidBitmap::get_termfreq_est() const
+{
+    // Estimate assuming independence:
+    // P(l or r) = P(l) + P(r) - P(l) . P(r)
+    double est(bitmaps[0]->get_termfreq_est());
+    for (size_t i = 1; i < bitmaps.size(); ++i) {
+	double rest(bitmaps[i]->get_termfreq_est());
+	est = est + rest - (est * rest / db_size);
+    }
+    return static_cast<Xapian::doccount>(est + 0.5);
+}
+
+Xapian::doccount
+OrDocidBitmap::get_termfreq_max() const
+{
+    Xapian::doccount result = 0;
+    for (size_t i = 0; i < bitmaps.size(); ++i) {
+	Xapian::doccount tf = bitmaps[i]->get_termfreq_max();
+	// Avoid overflow.
+	if (tf >= db_size - result) return db_size;
+	result += tf;
+    }
+    return result;
+}
+
+string
+OrDocidBitmap::get_description() const
+{
+    string desc("(");
+    for (size_t i = 0; i != bitmaps.size(); ++i) {
+	if (i) desc += " OR ";
+	desc += bitmaps[i]->get_description();
+    }
+    desc += ')';
+    return desc;
+}
+
+Xapian::docid
+AndNotDocidBitmap::find_block(Xapian::docid block)
+{
+    return l->find_block(block);
+}
+
+void
+AndNotDocidBitmap::read_block(Xapian::docid block, uint8 * words)
+{
+    l->read_block(block, words);
+    if (r->find_block(block) != block) return;
+    r->read_block(block, &tmp[0]);
+    for (unsigned w = 0; w != BLOCK_WORDS; ++w) {
+	words[w] &= ~tmp[w];
+    }
+}
+
+Xapian::doccount
+AndNotDocidBitmap::get_termfreq_min() const
+{
+    Xapian::doccount l_min = l->get_termfreq_min();
+    Xapian::doccount r_max = r->get_termfreq_max();
+    return (l_min > r_max) ? l_min - r_max : 0;
+}
+
+Xapian::doccount
+AndNotDocidBitmap::get_termfreq_est() const
+{
+    // Estimate assuming independence:
+    // P(l not r) = P(l) . ( 1 - P(r))
+    double est = l->get_termfreq_est() *
+	     (1.0 - double(r->get_termfreq_est()) / db_size);
+    return static_cast<Xapian::doccount>(est + 0.5);
+}
+
+Xapian::doccount
+AndNotDocidBitmap::get_termfreq_max() const
+{
+    return l->get_termfreq_max();
+}
+
+string
+AndNotDocidBitmap::get_description() const
+{
+    string desc("(");
+    desc += l->get_description();
+    desc += " AND_NOT ";
+    desc += r->get_description();
+    desc += ')';
+    return desc;
+}
+
+void
+BitmapPostList::find_next(Xapian::docid target)
+{
+    const Xapian::docid mask = DocidBitmap::BLOCK_SIZE - 1;
+    Xapian::docid b = target >> DocidBitmap::BLOCK_SHIFT;
+    while (true) {
+	if (b != block) {
+	    Xapian::docid found = bitmap->find_block(b);
+	    if (found == DocidBitmap::NO_BLOCK) {
+		finished = true;
+		return;
+	    }
+	    bitmap->read_block(found, &words[0]);
+	    block = found;
+	    if (found != b) target = found << DocidBitmap::BLOCK_SHIFT;
+	}
+
+	unsigned bit = target & mask;
+	unsigned w = bit >> 6;
+	uint8 word = words[w] & (~uint8(0) << (bit & 63));
+	while (true) {
+	    if (word) {
+		did = (block << DocidBitmap::BLOCK_SHIFT) + w * 64 +
+		      lowest_set_bit(word);
+		return;
+	    }
+	    if (++w == DocidBitmap::BLOCK_WORDS) break;
+	    word = words[w];
+	}
+
+	// Nothing more in this block, so try the next one.
+	b = block + 1;
+	if (b > (Xapian::docid(-1) >> DocidBitmap::BLOCK_SHIFT)) {
+	    finished = true;
+	    return;
+	}
+	target = b << DocidBitmap::BLOCK_SHIFT;
+    }
+}
+
+Xapian::doccount
+BitmapPostList::get_termfreq_min() const
+{
+    return bitmap->get_termfreq_min();
+}
+
+Xapian::doccount
+BitmapPostList::get_termfreq_est() const
+{
+    return bitmap->get_termfreq_est();
+}
+
+Xapian::doccount
+BitmapPostList::get_termfreq_max() const
+{
+    return bitmap->get_termfreq_max();
+}
+
+TermFreqs
+BitmapPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "BitmapPostList::get_termfreq_est_using_stats", stats);
+    // The statistics may be for several databases, so scale by the
+    // proportion of this one which we estimate matches.
+    if (db_size == 0) RETURN(TermFreqs(0, 0));
+    double fraction = double(bitmap->get_termfreq_est()) / db_size;
+    RETURN(TermFreqs(Xapian::doccount(stats.collection_size * fraction + 0.5),
+		     Xapian::doccount(stats.rset_size * fraction + 0.5)));
+}
+
+Xapian::weight
+BitmapPostList::get_maxweight() const
+{
+    return 0;
+}
+
+Xapian::docid
+BitmapPostList::get_docid() const
+{
+    Assert(did);
+    Assert(!finished);
+    return did;
+}
+
+Xapian::weight
+BitmapPostList::get_weight() const
+{
+    return 0;
+}
+
+Xapian::termcount
+BitmapPostList::get_doclength() const
+{
+    return 0;
+}
+
+Xapian::weight
+BitmapPostList::recalc_maxweight()
+{
+    return 0;
+}
+
+PostList *
+BitmapPostList::next(Xapian::weight)
+{
+    Assert(!finished);
+    if (rare(did == Xapian::docid(-1))) {
+	finished = true;
+	return NULL;
+    }
+    find_next(did + 1);
+    return NULL;
+}
+
+PostList *
+BitmapPostList::skip_to(Xapian::docid target, Xapian::weight)
+{
+    Assert(!finished);
+    if (target > did) find_next(target);
+    return NULL;
+}
+
+bool
+BitmapPostList::at_end() const
+{
+    return finished;
+}
+
+Xapian::termcount
+BitmapPostList::count_matching_subqs() const
+{
+    return 1;
+}
+
+string
+BitmapPostList::get_description() const
+{
+    string desc = "BitmapPostList(";
+    desc += bitmap->get_description();
+    desc += ')';
+    return desc;
+}
@@ -0,0 +1,223 @@
+/** @file bitmappostlist.h
+ *  @brief PostList iterating a DocidBitmap, and operators combining them.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_BITMAPPOSTLIST_H
+#define XAPIAN_INCLUDED_BITMAPPOSTLIST_H
+
+#include "autoptr.h"
+#include "docidbitmap.h"
+#include "postlist.h"
+
+#include <string>
+#include <vector>
+
+/// DocidBitmap for the intersection of several others.
+class AndDocidBitmap : public DocidBitmap {
+    /// The sets to intersect (which we own).
+    std::vector<DocidBitmap *> bitmaps;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Space to read each set's bitmap into.
+    std::vector<uint8> tmp;
+
+  public:
+    /** Construct an AndDocidBitmap.
+     *
+     *  @param bitmaps_	The sets to intersect, which this object takes
+     *			ownership of.  The contents are swapped out of the
+     *			vector passed in, which is left empty.
+     *  @param db_size_	The number of documents in the database.
+     */
+    AndDocidBitmap(std::vector<DocidBitmap *> & bitmaps_,
+		   Xapian::doccount db_size_);
+
+    ~AndDocidBitmap();
+
+    Xapian::docid find_block(Xapian::docid block);
+
+    void read_block(Xapian::docid block, uint8 * words);
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    std::string get_description() const;
+};
+
+/// DocidBitmap for the union of several others.
+class OrDocidBitmap : public DocidBitmap {
+    /// The sets to combine (which we own).
+    std::vector<DocidBitmap *> bitmaps;
+
+    /// The block each set's last find_block() call returned.
+    std::vector<Xapian::docid> blocks;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Space to read each set's bitmap into.
+    std::vector<uint8> tmp;
+
+  public:
+    /** Construct an OrDocidBitmap.
+     *
+     *  @param bitmaps_	The sets to combine, which this object takes
+     *			ownership of.  The contents are swapped out of the
+     *			vector passed in, which is left empty.
+     *  @param db_size_	The number of documents in the database.
+     */
+    OrDocidBitmap(std::vector<DocidBitmap *> & bitmaps_,
+		  Xapian::doccount db_size_);
+
+    ~OrDocidBitmap();
+
+    Xapian::docid find_block(Xapian::docid block);
+
+    void read_block(Xapian::docid block, uint8 * words);
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    std::string get_description() const;
+};
+
+/// DocidBitmap for the docids in one set but not another.
+class AndNotDocidBitmap : public DocidBitmap {
+    /// The set to take docids from.
+    AutoPtr<DocidBitmap> l;
+
+    /// The set of docids to exclude.
+    AutoPtr<DocidBitmap> r;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Space to read the bitmap of r into.
+    std::vector<uint8> tmp;
+
+  public:
+    /** Construct an AndNotDocidBitmap.
+     *
+     *  @param l_	The set to take docids from (which this object takes
+     *			ownership of).
+     *  @param r_	The set of docids to exclude (which this object takes
+     *			ownership of).
+     *  @param db_size_	The number of documents in the database.
+     */
+    AndNotDocidBitmap(DocidBitmap * l_, DocidBitmap * r_,
+		      Xapian::doccount db_size_)
+	: l(l_), r(r_), db_size(db_size_), tmp(BLOCK_WORDS) { }
+
+    Xapian::docid find_block(Xapian::docid block);
+
+    void read_block(Xapian::docid block, uint8 * words);
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    std::string get_description() const;
+};
+
+/** PostList returning the docids in a DocidBitmap, with zero weight.
+ *
+ *  A block of docids is read at a time, so moving within a block is just a
+ *  matter of finding the next set bit - this makes skip_to() cheap when a
+ *  bitmap is used to filter a weighted query.
+ */
+class BitmapPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const BitmapPostList &);
+
+    /// Don't allow copying.
+    BitmapPostList(const BitmapPostList &);
+
+    /// The set of docids to return.
+    AutoPtr<DocidBitmap> bitmap;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// The block currently read into words, or NO_BLOCK if none is.
+    Xapian::docid block;
+
+    /// The bitmap for block.
+    std::vector<uint8> words;
+
+    /// The current docid, or 0 if we haven't started yet.
+    Xapian::docid did;
+
+    /// True if we've reached the end.
+    bool finished;
+
+    /// Move to the first docid >= @a target.
+    void find_next(Xapian::docid target);
+
+  public:
+    /** Construct a BitmapPostList.
+     *
+     *  @param bitmap_	The set of docids to return (which this object takes
+     *			ownership of).
+     *  @param db_size_	The number of documents in the database.
+     */
+    BitmapPostList(DocidBitmap * bitmap_, Xapian::doccount db_size_)
+	: bitmap(bitmap_), db_size(db_size_), block(DocidBitmap::NO_BLOCK),
+	  words(DocidBitmap::BLOCK_WORDS), did(0), finished(false) { }
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    Xapian::weight get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::weight get_weight() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::weight recalc_maxweight();
+
+    PostList * next(Xapian::weight w_min);
+
+    PostList * skip_to(Xapian::docid did, Xapian::weight w_min);
+
+    bool at_end() const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_BITMAPPOSTLIST_H
@@ -0,0 +1,161 @@
+/** @file docidlistpostlist.cc
+ *  @brief PostList returning a sorted list of document ids.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "docidlistpostlist.h"
+
+#include "debuglog.h"
+#include "omassert.h"
+#include "str.h"
+#include "weightinternal.h"
+
+#include <algorithm>
+
+using namespace std;
+
+/// Make a DocidList, swapping the contents of @a dids into it.
+static DocidList *
+make_docid_list(vector<Xapian::docid> & dids)
+{
+    DocidList * list = new DocidList;
+    swap(list->dids, dids);
+    return list;
+}
+
+DocidListPostList::DocidListPostList(vector<Xapian::docid> & dids_,
+				     Xapian::doccount db_size_,
+				     const string & description_)
+    : list(make_docid_list(dids_)), dids(list->dids),
+      i(vector<Xapian::docid>::size_type(-1)), db_size(db_size_),
+      description(description_)
+{
+}
+
+DocidListPostList::DocidListPostList(const DocidList * list_,
+				     Xapian::doccount db_size_,
+				     const string & description_)
+    : list(list_), dids(list->dids),
+      i(vector<Xapian::docid>::size_type(-1)), db_size(db_size_),
+      description(description_)
+{
+}
+
+Xapian::doccount
+DocidListPostList::get_termfreq_min() const
+{
+    return dids.size();
+}
+
+Xapian::doccount
+DocidListPostList::get_termfreq_est() const
+{
+    return dids.size();
+}
+
+Xapian::doccount
+DocidListPostList::get_termfreq_max() const
+{
+    return dids.size();
+}
+
+TermFreqs
+DocidListPostList::get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const
+{
+    LOGCALL(MATCH, TermFreqs, "DocidListPostList::get_termfreq_est_using_stats", stats);
+    // The statistics may be for several databases, so scale by the
+    // proportion of this one which matches.
+    if (db_size == 0) RETURN(TermFreqs(0, 0));
+    double fraction = double(dids.size()) / db_size;
+    RETURN(TermFreqs(Xapian::doccount(stats.collection_size * fraction + 0.5),
+		     Xapian::doccount(stats.rset_size * fraction + 0.5)));
+}
+
+Xapian::weight
+DocidListPostList::get_maxweight() const
+{
+    return 0;
+}
+
+Xapian::docid
+DocidListPostList::get_docid() const
+{
+    Assert(i < dids.size());
+    return dids[i];
+}
+
+Xapian::weight
+DocidListPostList::get_weight() const
+{
+    return 0;
+}
+
+Xapian::termcount
+DocidListPostList::get_doclength() const
+{
+    return 0;
+}
+
+Xapian::weight
+DocidListPostList::recalc_maxweight()
+{
+    return 0;
+}
+
+PostList *
+DocidListPostList::next(Xapian::weight)
+{
+    ++i;
+    return NULL;
+}
+
+PostList *
+DocidListPostList::skip_to(Xapian::docid did, Xapian::weight)
+{
+    if (i == vector<Xapian::docid>::size_type(-1)) i = 0;
+    if (i < dids.size() && dids[i] < did) {
+	i = lower_bound(dids.begin() + i, dids.end(), did) - dids.begin();
+    }
+    return NULL;
+}
+
+bool
+DocidListPostList::at_end() const
+{
+    return i == dids.size();
+}
+
+Xapian::termcount
+DocidListPostList::count_matching_subqs() const
+{
+    return 1;
+}
+
+string
+DocidListPostList::get_description() const
+{
+    string desc = "DocidListPostList(";
+    desc += str(dids.size());
+    desc += ", ";
+    desc += description;
+    desc += ')';
+    return desc;
+}
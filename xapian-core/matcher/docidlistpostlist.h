@@ -0,0 +1,115 @@
+/** @file docidlistpostlist.h
+ *  @brief PostList returning a sorted list of document ids.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDLISTPOSTLIST_H
+#define XAPIAN_INCLUDED_DOCIDLISTPOSTLIST_H
+
+#include "filtercache.h"
+#include "postlist.h"
+
+#include <string>
+#include <vector>
+
+/** PostList returning a sorted list of document ids, with zero weight.
+ *
+ *  This is used for boolean subqueries whose matching documents have
+ *  already been found (for example, from a value index), so the termfreq
+ *  statistics are exact.
+ */
+class DocidListPostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const DocidListPostList &);
+
+    /// Don't allow copying.
+    DocidListPostList(const DocidListPostList &);
+
+    /// The document ids (which may be shared with the filter cache).
+    Xapian::Internal::intrusive_ptr<const DocidList> list;
+
+    /// The document ids, in ascending order.
+    const std::vector<Xapian::docid> & dids;
+
+    /** Index of the current document id in dids.
+     *
+     *  This is dids.size() once we're at the end, and before next() or
+     *  skip_to() is first called it is -1 (so next() can just increment it).
+     */
+    std::vector<Xapian::docid>::size_type i;
+
+    /// The number of documents in the database.
+    Xapian::doccount db_size;
+
+    /// Description of the subquery the document ids are for.
+    std::string description;
+
+  public:
+    /** Construct a DocidListPostList.
+     *
+     *  @param dids_		The document ids, in ascending order.  The
+     *				contents are swapped out of the vector passed
+     *				in, which is left empty.
+     *  @param db_size_		The number of documents in the database.
+     *  @param description_	Description of the subquery.
+     */
+    DocidListPostList(std::vector<Xapian::docid> & dids_,
+		      Xapian::doccount db_size_,
+		      const std::string & description_);
+
+    /** Construct a DocidListPostList sharing a list of document ids.
+     *
+     *  @param list_		The document ids.
+     *  @param db_size_		The number of documents in the database.
+     *  @param description_	Description of the subquery.
+     */
+    DocidListPostList(const DocidList * list_,
+		      Xapian::doccount db_size_,
+		      const std::string & description_);
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    TermFreqs get_termfreq_est_using_stats(
+	const Xapian::Weight::Internal & stats) const;
+
+    Xapian::weight get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::weight get_weight() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::weight recalc_maxweight();
+
+    PostList * next(Xapian::weight w_min);
+
+    PostList * skip_to(Xapian::docid did, Xapian::weight w_min);
+
+    bool at_end() const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDLISTPOSTLIST_H
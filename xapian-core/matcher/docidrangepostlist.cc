@@ -0,0 +1,152 @@
+/** @file docidrangepostlist.cc
+ *  @brief Return the entries from a PostList in a range of document ids.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "docidrangepostlist.h"
+
+#include "debuglog.h"
+#include "multimatch.h"
+#include "omassert.h"
+#include "str.h"
+
+using namespace std;
+
+DocidRangePostList::~DocidRangePostList()
+{
+    delete source;
+}
+
+void
+DocidRangePostList::handle_prune(PostList * pl)
+{
+    if (pl) {
+	delete source;
+	source = pl;
+	if (matcher) matcher->recalc_maxweight();
+    }
+}
+
+Xapian::doccount
+DocidRangePostList::get_termfreq_min() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "DocidRangePostList::get_termfreq_min", NO_ARGS);
+    // At most this many matching documents can be outside the range.
+    Xapian::doccount outside = db_last_did - (last_did - first_did + 1);
+    Xapian::doccount tf = source->get_termfreq_min();
+    RETURN(tf > outside ? tf - outside : 0);
+}
+
+Xapian::doccount
+DocidRangePostList::get_termfreq_est() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "DocidRangePostList::get_termfreq_est", NO_ARGS);
+    double fraction = double(last_did - first_did + 1) / db_last_did;
+    Xapian::doccount est;
+    est = Xapian::doccount(source->get_termfreq_est() * fraction + 0.5);
+    est = max(est, get_termfreq_min());
+    RETURN(min(est, get_termfreq_max()));
+}
+
+Xapian::doccount
+DocidRangePostList::get_termfreq_max() const
+{
+    LOGCALL(MATCH, Xapian::doccount, "DocidRangePostList::get_termfreq_max", NO_ARGS);
+    RETURN(min(source->get_termfreq_max(), last_did - first_did + 1));
+}
+
+Xapian::weight
+DocidRangePostList::get_maxweight() const
+{
+    return source->get_maxweight();
+}
+
+Xapian::docid
+DocidRangePostList::get_docid() const
+{
+    Assert(started);
+    return source->get_docid();
+}
+
+Xapian::weight
+DocidRangePostList::get_weight() const
+{
+    return source->get_weight();
+}
+
+Xapian::termcount
+DocidRangePostList::get_doclength() const
+{
+    return source->get_doclength();
+}
+
+Xapian::weight
+DocidRangePostList::recalc_maxweight()
+{
+    return source->recalc_maxweight();
+}
+
+PostList *
+DocidRangePostList::next(Xapian::weight w_min)
+{
+    LOGCALL(MATCH, PostList *, "DocidRangePostList::next", w_min);
+    if (!started) {
+	started = true;
+	handle_prune(source->skip_to(first_did, w_min));
+    } else {
+	handle_prune(source->next(w_min));
+    }
+    RETURN(NULL);
+}
+
+PostList *
+DocidRangePostList::skip_to(Xapian::docid did, Xapian::weight w_min)
+{
+    LOGCALL(MATCH, PostList *, "DocidRangePostList::skip_to", did | w_min);
+    started = true;
+    handle_prune(source->skip_to(max(did, first_did), w_min));
+    RETURN(NULL);
+}
+
+bool
+DocidRangePostList::at_end() const
+{
+    Assert(started);
+    return source->at_end() || source->get_docid() > last_did;
+}
+
+Xapian::termcount
+DocidRangePostList::count_matching_subqs() const
+{
+    return source->count_matching_subqs();
+}
+
+string
+DocidRangePostList::get_description() const
+{
+    string desc = "(DocidRange ";
+    desc += str(first_did);
+    desc += "..";
+    desc += str(last_did);
+    desc += ' ';
+    desc += source->get_description();
+    desc += ')';
+    return desc;
+}
@@ -0,0 +1,98 @@
+/** @file docidrangepostlist.h
+ *  @brief Return the entries from a PostList in a range of document ids.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+#define XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
+
+#include "postlist.h"
+
+class MultiMatch;
+
+/** PostList returning the entries from a source PostList in a docid range.
+ *
+ *  This is used at the top of the PostList tree to match part of a database,
+ *  so that several parts can be matched in parallel.  The termfreq
+ *  statistics are scaled by the proportion of the docid space in the range.
+ */
+class DocidRangePostList : public PostList {
+    /// Don't allow assignment.
+    void operator=(const DocidRangePostList &);
+
+    /// Don't allow copying.
+    DocidRangePostList(const DocidRangePostList &);
+
+    /// The PostList to return entries from.
+    PostList * source;
+
+    /// The first document id in the range.
+    Xapian::docid first_did;
+
+    /// The last document id in the range.
+    Xapian::docid last_did;
+
+    /// The highest document id in the whole database.
+    Xapian::docid db_last_did;
+
+    /// The matcher to notify if the source PostList is replaced.
+    MultiMatch * matcher;
+
+    /// Has source been advanced to the start of the range yet?
+    bool started;
+
+    /// Replace source with @a pl if it isn't NULL.
+    void handle_prune(PostList * pl);
+
+  public:
+    DocidRangePostList(PostList * source_,
+		       Xapian::docid first_did_, Xapian::docid last_did_,
+		       Xapian::docid db_last_did_, MultiMatch * matcher_)
+	: source(source_), first_did(first_did_), last_did(last_did_),
+	  db_last_did(db_last_did_), matcher(matcher_), started(false) { }
+
+    ~DocidRangePostList();
+
+    Xapian::doccount get_termfreq_min() const;
+
+    Xapian::doccount get_termfreq_est() const;
+
+    Xapian::doccount get_termfreq_max() const;
+
+    Xapian::weight get_maxweight() const;
+
+    Xapian::docid get_docid() const;
+
+    Xapian::weight get_weight() const;
+
+    Xapian::termcount get_doclength() const;
+
+    Xapian::weight recalc_maxweight();
+
+    PostList * next(Xapian::weight w_min);
+
+    PostList * skip_to(Xapian::docid did, Xapian::weight w_min);
+
+    bool at_end() const;
+
+    Xapian::termcount count_matching_subqs() const;
+
+    std::string get_description() const;
+};
+
+#endif // XAPIAN_INCLUDED_DOCIDRANGEPOSTLIST_H
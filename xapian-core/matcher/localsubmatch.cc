@@ -152,3 +152,16 @@ LocalSubMatch::postlist_from_op_leaf_query(const Xapian::Query::Internal *leaf,
 	pl->set_termweight(wt.release());
     RETURN(pl);
 }
+
+void
+LocalSubMatch::register_boolean_term(const string & term)
+{
+    LOGCALL_VOID(MATCH, "LocalSubMatch::register_boolean_term", term);
+    if (term_info) {
+	Xapian::doccount tf = stats->get_termfreq(term);
+	using namespace Xapian;
+	// Make a new entry for the term if there isn't one already.
+	term_info->insert(
+		make_pair(term, MSet::Internal::TermFreqAndWeight(tf)));
+    }
+}
@@ -102,6 +102,13 @@ class LocalSubMatch : public SubMatch {
      */
     PostList * postlist_from_op_leaf_query(const Xapian::Query::Internal *query,
 					   double factor);
+
+    /** Record the statistics for a term used as a boolean filter.
+     *
+     *  postlist_from_op_leaf_query() does this itself, but QueryOptimiser
+     *  calls this when it handles the term another way.
+     */
+    void register_boolean_term(const std::string & term);
 };
 
 #endif /* XAPIAN_INCLUDED_LOCALSUBMATCH_H */
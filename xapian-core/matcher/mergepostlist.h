@@ -68,6 +68,7 @@ class MergePostList : public PostList {
 	Xapian::docid  get_docid() const;
 	Xapian::weight get_weight() const;
 	const string * get_collapse_key() const;
+	const string * get_sort_key() const;
 
 	Xapian::weight get_maxweight() const;
 
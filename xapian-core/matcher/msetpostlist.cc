@@ -90,6 +90,15 @@ MSetPostList::get_collapse_key() const
     RETURN(&mset_internal->items[cursor].collapse_key);
 }
 
+const string *
+MSetPostList::get_sort_key() const
+{
+    LOGCALL(MATCH, const string *, "MSetPostList::get_sort_key", NO_ARGS);
+    Assert(cursor != -1);
+    if (!have_sort_keys) RETURN(NULL);
+    RETURN(&mset_internal->items[cursor].sort_key);
+}
+
 Xapian::termcount
 MSetPostList::get_doclength() const
 {
@@ -34,9 +34,11 @@
 #include "localsubmatch.h"
 #include "omassert.h"
 #include "omenquireinternal.h"
+#include "shardsubmatch.h"
 
 #include "emptypostlist.h"
 #include "branchpostlist.h"
+#include "docidrangepostlist.h"
 #include "mergepostlist.h"
 
 #include "document.h"
@@ -79,6 +81,19 @@ const Xapian::Enquire::Internal::sort_setting VAL_REL =
 	Xapian::Enquire::Internal::VAL_REL;
 #endif
 
+/** Don't split a database into ranges with fewer documents than this.
+ *
+ *  Each range needs its own database handle, so the overhead of opening
+ *  those would outweigh the gain for small databases.
+ */
+const Xapian::doccount MIN_DOCS_PER_RANGE = 5000;
+
+/** How often to check the minimum weight shared with other threads.
+ *
+ *  This is the number of candidate documents between checks.
+ */
+const unsigned SHARED_MIN_WEIGHT_INTERVAL = 64;
+
 /** Split an RSet into several sub rsets, one for each database.
  *
  *  @param rset The RSet to split.
@@ -139,10 +154,11 @@ split_rset_by_db(const Xapian::RSet * rset,
  */
 static void
 prepare_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
+		    const vector<bool> & is_remote,
 		    Xapian::ErrorHandler * errorhandler,
 		    Xapian::Weight::Internal & stats)
 {
-    LOGCALL_STATIC_VOID(MATCH, "prepare_sub_matches", leaves | errorhandler | stats);
+    LOGCALL_STATIC_VOID(MATCH, "prepare_sub_matches", leaves | is_remote | errorhandler | stats);
     // We use a vector<bool> to track which SubMatches we're already prepared.
     vector<bool> prepared;
     prepared.resize(leaves.size(), false);
@@ -168,12 +184,80 @@ prepare_sub_matches(vector<intrusive_ptr<SubMatch> > & leaves,
 		--unprepared;
 	    }
 	}
-	// Use blocking IO on subsequent passes, so that we don't go into
-	// a tight loop.
+	if (!unprepared || !nowait) break;
+
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	// Only remote sub-matches wait for their statistics, so wait for
+	// whichever of those replies first rather than for each in turn.
+	vector<const RemoteDatabase *> dbs;
+	for (size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+	    if (prepared[leaf]) continue;
+	    if (!is_remote[leaf]) {
+		dbs.clear();
+		break;
+	    }
+	    RemoteSubMatch * rem_match;
+	    rem_match = static_cast<RemoteSubMatch*>(leaves[leaf].get());
+	    dbs.push_back(rem_match->get_database());
+	}
+	if (!dbs.empty() && RemoteDatabase::wait_for_replies(dbs)) continue;
+#else
+	(void)is_remote;
+#endif
+	// Use blocking IO on the final pass, which reports any timeouts.
 	nowait = false;
     }
 }
 
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+/** Read the MSets from remote sub-matches as they arrive.
+ *
+ *  This means the time we wait is that for the slowest remote server to
+ *  reply, rather than the sum of the times for all of them.
+ */
+static void
+read_remote_msets(vector<intrusive_ptr<SubMatch> > & leaves,
+		  const vector<bool> & is_remote,
+		  Xapian::ErrorHandler * errorhandler)
+{
+    LOGCALL_STATIC_VOID(MATCH, "read_remote_msets", leaves | is_remote | errorhandler);
+    vector<size_t> waiting;
+    for (size_t leaf = 0; leaf < leaves.size(); ++leaf) {
+	if (is_remote[leaf] && leaves[leaf].get()) waiting.push_back(leaf);
+    }
+    // With only one, get_postlist_and_term_info() might as well wait for it.
+    if (waiting.size() < 2) return;
+
+    bool nowait = true;
+    while (!waiting.empty()) {
+	vector<size_t> still_waiting;
+	vector<const RemoteDatabase *> dbs;
+	vector<size_t>::const_iterator i;
+	for (i = waiting.begin(); i != waiting.end(); ++i) {
+	    RemoteSubMatch * rem_match;
+	    rem_match = static_cast<RemoteSubMatch*>(leaves[*i].get());
+	    try {
+		if (rem_match->read_mset(nowait)) continue;
+	    } catch (Xapian::Error & e) {
+		if (!errorhandler) throw;
+		LOGLINE(EXCEPTION, "Calling error handler for read_mset() on a RemoteSubMatch.");
+		(*errorhandler)(e);
+		// Continue match without this sub-match.
+		leaves[*i] = NULL;
+		continue;
+	    }
+	    still_waiting.push_back(*i);
+	    dbs.push_back(rem_match->get_database());
+	}
+	swap(waiting, still_waiting);
+	// If we time out waiting, use blocking IO on the final pass, which
+	// reports the timeouts.
+	if (!waiting.empty() && !RemoteDatabase::wait_for_replies(dbs))
+	    nowait = false;
+    }
+}
+#endif
+
 /// Class which applies several match spies in turn.
 class MultipleMatchSpy : public Xapian::MatchSpy {
   private:
@@ -218,7 +302,8 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		       Xapian::Weight::Internal & stats,
 		       const Xapian::Weight * weight_,
 		       const vector<Xapian::MatchSpy *> & matchspies_,
-		       bool have_sorter, bool have_mdecider)
+		       bool have_sorter, bool have_mdecider,
+		       ThreadPool * pool)
 	: db(db_), query(query_),
 	  collapse_max(collapse_max_), collapse_key(collapse_key_),
 	  percent_cutoff(percent_cutoff_), weight_cutoff(weight_cutoff_),
@@ -227,9 +312,11 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 	  sort_value_forward(sort_value_forward_),
 	  errorhandler(errorhandler_), weight(weight_),
 	  is_remote(db.internal.size()),
-	  matchspies(matchspies_)
+	  is_matched_separately(db.internal.size()),
+	  matchspies(matchspies_),
+	  range_first_did(0), range_last_did(0), shared_min_weight(NULL)
 {
-    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider);
+    LOGCALL_CTOR(MATCH, "MultiMatch", db_ | query_ | qlen | omrset | collapse_max_ | collapse_key_ | percent_cutoff_ | weight_cutoff_ | int(order_) | sort_key_ | int(sort_by_) | sort_value_forward_ | errorhandler_ | stats | weight_ | matchspies_ | have_sorter | have_mdecider | pool);
 
     if (!query) return;
     query->validate_query();
@@ -238,6 +325,48 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     vector<Xapian::RSet> subrsets;
     split_rset_by_db(omrset, number_of_subdbs, subrsets);
 
+    // If we've been given a thread pool, match each local sub-database on a
+    // worker thread.  Match spies, match deciders, sorters and posting
+    // sources which can't be cloned are user objects which may not be safe
+    // to call from several threads at once, so we don't if any are in use.
+    bool use_threads = false;
+    // The number of docid ranges to split each sub-database into.
+    vector<unsigned> ranges(number_of_subdbs, 1);
+    if (pool && pool->size() && !have_sorter && !have_mdecider &&
+	matchspies.empty() && !has_shared_source(query)) {
+	// Each worker thread must have a sub-database to itself, so give up
+	// if the same one has been added more than once.
+	set<const Xapian::Database::Internal *> local_subdbs;
+	use_threads = true;
+	for (size_t i = 0; i != number_of_subdbs; ++i) {
+	    Xapian::Database::Internal *subdb = db.internal[i].get();
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+	    if (subdb->as_remotedatabase()) continue;
+#endif
+	    if (!local_subdbs.insert(subdb).second) {
+		use_threads = false;
+		break;
+	    }
+	}
+
+	// If there are more threads than local sub-databases, split large
+	// sub-databases into ranges of document ids to use the others.
+	unsigned tasks = 0;
+	if (use_threads && !local_subdbs.empty()) {
+	    unsigned max_ranges = pool->size() / local_subdbs.size();
+	    for (size_t i = 0; i != number_of_subdbs; ++i) {
+		const Xapian::Database::Internal *subdb = db.internal[i].get();
+		if (!local_subdbs.count(subdb)) continue;
+		Xapian::doccount n = subdb->get_doccount() / MIN_DOCS_PER_RANGE;
+		if (n > max_ranges) n = max_ranges;
+		if (n > 1) ranges[i] = n;
+		tasks += ranges[i];
+	    }
+	}
+	// There's no point unless there are several tasks to run at once.
+	if (tasks < 2) use_threads = false;
+    }
+
     for (size_t i = 0; i != number_of_subdbs; ++i) {
 	Xapian::Database::Internal *subdb = db.internal[i].get();
 	Assert(subdb);
@@ -261,15 +390,26 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
 		    (sort_by == REL || sort_by == REL_VAL);
 		smatch = new RemoteSubMatch(rem_db, decreasing_relevance, matchspies);
 		is_remote[i] = true;
+		is_matched_separately[i] = true;
+	    } else
+#endif /* XAPIAN_HAS_REMOTE_BACKEND */
+	    if (use_threads) {
+		// When sorting primarily by relevance, the worker threads can
+		// share the minimum weight needed to make the MSet.
+		SharedMinWeight * shared = NULL;
+		if (sort_by == REL || sort_by == REL_VAL)
+		    shared = &worker_min_weight;
+		smatch = new ShardSubMatch(Xapian::Database(subdb), query, qlen,
+					   subrsets[i], collapse_max,
+					   collapse_key, weight_cutoff,
+					   order, sort_key, sort_by,
+					   sort_value_forward, weight,
+					   matchspies, *pool, ranges[i],
+					   shared);
+		is_matched_separately[i] = true;
 	    } else {
 		smatch = new LocalSubMatch(subdb, query, qlen, subrsets[i], weight);
 	    }
-#else
-	    // Avoid unused parameter warnings.
-	    (void)have_sorter;
-	    (void)have_mdecider;
-	    smatch = new LocalSubMatch(subdb, query, qlen, subrsets[i], weight);
-#endif /* XAPIAN_HAS_REMOTE_BACKEND */
 	} catch (Xapian::Error & e) {
 	    if (!errorhandler) throw;
 	    LOGLINE(EXCEPTION, "Calling error handler for creation of a SubMatch from a database and query.");
@@ -281,10 +421,24 @@ MultiMatch::MultiMatch(const Xapian::Database &db_,
     }
 
     stats.mark_wanted_terms(*query);
-    prepare_sub_matches(leaves, errorhandler, stats);
+    prepare_sub_matches(leaves, is_remote, errorhandler, stats);
     stats.set_bounds_from_db(db);
 }
 
+bool
+MultiMatch::has_shared_source(const Xapian::Query::Internal * query)
+{
+    if (query->op == Xapian::Query::Internal::OP_EXTERNAL_SOURCE) {
+	// If the PostingSource could be cloned, the query owns the clone.
+	return !query->external_source_owned;
+    }
+    Xapian::Query::Internal::subquery_list::const_iterator i;
+    for (i = query->subqs.begin(); i != query->subqs.end(); ++i) {
+	if (has_shared_source(*i)) return true;
+    }
+    return false;
+}
+
 Xapian::weight
 MultiMatch::getorrecalc_maxweight(PostList *pl)
 {
@@ -353,6 +507,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	}
     }
 
+#ifdef XAPIAN_HAS_REMOTE_BACKEND
+    read_remote_msets(leaves, is_remote, errorhandler);
+#endif
+
     // Get postlists and term info
     vector<PostList *> postlists;
     map<string, Xapian::MSet::Internal::TermFreqAndWeight> termfreqandwts;
@@ -367,18 +525,23 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount definite_matches_not_seen = 0;
     for (size_t i = 0; i != leaves.size(); ++i) {
 	PostList *pl;
+	if (!leaves[i].get()) {
+	    // This sub-match failed and the error handler let us continue.
+	    postlists.push_back(new EmptyPostList);
+	    continue;
+	}
 	try {
 	    pl = leaves[i]->get_postlist_and_term_info(this,
 						       termfreqandwts_ptr,
 						       &total_subqs);
 	    if (termfreqandwts_ptr && !termfreqandwts.empty())
 		termfreqandwts_ptr = NULL;
-	    if (is_remote[i]) {
+	    if (is_matched_separately[i]) {
 		if (pl->get_termfreq_min() > first + maxitems) {
 		    LOGLINE(MATCH, "Found " <<
 				   pl->get_termfreq_min() - (first + maxitems)
-				   << " definite matches in remote submatch "
-				   "which aren't passed to local match");
+				   << " definite matches in separate submatch "
+				   "which aren't passed to this match");
 		    definite_matches_not_seen += pl->get_termfreq_min();
 		    definite_matches_not_seen -= first + maxitems;
 		}
@@ -409,6 +572,14 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	pl.reset(new MergePostList(postlists, this, vsdoc, errorhandler));
     }
 
+    if (range_first_did) {
+	// Only match documents in our range of document ids.
+	Assert(postlists.size() == 1);
+	pl.reset(new DocidRangePostList(pl.release(),
+					range_first_did, range_last_did,
+					db.get_lastdocid(), this));
+    }
+
     LOGLINE(MATCH, "pl = (" << pl->get_description() << ")");
 
 #ifdef XAPIAN_DEBUG_LOG
@@ -424,9 +595,7 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     Xapian::doccount docs_matched = 0;
     Xapian::weight greatest_wt = 0;
     Xapian::termcount greatest_wt_subqs_matched = 0;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
     unsigned greatest_wt_subqs_db_num = UINT_MAX;
-#endif
     vector<Xapian::Internal::MSetItem> items;
 
     // maximum weight a document could possibly have
@@ -529,9 +698,31 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
     // Is the mset a valid heap?
     bool is_heap = false;
 
+    // Countdown to next checking shared_min_weight.
+    unsigned shared_min_weight_countdown = SHARED_MIN_WEIGHT_INTERVAL;
+
+    // Have we skipped documents because of shared_min_weight?  If so, we
+    // haven't seen all the matches, even if the proto-mset isn't full.
+    bool used_shared_min_weight = false;
+
     while (true) {
 	bool pushback;
 
+	if (shared_min_weight && rare(--shared_min_weight_countdown == 0)) {
+	    shared_min_weight_countdown = SHARED_MIN_WEIGHT_INTERVAL;
+	    Xapian::weight w = shared_min_weight->get();
+	    if (w > min_weight) {
+		LOGLINE(MATCH, "Setting min_weight to " << w <<
+			       " from " << min_weight << " (shared)");
+		min_weight = w;
+		used_shared_min_weight = true;
+		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
+		    LOGLINE(MATCH, "*** TERMINATING EARLY (4)");
+		    break;
+		}
+	    }
+	}
+
 	if (rare(recalculate_w_max)) {
 	    if (min_weight > 0.0) {
 		if (rare(getorrecalc_maxweight(pl.get()) < min_weight)) {
@@ -582,7 +773,12 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	LOGLINE(MATCH, "Candidate document id " << did << " wt " << wt);
 	Xapian::Internal::MSetItem new_item(wt, did);
 	if (sort_by != REL) {
-	    if (sorter) {
+	    const string * key = pl->get_sort_key();
+	    if (key) {
+		// The MSet from a worker thread has the sort keys, and we can't
+		// read them via vsdoc since it needs ascending docids.
+		new_item.sort_key = *key;
+	    } else if (sorter) {
 		new_item.sort_key = (*sorter)(doc);
 	    } else {
 		new_item.sort_key = vsdoc.get_value(sort_key);
@@ -625,9 +821,10 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	    const unsigned int multiplier = db.internal.size();
 	    Assert(multiplier != 0);
 	    Xapian::doccount n = (did - 1) % multiplier; // which actual database
-	    // If the results are from a remote database, then the functor will
-	    // already have been applied there so we can skip this step.
-	    if (!is_remote[n]) {
+	    // If the results are from a database which was matched separately
+	    // (e.g. a remote database), then the functor will already have
+	    // been applied there so we can skip this step.
+	    if (!is_matched_separately[n]) {
 		++decider_considered;
 		if (mdecider && !mdecider->operator()(doc)) {
 		    ++decider_denied;
@@ -739,6 +936,13 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 			    LOGLINE(MATCH, "Setting min_weight to " <<
 				    min_item.wt << " from " << min_weight);
 			    min_weight = min_item.wt;
+			    if (shared_min_weight) {
+				// Tell the other threads, and see if they've
+				// found a higher minimum.
+				min_weight = shared_min_weight->raise(min_weight);
+				if (min_weight > min_item.wt)
+				    used_shared_min_weight = true;
+			    }
 			}
 		    }
 		}
@@ -771,20 +975,15 @@ MultiMatch::get_mset(Xapian::doccount first, Xapian::doccount maxitems,
 	if (wt > greatest_wt) {
 new_greatest_weight:
 	    greatest_wt = wt;
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	    const unsigned int multiplier = db.internal.size();
 	    unsigned int db_num = (did - 1) % multiplier;
-	    if (is_remote[db_num]) {
-		// Note that the greatest weighted document came from a remote
-		// database, and which one.
+	    if (is_matched_separately[db_num]) {
+		// Note that the greatest weighted document came from a
+		// database which was matched separately, and which one.
 		greatest_wt_subqs_db_num = db_num;
-	    } else
-#endif
-	    {
+	    } else {
 		greatest_wt_subqs_matched = pl->count_matching_subqs();
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 		greatest_wt_subqs_db_num = UINT_MAX;
-#endif
 	    }
 	    if (percent_cutoff) {
 		Xapian::weight w = wt * percent_cutoff_factor;
@@ -822,15 +1021,10 @@ new_greatest_weight:
 	vector<Xapian::Internal::MSetItem>::const_iterator best;
 	best = min_element(items.begin(), items.end(), mcmp);
 
-#ifdef XAPIAN_HAS_REMOTE_BACKEND
 	if (greatest_wt_subqs_db_num != UINT_MAX) {
 	    const unsigned int n = greatest_wt_subqs_db_num;
-	    RemoteSubMatch * rem_match;
-	    rem_match = static_cast<RemoteSubMatch*>(leaves[n].get());
-	    percent_scale = rem_match->get_percent_factor() / 100.0;
-	} else
-#endif
-	{
+	    percent_scale = leaves[n]->get_percent_factor() / 100.0;
+	} else {
 	    percent_scale = greatest_wt_subqs_matched / double(total_subqs);
 	    percent_scale /= greatest_wt;
 	}
@@ -876,7 +1070,7 @@ new_greatest_weight:
     Xapian::doccount uncollapsed_lower_bound = matches_lower_bound;
     Xapian::doccount uncollapsed_upper_bound = matches_upper_bound;
     Xapian::doccount uncollapsed_estimated = matches_estimated;
-    if (items.size() < max_msize) {
+    if (items.size() < max_msize && !used_shared_min_weight) {
 	// We have fewer items in the mset than we tried to get for it, so we
 	// must have all the matches in it.
 	LOGLINE(MATCH, "items.size() = " << items.size() <<
@@ -887,7 +1081,8 @@ new_greatest_weight:
 	    = items.size();
 	if (collapser && matches_lower_bound > uncollapsed_lower_bound)
 	    uncollapsed_lower_bound = matches_lower_bound;
-    } else if (!collapser && docs_matched < check_at_least) {
+    } else if (!collapser && docs_matched < check_at_least &&
+	       !used_shared_min_weight) {
 	// We have seen fewer matches than we checked for, so we must have seen
 	// all the matches.
 	LOGLINE(MATCH, "Setting bounds equal");
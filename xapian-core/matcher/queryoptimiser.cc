@@ -25,8 +25,11 @@
 
 #include "andmaybepostlist.h"
 #include "andnotpostlist.h"
+#include "bitmappostlist.h"
+#include "branchpostlist.h"
 #include "const_database_wrapper.h"
 #include "debuglog.h"
+#include "docidlistpostlist.h"
 #include "emptypostlist.h"
 #include "exactphrasepostlist.h"
 #include "externalpostlist.h"
@@ -38,6 +41,7 @@
 #include "orpostlist.h"
 #include "phrasepostlist.h"
 #include "postlist.h"
+#include "str.h"
 #include "valuegepostlist.h"
 #include "valuerangepostlist.h"
 
@@ -48,6 +52,10 @@
 
 using namespace std;
 
+template<class CLASS> struct delete_ptr {
+    void operator()(CLASS *p) { delete p; }
+};
+
 PostList *
 QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor)
 {
@@ -56,6 +64,12 @@ QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor
     // Handle QueryMatchNothing.
     if (!query) RETURN(new EmptyPostList);
 
+    if (factor == 0.0) {
+	// For a boolean subquery, use the stored bitmaps if we can.
+	DocidBitmap * bitmap = do_bitmap(query);
+	if (bitmap) RETURN(new BitmapPostList(bitmap, db_size));
+    }
+
     switch (query->op) {
 	case Xapian::Query::Internal::OP_LEAF:
 	    if (factor != 0.0) {
@@ -122,6 +136,8 @@ QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor
 		 range_begin > db.get_value_upper_bound(slot))) {
 		RETURN(new EmptyPostList);
 	    }
+	    PostList * pl = do_value_index(slot, range_begin, range_end);
+	    if (pl) RETURN(pl);
 	    RETURN(new ValueRangePostList(&db, slot, range_begin, range_end));
 	}
 
@@ -135,6 +151,8 @@ QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor
 		range_begin > db.get_value_upper_bound(slot)) {
 		RETURN(new EmptyPostList);
 	    }
+	    PostList * pl = do_value_index(slot, range_begin, string());
+	    if (pl) RETURN(pl);
 	    RETURN(new ValueGePostList(&db, slot, range_begin));
 	}
 
@@ -146,6 +164,8 @@ QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor
 	    if (range_end < db.get_value_lower_bound(slot)) {
 		RETURN(new EmptyPostList);
 	    }
+	    PostList * pl = do_value_index(slot, string(), range_end);
+	    if (pl) RETURN(pl);
 	    RETURN(new ValueRangePostList(&db, slot, string(), range_end));
 	}
 
@@ -162,6 +182,144 @@ QueryOptimiser::do_subquery(const Xapian::Query::Internal * query, double factor
     }
 }
 
+PostList *
+QueryOptimiser::do_value_index(Xapian::valueno slot,
+			       const string & begin, const string & end)
+{
+    LOGCALL(MATCH, PostList *, "QueryOptimiser::do_value_index", slot | begin | end);
+    // Each index entry is read separately, so if a large proportion of the
+    // documents match, scanning the value stream is likely to be cheaper -
+    // and then giving up after this many entries costs no more than a part
+    // of that scan.
+    Xapian::doccount limit = db_size / 8;
+    vector<Xapian::docid> dids;
+    if (!db.get_value_range_docids(slot, begin, end, limit, dids))
+	RETURN(NULL);
+    string desc = str(slot);
+    desc += ", ";
+    desc += begin;
+    desc += ", ";
+    desc += end;
+    RETURN(new DocidListPostList(dids, db_size, desc));
+}
+
+DocidBitmap *
+QueryOptimiser::do_bitmap(const Xapian::Query::Internal * query)
+{
+    LOGCALL(MATCH, DocidBitmap *, "QueryOptimiser::do_bitmap", query);
+    if (!query) RETURN(NULL);
+
+    switch (query->op) {
+	case Xapian::Query::Internal::OP_LEAF: {
+	    const string & term = query->tname;
+	    if (term.empty()) RETURN(NULL);
+	    DocidBitmap * bitmap = db.open_docid_bitmap(term);
+	    if (bitmap) localsubmatch.register_boolean_term(term);
+	    RETURN(bitmap);
+	}
+
+	case Xapian::Query::OP_AND:
+	case Xapian::Query::OP_FILTER:
+	case Xapian::Query::OP_OR:
+	case Xapian::Query::OP_SYNONYM: {
+	    // Give up as soon as we find a subquery we can't convert, so we
+	    // don't open bitmaps we won't use.
+	    const Xapian::Query::Internal::subquery_list & queries = query->subqs;
+	    vector<DocidBitmap *> bitmaps;
+	    bitmaps.reserve(queries.size());
+	    Xapian::Query::Internal::subquery_list::const_iterator q;
+	    for (q = queries.begin(); q != queries.end(); ++q) {
+		DocidBitmap * bitmap = do_bitmap(*q);
+		if (!bitmap) {
+		    for_each(bitmaps.begin(), bitmaps.end(),
+			     delete_ptr<DocidBitmap>());
+		    RETURN(NULL);
+		}
+		bitmaps.push_back(bitmap);
+	    }
+	    if (query->op == Xapian::Query::OP_OR ||
+		query->op == Xapian::Query::OP_SYNONYM) {
+		RETURN(new OrDocidBitmap(bitmaps, db_size));
+	    }
+	    RETURN(new AndDocidBitmap(bitmaps, db_size));
+	}
+
+	case Xapian::Query::OP_AND_NOT: {
+	    AssertEq(query->subqs.size(), 2);
+	    AutoPtr<DocidBitmap> l(do_bitmap(query->subqs[0]));
+	    if (!l.get()) RETURN(NULL);
+	    DocidBitmap * r = do_bitmap(query->subqs[1]);
+	    if (!r) RETURN(NULL);
+	    RETURN(new AndNotDocidBitmap(l.release(), r, db_size));
+	}
+
+	case Xapian::Query::OP_SCALE_WEIGHT:
+	    AssertEq(query->subqs.size(), 1);
+	    RETURN(do_bitmap(query->subqs[0]));
+
+	default:
+	    RETURN(NULL);
+    }
+}
+
+bool
+QueryOptimiser::get_filter_terms(const Xapian::Query::Internal * query,
+				 vector<string> & terms)
+{
+    if (query->op == Xapian::Query::Internal::OP_LEAF) {
+	terms.push_back(query->tname);
+	return true;
+    }
+    if (query->op == Xapian::Query::Internal::OP_EXTERNAL_SOURCE)
+	return false;
+    Xapian::Query::Internal::subquery_list::const_iterator q;
+    for (q = query->subqs.begin(); q != query->subqs.end(); ++q) {
+	if (!get_filter_terms(*q, terms)) return false;
+    }
+    return true;
+}
+
+PostList *
+QueryOptimiser::do_cached_filter(const Xapian::Query::Internal * query)
+{
+    LOGCALL(MATCH, PostList *, "QueryOptimiser::do_cached_filter", query);
+    vector<string> terms;
+    if (!get_filter_terms(query, terms)) RETURN(NULL);
+
+    string key = query->serialise();
+    Xapian::Internal::intrusive_ptr<const DocidList> list;
+    list = db.filter_cache.find(key);
+    if (list.get()) {
+	// Note the terms' statistics, as running the filter would have.
+	vector<string>::const_iterator t;
+	for (t = terms.begin(); t != terms.end(); ++t) {
+	    localsubmatch.register_boolean_term(*t);
+	}
+    } else {
+	PostList * pl = do_subquery(query, 0.0);
+	// Don't read all the documents if there could be too many to cache.
+	if (!db.filter_cache.fits(key, pl->get_termfreq_max())) RETURN(pl);
+	DocidList * new_list = new DocidList;
+	list = new_list;
+	try {
+	    // The maxweights need initialising before we start iterating.
+	    (void)pl->recalc_maxweight();
+	    while (true) {
+		(void)next_handling_prune(pl, 0.0, NULL);
+		if (pl->at_end()) break;
+		new_list->dids.push_back(pl->get_docid());
+	    }
+	} catch (...) {
+	    delete pl;
+	    throw;
+	}
+	delete pl;
+	db.filter_cache.add(key, new_list);
+    }
+    RETURN(new DocidListPostList(list.get(), db_size,
+				 query->get_description()));
+}
+
 struct PosFilter {
     PosFilter(Xapian::Query::Internal::op_t op_, size_t begin_, size_t end_,
 	      Xapian::termcount window_)
@@ -182,11 +340,26 @@ QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor)
 
     list<PosFilter> pos_filters;
     vector<PostList *> plists;
-    do_and_like(query, factor, plists, pos_filters);
-    AssertRel(plists.size(), >=, 2);
+    vector<DocidBitmap *> bitmaps;
+    do_and_like(query, factor, plists, bitmaps, pos_filters);
+
+    // Intersect all the boolean subqueries we have bitmaps for a word at a
+    // time, and then filter the rest of the query with the result.
+    if (bitmaps.size() == 1) {
+	plists.push_back(new BitmapPostList(bitmaps[0], db_size));
+    } else if (!bitmaps.empty()) {
+	plists.push_back(new BitmapPostList(new AndDocidBitmap(bitmaps, db_size),
+					    db_size));
+    }
+    AssertRel(plists.size(), >=, 1);
 
     PostList * pl;
-    pl = new MultiAndPostList(plists.begin(), plists.end(), matcher, db_size);
+    if (plists.size() == 1) {
+	pl = plists[0];
+    } else {
+	pl = new MultiAndPostList(plists.begin(), plists.end(), matcher,
+				  db_size);
+    }
 
     // Sort the positional filters to try to apply them in an efficient order.
     // FIXME: We need to figure out what that is!  Try applying lowest cf/tf
@@ -223,9 +396,10 @@ inline bool is_and_like(Xapian::Query::Internal::op_t op) {
 void
 QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor,
 			    vector<PostList *> & and_plists,
+			    vector<DocidBitmap *> & and_bitmaps,
 			    list<PosFilter> & pos_filters)
 {
-    LOGCALL_VOID(MATCH, "QueryOptimiser::do_and_like", query | factor | and_plists | pos_filters);
+    LOGCALL_VOID(MATCH, "QueryOptimiser::do_and_like", query | factor | and_plists | and_bitmaps | pos_filters);
 
     Xapian::Query::Internal::op_t op = query->op;
     Assert(is_and_like(op));
@@ -250,8 +424,25 @@ QueryOptimiser::do_and_like(const Xapian::Query::Internal *query, double factor,
 	if (i == 1 && op == Xapian::Query::OP_FILTER) factor = 0.0;
 
 	const Xapian::Query::Internal * subq = queries[i];
+	if (i != 0 && op == Xapian::Query::OP_FILTER &&
+	    db.filter_cache.enabled()) {
+	    PostList * pl = do_cached_filter(subq);
+	    if (pl) {
+		and_plists.push_back(pl);
+		continue;
+	    }
+	}
+	if (factor == 0.0 && !positional) {
+	    // The positional filters need a PostList for each subquery, but
+	    // otherwise we can combine boolean subqueries as bitmaps.
+	    DocidBitmap * bitmap = do_bitmap(subq);
+	    if (bitmap) {
+		and_bitmaps.push_back(bitmap);
+		continue;
+	    }
+	}
 	if (is_and_like(subq->op)) {
-	    do_and_like(subq, factor, and_plists, pos_filters);
+	    do_and_like(subq, factor, and_plists, and_bitmaps, pos_filters);
 	} else {
 	    PostList * pl = do_subquery(subq, factor);
 	    and_plists.push_back(pl);
@@ -316,10 +507,6 @@ struct CmpMaxOrTerms {
     }
 };
 
-template<class CLASS> struct delete_ptr {
-    void operator()(CLASS *p) { delete p; }
-};
-
 /// Comparison functor which orders PostList* by descending get_termfreq_est().
 struct ComparePostListTermFreqAscending {
     /// Order by descending get_termfreq_est().
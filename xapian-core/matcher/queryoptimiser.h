@@ -32,6 +32,7 @@
 #include <list>
 #include <vector>
 
+class DocidBitmap;
 class MultiMatch;
 struct PosFilter;
 
@@ -78,11 +79,14 @@ class QueryOptimiser {
      *  @param factor	    How much to scale weights for this subtree by.
      *  @param and_plists   Append new PostList subtrees to be combined with
      *			    AND to this vector.
+     *  @param and_bitmaps  Append new DocidBitmap objects for boolean
+     *			    subtrees to be combined with AND to this vector.
      *  @param pos_filters  Append any positional filters to be applied to the
      *                      tree to this list.
      */
     void do_and_like(const Xapian::Query::Internal *query, double factor,
 		     std::vector<PostList *> & and_plists,
+		     std::vector<DocidBitmap *> & and_bitmaps,
 		     std::list<PosFilter> & pos_filters);
 
     /** Optimise an OR-like Xapian::Query::Internal subtree into a PostList
@@ -104,6 +108,56 @@ class QueryOptimiser {
      */
     PostList * do_synonym(const Xapian::Query::Internal *query, double factor);
 
+    /** Convert a boolean Xapian::Query::Internal subtree into a DocidBitmap.
+     *
+     *  This is possible if every term in the subtree has a bitmap stored
+     *  and the only operators are AND, FILTER, OR and AND_NOT.
+     *
+     *  @param query	The subtree to convert.
+     *
+     *  @return		A new DocidBitmap, or NULL if the subtree can't be
+     *			converted.
+     */
+    DocidBitmap * do_bitmap(const Xapian::Query::Internal * query);
+
+    /** Find the terms in a filter subquery.
+     *
+     *  @param query	The subquery.
+     *  @param terms	Vector to append the terms to.
+     *
+     *  @return		false if the subquery contains an external posting
+     *			source, so can't be cached.
+     */
+    static bool get_filter_terms(const Xapian::Query::Internal * query,
+				 std::vector<std::string> & terms);
+
+    /** Use the filter cache for a filter subquery.
+     *
+     *  If the documents matching @a query aren't cached, they are found
+     *  and added to the cache.
+     *
+     *  @param query	The subquery.
+     *
+     *  @return		A PostList of the matching documents, or NULL if
+     *			@a query can't be cached (because it contains an
+     *			external posting source).
+     */
+    PostList * do_cached_filter(const Xapian::Query::Internal * query);
+
+    /** Find the documents matching a value range using a value index.
+     *
+     *  @param slot	The value slot.
+     *  @param begin	The start of the range.
+     *  @param end	The end of the range, or empty for no upper limit.
+     *
+     *  @return		A PostList of the matching documents, or NULL if
+     *			there's no index for @a slot or the range matches
+     *			too many documents for using it to be worthwhile.
+     */
+    PostList * do_value_index(Xapian::valueno slot,
+			      const std::string & begin,
+			      const std::string & end);
+
   public:
     QueryOptimiser(const Xapian::Database::Internal & db_,
 		   LocalSubMatch & localsubmatch_,
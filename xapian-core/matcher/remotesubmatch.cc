@@ -33,7 +33,7 @@ RemoteSubMatch::RemoteSubMatch(RemoteDatabase *db_,
 			       const vector<Xapian::MatchSpy *> & matchspies_)
 	: db(db_),
 	  decreasing_relevance(decreasing_relevance_),
-	  matchspies(matchspies_)
+	  matchspies(matchspies_), have_mset(false)
 {
     LOGCALL_CTOR(MATCH, "RemoteSubMatch", db_ | decreasing_relevance_ | matchspies_);
 }
@@ -56,21 +56,33 @@ RemoteSubMatch::start_match(Xapian::doccount first,
 			    const Xapian::Weight::Internal & total_stats)
 {
     LOGCALL_VOID(MATCH, "RemoteSubMatch::start_match", first | maxitems | check_at_least | total_stats);
+    have_mset = false;
     db->send_global_stats(first, maxitems, check_at_least, total_stats);
 }
 
+bool
+RemoteSubMatch::read_mset(bool nowait)
+{
+    LOGCALL(MATCH, bool, "RemoteSubMatch::read_mset", nowait);
+    if (!have_mset) {
+	if (nowait && !db->reply_ready()) RETURN(false);
+	db->get_mset(remote_mset, matchspies);
+	have_mset = true;
+    }
+    RETURN(true);
+}
+
 PostList *
 RemoteSubMatch::get_postlist_and_term_info(MultiMatch *,
 	map<string, Xapian::MSet::Internal::TermFreqAndWeight> * termfreqandwts,
 	Xapian::termcount * total_subqs_ptr)
 {
     LOGCALL(MATCH, PostList *, "RemoteSubMatch::get_postlist_and_term_info", Literal("[matcher]") | termfreqandwts | total_subqs_ptr);
-    Xapian::MSet mset;
-    db->get_mset(mset, matchspies);
-    percent_factor = mset.internal->percent_factor;
-    if (termfreqandwts) *termfreqandwts = mset.internal->termfreqandwts;
+    (void)read_mset(false);
+    percent_factor = remote_mset.internal->percent_factor;
+    if (termfreqandwts) *termfreqandwts = remote_mset.internal->termfreqandwts;
     // For remote databases we report percent_factor rather than counting the
     // number of subqueries.
     (void)total_subqs_ptr;
-    return new MSetPostList(mset, decreasing_relevance);
+    return new MSetPostList(remote_mset, decreasing_relevance);
 }
@@ -53,6 +53,12 @@ class RemoteSubMatch : public SubMatch {
     /// The matchspies to use.
     const vector<Xapian::MatchSpy *> & matchspies;
 
+    /// The MSet, if read_mset() has read it.
+    Xapian::MSet remote_mset;
+
+    /// True if read_mset() has read the MSet.
+    bool have_mset;
+
   public:
     /// Constructor.
     RemoteSubMatch(RemoteDatabase *db_,
@@ -68,6 +74,15 @@ class RemoteSubMatch : public SubMatch {
 		     Xapian::doccount check_at_least,
 		     const Xapian::Weight::Internal & total_stats);
 
+    /** Read the MSet from the remote server.
+     *
+     *  @param nowait	If true, return false rather than waiting if the
+     *			remote server hasn't started to send the MSet yet.
+     *
+     *  @return	true if the MSet has been read.
+     */
+    bool read_mset(bool nowait);
+
     /// Get PostList and term info.
     PostList * get_postlist_and_term_info(MultiMatch *matcher,
 	std::map<std::string,
@@ -77,6 +92,9 @@ class RemoteSubMatch : public SubMatch {
     /// Get percentage factor - only valid after get_postlist_and_term_info().
     double get_percent_factor() const { return percent_factor; }
 
+    /// The remote database.
+    const RemoteDatabase * get_database() const { return db; }
+
     /// Short-cut for single remote match.
     void get_mset(Xapian::MSet & mset) { db->get_mset(mset, matchspies); }
 };
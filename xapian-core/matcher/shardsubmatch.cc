@@ -0,0 +1,253 @@
+/** @file shardsubmatch.cc
+ *  @brief SubMatch class which matches a local database on a worker thread.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <config.h>
+
+#include "shardsubmatch.h"
+
+#include "debuglog.h"
+#include "msetcmp.h"
+#include "msetpostlist.h"
+#include "omassert.h"
+
+#include <algorithm>
+
+using namespace std;
+
+void
+ShardSubMatch::RangeMatch::run()
+{
+    LOGCALL_VOID(MATCH, "ShardSubMatch::RangeMatch::run", NO_ARGS);
+    match->get_mset(submatch.first, submatch.maxitems,
+		    submatch.check_at_least, mset, total_stats, NULL, NULL);
+}
+
+ShardSubMatch::ShardSubMatch(const Xapian::Database & db,
+			     const Xapian::Query::Internal * query,
+			     Xapian::termcount qlen,
+			     const Xapian::RSet & rset,
+			     Xapian::doccount collapse_max_,
+			     Xapian::valueno collapse_key,
+			     Xapian::weight weight_cutoff,
+			     Xapian::Enquire::docid_order order,
+			     Xapian::valueno sort_key,
+			     Xapian::Enquire::Internal::sort_setting sort_by_,
+			     bool sort_value_forward_,
+			     const Xapian::Weight * weight,
+			     const vector<Xapian::MatchSpy *> & matchspies,
+			     ThreadPool & pool_,
+			     unsigned n_ranges,
+			     SharedMinWeight * shared_min_weight)
+	: pool(pool_), collapse_max(collapse_max_), sort_by(sort_by_),
+	  sort_forward(order != Xapian::Enquire::DESCENDING),
+	  sort_value_forward(sort_value_forward_),
+	  decreasing_relevance(sort_by == Xapian::Enquire::Internal::REL ||
+			       sort_by == Xapian::Enquire::Internal::REL_VAL),
+	  percent_factor(0)
+{
+    LOGCALL_CTOR(MATCH, "ShardSubMatch", db | query | qlen | rset | collapse_max_ | collapse_key | weight_cutoff | int(order) | sort_key | int(sort_by_) | sort_value_forward_ | weight | matchspies | Literal("pool") | n_ranges | shared_min_weight);
+    Assert(matchspies.empty());
+    Assert(db.internal.size() == 1);
+
+    // Each range needs its own handle on the database.
+    vector<Xapian::Database> dbs(1, db);
+    while (dbs.size() < n_ranges) {
+	Xapian::Database::Internal * handle;
+	handle = db.internal[0]->open_concurrent_reader();
+	if (!handle) break;
+	dbs.push_back(Xapian::Database(handle));
+    }
+
+    Xapian::docid last_did = db.get_lastdocid();
+    try {
+	for (size_t i = 0; i != dbs.size(); ++i) {
+	    ranges.push_back(new RangeMatch(*this, dbs[i]));
+	    RangeMatch & range = *ranges.back();
+	    // Errors are reported to our caller, which passes them to its
+	    // ErrorHandler if it has one.  We don't apply any percentage cutoff
+	    // since that depends on the best match in the whole collection -
+	    // our caller applies it when merging.
+	    range.match.reset(new MultiMatch(range.db, query, qlen, &rset,
+					     collapse_max, collapse_key, 0,
+					     weight_cutoff, order, sort_key,
+					     sort_by, sort_value_forward,
+					     NULL, range.local_stats, weight,
+					     matchspies, false, false, NULL));
+	    if (dbs.size() > 1) {
+		Xapian::docid first_did = 1 + Xapian::docid(double(last_did) * i / dbs.size());
+		Xapian::docid range_last_did = Xapian::docid(double(last_did) * (i + 1) / dbs.size());
+		range.match->set_docid_range(first_did, range_last_did);
+	    }
+	    range.match->set_shared_min_weight(shared_min_weight);
+	}
+    } catch (...) {
+	vector<RangeMatch *>::const_iterator i;
+	for (i = ranges.begin(); i != ranges.end(); ++i) delete *i;
+	throw;
+    }
+}
+
+ShardSubMatch::~ShardSubMatch()
+{
+    LOGCALL_DTOR(MATCH, "ShardSubMatch");
+    // The matches must finish before we destroy the objects they use.
+    wait_for_ranges();
+    vector<RangeMatch *>::const_iterator i;
+    for (i = ranges.begin(); i != ranges.end(); ++i) delete *i;
+}
+
+void
+ShardSubMatch::wait_for_ranges()
+{
+    vector<RangeMatch *>::const_iterator i;
+    for (i = ranges.begin(); i != ranges.end(); ++i) {
+	if ((*i)->running) {
+	    (*i)->running = false;
+	    try {
+		pool.wait(*i);
+	    } catch (...) {
+	    }
+	}
+    }
+}
+
+bool
+ShardSubMatch::prepare_match(bool nowait,
+			     Xapian::Weight::Internal & total_stats_)
+{
+    LOGCALL(MATCH, bool, "ShardSubMatch::prepare_match", nowait | total_stats_);
+    (void)nowait;
+    // The MultiMatch constructor gathered our statistics.  Each range has
+    // the statistics for the whole sub-database, so only count them once.
+    total_stats_ += ranges[0]->local_stats;
+    RETURN(true);
+}
+
+void
+ShardSubMatch::start_match(Xapian::doccount first_,
+			   Xapian::doccount maxitems_,
+			   Xapian::doccount check_at_least_,
+			   const Xapian::Weight::Internal & total_stats_)
+{
+    LOGCALL_VOID(MATCH, "ShardSubMatch::start_match", first_ | maxitems_ | check_at_least_ | total_stats_);
+    first = first_;
+    maxitems = maxitems_;
+    check_at_least = check_at_least_;
+
+    vector<RangeMatch *>::const_iterator i;
+    for (i = ranges.begin(); i != ranges.end(); ++i) {
+	RangeMatch & range = **i;
+	Assert(!range.running);
+	// Copy the statistics member by member - copying total_stats_.db would
+	// update the reference counts of sub-databases which other worker
+	// threads may already be using.  The bounds from this range's database
+	// are valid bounds for the documents it contains.
+	range.total_stats.total_length = total_stats_.total_length;
+	range.total_stats.collection_size = total_stats_.collection_size;
+	range.total_stats.rset_size = total_stats_.rset_size;
+	range.total_stats.termfreqs = total_stats_.termfreqs;
+	range.total_stats.set_bounds_from_db(range.db);
+    }
+
+    for (i = ranges.begin(); i != ranges.end(); ++i) {
+	(*i)->running = true;
+	pool.start(*i);
+    }
+}
+
+Xapian::MSet
+ShardSubMatch::combine_msets() const
+{
+    LOGCALL(MATCH, Xapian::MSet, "ShardSubMatch::combine_msets", NO_ARGS);
+    if (ranges.size() == 1) RETURN(ranges[0]->mset);
+
+    // The ranges don't overlap, so we can add up most of the counts.
+    // When collapsing, several ranges may contain documents with the same
+    // collapse key, so the lower bound is the largest of those for the
+    // ranges.
+    Xapian::doccount lower = 0, est = 0, upper = 0;
+    Xapian::doccount uncollapsed_lower = 0, uncollapsed_est = 0;
+    Xapian::doccount uncollapsed_upper = 0;
+    Xapian::weight max_possible = 0, max_attained = 0;
+    double factor = 0;
+    vector<Xapian::Internal::MSetItem> items;
+    vector<RangeMatch *>::const_iterator i;
+    for (i = ranges.begin(); i != ranges.end(); ++i) {
+	const Xapian::MSet::Internal & m = *((*i)->mset.internal);
+	if (collapse_max) {
+	    lower = max(lower, m.matches_lower_bound);
+	} else {
+	    lower += m.matches_lower_bound;
+	}
+	est += m.matches_estimated;
+	upper += m.matches_upper_bound;
+	uncollapsed_lower += m.uncollapsed_lower_bound;
+	uncollapsed_est += m.uncollapsed_estimated;
+	uncollapsed_upper += m.uncollapsed_upper_bound;
+	max_possible = max(max_possible, m.max_possible);
+	// The percentages are relative to the best match.
+	if (m.max_attained > max_attained || factor == 0) {
+	    max_attained = max(max_attained, m.max_attained);
+	    factor = m.percent_factor;
+	}
+	items.insert(items.end(), m.items.begin(), m.items.end());
+    }
+    est = max(min(est, upper), lower);
+
+    // Sort the combined items, and keep only as many as we were asked for.
+    sort(items.begin(), items.end(),
+	 MSetCmp(get_msetcmp_function(sort_by, sort_forward,
+				       sort_value_forward)));
+    if (items.size() > first + maxitems)
+	items.erase(items.begin() + (first + maxitems), items.end());
+
+    RETURN(Xapian::MSet(new Xapian::MSet::Internal(
+			0, upper, lower, est,
+			uncollapsed_upper, uncollapsed_lower, uncollapsed_est,
+			max_possible, max_attained, items,
+			ranges[0]->mset.internal->termfreqandwts, factor)));
+}
+
+PostList *
+ShardSubMatch::get_postlist_and_term_info(MultiMatch *,
+	map<string, Xapian::MSet::Internal::TermFreqAndWeight> * termfreqandwts,
+	Xapian::termcount * total_subqs_ptr)
+{
+    LOGCALL(MATCH, PostList *, "ShardSubMatch::get_postlist_and_term_info", Literal("[matcher]") | termfreqandwts | total_subqs_ptr);
+    vector<RangeMatch *>::const_iterator i;
+    for (i = ranges.begin(); i != ranges.end(); ++i) {
+	Assert((*i)->running);
+	(*i)->running = false;
+	try {
+	    pool.wait(*i);
+	} catch (...) {
+	    // Don't leave the other matches running.
+	    wait_for_ranges();
+	    throw;
+	}
+    }
+    Xapian::MSet mset = combine_msets();
+    percent_factor = mset.internal->percent_factor;
+    if (termfreqandwts) *termfreqandwts = mset.internal->termfreqandwts;
+    // As for remote databases, we report percent_factor rather than counting
+    // the number of subqueries.
+    (void)total_subqs_ptr;
+    RETURN(new MSetPostList(mset, decreasing_relevance, true));
+}
@@ -0,0 +1,183 @@
+/** @file shardsubmatch.h
+ *  @brief SubMatch class which matches a local database on a worker thread.
+ */
+/* Copyright (C) 2026 The Xapian contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef XAPIAN_INCLUDED_SHARDSUBMATCH_H
+#define XAPIAN_INCLUDED_SHARDSUBMATCH_H
+
+#include "autoptr.h"
+#include "multimatch.h"
+#include "submatch.h"
+#include "threadpool.h"
+#include "weightinternal.h"
+#include "xapian/database.h"
+#include "xapian/enquire.h"
+#include "xapian/weight.h"
+
+#include <vector>
+
+/** Class for matching one local sub-database on worker threads.
+ *
+ *  This works much like RemoteSubMatch - the sub-database is matched on its
+ *  own to give a proto-MSet using the statistics for the whole collection,
+ *  and the results are merged with those from the other sub-databases by
+ *  returning an MSetPostList.  The difference is that the match is run by
+ *  MultiMatch objects on a ThreadPool rather than by a remote server.
+ *
+ *  A large sub-database can be split into ranges of document ids, each
+ *  matched by a different thread using its own database handle.  The
+ *  proto-MSets for the ranges are then combined into one.
+ *
+ *  The worker threads only touch the objects for this sub-database, so
+ *  match spies, match deciders and sorters (which are user objects which may
+ *  not be safe to call from several threads at once) aren't supported.
+ */
+class ShardSubMatch : public SubMatch {
+    /// Don't allow assignment.
+    void operator=(const ShardSubMatch &);
+
+    /// Don't allow copying.
+    ShardSubMatch(const ShardSubMatch &);
+
+    /// The task which matches one range of document ids.
+    class RangeMatch : public ThreadTask {
+	/// Don't allow assignment.
+	void operator=(const RangeMatch &);
+
+	/// Don't allow copying.
+	RangeMatch(const RangeMatch &);
+
+	/// The ShardSubMatch this is part of.
+	ShardSubMatch & submatch;
+
+      public:
+	/// The database handle for this range.
+	Xapian::Database db;
+
+	/// The statistics for the sub-database.
+	Xapian::Weight::Internal local_stats;
+
+	/// Matcher for this range.
+	AutoPtr<MultiMatch> match;
+
+	/** The total statistics for the collection.
+	 *
+	 *  These are a copy, with the bounds taken from db, so the worker
+	 *  thread doesn't need to touch the other sub-databases.
+	 */
+	Xapian::Weight::Internal total_stats;
+
+	/// The MSet the match produces.
+	Xapian::MSet mset;
+
+	/// True if the task has been started and not yet waited for.
+	bool running;
+
+	RangeMatch(ShardSubMatch & submatch_, const Xapian::Database & db_)
+	    : submatch(submatch_), db(db_), running(false) { }
+
+	/// Run the match.
+	void run();
+    };
+
+    /// The matches for each range of document ids.
+    std::vector<RangeMatch *> ranges;
+
+    /// The thread pool to run the matches on.
+    ThreadPool & pool;
+
+    /// Parameters passed to start_match().
+    Xapian::doccount first, maxitems, check_at_least;
+
+    /// The maximum number of items with the same collapse key.
+    Xapian::doccount collapse_max;
+
+    /// How the MSet is sorted.
+    Xapian::Enquire::Internal::sort_setting sort_by;
+
+    /// Are documents which sort equally in ascending docid order?
+    bool sort_forward;
+
+    /// Are values sorted in ascending order?
+    bool sort_value_forward;
+
+    /** Is the sort order such the relevance decreases down the MSet?
+     *
+     *  This is true for sort_by_relevance and sort_by_relevance_then_value.
+     */
+    bool decreasing_relevance;
+
+    /// The factor to use to convert weights to percentages.
+    double percent_factor;
+
+    /// Wait for the matches still running, ignoring any errors.
+    void wait_for_ranges();
+
+    /// Combine the MSets for the ranges into one.
+    Xapian::MSet combine_msets() const;
+
+  public:
+    /** Constructor.
+     *
+     *  @param n_ranges  The number of ranges of document ids to split the
+     *		     database into.  Fewer are used if the database can't
+     *		     open enough handles on the same revision.
+     *  @param shared_min_weight  Minimum weight to share with the matches on
+     *		     other threads, or NULL.
+     */
+    ShardSubMatch(const Xapian::Database & db,
+		  const Xapian::Query::Internal * query,
+		  Xapian::termcount qlen,
+		  const Xapian::RSet & rset,
+		  Xapian::doccount collapse_max_,
+		  Xapian::valueno collapse_key,
+		  Xapian::weight weight_cutoff,
+		  Xapian::Enquire::docid_order order,
+		  Xapian::valueno sort_key,
+		  Xapian::Enquire::Internal::sort_setting sort_by_,
+		  bool sort_value_forward_,
+		  const Xapian::Weight * weight,
+		  const std::vector<Xapian::MatchSpy *> & matchspies,
+		  ThreadPool & pool_,
+		  unsigned n_ranges,
+		  SharedMinWeight * shared_min_weight);
+
+    /// Wait for any matches still running.
+    ~ShardSubMatch();
+
+    /// Fetch and collate statistics.
+    bool prepare_match(bool nowait, Xapian::Weight::Internal & total_stats);
+
+    /// Start the matches on worker threads.
+    void start_match(Xapian::doccount first,
+		     Xapian::doccount maxitems,
+		     Xapian::doccount check_at_least,
+		     const Xapian::Weight::Internal & total_stats);
+
+    /// Wait for the matches to finish, then get PostList and term info.
+    PostList * get_postlist_and_term_info(MultiMatch *matcher,
+	std::map<std::string,
+		 Xapian::MSet::Internal::TermFreqAndWeight> *termfreqandwts,
+	Xapian::termcount * total_subqs_ptr);
+
+    /// Get percentage factor - only valid after get_postlist_and_term_info().
+    double get_percent_factor() const { return percent_factor; }
+};
+
+#endif /* XAPIAN_INCLUDED_SHARDSUBMATCH_H */
@@ -45,10 +45,85 @@
 # include "msvc_posix_wrapper.h"
 #endif
 
+#ifdef HAVE_ZLIB_H
+# include <zlib.h>
+#endif
+
 using namespace std;
 
 #define CHUNKSIZE 4096
 
+/** Flag set in the message type if the message data is compressed.
+ *
+ *  The compressed data is the length of the uncompressed data, followed by
+ *  the data compressed with zlib.
+ */
+const unsigned char MESSAGE_COMPRESSED = 0x80;
+
+/// Don't bother trying to compress messages shorter than this.
+const size_t MIN_COMPRESS_SIZE = 1024;
+
+/// The most zlib can compress data by.
+const size_t MAX_COMPRESSION_RATIO = 1032;
+
+/** Compress message data.
+ *
+ *  @return	true if the data was compressed; false if compression doesn't
+ *		make it enough smaller to be worthwhile.
+ */
+static bool
+compress_message(const string & message, string & compressed)
+{
+#ifdef HAVE_ZLIB_H
+    compressed = encode_length(message.size());
+    size_t header_len = compressed.size();
+    // Only use the compressed form if it saves at least an eighth.
+    uLongf len = message.size() - message.size() / 8 - header_len;
+    compressed.resize(header_len + len);
+    int err = compress2(reinterpret_cast<Bytef *>(&compressed[header_len]),
+			&len,
+			reinterpret_cast<const Bytef *>(message.data()),
+			message.size(), Z_BEST_SPEED);
+    // Z_BUF_ERROR means the compressed data wouldn't fit.
+    if (err != Z_OK) return false;
+    compressed.resize(header_len + len);
+    return true;
+#else
+    (void)message;
+    (void)compressed;
+    return false;
+#endif
+}
+
+/** Uncompress message data if it's compressed.
+ *
+ *  @return	The message type, without MESSAGE_COMPRESSED.
+ */
+static char
+uncompress_message(char type, string & result)
+{
+    if (!(static_cast<unsigned char>(type) & MESSAGE_COMPRESSED))
+	return type;
+#ifdef HAVE_ZLIB_H
+    const char * p = result.data();
+    const char * p_end = p + result.size();
+    uLongf len = decode_length(&p, p_end, false);
+    // Reject a length which the compressed data couldn't possibly expand to,
+    // rather than trying to allocate however much the peer asked for.
+    if (len / MAX_COMPRESSION_RATIO > size_t(p_end - p))
+	throw Xapian::NetworkError("Bad compressed message received");
+    string message(len, '\0');
+    int err = uncompress(reinterpret_cast<Bytef *>(&message[0]), &len,
+			 reinterpret_cast<const Bytef *>(p), p_end - p);
+    if (err != Z_OK || len != message.size())
+	throw Xapian::NetworkError("Bad compressed message received");
+    swap(result, message);
+    return char(static_cast<unsigned char>(type) & ~MESSAGE_COMPRESSED);
+#else
+    throw Xapian::NetworkError("Compressed message received, but zlib support wasn't compiled in");
+#endif
+}
+
 XAPIAN_NORETURN(static void throw_database_closed());
 static void
 throw_database_closed()
@@ -194,28 +269,79 @@ RemoteConnection::ready_to_read() const
 
     if (!buffer.empty()) RETURN(true);
 
-    // Use select to see if there's data available to be read.
+    // Use select to see if there's data available to be read.  We don't
+    // wait - a caller which wants to wait for several connections at once
+    // should use wait_for_input().
     fd_set fdset;
     FD_ZERO(&fdset);
     FD_SET(fdin, &fdset);
 
-    // Set a 0.1 second timeout to avoid a busy loop.
-    // FIXME: this would be much better done by exposing the fd so that the
-    // matcher can call select on all the fds involved...
     struct timeval tv;
     tv.tv_sec = 0;
-    tv.tv_usec = 100000;
+    tv.tv_usec = 0;
     RETURN(select(fdin + 1, &fdset, 0, &fdset, &tv) > 0);
 }
 
+bool
+RemoteConnection::wait_for_input(const vector<const RemoteConnection *> & links,
+				 double end_time)
+{
+    LOGCALL_STATIC(REMOTE, bool, "RemoteConnection::wait_for_input", links.size() | end_time);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    int max_fd = -1;
+    vector<const RemoteConnection *>::const_iterator i;
+    for (i = links.begin(); i != links.end(); ++i) {
+	const RemoteConnection & link = **i;
+	if (link.fdin == -1)
+	    throw_database_closed();
+	if (!link.buffer.empty()) RETURN(true);
+	FD_SET(link.fdin, &fdset);
+	if (link.fdin > max_fd) max_fd = link.fdin;
+    }
+
+    while (true) {
+	struct timeval tv;
+	struct timeval * tvp = NULL;
+	if (end_time != 0.0) {
+	    // Calculate how far in the future end_time is.
+	    double time_diff = end_time - RealTime::now();
+	    if (time_diff < 0) RETURN(false);
+	    tv.tv_sec = long(time_diff);
+	    tv.tv_usec = long(fmod(time_diff, 1.0) * 1000000);
+	    tvp = &tv;
+	}
+
+	// select() modifies the fd_sets, so pass it copies.
+	fd_set readfds = fdset;
+	fd_set exceptfds = fdset;
+	int select_result = select(max_fd + 1, &readfds, 0, &exceptfds, tvp);
+	if (select_result >= 0) RETURN(select_result > 0);
+
+	// EINTR means select was interrupted by a signal.
+	if (errno != EINTR)
+	    throw Xapian::NetworkError("select failed while waiting to read", errno);
+    }
+}
+
 void
 RemoteConnection::send_message(char type, const string &message,
-			       double end_time)
+			       double end_time, bool compress)
 {
-    LOGCALL_VOID(REMOTE, "RemoteConnection::send_message", type | message | end_time);
+    LOGCALL_VOID(REMOTE, "RemoteConnection::send_message", type | message | end_time | compress);
     if (fdout == -1)
 	throw_database_closed();
 
+    if (compress && message.size() >= MIN_COMPRESS_SIZE) {
+	string compressed;
+	if (compress_message(message, compressed)) {
+	    unsigned char flagged_type = static_cast<unsigned char>(type);
+	    flagged_type |= MESSAGE_COMPRESSED;
+	    send_message(char(flagged_type), compressed, end_time);
+	    return;
+	}
+    }
+
     string header;
     header += type;
     header += encode_length(message.size());
@@ -485,7 +611,7 @@ RemoteConnection::get_message(string &result, double end_time)
 	result.assign(buffer.data() + 2, len);
 	char type = buffer[0];
 	buffer.erase(0, len + 2);
-	RETURN(type);
+	RETURN(uncompress_message(type, result));
     }
     len = 0;
     string::const_iterator i = buffer.begin() + 2;
@@ -506,7 +632,7 @@ RemoteConnection::get_message(string &result, double end_time)
     result.assign(buffer.data() + header_len, len);
     char type = buffer[0];
     buffer.erase(0, header_len + len);
-    RETURN(type);
+    RETURN(uncompress_message(type, result));
 }
 
 char
@@ -31,6 +31,7 @@
 #include "safeerrno.h"
 #include <signal.h>
 #include <cstdlib>
+#include <vector>
 
 #include "autoptr.h"
 #include "multimatch.h"
@@ -58,7 +59,8 @@ RemoteServer::RemoteServer(const std::vector<std::string> &dbpaths,
 			   bool writable_)
     : RemoteConnection(fdin_, fdout_, std::string()),
       db(NULL), wdb(NULL), writable(writable_),
-      active_timeout(active_timeout_), idle_timeout(idle_timeout_)
+      active_timeout(active_timeout_), idle_timeout(idle_timeout_),
+      compress_replies(false)
 {
     // Catch errors opening the database and propagate them to the client.
     try {
@@ -135,93 +137,115 @@ RemoteServer::send_message(reply_type type, const string &message)
 {
     double end_time = RealTime::end_time(active_timeout);
     unsigned char type_as_char = static_cast<unsigned char>(type);
-    RemoteConnection::send_message(type_as_char, message, end_time);
+    RemoteConnection::send_message(type_as_char, message, end_time,
+				   compress_replies);
 }
 
 typedef void (RemoteServer::* dispatch_func)(const string &);
 
-void
-RemoteServer::run()
+bool
+RemoteServer::run_one_message(double timeout)
 {
-    while (true) {
+    try {
+	/* This list needs to be kept in the same order as the list of
+	 * message types in "remoteprotocol.h". Note that messages at the
+	 * end of the list in "remoteprotocol.h" can be omitted if they
+	 * don't correspond to dispatch actions.
+	 */
+	static const dispatch_func dispatch[] = {
+	    &RemoteServer::msg_allterms,
+	    &RemoteServer::msg_collfreq,
+	    &RemoteServer::msg_document,
+	    &RemoteServer::msg_termexists,
+	    &RemoteServer::msg_termfreq,
+	    &RemoteServer::msg_valuestats,
+	    &RemoteServer::msg_keepalive,
+	    &RemoteServer::msg_doclength,
+	    &RemoteServer::msg_query,
+	    &RemoteServer::msg_termlist,
+	    &RemoteServer::msg_positionlist,
+	    &RemoteServer::msg_postlist,
+	    &RemoteServer::msg_reopen,
+	    &RemoteServer::msg_update,
+	    &RemoteServer::msg_adddocument,
+	    &RemoteServer::msg_cancel,
+	    &RemoteServer::msg_deletedocumentterm,
+	    &RemoteServer::msg_commit,
+	    &RemoteServer::msg_replacedocument,
+	    &RemoteServer::msg_replacedocumentterm,
+	    &RemoteServer::msg_deletedocument,
+	    &RemoteServer::msg_writeaccess,
+	    &RemoteServer::msg_getmetadata,
+	    &RemoteServer::msg_setmetadata,
+	    &RemoteServer::msg_addspelling,
+	    &RemoteServer::msg_removespelling,
+	    0, // MSG_GETMSET - used during a conversation.
+	    0, // MSG_SHUTDOWN - handled by get_message().
+	    &RemoteServer::msg_openmetadatakeylist,
+	    &RemoteServer::msg_documents,
+	    &RemoteServer::msg_compression,
+	    &RemoteServer::msg_adddocuments,
+	    &RemoteServer::msg_replacedocuments,
+	    &RemoteServer::msg_replacedocumentterms,
+	};
+
+	string message;
+	size_t type = get_message(timeout, message);
+	if (type >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[type]) {
+	    string errmsg("Unexpected message type ");
+	    errmsg += str(type);
+	    throw Xapian::InvalidArgumentError(errmsg);
+	}
+	(this->*(dispatch[type]))(message);
+    } catch (const Xapian::NetworkTimeoutError & e) {
 	try {
-	    /* This list needs to be kept in the same order as the list of
-	     * message types in "remoteprotocol.h". Note that messages at the
-	     * end of the list in "remoteprotocol.h" can be omitted if they
-	     * don't correspond to dispatch actions.
-	     */
-	    static const dispatch_func dispatch[] = {
-		&RemoteServer::msg_allterms,
-		&RemoteServer::msg_collfreq,
-		&RemoteServer::msg_document,
-		&RemoteServer::msg_termexists,
-		&RemoteServer::msg_termfreq,
-		&RemoteServer::msg_valuestats,
-		&RemoteServer::msg_keepalive,
-		&RemoteServer::msg_doclength,
-		&RemoteServer::msg_query,
-		&RemoteServer::msg_termlist,
-		&RemoteServer::msg_positionlist,
-		&RemoteServer::msg_postlist,
-		&RemoteServer::msg_reopen,
-		&RemoteServer::msg_update,
-		&RemoteServer::msg_adddocument,
-		&RemoteServer::msg_cancel,
-		&RemoteServer::msg_deletedocumentterm,
-		&RemoteServer::msg_commit,
-		&RemoteServer::msg_replacedocument,
-		&RemoteServer::msg_replacedocumentterm,
-		&RemoteServer::msg_deletedocument,
-		&RemoteServer::msg_writeaccess,
-		&RemoteServer::msg_getmetadata,
-		&RemoteServer::msg_setmetadata,
-		&RemoteServer::msg_addspelling,
-		&RemoteServer::msg_removespelling,
-		0, // MSG_GETMSET - used during a conversation.
-		0, // MSG_SHUTDOWN - handled by get_message().
-		&RemoteServer::msg_openmetadatakeylist,
-	    };
-
-	    string message;
-	    size_t type = get_message(idle_timeout, message);
-	    if (type >= sizeof(dispatch)/sizeof(dispatch[0]) || !dispatch[type]) {
-		string errmsg("Unexpected message type ");
-		errmsg += str(type);
-		throw Xapian::InvalidArgumentError(errmsg);
-	    }
-	    (this->*(dispatch[type]))(message);
-	} catch (const Xapian::NetworkTimeoutError & e) {
-	    try {
-		// We've had a timeout, so the client may not be listening, so
-		// set the end_time to 1 and if we can't send the message right
-		// away, just exit and the client will cope.
-		send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
-	    } catch (...) {
-	    }
-	    // And rethrow it so our caller can log it and close the
-	    // connection.
-	    throw;
-	} catch (const Xapian::NetworkError &) {
-	    // All other network errors mean we are fatally confused and are
-	    // unlikely to be able to communicate further across this
-	    // connection.  So we don't try to propagate the error to the
-	    // client, but instead just rethrow the exception so our caller can
-	    // log it and close the connection.
-	    throw;
-	} catch (const Xapian::Error &e) {
-	    // Propagate the exception to the client, then return to the main
-	    // message handling loop.
-	    send_message(REPLY_EXCEPTION, serialise_error(e));
-	} catch (ConnectionClosed &) {
-	    return;
+	    // We've had a timeout, so the client may not be listening, so
+	    // set the end_time to 1 and if we can't send the message right
+	    // away, just exit and the client will cope.
+	    send_message(REPLY_EXCEPTION, serialise_error(e), 1.0);
 	} catch (...) {
-	    // Propagate an unknown exception to the client.
-	    send_message(REPLY_EXCEPTION, string());
-	    // And rethrow it so our caller can log it and close the
-	    // connection.
-	    throw;
 	}
+	// And rethrow it so our caller can log it and close the
+	// connection.
+	throw;
+    } catch (const Xapian::NetworkError &) {
+	// All other network errors mean we are fatally confused and are
+	// unlikely to be able to communicate further across this
+	// connection.  So we don't try to propagate the error to the
+	// client, but instead just rethrow the exception so our caller can
+	// log it and close the connection.
+	throw;
+    } catch (const Xapian::Error &e) {
+	// Propagate the exception to the client, then return to the main
+	// message handling loop.
+	send_message(REPLY_EXCEPTION, serialise_error(e));
+    } catch (ConnectionClosed &) {
+	return false;
+    } catch (...) {
+	// Propagate an unknown exception to the client.
+	send_message(REPLY_EXCEPTION, string());
+	// And rethrow it so our caller can log it and close the
+	// connection.
+	throw;
     }
+    return true;
+}
+
+void
+RemoteServer::run()
+{
+    while (run_one_message(idle_timeout)) { }
+}
+
+bool
+RemoteServer::run_pending()
+{
+    // The client has started to send a message, so the rest of it should
+    // arrive within the active timeout.
+    do {
+	if (!run_one_message(active_timeout)) return false;
+    } while (input_buffered());
+    return true;
 }
 
 void
@@ -458,7 +482,8 @@ RemoteServer::msg_query(const string &message_in)
     MultiMatch match(*db, query.get(), qlen, &rset, collapse_max, collapse_key,
 		     percent_cutoff, weight_cutoff, order,
 		     sort_key, sort_by, sort_value_forward, NULL,
-		     local_stats, wt.get(), matchspies.spies, false, false);
+		     local_stats, wt.get(), matchspies.spies, false, false,
+		     NULL);
 
     send_message(REPLY_STATS, serialise_stats(local_stats));
 
@@ -511,6 +536,49 @@ RemoteServer::msg_document(const string &message)
     send_message(REPLY_DONE, string());
 }
 
+void
+RemoteServer::msg_documents(const string &message)
+{
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    while (p != p_end) {
+	Xapian::docid did = decode_length(&p, p_end, false);
+
+	// Read everything we need before we start to reply, so if there's an
+	// error we can report it for just this document and carry on with the
+	// others.
+	string data;
+	vector<string> values;
+	try {
+	    Xapian::Document doc = db->get_document(did);
+	    data = doc.get_data();
+	    Xapian::ValueIterator i;
+	    for (i = doc.values_begin(); i != doc.values_end(); ++i) {
+		string item = encode_length(i.get_valueno());
+		item += *i;
+		values.push_back(item);
+	    }
+	} catch (const Xapian::Error & e) {
+	    send_message(REPLY_EXCEPTION, serialise_error(e));
+	    continue;
+	}
+
+	send_message(REPLY_DOCDATA, data);
+	vector<string>::const_iterator i;
+	for (i = values.begin(); i != values.end(); ++i) {
+	    send_message(REPLY_VALUE, *i);
+	}
+	send_message(REPLY_DONE, string());
+    }
+}
+
+void
+RemoteServer::msg_compression(const string &)
+{
+    // There's no reply to this message.
+    compress_replies = true;
+}
+
 void
 RemoteServer::msg_keepalive(const string &)
 {
@@ -654,6 +722,83 @@ RemoteServer::msg_replacedocumentterm(const string & message)
     send_message(REPLY_ADDDOCUMENT, encode_length(did));
 }
 
+/// Read a length-prefixed serialised document from a batch message.
+static Xapian::Document
+unserialise_batch_document(const char ** p, const char * p_end)
+{
+    size_t len = decode_length(p, p_end, true);
+    Xapian::Document doc = unserialise_document(string(*p, len));
+    *p += len;
+    return doc;
+}
+
+/// Encode the document ids in a reply to a batch message.
+static string
+encode_docids(const vector<Xapian::docid> & dids)
+{
+    string reply;
+    vector<Xapian::docid>::const_iterator i;
+    for (i = dids.begin(); i != dids.end(); ++i) {
+	reply += encode_length(*i);
+    }
+    return reply;
+}
+
+void
+RemoteServer::msg_adddocuments(const string & message)
+{
+    if (!wdb)
+	throw_read_only();
+
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    vector<Xapian::Document> docs;
+    while (p != p_end) {
+	docs.push_back(unserialise_batch_document(&p, p_end));
+    }
+
+    send_message(REPLY_ADDDOCUMENT, encode_docids(wdb->add_documents(docs)));
+}
+
+void
+RemoteServer::msg_replacedocuments(const string & message)
+{
+    if (!wdb)
+	throw_read_only();
+
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    vector<Xapian::docid> dids;
+    vector<Xapian::Document> docs;
+    while (p != p_end) {
+	dids.push_back(decode_length(&p, p_end, false));
+	docs.push_back(unserialise_batch_document(&p, p_end));
+    }
+
+    wdb->replace_documents(dids, docs);
+}
+
+void
+RemoteServer::msg_replacedocumentterms(const string & message)
+{
+    if (!wdb)
+	throw_read_only();
+
+    const char *p = message.data();
+    const char *p_end = p + message.size();
+    vector<string> unique_terms;
+    vector<Xapian::Document> docs;
+    while (p != p_end) {
+	size_t len = decode_length(&p, p_end, true);
+	unique_terms.push_back(string(p, len));
+	p += len;
+	docs.push_back(unserialise_batch_document(&p, p_end));
+    }
+
+    vector<Xapian::docid> dids = wdb->replace_documents(unique_terms, docs);
+    send_message(REPLY_ADDDOCUMENT, encode_docids(dids));
+}
+
 void
 RemoteServer::msg_getmetadata(const string & message)
 {
@@ -28,6 +28,24 @@
 
 #include "remoteserver.h"
 
+#ifdef HAVE_PTHREAD
+# ifdef HAVE_SYS_EPOLL_H
+#  define USE_THREADED_SERVER
+# endif
+#endif
+
+#ifdef USE_THREADED_SERVER
+# include "autoptr.h"
+# include "realtime.h"
+# include "safeerrno.h"
+# include "safeunistd.h"
+# include "threadpool.h"
+
+# include <cstring>
+# include <map>
+# include <sys/epoll.h>
+#endif
+
 #include <iostream>
 
 using namespace std;
@@ -59,3 +77,352 @@ RemoteTcpServer::handle_one_connection(int socket)
 	// ignore other exceptions
     }
 }
+
+#ifdef USE_THREADED_SERVER
+
+namespace {
+
+/// The state shared by the connections in run_threaded().
+struct ThreadedServerState {
+    /// Paths to the databases each connection opens.
+    const vector<string> & dbpaths;
+
+    /// Timeout between messages during a single operation (in seconds).
+    double active_timeout;
+
+    /// Timeout between operations (in seconds).
+    double idle_timeout;
+
+    /// Should we produce output when connections are made or lost?
+    bool verbose;
+
+    /// The epoll file descriptor.
+    int epoll_fd;
+
+    /** Pipe used by worker threads to pass back finished connections.
+     *
+     *  Writes of a pointer to a pipe are atomic, so we don't need to lock.
+     */
+    int done_pipe[2];
+
+    ThreadedServerState(const vector<string> & dbpaths_,
+			double active_timeout_, double idle_timeout_,
+			bool verbose_)
+	: dbpaths(dbpaths_), active_timeout(active_timeout_),
+	  idle_timeout(idle_timeout_), verbose(verbose_), epoll_fd(-1)
+    {
+	done_pipe[0] = done_pipe[1] = -1;
+    }
+
+    ~ThreadedServerState() {
+	if (epoll_fd != -1) close(epoll_fd);
+	if (done_pipe[0] != -1) close(done_pipe[0]);
+	if (done_pipe[1] != -1) close(done_pipe[1]);
+    }
+};
+
+/// Add @a fd to the epoll set, or change the events to wait for on it.
+static void
+watch_fd(int epoll_fd, int op, int fd, unsigned events)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, op, fd, &event) < 0)
+	throw Xapian::NetworkError("epoll_ctl failed", errno);
+}
+
+/// Watches the listening socket in the epoll set, unless paused.
+class Listener {
+    int epoll_fd;
+
+    int fd;
+
+    bool watching;
+
+  public:
+    Listener(int epoll_fd_, int fd_)
+	: epoll_fd(epoll_fd_), fd(fd_), watching(false) { }
+
+    /// Stop accepting connections (further ones wait in the listen queue).
+    void pause() {
+	if (!watching) return;
+	watch_fd(epoll_fd, EPOLL_CTL_DEL, fd, 0);
+	watching = false;
+    }
+
+    /// Start accepting connections again.
+    void resume() {
+	if (watching) return;
+	watch_fd(epoll_fd, EPOLL_CTL_ADD, fd, EPOLLIN);
+	watching = true;
+    }
+
+    bool paused() const { return !watching; }
+};
+
+}
+
+/** A connection served by run_threaded().
+ *
+ *  When the client sends a request, the connection is run as a task on a
+ *  worker thread, which processes the waiting messages and then passes the
+ *  connection back to the main thread through the done pipe.
+ */
+class RemoteTcpServer::Connection : public ThreadTask {
+    /// The state shared by all connections.
+    ThreadedServerState & state;
+
+    /// The server for this connection (NULL until the first run()).
+    AutoPtr<RemoteServer> server;
+
+  public:
+    /// The connected socket.
+    int socket;
+
+    /// True if the connection has been passed to a worker thread.
+    bool busy;
+
+    /// True if the socket has been added to the epoll set.
+    bool registered;
+
+    /// True if the connection should be closed.
+    bool closed;
+
+    /// When the connection was last passed back by a worker thread.
+    double last_active;
+
+    Connection(ThreadedServerState & state_, int socket_)
+	: state(state_), socket(socket_), busy(false), registered(false),
+	  closed(false), last_active(0) { }
+
+    ~Connection() {
+	server.reset();
+	close(socket);
+    }
+
+    /// Process the waiting messages (or send the greeting if new).
+    void run();
+};
+
+void
+RemoteTcpServer::Connection::run()
+{
+    try {
+	if (!server.get()) {
+	    // Open the databases just for this connection, as a forked child
+	    // would, so the client sees the revision it opened until it calls
+	    // reopen().
+	    server.reset(new RemoteServer(state.dbpaths, socket, socket,
+					  state.active_timeout,
+					  state.idle_timeout));
+	} else if (!server->run_pending()) {
+	    closed = true;
+	}
+    } catch (const Xapian::NetworkTimeoutError &e) {
+	if (state.verbose)
+	    cerr << "Connection timed out: " << e.get_description() << endl;
+	closed = true;
+    } catch (const Xapian::Error &e) {
+	cerr << "Got exception " << e.get_description() << endl;
+	closed = true;
+    } catch (...) {
+	// ignore other exceptions
+	closed = true;
+    }
+
+    Connection * self = this;
+    while (write(state.done_pipe[1], &self, sizeof(self)) < 0) {
+	// If we can't pass the connection back, it'll never be closed, but
+	// there isn't much else we can do.
+	if (errno != EINTR) break;
+    }
+}
+
+void
+RemoteTcpServer::run_threaded(unsigned n_threads, unsigned max_connections,
+			      bool one_shot)
+{
+    if (writable) {
+	throw Xapian::InvalidOperationError("Threaded server can't be writable");
+    }
+    if (n_threads == 0) n_threads = 1;
+
+    ThreadedServerState state(dbpaths, active_timeout, idle_timeout, verbose);
+
+    if (pipe(state.done_pipe) < 0)
+	throw Xapian::NetworkError("pipe failed", errno);
+    state.epoll_fd = epoll_create(16);
+    if (state.epoll_fd < 0)
+	throw Xapian::NetworkError("epoll_create failed", errno);
+
+    int listen_fd = get_listen_socket();
+    Listener listener(state.epoll_fd, listen_fd);
+    listener.resume();
+    watch_fd(state.epoll_fd, EPOLL_CTL_ADD, state.done_pipe[0], EPOLLIN);
+
+    // If accept() runs out of resources, don't try again before this time.
+    double accept_retry_time = 0;
+    // Set once the connection for one_shot has been accepted.
+    bool accepted_one = false;
+
+    // Connections, indexed by socket.  The pool must be destroyed (which
+    // waits for the running tasks) before the connections are.
+    map<int, Connection *> connections;
+    struct ConnectionsDeleter {
+	map<int, Connection *> & c;
+	explicit ConnectionsDeleter(map<int, Connection *> & c_) : c(c_) { }
+	~ConnectionsDeleter() {
+	    map<int, Connection *>::const_iterator i;
+	    for (i = c.begin(); i != c.end(); ++i) delete i->second;
+	}
+    } deleter(connections);
+    ThreadPool pool(n_threads);
+
+    double next_idle_check = 0;
+    while (true) {
+	if (accepted_one && connections.empty()) {
+	    // The connection for one_shot has been closed.
+	    return;
+	}
+	if (listener.paused() && !accepted_one &&
+	    (max_connections == 0 || connections.size() < max_connections) &&
+	    (accept_retry_time == 0 || RealTime::now() >= accept_retry_time)) {
+	    accept_retry_time = 0;
+	    listener.resume();
+	}
+
+	struct epoll_event events[64];
+	// Wake up once a second to check for idle connections, or to retry
+	// accepting after running out of resources.
+	int timeout = -1;
+	if ((!connections.empty() && state.idle_timeout != 0) ||
+	    accept_retry_time != 0) {
+	    timeout = 1000;
+	}
+	int n_events = epoll_wait(state.epoll_fd, events, 64, timeout);
+	if (n_events < 0) {
+	    if (errno == EINTR) continue;
+	    throw Xapian::NetworkError("epoll_wait failed", errno);
+	}
+
+	for (int i = 0; i != n_events; ++i) {
+	    int fd = events[i].data.fd;
+	    Connection * conn;
+	    if (fd == listen_fd) {
+		if (listener.paused()) continue;
+		int socket;
+		try {
+		    socket = TcpServer::try_accept_connection();
+		} catch (const Xapian::Error &e) {
+		    cerr << "Caught " << e.get_description() << endl;
+		    continue;
+		}
+		if (socket < 0) {
+		    int accept_errno = errno;
+		    switch (accept_errno) {
+			case EBADF: case EFAULT: case EINVAL: case ENOTSOCK:
+			    // Something is wrong with the listening socket
+			    // itself, so we can't carry on.
+			    throw Xapian::NetworkError("accept failed",
+						       accept_errno);
+			case EMFILE: case ENFILE: case ENOBUFS: case ENOMEM:
+			    // Stop accepting until a connection is closed or
+			    // a second has passed, rather than spinning while
+			    // the connection waits in the listen queue.
+			    cerr << "Couldn't accept connection: "
+				 << strerror(accept_errno) << endl;
+			    listener.pause();
+			    accept_retry_time = RealTime::now() + 1.0;
+			    break;
+			default:
+			    // The connection failed or was aborted before we
+			    // accepted it (or accept() was interrupted), so
+			    // just wait for the next one.
+			    if (verbose) {
+				cerr << "Couldn't accept connection: "
+				     << strerror(accept_errno) << endl;
+			    }
+			    break;
+		    }
+		    continue;
+		}
+		AutoPtr<Connection> new_conn(new Connection(state, socket));
+		connections[socket] = new_conn.get();
+		conn = new_conn.release();
+		if (one_shot) {
+		    accepted_one = true;
+		    listener.pause();
+		} else if (max_connections &&
+			   connections.size() >= max_connections) {
+		    // Leave further connections in the listen queue.
+		    listener.pause();
+		}
+		// Start the task to send the greeting.
+	    } else if (fd == state.done_pipe[0]) {
+		if (read(fd, &conn, sizeof(conn)) != sizeof(conn)) {
+		    if (errno == EINTR) continue;
+		    throw Xapian::NetworkError("read from pipe failed", errno);
+		}
+		// The task has finished, but the pool needs to know we've
+		// seen that before we can start it again or delete it.
+		pool.wait(conn);
+		conn->busy = false;
+		conn->last_active = RealTime::now();
+		if (conn->closed) {
+		    if (state.verbose) cout << "Closing connection." << endl;
+		    connections.erase(conn->socket);
+		    delete conn;
+		    // Closing a connection frees resources for accept().
+		    accept_retry_time = 0;
+		    continue;
+		}
+		// Wait for the client to send another request.  With
+		// EPOLLONESHOT, the socket is disabled once it's reported so
+		// it isn't reported again while a worker is using it.
+		int op = conn->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		watch_fd(state.epoll_fd, op, conn->socket,
+			 EPOLLIN | EPOLLONESHOT);
+		conn->registered = true;
+		continue;
+	    } else {
+		map<int, Connection *>::const_iterator c = connections.find(fd);
+		if (c == connections.end()) continue;
+		conn = c->second;
+	    }
+	    conn->busy = true;
+	    pool.start(conn);
+	}
+
+	if (connections.empty() || state.idle_timeout == 0) continue;
+	double now = RealTime::now();
+	if (now < next_idle_check) continue;
+	next_idle_check = now + 1.0;
+	map<int, Connection *>::iterator c = connections.begin();
+	while (c != connections.end()) {
+	    Connection * conn = c->second;
+	    if (conn->busy || now - conn->last_active < state.idle_timeout) {
+		++c;
+		continue;
+	    }
+	    if (state.verbose) {
+		cerr << "Connection timed out: idle for " << state.idle_timeout
+		     << " seconds" << endl;
+	    }
+	    connections.erase(c++);
+	    delete conn;
+	    accept_retry_time = 0;
+	}
+    }
+}
+
+#else
+
+void
+RemoteTcpServer::run_threaded(unsigned, unsigned, bool)
+{
+    throw Xapian::FeatureUnavailableError("Threaded server requires pthreads and epoll");
+}
+
+#endif
@@ -228,7 +228,7 @@ TcpServer::get_listening_socket(const std::string & host, int port,
 }
 
 int
-TcpServer::accept_connection()
+TcpServer::try_accept_connection()
 {
     struct sockaddr_in remote_address;
     SOCKLEN_T remote_address_size = sizeof(remote_address);
@@ -237,6 +237,24 @@ TcpServer::accept_connection()
 			    reinterpret_cast<sockaddr *>(&remote_address),
 			    &remote_address_size);
 
+    if (con_socket < 0) return -1;
+
+    if (remote_address_size != sizeof(remote_address)) {
+	throw Xapian::NetworkError("accept: unexpected remote address size");
+    }
+
+    if (verbose) {
+	cout << "Connection from " << inet_ntoa(remote_address.sin_addr)
+	     << ", port " << remote_address.sin_port << endl;
+    }
+
+    return con_socket;
+}
+
+int
+TcpServer::accept_connection()
+{
+    int con_socket = try_accept_connection();
     if (con_socket < 0) {
 #ifdef __WIN32__
 	if (WSAGetLastError() == WSAEINTR) {
@@ -248,16 +266,6 @@ TcpServer::accept_connection()
 #endif
 	throw Xapian::NetworkError("accept failed", socket_errno());
     }
-
-    if (remote_address_size != sizeof(remote_address)) {
-	throw Xapian::NetworkError("accept: unexpected remote address size");
-    }
-
-    if (verbose) {
-	cout << "Connection from " << inet_ntoa(remote_address.sin_addr)
-	     << ", port " << remote_address.sin_port << endl;
-    }
-
     return con_socket;
 }
 
@@ -354,6 +354,109 @@ DEFINE_TESTCASE(multidb5, backend && !multi) {
     return true;
 }
 
+/** Check that get_mset() gives the same results as a serial match.
+ *
+ *  @a serial_mset is the result of the serial match with the same maxitems,
+ *  and @a all_mset the result with enough maxitems for all the matches.
+ */
+static void
+check_threaded_mset(Xapian::Enquire & enquire,
+		    Xapian::doccount maxitems,
+		    const Xapian::MSet & serial_mset,
+		    const Xapian::MSet & all_mset)
+{
+    Xapian::MSet mset = enquire.get_mset(0, maxitems);
+    TEST_EQUAL(mset.size(), serial_mset.size());
+    TEST(mset_range_is_same(mset, 0, serial_mset, 0, mset.size()));
+    TEST(mset_range_is_same_percents(mset, 0, serial_mset, 0, mset.size()));
+    // The estimates may differ from those for the serial match when
+    // collapsing, but must still be within the correct bounds.
+    TEST_REL(mset.get_matches_lower_bound(),<=,all_mset.size());
+    TEST_REL(mset.get_matches_upper_bound(),>=,all_mset.size());
+    Xapian::MSetIterator i = mset.begin(), j = all_mset.begin();
+    for ( ; i != mset.end(); ++i, ++j) {
+	TEST_REL(i.get_collapse_count(),<=,j.get_collapse_count());
+    }
+}
+
+/// Test that matching sub-databases on worker threads gives the same results.
+DEFINE_TESTCASE(searchthreads1, backend && !multi) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    db.add_database(get_database("apitest_simpledata2"));
+    db.add_database(get_database("apitest_termorder"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("this"),
+				    Xapian::Query("word")));
+
+    for (int testcase = 0; testcase != 5; ++testcase) {
+	tout << "testcase=" << testcase << endl;
+	switch (testcase) {
+	    case 0:
+		break;
+	    case 1:
+		enquire.set_sort_by_value_then_relevance(11, true);
+		break;
+	    case 2:
+		enquire.set_sort_by_relevance_then_value(11, false);
+		enquire.set_collapse_key(1);
+		break;
+	    case 3:
+		enquire.set_sort_by_relevance();
+		enquire.set_cutoff(60);
+		break;
+	    case 4:
+		enquire.set_collapse_key(Xapian::BAD_VALUENO);
+		enquire.set_cutoff(0);
+		enquire.set_docid_order(Xapian::Enquire::DESCENDING);
+		break;
+	}
+	for (Xapian::doccount maxitems = 1; maxitems <= 10; maxitems += 3) {
+	    enquire.set_search_threads(1);
+	    Xapian::MSet serial_mset = enquire.get_mset(0, maxitems);
+	    Xapian::MSet all_mset = enquire.get_mset(0, db.get_doccount());
+	    enquire.set_search_threads(4);
+	    check_threaded_mset(enquire, maxitems, serial_mset, all_mset);
+	    // Check again with the same worker threads.
+	    check_threaded_mset(enquire, maxitems, serial_mset, all_mset);
+	}
+    }
+
+    return true;
+}
+
+/// PostingSource which throws an exception when initialised.
+class ThrowingSource : public Xapian::PostingSource {
+  public:
+    Xapian::doccount get_termfreq_min() const { return 0; }
+    Xapian::doccount get_termfreq_est() const { return 0; }
+    Xapian::doccount get_termfreq_max() const { return 0; }
+    void next(Xapian::weight) { }
+    bool at_end() const { return true; }
+    Xapian::docid get_docid() const { return 0; }
+    ThrowingSource * clone() const { return new ThrowingSource; }
+    void init(const Xapian::Database &) {
+	throw Xapian::InvalidOperationError("ThrowingSource::init()");
+    }
+};
+
+/// Test that errors from worker threads are reported.
+DEFINE_TESTCASE(searchthreads2, backend && !multi && !remote) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    db.add_database(get_database("apitest_simpledata2"));
+    Xapian::Enquire enquire(db);
+    enquire.set_search_threads(2);
+    ThrowingSource source;
+    enquire.set_query(Xapian::Query(&source));
+    TEST_EXCEPTION(Xapian::InvalidOperationError, enquire.get_mset(0, 10));
+    // Check the Enquire object is still usable.
+    enquire.set_query(Xapian::Query("this"));
+    Xapian::MSet mset = enquire.get_mset(0, 10);
+    enquire.set_search_threads(1);
+    TEST_EQUAL(mset, enquire.get_mset(0, 10));
+    return true;
+}
+
 // tests that when specifying maxitems to get_mset, no more than
 // that are returned.
 DEFINE_TESTCASE(msetmaxitems1, backend) {
@@ -1122,6 +1225,37 @@ DEFINE_TESTCASE(fetchdocs1, backend) {
     return true;
 }
 
+// test prefetching documents with other requests in between
+DEFINE_TESTCASE(fetchdocs2, backend) {
+    Xapian::Database db(get_database("apitest_simpledata"));
+    Xapian::Enquire enquire(db);
+    enquire.set_query(query(Xapian::Query::OP_OR, "this", "word"));
+
+    Xapian::MSet mymset1 = enquire.get_mset(0, 10);
+    Xapian::MSet mymset2 = enquire.get_mset(0, 10);
+    TEST(!mymset1.empty());
+    mymset1.fetch();
+    mymset2.fetch();
+
+    // Ask for other things before reading the fetched documents.
+    TEST_EQUAL(db.get_termfreq("this"), mymset1.get_termfreq("this"));
+    Xapian::docid did = *mymset1[0];
+    string data = db.get_document(did).get_data();
+    TEST_NOT_EQUAL(data, "");
+
+    // Read the documents in the opposite order to which they were fetched.
+    for (Xapian::doccount i = mymset2.size(); i-- != 0; ) {
+	Xapian::Document doc2 = mymset2[i].get_document();
+	Xapian::Document doc1 = mymset1[i].get_document();
+	TEST_EQUAL(doc1.get_data(), db.get_document(*mymset1[i]).get_data());
+	TEST_EQUAL(doc2.get_data(), doc1.get_data());
+	TEST_EQUAL(doc2.values_count(), doc1.values_count());
+    }
+    TEST_EQUAL(mymset1[0].get_document().get_data(), data);
+
+    return true;
+}
+
 // test that searching for a term not in the database fails nicely
 DEFINE_TESTCASE(absentterm1, backend) {
     Xapian::Enquire enquire(get_database("apitest_simpledata"));
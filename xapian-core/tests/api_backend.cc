@@ -27,15 +27,23 @@
 #define XAPIAN_DEPRECATED(X) X
 #include <xapian.h>
 
+#include "backendmanager.h" // For XAPIAN_BIN_PATH.
 #include "str.h"
 #include "testsuite.h"
 #include "testutils.h"
+#include "unixcmds.h"
 #include "utils.h"
 
 #include "apitest.h"
 
+#include "safefcntl.h"
 #include "safeunistd.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <set>
+#include <vector>
+
 using namespace std;
 
 /// Regression test - lockfile should honour umask, was only user-readable.
@@ -302,6 +310,12 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote) {
     //
     // The remote backend doesn't work as expected here, I think due to
     // test harness issues.
+#ifdef F_OFD_SETLK
+    // Brass readers pin the revision they have open, so it doesn't get
+    // overwritten (see pinrevision1).
+    if (get_dbtype().find("brass") != string::npos)
+	SKIP_TEST("Brass readers pin their revision");
+#endif
     Xapian::WritableDatabase db(get_writable_database());
     Xapian::Document doc;
     doc.set_data("cargo");
@@ -342,6 +356,11 @@ DEFINE_TESTCASE(databasemodified1, writable && !inmemory && !remote) {
 /// Regression test for bug#462 fixed in 1.0.19 and 1.1.5.
 DEFINE_TESTCASE(qpmemoryleak1, writable && !inmemory) {
     // Inmemory never throws DatabaseModifiedError.
+#ifdef F_OFD_SETLK
+    // Nor does brass if readers can pin the revision they have open.
+    if (get_dbtype().find("brass") != string::npos)
+	SKIP_TEST("Brass readers pin their revision");
+#endif
     Xapian::WritableDatabase wdb(get_writable_database());
     Xapian::Document doc;
 
@@ -369,6 +388,205 @@ DEFINE_TESTCASE(qpmemoryleak1, writable && !inmemory) {
     return true;
 }
 
+/// Check a brass reader can keep using its revision while the writer commits.
+DEFINE_TESTCASE(pinrevision1, brass) {
+#ifndef F_OFD_SETLK
+    SKIP_TEST("Revision pinning not supported on this platform");
+#endif
+    Xapian::WritableDatabase db(get_writable_database());
+    Xapian::Document doc;
+    doc.set_data("cargo");
+    doc.add_term("abc");
+    doc.add_term("def");
+    doc.add_term("ghi");
+    const int N = 500;
+    for (int i = 0; i < N; ++i) {
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Database rodb(get_writable_database_as_database());
+
+    // Change every document several times, so without the pin the blocks
+    // the reader's revision uses would be reused.
+    Xapian::Document doc2;
+    doc2.set_data("freight");
+    doc2.add_term("xyz");
+    for (int j = 0; j < 4; ++j) {
+	for (Xapian::docid did = 1; did <= Xapian::docid(N); ++did) {
+	    db.replace_document(did, doc2);
+	}
+	db.commit();
+    }
+
+    TEST_EQUAL(*rodb.termlist_begin(N - 1), "abc");
+    TEST_EQUAL(rodb.get_document(N).get_data(), "cargo");
+    Xapian::Enquire enq(rodb);
+    enq.set_query(Xapian::Query("abc"));
+    Xapian::MSet mset = enq.get_mset(0, 10);
+    TEST_EQUAL(mset.get_matches_estimated(), N);
+    TEST_EQUAL(rodb.get_termfreq("xyz"), 0);
+
+    // After reopening, the reader sees (and pins) the latest revision.
+    TEST(rodb.reopen());
+    TEST_EQUAL(rodb.get_termfreq("abc"), 0);
+    TEST_EQUAL(rodb.get_termfreq("xyz"), N);
+    TEST_EQUAL(rodb.get_document(1).get_data(), "freight");
+
+    // Once the reader has gone, blocks can be reused again.
+    rodb = Xapian::Database();
+    for (Xapian::docid did = 1; did <= Xapian::docid(N); ++did) {
+	db.replace_document(did, doc);
+    }
+    db.commit();
+    TEST_EQUAL(db.get_termfreq("abc"), N);
+
+    return true;
+}
+
+/// Check a reader pins its revision even if the pin file doesn't exist yet.
+DEFINE_TESTCASE(pinrevision2, brass) {
+#ifndef F_OFD_SETLK
+    SKIP_TEST("Revision pinning not supported on this platform");
+#endif
+    Xapian::Document doc;
+    doc.set_data("cargo");
+    doc.add_term("abc");
+    const int N = 500;
+    {
+	Xapian::WritableDatabase db(get_named_writable_database("pinrevision2"));
+	for (int i = 0; i < N; ++i) {
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+
+    // A database created before pins existed has no pin file.
+    string path = get_named_writable_database_path("pinrevision2");
+    TEST(unlink((path + "/pinlock").c_str()) == 0);
+
+    Xapian::Database rodb(path);
+    TEST(file_exists(path + "/pinlock"));
+
+    Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+    Xapian::Document doc2;
+    doc2.set_data("freight");
+    doc2.add_term("xyz");
+    for (int j = 0; j < 4; ++j) {
+	for (Xapian::docid did = 1; did <= Xapian::docid(N); ++did) {
+	    db.replace_document(did, doc2);
+	}
+	db.commit();
+    }
+
+    TEST_EQUAL(rodb.get_document(N).get_data(), "cargo");
+    TEST_EQUAL(rodb.get_termfreq("abc"), N);
+    TEST_EQUAL(rodb.get_termfreq("xyz"), 0);
+
+    return true;
+}
+
+/// Check reopen() picks up changes which only touch some of the tables.
+DEFINE_TESTCASE(reopenpartial1, writable && !inmemory) {
+    Xapian::WritableDatabase db(get_writable_database());
+    Xapian::Document doc;
+    doc.set_data("v");
+    doc.add_posting("abc", 1);
+    doc.add_posting("def", 2);
+    for (int i = 0; i < 100; ++i) {
+	db.add_document(doc);
+    }
+    db.set_metadata("key", "0");
+    db.commit();
+
+    Xapian::Database rodb(get_writable_database_as_database());
+    TEST_EQUAL(rodb.get_metadata("key"), "0");
+    TEST_EQUAL(*rodb.termlist_begin(50), "abc");
+
+    // Change only the metadata.
+    db.set_metadata("key", "1");
+    db.commit();
+    TEST(rodb.reopen());
+    TEST_EQUAL(rodb.get_metadata("key"), "1");
+    TEST_EQUAL(*rodb.termlist_begin(50), "abc");
+    TEST_EQUAL(*rodb.positionlist_begin(50, "def"), 2);
+    TEST_EQUAL(rodb.get_document(50).get_data(), "v");
+
+    // Change only the document data, reopening after each commit.  The
+    // blocks freed by earlier commits get reused along the way.
+    for (int j = 0; j < 6; ++j) {
+	doc.set_data("v" + str(j));
+	db.replace_document(1, doc);
+	db.commit();
+	TEST(rodb.reopen());
+	TEST_EQUAL(rodb.get_document(1).get_data(), "v" + str(j));
+	TEST_EQUAL(*rodb.termlist_begin(1), "abc");
+	TEST_EQUAL(rodb.get_termfreq("abc"), 100);
+    }
+
+    // Change the terms as well.
+    Xapian::Document doc2;
+    doc2.add_posting("xyz", 3);
+    db.replace_document(1, doc2);
+    db.commit();
+    TEST(rodb.reopen());
+    TEST_EQUAL(*rodb.termlist_begin(1), "xyz");
+    TEST_EQUAL(*rodb.positionlist_begin(1, "xyz"), 3);
+    TEST_EQUAL(rodb.get_termfreq("abc"), 99);
+    TEST_EQUAL(rodb.get_metadata("key"), "1");
+
+    // Nothing has changed, so reopen() should say so.
+    TEST(!rodb.reopen());
+
+    if (get_dbtype() != "brass") return true;
+
+    // Blocks cached before a reopen should still be used afterwards, apart
+    // from those the changes rewrote.
+    size_t old_size = Xapian::get_block_cache_size();
+    Xapian::set_block_cache_size(16 * 1024 * 1024);
+    try {
+	for (Xapian::docid did = 2; did <= 2000; ++did) {
+	    Xapian::Document d;
+	    d.set_data("document " + str(did));
+	    d.add_posting("abc", 1);
+	    d.add_posting("t" + str(did % 50), 2);
+	    db.replace_document(did, d);
+	}
+	db.commit();
+	TEST(rodb.reopen());
+
+	// Read every document's data and terms, to fill the cache.
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    (void)rodb.get_document(did).get_data();
+	    (void)*rodb.termlist_begin(did);
+	}
+
+	doc.set_data("changed");
+	db.replace_document(1000, doc);
+	db.commit();
+	TEST(rodb.reopen());
+
+	unsigned long hits = Xapian::get_block_cache_hits();
+	unsigned long misses = Xapian::get_block_cache_misses();
+	for (Xapian::docid did = 1; did <= 2000; ++did) {
+	    (void)rodb.get_document(did).get_data();
+	    (void)*rodb.termlist_begin(did);
+	}
+	TEST_EQUAL(rodb.get_document(1000).get_data(), "changed");
+	hits = Xapian::get_block_cache_hits() - hits;
+	misses = Xapian::get_block_cache_misses() - misses;
+	tout << "After reopen: " << hits << " hits, " << misses << " misses"
+	     << endl;
+	TEST_REL(misses * 10,<,hits);
+    } catch (...) {
+	Xapian::set_block_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_block_cache_size(old_size);
+
+    return true;
+}
+
 static void
 make_msize1_db(Xapian::WritableDatabase &db, const string &)
 {
@@ -741,3 +959,1134 @@ DEFINE_TESTCASE(tradweight2, backend) {
     }
     return true;
 }
+
+/// Check that the block cache is used, and doesn't change results.
+DEFINE_TESTCASE(blockcache1, brass || chert) {
+    size_t old_size = Xapian::get_block_cache_size();
+    Xapian::set_block_cache_size(1024 * 1024);
+    try {
+	const string & path = get_database_path("etext");
+	Xapian::Database db1(path);
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				     Xapian::Query("the"),
+				     Xapian::Query("king")));
+	Xapian::MSet mset1 = enq1.get_mset(0, 10);
+
+	// A second Database object open at the same revision should find the
+	// blocks it needs in the cache.
+	unsigned long hits = Xapian::get_block_cache_hits();
+	unsigned long misses = Xapian::get_block_cache_misses();
+	Xapian::Database db2(path);
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(enq1.get_query());
+	Xapian::MSet mset2 = enq2.get_mset(0, 10);
+	TEST_REL(Xapian::get_block_cache_hits(),>,hits);
+	TEST_EQUAL(Xapian::get_block_cache_misses(), misses);
+
+	TEST_EQUAL(mset1, mset2);
+	for (Xapian::MSetIterator i = mset2.begin(); i != mset2.end(); ++i) {
+	    TEST_EQUAL(i.get_document().get_data(),
+		       db1.get_document(*i).get_data());
+	}
+
+	// Shrinking the cache to zero disables it.
+	Xapian::set_block_cache_size(0);
+	hits = Xapian::get_block_cache_hits();
+	Xapian::Database db3(path);
+	Xapian::Enquire enq3(db3);
+	enq3.set_query(enq1.get_query());
+	TEST_EQUAL(enq3.get_mset(0, 10), mset1);
+	TEST_EQUAL(Xapian::get_block_cache_hits(), hits);
+    } catch (...) {
+	Xapian::set_block_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_block_cache_size(old_size);
+
+    return true;
+}
+
+/// Check copies of a database with the same UUID don't share cached blocks.
+DEFINE_TESTCASE(blockcache2, brass || chert) {
+    string path = get_named_writable_database_path("blockcache2");
+    string copy_path = get_named_writable_database_path("blockcache2copy");
+    {
+	Xapian::WritableDatabase db = get_named_writable_database("blockcache2");
+	Xapian::Document doc;
+	doc.add_term("foo");
+	db.add_document(doc);
+	db.commit();
+    }
+    rm_rf(copy_path);
+    cp_R(path, copy_path);
+
+    // Modify the original and the copy differently, so they have the same
+    // UUID and revision but different contents.
+    {
+	Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.set_data("original");
+	doc.add_term("foo");
+	db.add_document(doc);
+	db.commit();
+    }
+    {
+	Xapian::WritableDatabase db(copy_path, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.set_data("copy");
+	doc.add_term("bar");
+	db.add_document(doc);
+	db.commit();
+    }
+
+    size_t old_size = Xapian::get_block_cache_size();
+    Xapian::set_block_cache_size(1024 * 1024);
+    try {
+	Xapian::Database db1(path);
+	Xapian::Database db2(copy_path);
+	TEST_EQUAL(db1.get_uuid(), db2.get_uuid());
+	TEST_EQUAL(db1.get_termfreq("foo"), 2);
+	TEST_EQUAL(db1.get_document(2).get_data(), "original");
+	TEST_EQUAL(db2.get_termfreq("foo"), 1);
+	TEST_EQUAL(db2.get_termfreq("bar"), 1);
+	TEST_EQUAL(db2.get_document(2).get_data(), "copy");
+    } catch (...) {
+	Xapian::set_block_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_block_cache_size(old_size);
+
+    return true;
+}
+
+/// Check that the result cache is used, and doesn't change results.
+DEFINE_TESTCASE(resultcache1, brass || chert) {
+    size_t old_size = Xapian::get_result_cache_size();
+    Xapian::set_result_cache_size(1024 * 1024);
+    try {
+	const string & path = get_database_path("etext");
+	Xapian::Database db1(path);
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				     Xapian::Query("the"),
+				     Xapian::Query("king")));
+	unsigned long hits = Xapian::get_result_cache_hits();
+	unsigned long misses = Xapian::get_result_cache_misses();
+	Xapian::MSet mset1 = enq1.get_mset(0, 20);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 1);
+
+	// A second Database object open at the same revision should find the
+	// results in the cache, including for a later page.
+	Xapian::Database db2(path);
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(enq1.get_query());
+	Xapian::MSet mset2 = enq2.get_mset(0, 20);
+	Xapian::MSet page2 = enq2.get_mset(10, 10);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits + 2);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 1);
+	TEST_EQUAL(mset1, mset2);
+	TEST_EQUAL(mset2.get_matches_estimated(), mset1.get_matches_estimated());
+	TEST_EQUAL(mset2.get_termfreq("king"), mset1.get_termfreq("king"));
+	TEST_EQUAL(mset2.get_termweight("king"), mset1.get_termweight("king"));
+	TEST_EQUAL(page2.get_firstitem(), 10);
+	TEST(mset_range_is_same(page2, 0, mset1, 10, 10));
+	TEST(mset_range_is_same_percents(page2, 0, mset1, 10, 10));
+	for (Xapian::MSetIterator i = page2.begin(); i != page2.end(); ++i) {
+	    TEST_EQUAL(i.get_document().get_data(),
+		       db1.get_document(*i).get_data());
+	}
+
+	// Asking for more results, or changing a setting which affects them,
+	// runs the match again.
+	Xapian::Enquire enq3(db1);
+	enq3.set_query(enq1.get_query());
+	Xapian::MSet mset3 = enq3.get_mset(10, 20);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 2);
+	TEST(mset_range_is_same(mset3, 0, mset1, 10, 10));
+	enq3.set_cutoff(50);
+	mset3 = enq3.get_mset(0, 10);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 3);
+	TEST_REL(mset3.get_matches_estimated(),<,mset1.get_matches_estimated());
+	// The results for 30 items replaced those for 20.
+	enq3.set_cutoff(0);
+	TEST_EQUAL(enq3.get_mset(0, 30), enq2.get_mset(0, 30));
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits + 4);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 3);
+
+	// Shrinking the cache to zero disables it.
+	Xapian::set_result_cache_size(0);
+	hits = Xapian::get_result_cache_hits();
+	misses = Xapian::get_result_cache_misses();
+	TEST_EQUAL(enq2.get_mset(0, 20), mset1);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses);
+	Xapian::set_result_cache_size(1024 * 1024);
+
+	// Results from a database open for writing aren't cached, and a
+	// reader sees new results once reopened.
+	Xapian::WritableDatabase db = get_writable_database();
+	Xapian::Document doc;
+	doc.add_term("foo");
+	db.add_document(doc);
+	db.commit();
+	Xapian::Database rodb(get_writable_database_as_database());
+	Xapian::Enquire enq4(db);
+	enq4.set_query(Xapian::Query("foo"));
+	Xapian::Enquire enq5(rodb);
+	enq5.set_query(Xapian::Query("foo"));
+	TEST_EQUAL(enq5.get_mset(0, 10).size(), 1);
+	db.add_document(doc);
+	hits = Xapian::get_result_cache_hits();
+	misses = Xapian::get_result_cache_misses();
+	TEST_EQUAL(enq4.get_mset(0, 10).size(), 2);
+	TEST_EQUAL(enq4.get_mset(0, 10).size(), 2);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses);
+	TEST_EQUAL(enq5.get_mset(0, 10).size(), 1);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits + 1);
+	db.commit();
+	TEST(rodb.reopen());
+	TEST_EQUAL(enq5.get_mset(0, 10).size(), 2);
+	TEST_EQUAL(Xapian::get_result_cache_misses(), misses + 1);
+    } catch (...) {
+	Xapian::set_result_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_result_cache_size(old_size);
+
+    return true;
+}
+
+/// Check that copies of a database don't share cached results.
+DEFINE_TESTCASE(resultcache2, brass || chert) {
+    string path = get_named_writable_database_path("resultcache2");
+    string copy_path = get_named_writable_database_path("resultcache2copy");
+    {
+	Xapian::WritableDatabase db = get_named_writable_database("resultcache2");
+	Xapian::Document doc;
+	doc.add_term("foo");
+	db.add_document(doc);
+	db.commit();
+    }
+    rm_rf(copy_path);
+    cp_R(path, copy_path);
+
+    // Modify the original and the copy differently, so they have the same
+    // UUID and revision but different contents.
+    {
+	Xapian::WritableDatabase db(path, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.add_term("foo");
+	db.add_document(doc);
+	db.commit();
+    }
+    {
+	Xapian::WritableDatabase db(copy_path, Xapian::DB_OPEN);
+	Xapian::Document doc;
+	doc.add_term("bar");
+	db.add_document(doc);
+	db.commit();
+    }
+
+    size_t old_size = Xapian::get_result_cache_size();
+    Xapian::set_result_cache_size(1024 * 1024);
+    try {
+	Xapian::Database db1(path);
+	Xapian::Database db2(copy_path);
+	TEST_EQUAL(db1.get_uuid(), db2.get_uuid());
+	Xapian::Enquire enq1(db1);
+	enq1.set_query(Xapian::Query("foo"));
+	Xapian::Enquire enq2(db2);
+	enq2.set_query(Xapian::Query("foo"));
+	unsigned long hits = Xapian::get_result_cache_hits();
+	TEST_EQUAL(enq1.get_mset(0, 10).size(), 2);
+	TEST_EQUAL(enq2.get_mset(0, 10).size(), 1);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits);
+	// But the same database opened again still uses the cache.
+	Xapian::Database db3(path);
+	Xapian::Enquire enq3(db3);
+	enq3.set_query(Xapian::Query("foo"));
+	TEST_EQUAL(enq3.get_mset(0, 10).size(), 2);
+	TEST_EQUAL(Xapian::get_result_cache_hits(), hits + 1);
+    } catch (...) {
+	Xapian::set_result_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_result_cache_size(old_size);
+
+    return true;
+}
+
+/// The number of times a WdfWeight object has been asked for a weight.
+static Xapian::doccount wdfweight_calls = 0;
+
+/// Weight each document by the term's wdf, counting the weights calculated.
+class WdfWeight : public Xapian::Weight {
+    double factor;
+
+  public:
+    WdfWeight() {
+	need_stat(WDF);
+	need_stat(WDF_MAX);
+    }
+    WdfWeight * clone() const { return new WdfWeight; }
+    void init(double factor_) { factor = factor_; }
+    std::string name() const { return "WdfWeight"; }
+    string serialise() const { return string(); }
+    WdfWeight * unserialise(const string &) const { return new WdfWeight; }
+    Xapian::weight get_sumpart(Xapian::termcount wdf, Xapian::termcount) const {
+	++wdfweight_calls;
+	return wdf * factor;
+    }
+    Xapian::weight get_maxpart() const {
+	return get_maxpart_for_wdf(get_wdf_upper_bound());
+    }
+    Xapian::weight get_sumextra(Xapian::termcount) const { return 0; }
+    Xapian::weight get_maxextra() const { return 0; }
+
+  protected:
+    Xapian::weight get_maxpart_for_wdf(Xapian::termcount wdf_max) const {
+	return wdf_max * factor;
+    }
+};
+
+/// Check that skipping low-weight blocks of postings doesn't change results.
+DEFINE_TESTCASE(blockmax1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 6000; ++did) {
+	Xapian::Document doc;
+	// The posting list for "common" will span several chunks, and all but
+	// the first and one later entry have a low wdf.
+	Xapian::termcount wdf = 1;
+	if (did <= 20) wdf = 20;
+	if (did == 5000) wdf = 30;
+	doc.add_term("common", wdf);
+	if (did % 100 == 0) doc.add_term("rare");
+	doc.add_term("filler", did % 7 + 1);
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enq(db);
+    enq.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				Xapian::Query("common"),
+				Xapian::Query("rare")));
+    Xapian::MSet top = enq.get_mset(0, 10);
+    // Asking for every document means the minimum weight never rises, so
+    // nothing gets skipped.
+    Xapian::MSet all = enq.get_mset(0, db.get_doccount());
+    TEST_EQUAL(top.size(), 10);
+    TEST(mset_range_is_same(top, 0, all, 0, 10));
+    TEST(mset_range_is_same_weights(top, 0, all, 0, 10));
+
+    if (get_dbtype() == "brass") {
+	// Once the top 10 have been found, the chunks with only wdf 1 can't
+	// contain a better match, so their postings shouldn't be weighted.
+	enq.set_weighting_scheme(WdfWeight());
+	enq.set_query(Xapian::Query("common"));
+	wdfweight_calls = 0;
+	top = enq.get_mset(0, 10);
+	TEST_EQUAL(top.size(), 10);
+	TEST_EQUAL(*top.begin(), 5000);
+	tout << "Weights calculated: " << wdfweight_calls << endl;
+	TEST_REL(wdfweight_calls,<,db.get_doccount() / 2);
+    }
+
+    return true;
+}
+
+static void
+make_packedpostlists_db(Xapian::WritableDatabase & db)
+{
+    for (Xapian::docid did = 1; did <= 3000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all", did % 13 + 1);
+	if (did % 2 == 0) doc.add_term("even");
+	// Large gaps and a large wdf need wide bit fields.
+	if (did % 997 == 0) doc.add_term("sparse", did * 1000);
+	db.add_document(doc);
+    }
+    db.commit();
+    for (Xapian::docid did = 5; did <= 3000; did += 5) {
+	db.delete_document(did);
+    }
+    for (Xapian::docid did = 11; did <= 3000; did += 22) {
+	Xapian::Document doc;
+	doc.add_term("all", 1000);
+	doc.add_term("even");
+	db.replace_document(did, doc);
+    }
+    db.commit();
+}
+
+/// Check that a database with packed posting lists reads back correctly.
+DEFINE_TESTCASE(packedpostlists1, brass) {
+    Xapian::WritableDatabase ref = get_writable_database();
+    make_packedpostlists_db(ref);
+
+    string path = get_named_writable_database_path("packedpostlists1");
+    Xapian::WritableDatabase packed(path, Xapian::DB_CREATE_OR_OVERWRITE |
+					  Xapian::DB_PACKED_POSTLISTS);
+    make_packedpostlists_db(packed);
+
+    const char * terms[] = { "all", "even", "sparse", NULL };
+    for (const char ** t = terms; *t; ++t) {
+	tout << "Term " << *t << endl;
+	TEST_EQUAL(packed.get_termfreq(*t), ref.get_termfreq(*t));
+	TEST_EQUAL(packed.get_collection_freq(*t), ref.get_collection_freq(*t));
+	Xapian::PostingIterator p = packed.postlist_begin(*t);
+	Xapian::PostingIterator r = ref.postlist_begin(*t);
+	while (r != ref.postlist_end(*t)) {
+	    TEST(p != packed.postlist_end(*t));
+	    TEST_EQUAL(*p, *r);
+	    TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	    TEST_EQUAL(p.get_doclength(), r.get_doclength());
+	    ++p;
+	    ++r;
+	}
+	TEST(p == packed.postlist_end(*t));
+
+	// Check skip_to() lands on the same entries.
+	p = packed.postlist_begin(*t);
+	r = ref.postlist_begin(*t);
+	for (Xapian::docid did = 1; did <= 3000; did += 37) {
+	    p.skip_to(did);
+	    r.skip_to(did);
+	    if (r == ref.postlist_end(*t)) break;
+	    TEST(p != packed.postlist_end(*t));
+	    TEST_EQUAL(*p, *r);
+	    TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	}
+    }
+
+    Xapian::Enquire enq_ref(ref);
+    enq_ref.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				    Xapian::Query("all"),
+				    Xapian::Query("sparse")));
+    Xapian::Enquire enq_packed(packed);
+    enq_packed.set_query(enq_ref.get_query());
+    Xapian::MSet mset = enq_packed.get_mset(0, 10);
+    TEST(mset_range_is_same(mset, 0, enq_ref.get_mset(0, 10), 0, 10));
+
+    // Reopening without the flag should keep writing packed chunks - check
+    // that further modifications still read back correctly.
+    packed.close();
+    Xapian::WritableDatabase reopened(path, Xapian::DB_OPEN);
+    Xapian::Document doc;
+    doc.add_term("all", 7);
+    reopened.add_document(doc);
+    ref.add_document(doc);
+    reopened.delete_document(2);
+    ref.delete_document(2);
+    reopened.commit();
+    ref.commit();
+    Xapian::PostingIterator p = reopened.postlist_begin("all");
+    Xapian::PostingIterator r = ref.postlist_begin("all");
+    while (r != ref.postlist_end("all")) {
+	TEST(p != reopened.postlist_end("all"));
+	TEST_EQUAL(*p, *r);
+	TEST_EQUAL(p.get_wdf(), r.get_wdf());
+	++p;
+	++r;
+    }
+    TEST(p == reopened.postlist_end("all"));
+
+    return true;
+}
+
+/// Check skip_to() over packed posting lists with a range of skip distances.
+DEFINE_TESTCASE(packedpostlists2, brass) {
+    Xapian::WritableDatabase ref = get_writable_database();
+    make_packedpostlists_db(ref);
+
+    string path = get_named_writable_database_path("packedpostlists2");
+    Xapian::WritableDatabase packed(path, Xapian::DB_CREATE_OR_OVERWRITE |
+					  Xapian::DB_PACKED_POSTLISTS);
+    make_packedpostlists_db(packed);
+
+    // Strides either side of the group size, so skips land in the same
+    // group, the next one, and several groups on.
+    const Xapian::docid strides[] = { 1, 2, 3, 7, 64, 127, 128, 129, 300, 1000 };
+    const char * terms[] = { "all", "even", NULL };
+    for (const char ** t = terms; *t; ++t) {
+	for (size_t i = 0; i != sizeof(strides) / sizeof(strides[0]); ++i) {
+	    tout << "Term " << *t << ", stride " << strides[i] << endl;
+	    Xapian::PostingIterator p = packed.postlist_begin(*t);
+	    Xapian::PostingIterator r = ref.postlist_begin(*t);
+	    for (Xapian::docid did = 1; did <= 3100; did += strides[i]) {
+		p.skip_to(did);
+		r.skip_to(did);
+		if (r == ref.postlist_end(*t)) {
+		    TEST(p == packed.postlist_end(*t));
+		    break;
+		}
+		TEST(p != packed.postlist_end(*t));
+		TEST_EQUAL(*p, *r);
+		TEST_EQUAL(p.get_wdf(), r.get_wdf());
+		// Step on sometimes, so the next skip starts part way
+		// through a group.
+		if (did % 3 == 0) {
+		    ++p;
+		    ++r;
+		    if (r == ref.postlist_end(*t)) break;
+		    TEST_EQUAL(*p, *r);
+		    TEST_EQUAL(p.get_wdf(), r.get_wdf());
+		}
+	    }
+	}
+    }
+
+    // AND queries intersect the lists using skip_to().
+    const char * pairs[][2] = {
+	{ "all", "even" }, { "even", "sparse" }, { "all", "sparse" }
+    };
+    for (size_t i = 0; i != sizeof(pairs) / sizeof(pairs[0]); ++i) {
+	Xapian::Query query(Xapian::Query::OP_AND,
+			    Xapian::Query(pairs[i][0]),
+			    Xapian::Query(pairs[i][1]));
+	Xapian::Enquire enq_ref(ref);
+	enq_ref.set_query(query);
+	Xapian::Enquire enq_packed(packed);
+	enq_packed.set_query(query);
+	Xapian::MSet mset_ref = enq_ref.get_mset(0, 20);
+	Xapian::MSet mset = enq_packed.get_mset(0, 20);
+	TEST_EQUAL(mset.get_matches_estimated(),
+		   mset_ref.get_matches_estimated());
+	TEST(mset_range_is_same(mset, 0, mset_ref, 0, mset_ref.size()));
+	TEST(mset_range_is_same_weights(mset, 0, mset_ref, 0, mset_ref.size()));
+    }
+
+    return true;
+}
+
+/// Check skip_to() lands on the right entry when it moves a few chunks on.
+DEFINE_TESTCASE(skiptochunks1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    const Xapian::docid N = 20000;
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (did % 3 == 0) doc.add_term("third");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    // Strides from within a chunk to many chunks on.
+    const Xapian::docid strides[] = { 7, 500, 999, 1500, 2500, 4000, 9000 };
+    for (size_t i = 0; i != sizeof(strides) / sizeof(strides[0]); ++i) {
+	tout << "Stride " << strides[i] << endl;
+	Xapian::PostingIterator a = db.postlist_begin("all");
+	Xapian::PostingIterator t = db.postlist_begin("third");
+	for (Xapian::docid did = 1; did <= N; did += strides[i]) {
+	    a.skip_to(did);
+	    TEST(a != db.postlist_end("all"));
+	    TEST_EQUAL(*a, did);
+	    t.skip_to(did);
+	    Xapian::docid expect = (did + 2) / 3 * 3;
+	    if (expect > N) {
+		TEST(t == db.postlist_end("third"));
+		break;
+	    }
+	    TEST(t != db.postlist_end("third"));
+	    TEST_EQUAL(*t, expect);
+	}
+	a.skip_to(N + 1);
+	TEST(a == db.postlist_end("all"));
+	if (t != db.postlist_end("third")) t.skip_to(N + 1);
+	TEST(t == db.postlist_end("third"));
+    }
+
+    return true;
+}
+
+/// Check that opening with Xapian::DB_MMAP gives the same results.
+DEFINE_TESTCASE(mmap1, brass || chert) {
+    const string & path = get_database_path("etext");
+    Xapian::Database db1(path);
+    Xapian::Database db2(path, Xapian::DB_MMAP);
+    TEST_EQUAL(db1.get_doccount(), db2.get_doccount());
+    TEST_EQUAL(db1.get_avlength(), db2.get_avlength());
+
+    Xapian::Enquire enq1(db1);
+    enq1.set_query(Xapian::Query(Xapian::Query::OP_OR,
+				 Xapian::Query("the"),
+				 Xapian::Query("king")));
+    Xapian::Enquire enq2(db2);
+    enq2.set_query(enq1.get_query());
+    Xapian::MSet mset = enq2.get_mset(0, 10);
+    TEST_EQUAL(enq1.get_mset(0, 10), mset);
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	TEST_EQUAL(i.get_document().get_data(),
+		   db1.get_document(*i).get_data());
+    }
+
+    // Walking the termlists and the list of all terms reads blocks in
+    // sequence.
+    Xapian::TermIterator t1 = db1.allterms_begin();
+    Xapian::TermIterator t2 = db2.allterms_begin();
+    while (t1 != db1.allterms_end()) {
+	TEST(t2 != db2.allterms_end());
+	TEST_EQUAL(*t1, *t2);
+	TEST_EQUAL(t1.get_termfreq(), t2.get_termfreq());
+	++t1;
+	++t2;
+    }
+    TEST(t2 == db2.allterms_end());
+    TEST_EQUAL(db2.get_document(1).termlist_count(),
+	       db1.get_document(1).termlist_count());
+
+    return true;
+}
+
+/// Check reopen() of a database opened with Xapian::DB_MMAP.
+DEFINE_TESTCASE(mmap2, brass || chert) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap2");
+    Xapian::Document doc;
+    doc.add_term("foo");
+    wdb.add_document(doc);
+    wdb.commit();
+
+    Xapian::Database db(get_named_writable_database_path("mmap2"),
+			Xapian::DB_MMAP);
+    TEST_EQUAL(db.get_doccount(), 1);
+    TEST_EQUAL(db.get_termfreq("foo"), 1);
+
+    // Add enough documents that the file needs to grow.
+    for (int i = 0; i != 300; ++i) {
+	doc.add_term("bar" + str(i));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    TEST(db.reopen());
+    TEST_EQUAL(db.get_doccount(), 301);
+    TEST_EQUAL(db.get_termfreq("foo"), 301);
+    TEST_EQUAL(db.get_termfreq("bar299"), 1);
+    TEST_EQUAL(db.get_document(301).termlist_count(), 301);
+
+    return true;
+}
+
+/// Check an iterator over a database opened with DB_MMAP survives reopen().
+DEFINE_TESTCASE(mmap3, brass || chert) {
+    Xapian::WritableDatabase wdb = get_named_writable_database("mmap3");
+    for (int i = 0; i != 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("a" + str(i));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+
+    Xapian::Database db(get_named_writable_database_path("mmap3"),
+			Xapian::DB_MMAP);
+    // Position the iterator's cursor, with blocks from the current mapping.
+    Xapian::TermIterator t = db.allterms_begin("a5");
+    TEST(t != db.allterms_end("a5"));
+    TEST_EQUAL(*t, "a5");
+
+    // Change the database enough that the postlist table has to be mapped
+    // afresh on reopen().
+    for (int i = 0; i != 1000; ++i) {
+	Xapian::Document doc;
+	doc.add_term("a" + str(i));
+	doc.add_term("b" + str(i));
+	wdb.add_document(doc);
+    }
+    wdb.commit();
+    TEST(db.reopen());
+
+    // The iterator should carry on from where it was in the new revision.
+    ++t;
+    TEST(t != db.allterms_end("a5"));
+    TEST_EQUAL(*t, "a50");
+    TEST_EQUAL(t.get_termfreq(), 2);
+    Xapian::termcount count = 1;
+    while (++t != db.allterms_end("a5")) ++count;
+    TEST_EQUAL(count, 110);
+
+    return true;
+}
+
+static void
+make_searchthreads3_db(Xapian::WritableDatabase &db, const string &)
+{
+    for (Xapian::docid did = 1; did <= 12000; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	doc.add_term("t" + str(did % 7), did % 5 + 1);
+	doc.add_term("u" + str(did % 13), did % 3 + 1);
+	if (did % 97 == 0) doc.add_term("rare", did % 4 + 1);
+	doc.add_value(0, Xapian::sortable_serialise(did % 101));
+	doc.add_value(1, str(did % 17));
+	db.add_document(doc);
+    }
+}
+
+/// Test that splitting a database into docid ranges gives the same results.
+DEFINE_TESTCASE(searchthreads3, generated) {
+    Xapian::Database db = get_database("searchthreads3",
+				       make_searchthreads3_db);
+    Xapian::Enquire enquire(db);
+    Xapian::Query query(Xapian::Query::OP_OR,
+			Xapian::Query("t3"),
+			Xapian::Query("u5"));
+    query = Xapian::Query(Xapian::Query::OP_OR, query, Xapian::Query("rare"));
+    enquire.set_query(query);
+
+    for (int testcase = 0; testcase != 6; ++testcase) {
+	tout << "testcase=" << testcase << endl;
+	Xapian::doccount first = 0;
+	switch (testcase) {
+	    case 0:
+		break;
+	    case 1:
+		enquire.set_sort_by_value_then_relevance(0, true);
+		break;
+	    case 2:
+		enquire.set_sort_by_relevance_then_value(0, false);
+		break;
+	    case 3:
+		enquire.set_sort_by_relevance();
+		enquire.set_collapse_key(1);
+		break;
+	    case 4:
+		enquire.set_collapse_key(Xapian::BAD_VALUENO);
+		enquire.set_cutoff(80);
+		break;
+	    case 5:
+		enquire.set_cutoff(0);
+		first = 20;
+		break;
+	}
+	enquire.set_search_threads(1);
+	Xapian::MSet all_mset = enquire.get_mset(0, db.get_doccount());
+	for (Xapian::doccount maxitems = 1; maxitems <= 100; maxitems *= 10) {
+	    enquire.set_search_threads(1);
+	    Xapian::MSet serial_mset = enquire.get_mset(first, maxitems);
+	    enquire.set_search_threads(4);
+	    Xapian::MSet mset = enquire.get_mset(first, maxitems);
+	    TEST_EQUAL(mset.size(), serial_mset.size());
+	    TEST(mset_range_is_same(mset, 0, serial_mset, 0, mset.size()));
+	    TEST(mset_range_is_same_percents(mset, 0, serial_mset, 0,
+					     mset.size()));
+	    TEST_REL(mset.get_matches_lower_bound(),<=,all_mset.size());
+	    TEST_REL(mset.get_matches_upper_bound(),>=,all_mset.size());
+	}
+    }
+
+    return true;
+}
+
+/// Test fetching many documents, with data which is and isn't compressible.
+DEFINE_TESTCASE(fetchdocs3, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+    unsigned seed = 42;
+    for (int n = 0; n != 100; ++n) {
+	Xapian::Document doc;
+	string data;
+	if (n % 2 == 0) {
+	    data.assign(5000 + n, 'a' + n % 26);
+	} else {
+	    for (int i = 0; i != 3000 + n; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data += char(seed >> 16);
+	    }
+	}
+	doc.set_data(data);
+	doc.add_value(1, data.substr(0, 2000));
+	doc.add_term("big");
+	db.add_document(doc);
+    }
+    db.commit();
+
+    Xapian::Enquire enquire(db);
+    enquire.set_query(Xapian::Query("big"));
+    Xapian::MSet mset = enquire.get_mset(0, 100);
+    TEST_EQUAL(mset.size(), 100);
+    mset.fetch();
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	Xapian::Document doc = i.get_document();
+	Xapian::Document expected = db.get_document(*i);
+	TEST_EQUAL(doc.get_data(), expected.get_data());
+	TEST_EQUAL(doc.get_value(1), expected.get_value(1));
+	TEST_EQUAL(doc.get_data().size(), (*i % 2 ? 5000 : 3000) + *i - 1);
+    }
+
+    return true;
+}
+
+/// Test that set_flush_memory_limit() makes brass flush by memory used.
+DEFINE_TESTCASE(flushmemory1, brass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    db.set_flush_memory_limit(200000);
+    Xapian::Database rodb(get_writable_database_as_database());
+
+    // Documents with few terms shouldn't use enough memory to flush.
+    for (int n = 0; n != 20; ++n) {
+	Xapian::Document doc;
+	doc.add_term("small");
+	db.add_document(doc);
+    }
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 0);
+
+    // But a few large documents should.
+    Xapian::doccount added = 20;
+    while (rodb.get_doccount() == 0) {
+	TEST_REL(added,<,100);
+	Xapian::Document doc;
+	for (int i = 0; i != 1000; ++i) {
+	    doc.add_term("term" + str(added) + "_" + str(i));
+	}
+	doc.add_value(0, string(1000, 'v'));
+	db.add_document(doc);
+	++added;
+	rodb.reopen();
+    }
+    TEST_REL(rodb.get_doccount(),<=,added);
+
+    // With the limit removed, we flush after the usual number of documents.
+    db.set_flush_memory_limit(0);
+    db.commit();
+    Xapian::doccount committed = db.get_doccount();
+    for (int n = 0; n != 20; ++n) {
+	Xapian::Document doc;
+	for (int i = 0; i != 1000; ++i) {
+	    doc.add_term("more" + str(n) + "_" + str(i));
+	}
+	db.add_document(doc);
+    }
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), committed);
+
+    return true;
+}
+
+/// Check buffered postlist changes made out of docid order are merged right.
+DEFINE_TESTCASE(unorderedchanges1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    Xapian::Document doc;
+    doc.add_term("foo", 2);
+    db.replace_document(7, doc);
+    db.replace_document(3, doc);
+    db.replace_document(5, doc);
+    doc.add_term("foo", 3);
+    db.replace_document(3, doc);
+    db.delete_document(7);
+    db.replace_document(1, doc);
+    db.replace_document(7, doc);
+    db.delete_document(5);
+    db.commit();
+
+    TEST_EQUAL(db.get_termfreq("foo"), 3);
+    TEST_EQUAL(db.get_collection_freq("foo"), 15);
+    Xapian::PostingIterator p = db.postlist_begin("foo");
+    TEST(p != db.postlist_end("foo"));
+    TEST_EQUAL(*p, 1);
+    TEST_EQUAL(p.get_wdf(), 5);
+    ++p;
+    TEST(p != db.postlist_end("foo"));
+    TEST_EQUAL(*p, 3);
+    TEST_EQUAL(p.get_wdf(), 5);
+    ++p;
+    TEST(p != db.postlist_end("foo"));
+    TEST_EQUAL(*p, 7);
+    TEST_EQUAL(p.get_wdf(), 5);
+    ++p;
+    TEST(p == db.postlist_end("foo"));
+
+    return true;
+}
+
+/// Test commit_async() and wait_for_commit().
+DEFINE_TESTCASE(commitasync1, writable && !inmemory) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Database rodb(get_writable_database_as_database());
+
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit_async();
+    // We can keep modifying the database while the commit completes.
+    db.add_document(doc);
+    db.commit_async();
+    db.add_document(doc);
+    db.wait_for_commit();
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 2);
+    TEST_EQUAL(rodb.get_termfreq("foo"), 2);
+
+    // commit() waits for any commit in progress.
+    db.commit_async();
+    db.commit();
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 3);
+
+    // Nothing to commit should be fine too.
+    db.commit_async();
+    db.wait_for_commit();
+    db.wait_for_commit();
+    TEST_EQUAL(db.get_doccount(), 3);
+
+    // Transactions can't be committed asynchronously.
+    db.begin_transaction();
+    TEST_EXCEPTION(Xapian::InvalidOperationError, db.commit_async());
+    db.cancel_transaction();
+    return true;
+}
+
+/// Test that set_commit_window() groups calls to commit_async().
+DEFINE_TESTCASE(commitwindow1, brass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Database rodb(get_writable_database_as_database());
+    db.set_commit_window(1000);
+
+    Xapian::Document doc;
+    doc.add_term("foo");
+    db.add_document(doc);
+    db.commit();
+    db.add_document(doc);
+    // This is within the window after the commit() so is deferred.
+    db.commit_async();
+    db.add_document(doc);
+    db.commit_async();
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 1);
+    // wait_for_commit() commits the deferred changes.
+    db.wait_for_commit();
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 3);
+
+    // With no window, every call commits.
+    db.set_commit_window(0);
+    db.add_document(doc);
+    db.commit_async();
+    db.wait_for_commit();
+    rodb.reopen();
+    TEST_EQUAL(rodb.get_doccount(), 4);
+    return true;
+}
+
+/// Return the docids matching @a query, in ascending order.
+static vector<Xapian::docid>
+matching_docids(const Xapian::Database & db, const Xapian::Query & query)
+{
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    enq.set_docid_order(Xapian::Enquire::ASCENDING);
+    enq.set_weighting_scheme(Xapian::BoolWeight());
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    vector<Xapian::docid> result(mset.begin(), mset.end());
+    sort(result.begin(), result.end());
+    return result;
+}
+
+/// Check boolean filters on dense terms, which brass stores bitmaps for.
+static void
+check_docidbitmap_queries(const Xapian::Database & db,
+			  const set<Xapian::docid> & deleted,
+			  Xapian::docid offset = 0)
+{
+    typedef Xapian::Query Q;
+    Q even("even"), three("three"), w3("w3"), all("all");
+    Q queries[] = {
+	Q(Q::OP_FILTER, w3, Q(Q::OP_AND, even, three)),
+	Q(Q::OP_FILTER, w3, Q(Q::OP_OR, even, three)),
+	Q(Q::OP_FILTER, w3, Q(Q::OP_AND_NOT, all, even)),
+	Q(Q::OP_SCALE_WEIGHT, Q(Q::OP_AND, even, three), 0),
+	Q(Q::OP_SCALE_WEIGHT, Q(Q::OP_AND_NOT, Q(Q::OP_OR, even, three), all), 0)
+    };
+    Xapian::docid last = db.get_lastdocid();
+    for (size_t n = 0; n != sizeof(queries) / sizeof(queries[0]); ++n) {
+	tout << queries[n].get_description() << endl;
+	vector<Xapian::docid> expected;
+	// If the database has been renumbered, the document which had docid
+	// did now has docid did - offset.
+	for (Xapian::docid did = offset + 1; did - offset <= last; ++did) {
+	    if (deleted.find(did) != deleted.end()) continue;
+	    bool e = (did % 2 == 0), t = (did % 3 == 0);
+	    bool match = false;
+	    switch (n) {
+		case 0: match = (did % 7 == 3 && e && t); break;
+		case 1: match = (did % 7 == 3 && (e || t)); break;
+		case 2: match = (did % 7 == 3 && !e); break;
+		case 3: match = (e && t); break;
+		case 4: match = false; break;
+	    }
+	    if (match) expected.push_back(did - offset);
+	}
+	vector<Xapian::docid> result = matching_docids(db, queries[n]);
+	TEST_EQUAL(result.size(), expected.size());
+	TEST(result == expected);
+    }
+}
+
+/// Check queries using docid bitmaps, and that they're kept up to date.
+DEFINE_TESTCASE(docidbitmap1, brass) {
+    // Enough documents that the bitmaps span more than one block.
+    const Xapian::docid N = 70000;
+    Xapian::WritableDatabase db = get_named_writable_database("docidbitmap1");
+    for (Xapian::docid did = 1; did <= N; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (did % 2 == 0) doc.add_term("even");
+	if (did % 3 == 0) doc.add_term("three");
+	doc.add_term("w" + str(did % 7), did % 5 + 1);
+	db.add_document(doc);
+    }
+    db.commit();
+    set<Xapian::docid> deleted;
+    check_docidbitmap_queries(db, deleted);
+
+    // Modify the database, including changes which need flushing before
+    // the bitmaps are used.
+    for (Xapian::docid did = 1; did <= N; did += 997) {
+	db.delete_document(did);
+	deleted.insert(did);
+    }
+    check_docidbitmap_queries(db, deleted);
+    db.commit();
+    check_docidbitmap_queries(db, deleted);
+
+    string cmd = XAPIAN_BIN_PATH"xapian-check ";
+    cmd += get_named_writable_database_path("docidbitmap1");
+    cmd += " >/dev/null";
+    TEST_EQUAL(system(cmd.c_str()), 0);
+
+    // Compaction should rebuild the bitmaps with the docids renumbered.
+    string outpath = get_named_writable_database_path("docidbitmap1out");
+    rm_rf(outpath);
+    Xapian::Compactor compact;
+    compact.set_destdir(outpath);
+    compact.add_source(get_named_writable_database_path("docidbitmap1"));
+    compact.compact();
+    Xapian::Database out(outpath);
+    // Document 1 was deleted, so the docids all move down by one, which
+    // shifts the bits in every bitmap block.
+    TEST_EQUAL(out.get_lastdocid(), N - 1);
+    check_docidbitmap_queries(out, deleted, 1);
+
+    cmd = XAPIAN_BIN_PATH"xapian-check ";
+    cmd += outpath;
+    cmd += " >/dev/null";
+    TEST_EQUAL(system(cmd.c_str()), 0);
+
+    return true;
+}
+
+/// Return the number of blocks read to find all the matches for @a query.
+static unsigned long
+count_blocks_read(const Xapian::Database & db, const Xapian::Query & query)
+{
+    unsigned long before = Xapian::get_block_cache_hits() +
+			   Xapian::get_block_cache_misses();
+    Xapian::Enquire enq(db);
+    enq.set_query(query);
+    (void)enq.get_mset(0, db.get_doccount());
+    return Xapian::get_block_cache_hits() + Xapian::get_block_cache_misses() -
+	   before;
+}
+
+/// Check that boolean queries use the docid bitmaps rather than postlists.
+DEFINE_TESTCASE(docidbitmap2, brass) {
+    const Xapian::docid N = 70000;
+    {
+	Xapian::WritableDatabase db =
+	    get_named_writable_database("docidbitmap2");
+	for (Xapian::docid did = 1; did <= N; ++did) {
+	    Xapian::Document doc;
+	    // Large wdfs make the postlists much bigger than the bitmaps.
+	    if (did % 2 == 0) doc.add_term("even", did);
+	    if (did % 3 == 0) doc.add_term("three", did);
+	    db.add_document(doc);
+	}
+	db.commit();
+    }
+
+    // Every block read from a read-only database goes through the block
+    // cache, so we can use it to count them.
+    size_t old_size = Xapian::get_block_cache_size();
+    Xapian::set_block_cache_size(16 * 1024 * 1024);
+    try {
+	Xapian::Database db(get_named_writable_database_path("docidbitmap2"));
+	typedef Xapian::Query Q;
+	Q both(Q::OP_AND, Q("even"), Q("three"));
+	unsigned long postlist_reads = count_blocks_read(db, both);
+	unsigned long bitmap_reads =
+	    count_blocks_read(db, Q(Q::OP_SCALE_WEIGHT, both, 0));
+	tout << "Blocks read: " << postlist_reads << " using postlists, "
+	     << bitmap_reads << " using bitmaps" << endl;
+	TEST_REL(bitmap_reads * 4,<,postlist_reads);
+    } catch (...) {
+	Xapian::set_block_cache_size(old_size);
+	throw;
+    }
+    Xapian::set_block_cache_size(old_size);
+
+    return true;
+}
+
+/// Check the filter cache gives the right results as the database changes.
+DEFINE_TESTCASE(filtercache1, brass || chert) {
+    Xapian::WritableDatabase db = get_writable_database();
+    for (Xapian::docid did = 1; did <= 100; ++did) {
+	Xapian::Document doc;
+	doc.add_term("all");
+	if (did % 3 == 0) doc.add_term("Tx");
+	if (did % 5 == 0) doc.add_term("Ty");
+	doc.add_value(0, Xapian::sortable_serialise(did));
+	db.add_document(doc);
+    }
+    db.commit();
+    Xapian::Database rodb(get_writable_database_as_database());
+    db.set_filter_cache_size(1 << 20);
+    rodb.set_filter_cache_size(1 << 20);
+
+    typedef Xapian::Query Q;
+    Q filter(Q::OP_AND,
+	     Q(Q::OP_OR, Q("Tx"), Q("Ty")),
+	     Q(Q::OP_VALUE_LE, 0, Xapian::sortable_serialise(50)));
+    Q query(Q::OP_FILTER, Q("all"), filter);
+
+    // Run each query twice, so the second run uses the cache.
+    for (int n = 0; n != 2; ++n) {
+	TEST_EQUAL(matching_docids(db, query).size(), 23);
+	TEST_EQUAL(db.get_filter_cache_hits(), unsigned(n));
+	TEST_EQUAL(matching_docids(rodb, query).size(), 23);
+	Xapian::Enquire enq(rodb);
+	enq.set_query(query);
+	Xapian::MSet mset = enq.get_mset(0, 10);
+	TEST_EQUAL(mset.get_termfreq("Tx"), 33);
+	TEST_EQUAL(mset.get_matches_estimated(), 23);
+	TEST_EQUAL(rodb.get_filter_cache_hits(), unsigned(n * 2 + 1));
+    }
+
+    // Modifying the database should empty its cache.
+    db.delete_document(3);
+    TEST_EQUAL(matching_docids(db, query).size(), 22);
+    Xapian::Document doc;
+    doc.add_term("all");
+    doc.add_term("Ty");
+    doc.add_value(0, Xapian::sortable_serialise(4));
+    db.replace_document(4, doc);
+    TEST_EQUAL(matching_docids(db, query).size(), 23);
+    TEST_EQUAL(matching_docids(db, query).front(), 4);
+
+    // The reader keeps its cache until it's reopened.
+    TEST_EQUAL(matching_docids(rodb, query).front(), 3);
+    db.commit();
+    TEST_EQUAL(matching_docids(rodb, query).front(), 3);
+    TEST(rodb.reopen());
+    TEST_EQUAL(matching_docids(rodb, query).front(), 4);
+
+    // A cache too small for any entries still gives the right results.
+    rodb.set_filter_cache_size(1);
+    unsigned long hits = rodb.get_filter_cache_hits();
+    TEST_EQUAL(matching_docids(rodb, query).size(), 23);
+    TEST_EQUAL(matching_docids(rodb, query).size(), 23);
+    TEST_EQUAL(rodb.get_filter_cache_hits(), hits);
+    return true;
+}
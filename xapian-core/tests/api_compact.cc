@@ -33,7 +33,10 @@
 
 #include <cstdlib>
 #include <fstream>
+#include <map>
 
+#include "realtime.h"
+#include "safesysstat.h"
 #include "str.h"
 #include "utils.h"
 #include "unixcmds.h"
@@ -461,3 +464,350 @@ DEFINE_TESTCASE(compactmissingtables1, generated) {
     return true;
 }
 
+
+// Test compacting a brass database with packed posting lists.
+DEFINE_TESTCASE(compactpacked1, brass) {
+    string indbpath = get_named_writable_database_path("compactpacked1in");
+    {
+	Xapian::WritableDatabase db(indbpath, Xapian::DB_CREATE_OR_OVERWRITE |
+					      Xapian::DB_PACKED_POSTLISTS);
+	for (Xapian::docid did = 1; did <= 5000; ++did) {
+	    Xapian::Document doc;
+	    doc.add_term("a", did % 5 + 1);
+	    if (did % 3 == 0) doc.add_term("b");
+	    db.add_document(doc);
+	}
+	db.delete_document(4000);
+	db.commit();
+    }
+
+    string outdbpath = get_named_writable_database_path("compactpacked1out");
+    rm_rf(outdbpath);
+
+    Xapian::Compactor compact;
+    compact.set_destdir(outdbpath);
+    compact.add_source(indbpath);
+    compact.add_source(indbpath);
+    compact.compact();
+
+    {
+	Xapian::Database indb(indbpath);
+	Xapian::Database outdb(outdbpath);
+	TEST_EQUAL(indb.get_doccount() * 2, outdb.get_doccount());
+	dbcheck(outdb, outdb.get_doccount(), outdb.get_lastdocid());
+	// Check the postings from the second copy of the input.
+	Xapian::docid offset = outdb.get_lastdocid() - indb.get_lastdocid();
+	Xapian::PostingIterator i = indb.postlist_begin("a");
+	Xapian::PostingIterator o = outdb.postlist_begin("a");
+	o.skip_to(offset + 1);
+	while (i != indb.postlist_end("a")) {
+	    TEST(o != outdb.postlist_end("a"));
+	    TEST_EQUAL(*i + offset, *o);
+	    TEST_EQUAL(i.get_wdf(), o.get_wdf());
+	    ++i;
+	    ++o;
+	}
+	TEST(o == outdb.postlist_end("a"));
+    }
+
+    // The output should be writable, and read back correctly after being
+    // modified.
+    Xapian::WritableDatabase outdb(outdbpath, Xapian::DB_OPEN);
+    Xapian::doccount termfreq = outdb.get_termfreq("a");
+    for (Xapian::docid did = 1; did <= 1000; ++did)
+	outdb.delete_document(did);
+    outdb.commit();
+    TEST_EQUAL(outdb.get_termfreq("a"), termfreq - 1000);
+    dbcheck(outdb, outdb.get_doccount(), outdb.get_lastdocid());
+
+    return true;
+}
+
+DEFINE_TESTCASE(bulkbuild1, brass) {
+    string outdbpath = get_named_writable_database_path("bulkbuild1");
+    rm_rf(outdbpath);
+
+    {
+	Xapian::BulkBuilder builder(outdbpath, 3);
+	builder.set_batch_size(7);
+	for (int i = 1; i <= 50; ++i) {
+	    builder.add_record("record number " + str(i));
+	}
+	builder.finish();
+	TEST_EXCEPTION(Xapian::InvalidOperationError,
+		       builder.add_record("too late"));
+    }
+
+    // The directory holding the runs should have been removed.
+    TEST(!dir_exists(outdbpath + "/bulkruns"));
+
+    Xapian::Database db(outdbpath);
+    TEST_EQUAL(db.get_doccount(), 50);
+    TEST_EQUAL(db.get_lastdocid(), 50);
+    TEST_EQUAL(db.get_termfreq("record"), 50);
+    TEST_EQUAL(db.get_termfreq("number"), 50);
+    for (Xapian::docid did = 1; did <= 50; ++did) {
+	TEST_EQUAL(db.get_document(did).get_data(), "record number " + str(did));
+	Xapian::PostingIterator p = db.postlist_begin(str(did));
+	TEST(p != db.postlist_end(str(did)));
+	TEST_EQUAL(*p, did);
+    }
+    dbcheck(db, 50, 50);
+
+    // Building with no records should give an empty database.
+    rm_rf(outdbpath);
+    {
+	Xapian::BulkBuilder builder(outdbpath, 2);
+	builder.finish();
+    }
+    TEST_EQUAL(Xapian::Database(outdbpath).get_doccount(), 0);
+
+    return true;
+}
+
+/// BulkIndexer which fails to index a particular record.
+class FailingBulkIndexer : public Xapian::BulkIndexer {
+  public:
+    void index(const string & record,
+	       Xapian::Document & doc,
+	       Xapian::TermGenerator & termgen) const {
+	if (record == "bad")
+	    throw Xapian::InvalidArgumentError("bad record");
+	Xapian::BulkIndexer::index(record, doc, termgen);
+    }
+};
+
+/// Check errors on worker threads are reported.
+DEFINE_TESTCASE(bulkbuild2, brass) {
+    string outdbpath = get_named_writable_database_path("bulkbuild2");
+    rm_rf(outdbpath);
+
+    FailingBulkIndexer indexer;
+    Xapian::BulkBuilder builder(outdbpath, indexer, 2);
+    builder.set_batch_size(10);
+    for (int i = 0; i != 35; ++i) {
+	builder.add_record(i == 23 ? "bad" : "good");
+    }
+    TEST_EXCEPTION(Xapian::InvalidArgumentError, builder.finish());
+    TEST_EXCEPTION(Xapian::InvalidOperationError, builder.finish());
+
+    return true;
+}
+
+/// Check destroying a BulkBuilder without calling finish() cleans up.
+DEFINE_TESTCASE(bulkbuild3, brass) {
+    string outdbpath = get_named_writable_database_path("bulkbuild3");
+    rm_rf(outdbpath);
+
+    {
+	// The indexer is declared first so that it outlives the builder,
+	// which waits for the batches being indexed when destroyed.
+	Xapian::BulkIndexer indexer;
+	Xapian::BulkBuilder builder(outdbpath, indexer, 3);
+	builder.set_batch_size(5);
+	for (int i = 0; i != 32; ++i) {
+	    builder.add_record("record number " + str(i));
+	}
+    }
+
+    // The directory holding the runs should have been removed.
+    TEST(!dir_exists(outdbpath + "/bulkruns"));
+
+    return true;
+}
+
+/// Compactor which records the last status reported for each table.
+class StatusCompactor : public Xapian::Compactor {
+  public:
+    map<string, string> last_status;
+
+    void set_status(const string & table, const string & status) {
+	last_status[table] = status;
+    }
+};
+
+/// Check compacting using several threads gives the same result.
+DEFINE_TESTCASE(compactthreads1, brass) {
+    string indbpath = get_database_path("apitest_simpledata");
+    string serialpath = get_named_writable_database_path("compactthreads1a");
+    string threadedpath = get_named_writable_database_path("compactthreads1b");
+    rm_rf(serialpath);
+    rm_rf(threadedpath);
+
+    for (int threaded = 0; threaded <= 1; ++threaded) {
+	StatusCompactor compact;
+	compact.set_destdir(threaded ? threadedpath : serialpath);
+	compact.set_multipass(true);
+	if (threaded) compact.set_threads(4);
+	for (int i = 0; i != 7; ++i) {
+	    compact.add_source(indbpath);
+	}
+	compact.compact();
+	TEST(!compact.last_status["postlist"].empty());
+	TEST(!compact.last_status["record"].empty());
+	TEST(!compact.last_status["termlist"].empty());
+    }
+
+    Xapian::Database serialdb(serialpath);
+    Xapian::Database threadeddb(threadedpath);
+    TEST_EQUAL(serialdb.get_doccount(), threadeddb.get_doccount());
+    TEST_EQUAL(serialdb.get_lastdocid(), threadeddb.get_lastdocid());
+    dbcheck(threadeddb, threadeddb.get_doccount(), threadeddb.get_lastdocid());
+
+    Xapian::TermIterator t = serialdb.allterms_begin();
+    Xapian::TermIterator u = threadeddb.allterms_begin();
+    while (t != serialdb.allterms_end()) {
+	TEST(u != threadeddb.allterms_end());
+	TEST_EQUAL(*t, *u);
+	TEST_EQUAL(t.get_termfreq(), u.get_termfreq());
+	TEST_EQUAL(serialdb.get_collection_freq(*t),
+		   threadeddb.get_collection_freq(*u));
+	++t;
+	++u;
+    }
+    TEST(u == threadeddb.allterms_end());
+
+    for (Xapian::docid did = 1; did <= serialdb.get_lastdocid(); ++did) {
+	TEST_EQUAL(serialdb.get_document(did).get_data(),
+		   threadeddb.get_document(did).get_data());
+    }
+
+    return true;
+}
+
+static string
+read_file(const string & path)
+{
+    ifstream in(path.c_str(), ios::in | ios::binary);
+    string data;
+    char buf[4096];
+    while (in.read(buf, sizeof(buf)) || in.gcount())
+	data.append(buf, in.gcount());
+    return data;
+}
+
+/// Check multipass merging gives the same result without temporary tables.
+DEFINE_TESTCASE(compactmultipass1, brass) {
+    string indbpath = get_database_path("compactmultichunks1in",
+					make_multichunk_db, "");
+    string singlepath = get_named_writable_database_path("compactmultipass1a");
+    string multipath = get_named_writable_database_path("compactmultipass1b");
+    rm_rf(singlepath);
+    rm_rf(multipath);
+
+    for (int multipass = 0; multipass <= 1; ++multipass) {
+	Xapian::Compactor compact;
+	compact.set_destdir(multipass ? multipath : singlepath);
+	compact.set_multipass(multipass);
+	for (int i = 0; i != 7; ++i) {
+	    compact.add_source(indbpath);
+	}
+	compact.compact();
+    }
+
+    // No temporary tables should have been written to the destination.
+    TEST(!file_exists(multipath + "/tmp0_0.DB"));
+
+    string single = read_file(singlepath + "/postlist.DB");
+    TEST(!single.empty());
+    TEST(single == read_file(multipath + "/postlist.DB"));
+
+    Xapian::Database db(multipath);
+    TEST_EQUAL(db.get_doccount(), 70000);
+    TEST_EQUAL(db.get_termfreq("a"), 70000);
+    dbcheck(db, db.get_doccount(), db.get_lastdocid());
+
+    return true;
+}
+
+/// Check Compactor::set_io_rate_limit() slows down compaction.
+DEFINE_TESTCASE(compactiolimit1, brass) {
+    string indbpath = get_database_path("apitest_simpledata");
+    string outdbpath = get_named_writable_database_path("compactiolimit1");
+    rm_rf(outdbpath);
+
+    const size_t rate = 128 * 1024;
+    double start = RealTime::now();
+    {
+	Xapian::Compactor compact;
+	// Use a large block size so we write enough to be slowed down.
+	compact.set_block_size(65536);
+	compact.set_io_rate_limit(rate);
+	compact.set_destdir(outdbpath);
+	compact.add_source(indbpath);
+	compact.compact();
+    }
+    double elapsed = RealTime::now() - start;
+
+    off_t written = 0;
+    const char * tables[] = { "postlist", "record", "termlist", "position" };
+    for (size_t i = 0; i != sizeof(tables) / sizeof(tables[0]); ++i) {
+	struct stat sb;
+	if (stat(outdbpath + "/" + tables[i] + ".DB", &sb) == 0)
+	    written += sb.st_size;
+    }
+    // Allow for up to a second's worth of I/O being done in a burst.
+    TEST_REL(elapsed,>=,double(written) / rate - 1.1);
+
+    Xapian::Database db(outdbpath);
+    TEST_EQUAL(db.get_doccount(), Xapian::Database(indbpath).get_doccount());
+
+    return true;
+}
+
+static void
+make_valueindex_db(Xapian::WritableDatabase &db, const string & s)
+{
+    Xapian::Document doc;
+    for (int i = 0; i < 100; ++i) {
+	doc.clear_values();
+	doc.add_value(0, Xapian::sortable_serialise(i % 40));
+	db.add_document(doc);
+    }
+    if (s == "indexed") db.set_value_index(0);
+    db.commit();
+}
+
+/// Check compaction keeps value indexes which all the inputs have.
+DEFINE_TESTCASE(compactvalueindex1, brass) {
+    string indexed = get_database_path("compactvalueindex1a",
+				       make_valueindex_db, "indexed");
+    string unindexed = get_database_path("compactvalueindex1b",
+					 make_valueindex_db, "");
+    string outdbpath = get_named_writable_database_path("compactvalueindex1");
+
+    Xapian::Query query(Xapian::Query::OP_VALUE_RANGE, 0,
+			Xapian::sortable_serialise(20),
+			Xapian::sortable_serialise(22));
+    for (int with_unindexed = 0; with_unindexed <= 1; ++with_unindexed) {
+	rm_rf(outdbpath);
+	Xapian::Compactor compact;
+	compact.set_destdir(outdbpath);
+	compact.add_source(indexed);
+	compact.add_source(with_unindexed ? unindexed : indexed);
+	compact.compact();
+
+	Xapian::Database db(outdbpath);
+	dbcheck(db, 200, 200);
+	Xapian::Enquire enq(db);
+	enq.set_query(query);
+	Xapian::MSet mset = enq.get_mset(0, 20);
+	TEST_EQUAL(mset.size(), 12);
+	Xapian::MSetIterator i;
+	for (i = mset.begin(); i != mset.end(); ++i) {
+	    Xapian::docid v = (*i - 1) % 100 % 40;
+	    TEST(v >= 20 && v <= 22);
+	}
+
+	// Only if both inputs are indexed is the index kept, and the number
+	// of matches known exactly from it.
+	mset = enq.get_mset(0, 1);
+	if (with_unindexed) {
+	    TEST_EQUAL(mset.get_matches_lower_bound(), 1);
+	} else {
+	    TEST_EQUAL(mset.get_matches_lower_bound(), 12);
+	}
+    }
+
+    return true;
+}
@@ -1751,6 +1751,44 @@ DEFINE_TESTCASE(netstats1, remote) {
     return true;
 }
 
+// Test searching several remote databases at once gives the same results as
+// searching them locally.
+DEFINE_TESTCASE(netstats2, remote) {
+    BackendManagerLocal local_manager;
+    local_manager.set_datadir(test_driver::get_srcdir() + "/testdata/");
+
+    const char * words[] = { "paragraph", "word", "this" };
+    Xapian::Query query(Xapian::Query::OP_OR, words, words + 3);
+    const char * dbnames[] = {
+	"apitest_simpledata", "apitest_simpledata2", "apitest_simpledata2",
+	"apitest_simpledata"
+    };
+    const size_t n_dbs = sizeof(dbnames) / sizeof(dbnames[0]);
+
+    Xapian::Database db_alllocal, db_allremote;
+    for (size_t i = 0; i != n_dbs; ++i) {
+	db_alllocal.add_database(local_manager.get_database(dbnames[i]));
+	db_allremote.add_database(get_database(dbnames[i]));
+    }
+
+    Xapian::Enquire enq_alllocal(db_alllocal);
+    enq_alllocal.set_query(query);
+    Xapian::Enquire enq(db_allremote);
+    enq.set_query(query);
+    for (Xapian::doccount first = 0; first != 20; first += 5) {
+	Xapian::MSet mset_alllocal = enq_alllocal.get_mset(first, 10);
+	Xapian::MSet mset = enq.get_mset(first, 10);
+	TEST_EQUAL(mset.get_matches_lower_bound(), mset_alllocal.get_matches_lower_bound());
+	TEST_EQUAL(mset.get_matches_upper_bound(), mset_alllocal.get_matches_upper_bound());
+	TEST_EQUAL(mset.get_matches_estimated(), mset_alllocal.get_matches_estimated());
+	TEST_EQUAL(mset.get_max_attained(), mset_alllocal.get_max_attained());
+	TEST_EQUAL(mset.size(), mset_alllocal.size());
+	TEST(mset_range_is_same(mset, 0, mset_alllocal, 0, mset.size()));
+    }
+
+    return true;
+}
+
 // Coordinate matching - scores 1 for each matching term
 class MyWeight : public Xapian::Weight {
     double scale_factor;
@@ -31,8 +31,11 @@
 #include "testsuite.h"
 #include "testutils.h"
 
+#include <set>
 #include <string>
 
+#include "str.h"
+
 using namespace std;
 
 // Feature test for Query::OP_VALUE_RANGE.
@@ -247,3 +250,118 @@ DEFINE_TESTCASE(valuerange4, backend) {
     Xapian::MSet mset = enq.get_mset(0, 20);
     return true;
 }
+
+/** Check the documents matching a value range query are the right ones.
+ *
+ *  Returns the number of matching documents.
+ */
+static Xapian::doccount
+check_value_range(const Xapian::Database & db, Xapian::Query::op op,
+		  Xapian::valueno slot, const string & begin,
+		  const string & end = string())
+{
+    set<Xapian::docid> expected;
+    Xapian::ValueIterator v;
+    for (v = db.valuestream_begin(slot); v != db.valuestream_end(slot); ++v) {
+	if ((op == Xapian::Query::OP_VALUE_LE || *v >= begin) &&
+	    (op == Xapian::Query::OP_VALUE_GE || *v <= end))
+	    expected.insert(v.get_docid());
+    }
+
+    Xapian::Enquire enq(db);
+    if (op == Xapian::Query::OP_VALUE_RANGE) {
+	enq.set_query(Xapian::Query(op, slot, begin, end));
+    } else if (op == Xapian::Query::OP_VALUE_GE) {
+	enq.set_query(Xapian::Query(op, slot, begin));
+    } else {
+	enq.set_query(Xapian::Query(op, slot, end));
+    }
+    Xapian::MSet mset = enq.get_mset(0, db.get_doccount());
+    set<Xapian::docid> matched;
+    for (Xapian::MSetIterator i = mset.begin(); i != mset.end(); ++i) {
+	matched.insert(*i);
+    }
+    TEST(matched == expected);
+    return expected.size();
+}
+
+/// Check range queries on a slot with a value index.
+DEFINE_TESTCASE(valueindex1, brass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    for (int i = 0; i < 200; ++i) {
+	doc.clear_values();
+	doc.add_value(0, Xapian::sortable_serialise(i % 50));
+	if (i % 3) doc.add_value(1, str(i));
+	db.add_document(doc);
+    }
+    db.commit();
+
+    // The index is built from the existing values, and then kept up to date
+    // as documents are replaced and deleted.
+    db.set_value_index(0);
+    for (Xapian::docid did = 1; did <= 200; did += 7) {
+	doc.clear_values();
+	doc.add_value(0, Xapian::sortable_serialise(did));
+	db.replace_document(did, doc);
+    }
+    for (Xapian::docid did = 5; did <= 200; did += 11) {
+	db.delete_document(did);
+    }
+    doc.clear_values();
+    doc.add_value(1, "x");
+    db.replace_document(3, doc);
+
+    // The writer sees its uncommitted changes.
+    check_value_range(db, Xapian::Query::OP_VALUE_RANGE, 0,
+		      Xapian::sortable_serialise(10),
+		      Xapian::sortable_serialise(12));
+    db.commit();
+
+    Xapian::Database rodb(get_writable_database_as_database());
+    const Xapian::Database * dbs[] = { &db, &rodb };
+    for (size_t k = 0; k != sizeof(dbs) / sizeof(dbs[0]); ++k) {
+	const Xapian::Database & d = *dbs[k];
+	for (int n = -1; n <= 60; n += 7) {
+	    string lo = Xapian::sortable_serialise(n);
+	    string hi = Xapian::sortable_serialise(n + 2);
+	    check_value_range(d, Xapian::Query::OP_VALUE_RANGE, 0, lo, hi);
+	    check_value_range(d, Xapian::Query::OP_VALUE_GE, 0, lo);
+	    check_value_range(d, Xapian::Query::OP_VALUE_LE, 0, "", hi);
+	}
+	check_value_range(d, Xapian::Query::OP_VALUE_RANGE, 1, "1", "2");
+
+	// A narrow range is matched from the index, so the number of matches
+	// is known exactly without looking at them all.
+	Xapian::doccount count;
+	count = check_value_range(d, Xapian::Query::OP_VALUE_RANGE, 0,
+				  Xapian::sortable_serialise(10),
+				  Xapian::sortable_serialise(12));
+	TEST_REL(count, >, 1);
+	Xapian::Enquire enq(d);
+	enq.set_query(Xapian::Query(Xapian::Query::OP_VALUE_RANGE, 0,
+				    Xapian::sortable_serialise(10),
+				    Xapian::sortable_serialise(12)));
+	Xapian::MSet mset = enq.get_mset(0, 1);
+	TEST_EQUAL(mset.get_matches_lower_bound(), count);
+	TEST_EQUAL(mset.get_matches_estimated(), count);
+	TEST_EQUAL(mset.get_matches_upper_bound(), count);
+    }
+
+    // Removing the index doesn't change the results.
+    db.set_value_index(0, false);
+    db.commit();
+    TEST(rodb.reopen());
+    check_value_range(rodb, Xapian::Query::OP_VALUE_RANGE, 0,
+		      Xapian::sortable_serialise(10),
+		      Xapian::sortable_serialise(12));
+
+    return true;
+}
+
+/// Check backends which don't support value indexes say so.
+DEFINE_TESTCASE(valueindex2, writable && !brass) {
+    Xapian::WritableDatabase db = get_writable_database();
+    TEST_EXCEPTION(Xapian::UnimplementedError, db.set_value_index(0));
+    return true;
+}
@@ -730,3 +730,45 @@ DEFINE_TESTCASE(replicate5, replicas) {
     rmtmpdir(tempdir);
     return true;
 }
+
+// Check changesets are written correctly for commits done in the background.
+DEFINE_TESTCASE(replicate6, replicas) {
+    string tempdir = ".replicatmp";
+    mktmpdir(tempdir);
+    string masterpath = get_named_writable_database_path("master");
+
+    set_max_changesets(10);
+
+    Xapian::WritableDatabase orig(get_named_writable_database("master"));
+    Xapian::DatabaseMaster master(masterpath);
+    string replicapath = tempdir + "/replica";
+    Xapian::DatabaseReplica replica(replicapath);
+
+    Xapian::Document doc1;
+    doc1.set_data(string("doc1"));
+    doc1.add_posting("doc", 1);
+    doc1.add_posting("one", 1);
+    orig.add_document(doc1);
+    orig.commit();
+
+    TEST_EQUAL(replicate(master, replica, tempdir, 0, 1, 1), 1);
+    check_equal_dbs(masterpath, replicapath);
+
+    for (int i = 0; i < 3; ++i) {
+	orig.add_document(doc1);
+	orig.commit_async();
+    }
+    orig.wait_for_commit();
+
+    // The changesets should only have been published once complete.
+    TEST_EQUAL(replicate(master, replica, tempdir, 3, 0, 1), 4);
+    check_equal_dbs(masterpath, replicapath);
+    TEST(file_exists(masterpath + "/changes3"));
+    TEST(!file_exists(masterpath + "/changes3.tmp"));
+
+    // Need to close the replica before we remove the temporary directory on
+    // Windows.
+    replica.close();
+    rmtmpdir(tempdir);
+    return true;
+}
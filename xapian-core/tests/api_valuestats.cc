@@ -320,3 +320,72 @@ DEFINE_TESTCASE(valuestats5, !backend) {
 
     return true;
 }
+
+/// Check value statistics when a document is replaced by a similar one.
+DEFINE_TESTCASE(valuestats6, writable && valuestats) {
+    Xapian::WritableDatabase db = get_writable_database();
+    Xapian::Document doc;
+    doc.add_term("fish", 2);
+    doc.add_posting("chips", 1);
+    doc.add_value(0, "b");
+    doc.add_value(1, "m");
+    doc.add_value(2, "x");
+    db.add_document(doc);
+    Xapian::Document doc2;
+    doc2.add_value(1, "n");
+    db.add_document(doc2);
+    db.commit();
+
+    // Reindex with only the data and two of the values changed.
+    doc = Xapian::Document();
+    doc.set_data("changed");
+    doc.add_term("fish", 2);
+    doc.add_posting("chips", 1);
+    doc.add_value(0, "a");
+    doc.add_value(1, "z");
+    doc.add_value(2, "x");
+    db.replace_document(1, doc);
+    db.commit();
+
+    TEST_EQUAL(db.get_document(1).get_data(), "changed");
+    TEST_EQUAL(db.get_doclength(1), 3);
+    TEST_EQUAL(db.get_termfreq("fish"), 1);
+    TEST_EQUAL(db.get_collection_freq("fish"), 2);
+    TEST_EQUAL(*db.positionlist_begin(1, "chips"), 1);
+    TEST_EQUAL(db.get_document(1).get_value(0), "a");
+    TEST_EQUAL(db.get_document(1).get_value(1), "z");
+    TEST_EQUAL(db.get_document(1).get_value(2), "x");
+    // Document 1 is the only one with a value in slot 0.
+    TEST_EQUAL(db.get_value_freq(0), 1);
+    TEST_EQUAL(db.get_value_lower_bound(0), "a");
+    TEST_EQUAL(db.get_value_upper_bound(0), "a");
+    TEST_EQUAL(db.get_value_freq(1), 2);
+    TEST_EQUAL(db.get_value_lower_bound(1), "m");
+    TEST_EQUAL(db.get_value_upper_bound(1), "z");
+    TEST_EQUAL(db.get_value_freq(2), 1);
+    TEST_EQUAL(db.get_value_lower_bound(2), "x");
+    TEST_EQUAL(db.get_value_upper_bound(2), "x");
+
+    // Now add and remove value slots.
+    doc.remove_value(0);
+    doc.add_value(3, "p");
+    doc.remove_term("fish");
+    db.replace_document(1, doc);
+    db.commit();
+
+    TEST_EQUAL(db.get_document(1).get_value(0), "");
+    TEST_EQUAL(db.get_document(1).get_value(3), "p");
+    TEST_EQUAL(db.get_value_freq(0), 0);
+    TEST_EQUAL(db.get_value_freq(1), 2);
+    TEST_EQUAL(db.get_value_freq(2), 1);
+    TEST_EQUAL(db.get_value_freq(3), 1);
+    TEST_EQUAL(db.get_value_lower_bound(3), "p");
+    TEST_EQUAL(db.get_value_upper_bound(3), "p");
+    TEST_EQUAL(db.get_doclength(1), 1);
+    TEST_EQUAL(db.get_termfreq("fish"), 0);
+    Xapian::ValueIterator v = db.get_document(1).values_begin();
+    TEST(v != db.get_document(1).values_end());
+    TEST_EQUAL(v.get_valueno(), 1);
+
+    return true;
+}
@@ -43,6 +43,7 @@
 #include <cstdlib>
 #include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -1991,3 +1992,85 @@ DEFINE_TESTCASE(modifyvalues1, writable) {
 
     return true;
 }
+
+/// Test adding and replacing documents in batches.
+DEFINE_TESTCASE(batchwrite1, writable) {
+    Xapian::WritableDatabase db = get_writable_database();
+
+    vector<Xapian::Document> docs;
+    for (int i = 0; i != 5; ++i) {
+	Xapian::Document doc;
+	doc.set_data("doc" + str(i));
+	doc.add_term("Q" + str(i));
+	doc.add_term("all");
+	doc.add_value(0, str(i));
+	docs.push_back(doc);
+    }
+    vector<Xapian::docid> dids = db.add_documents(docs);
+    TEST_EQUAL(dids.size(), 5);
+    for (size_t i = 0; i != dids.size(); ++i) {
+	TEST_EQUAL(dids[i], i + 1);
+    }
+    TEST_EQUAL(db.get_doccount(), 5);
+    TEST_EQUAL(db.get_termfreq("all"), 5);
+    TEST(db.add_documents(vector<Xapian::Document>()).empty());
+
+    // Replace out of docid order, with docid 2 twice so the last one should
+    // win, and docid 7 which doesn't exist yet.
+    dids.clear();
+    docs.clear();
+    const Xapian::docid replace_dids[] = { 4, 2, 7, 2 };
+    for (size_t i = 0; i != sizeof(replace_dids) / sizeof(replace_dids[0]); ++i) {
+	Xapian::Document doc;
+	doc.set_data("new" + str(i));
+	doc.add_term("new");
+	dids.push_back(replace_dids[i]);
+	docs.push_back(doc);
+    }
+    db.replace_documents(dids, docs);
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 6);
+    TEST_EQUAL(db.get_lastdocid(), 7);
+    TEST_EQUAL(db.get_termfreq("new"), 3);
+    TEST_EQUAL(db.get_termfreq("all"), 3);
+    TEST_EQUAL(db.get_document(2).get_data(), "new3");
+    TEST_EQUAL(db.get_document(4).get_data(), "new0");
+    TEST_EQUAL(db.get_document(7).get_data(), "new2");
+    TEST_EQUAL(db.get_document(4).get_value(0), "");
+
+    // Replace by unique term - "Q0" exists, "Q9" doesn't, and the second
+    // "Q9" should replace the document added for the first.
+    vector<string> terms;
+    terms.push_back("Q0");
+    terms.push_back("Q9");
+    terms.push_back("Q9");
+    docs.clear();
+    for (size_t i = 0; i != terms.size(); ++i) {
+	Xapian::Document doc;
+	doc.set_data("term" + str(i));
+	doc.add_term(terms[i]);
+	docs.push_back(doc);
+    }
+    dids = db.replace_documents(terms, docs);
+    TEST_EQUAL(dids.size(), 3);
+    TEST_EQUAL(dids[0], 1);
+    TEST_EQUAL(dids[1], 8);
+    TEST_EQUAL(dids[2], 8);
+    db.commit();
+    TEST_EQUAL(db.get_doccount(), 7);
+    TEST_EQUAL(db.get_document(1).get_data(), "term0");
+    TEST_EQUAL(db.get_document(8).get_data(), "term2");
+
+    // Check the arguments are validated.
+    dids.assign(1, 1);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.replace_documents(dids, vector<Xapian::Document>()));
+    dids.assign(1, 0);
+    docs.resize(1);
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.replace_documents(dids, docs));
+    terms.assign(1, string());
+    TEST_EXCEPTION(Xapian::InvalidArgumentError,
+		   db.replace_documents(terms, docs));
+    return true;
+}
@@ -320,9 +320,17 @@ BackendManagerRemoteTcp::~BackendManagerRemoteTcp() {
 std::string
 BackendManagerRemoteTcp::get_dbtype() const
 {
+    if (threads) return "remotetcpthreaded_" + remote_type;
     return "remotetcp_" + remote_type;
 }
 
+std::string
+BackendManagerRemoteTcp::get_read_only_args() const
+{
+    if (!threads) return string();
+    return "--threads " + str(threads) + " ";
+}
+
 Xapian::Database
 BackendManagerRemoteTcp::do_get_database(const vector<string> & files)
 {
@@ -344,7 +352,8 @@ Xapian::Database
 BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
 					     unsigned int timeout)
 {
-    string args = get_remote_database_args(files, timeout);
+    string args = get_read_only_args();
+    args += get_remote_database_args(files, timeout);
     int port = launch_xapian_tcpsrv(args);
     return Xapian::Remote::open(LOCALHOST, port);
 }
@@ -352,7 +361,8 @@ BackendManagerRemoteTcp::get_remote_database(const vector<string> & files,
 Xapian::Database
 BackendManagerRemoteTcp::get_writable_database_as_database()
 {
-    string args = get_writable_database_as_database_args();
+    string args = get_read_only_args();
+    args += get_writable_database_as_database_args();
     int port = launch_xapian_tcpsrv(args);
     return Xapian::Remote::open(LOCALHOST, port);
 }
@@ -38,13 +38,22 @@ class BackendManagerRemoteTcp : public BackendManagerRemote {
     /// The path of the last writable database used.
     std::string last_wdb_name;
 
+    /** The number of threads for xapian-tcpsrv --threads to use when
+     *  serving read-only databases, or 0 to fork for each connection.
+     */
+    unsigned threads;
+
+    /// Get the arguments to add to serve a read-only database.
+    std::string get_read_only_args() const;
+
   private:
     /// Create a Xapian::Database object indexing multiple files.
     Xapian::Database do_get_database(const std::vector<std::string> & files);
 
   public:
-    BackendManagerRemoteTcp(const std::string & remote_type_)
-	: BackendManagerRemote(remote_type_) { }
+    BackendManagerRemoteTcp(const std::string & remote_type_,
+			    unsigned threads_ = 0)
+	: BackendManagerRemote(remote_type_), threads(threads_) { }
 
     ~BackendManagerRemoteTcp();
 
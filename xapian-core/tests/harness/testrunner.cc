@@ -60,8 +60,10 @@ static BackendProperties backend_properties[] = {
     { "multi_chert", "backend,positional,valuestats,multi" },
     { "remoteprog_brass", "backend,remote,transactions,positional,valuestats,writable,metadata" },
     { "remotetcp_brass", "backend,remote,transactions,positional,valuestats,writable,metadata" },
+    { "remotetcpthreaded_brass", "backend,remote,transactions,positional,valuestats,writable,metadata" },
     { "remoteprog_chert", "backend,remote,transactions,positional,valuestats,writable,metadata" },
     { "remotetcp_chert", "backend,remote,transactions,positional,valuestats,writable,metadata" },
+    { "remotetcpthreaded_chert", "backend,remote,transactions,positional,valuestats,writable,metadata" },
     { NULL, NULL }
 };
 
@@ -233,6 +235,13 @@ TestRunner::run_tests(int argc, char ** argv)
 	    BackendManagerRemoteTcp m("brass");
 	    do_tests_for_backend(&m);
 	}
+#if defined HAVE_PTHREAD && defined HAVE_SYS_EPOLL_H
+	{
+	    // Serve read-only databases with xapian-tcpsrv --threads.
+	    BackendManagerRemoteTcp m("brass", 2);
+	    do_tests_for_backend(&m);
+	}
+#endif
 #endif
 #ifdef XAPIAN_HAS_CHERT_BACKEND
 	{
@@ -243,6 +252,12 @@ TestRunner::run_tests(int argc, char ** argv)
 	    BackendManagerRemoteTcp m("chert");
 	    do_tests_for_backend(&m);
 	}
+#if defined HAVE_PTHREAD && defined HAVE_SYS_EPOLL_H
+	{
+	    BackendManagerRemoteTcp m("chert", 2);
+	    do_tests_for_backend(&m);
+	}
+#endif
 #endif
 #endif
     } catch (const Xapian::Error &e) {
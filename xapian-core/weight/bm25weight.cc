@@ -175,9 +175,16 @@ Xapian::weight
 BM25Weight::get_maxpart() const
 {
     LOGCALL(WTCALC, Xapian::weight, "BM25Weight::get_maxpart", NO_ARGS);
+    RETURN(get_maxpart_for_wdf(get_wdf_upper_bound()));
+}
+
+Xapian::weight
+BM25Weight::get_maxpart_for_wdf(Xapian::termcount wdf_ub) const
+{
+    LOGCALL(WTCALC, Xapian::weight, "BM25Weight::get_maxpart_for_wdf", wdf_ub);
     Xapian::doclength normlen_lb = max(get_doclength_lower_bound() * len_factor,
 				       param_min_normlen);
-    double wdf_max(get_wdf_upper_bound());
+    double wdf_max(wdf_ub);
     double denom = param_k1 * (normlen_lb * param_b + (1 - param_b)) + wdf_max;
     AssertRel(denom,>,0);
     RETURN(termweight * (param_k1 + 1) * (wdf_max / denom));
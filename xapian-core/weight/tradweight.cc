@@ -148,9 +148,15 @@ TradWeight::get_sumpart(Xapian::termcount wdf, Xapian::termcount len) const
 
 Xapian::weight
 TradWeight::get_maxpart() const
+{
+    return get_maxpart_for_wdf(get_wdf_upper_bound());
+}
+
+Xapian::weight
+TradWeight::get_maxpart_for_wdf(Xapian::termcount wdf_ub) const
 {
     // FIXME: need to force non-zero wdf_max to stop percentages breaking...
-    double wdf_max(max(get_wdf_upper_bound(), Xapian::termcount(1)));
+    double wdf_max(max(wdf_ub, Xapian::termcount(1)));
     Xapian::termcount doclen_lb = get_doclength_lower_bound();
     return termweight * (wdf_max / (doclen_lb * len_factor + wdf_max));
 }